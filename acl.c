@@ -0,0 +1,593 @@
+/*
+ * File        : acl.c
+ * Description : Per port ingress ACLs compiled for lookup (tuple space search). The rules of a port are grouped by
+ *               their combination of masks, and every group is an open addressing hash table keyed by the masked
+ *               source, destination and ethertype, holding the lowest numbered rule of every key. Groups are ordered by
+ *               their lowest rule, so a frame is looked up group by group until no later group can hold a lower rule:
+ *               thousands of exact match rules are one lookup, a handful of prefix rules a few more.
+ *               Every change compiles a new ACL from the port's rules and publishes it to the port thread, the only
+ *               reader of the port's ACL, which takes it at its next frame and frees the one it replaces. The
+ *               forwarding path never takes a lock and never sees a half built ACL.
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "acl.h"
+#include "mac_util.h"
+
+#define MAX_PORTS 4
+#define MAX_DISPLAYED_RULES 20
+
+typedef struct acl_entry
+{
+  unsigned long long src, dest;  /* masked by the masks of the group */
+  unsigned int ethertype;
+  int rule;                      /* position of the rule in the port's rules, -1 -> empty slot */
+  int action;
+} acl_entry_t;
+
+/* rules sharing one combination of masks */
+typedef struct acl_group
+{
+  unsigned long long src_mask, dest_mask;
+  unsigned int ethertype_mask;
+  int first_rule;                /* position of its lowest rule, groups are ordered by it */
+  int count;
+  unsigned int slot_mask;        /* slots - 1, a power of two at least twice the rules */
+  acl_entry_t *slots;
+} acl_group_t;
+
+/* compiled ACL of a port */
+typedef struct acl
+{
+  int default_action;
+  int group_count;
+  acl_group_t *groups;
+} acl_t;
+
+/* rules of a port ordered by rule number, as configured */
+typedef struct acl_config
+{
+  acl_rule_t *rules;
+  int count;
+  int capacity;
+  int default_action;
+  int group_count;               /* of the last compiled ACL */
+} acl_config_t;
+
+static acl_config_t acl_config[MAX_PORTS];
+static pthread_mutex_t acl_config_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* ACL used by the port thread, only that thread reads or replaces it */
+static acl_t *acl_active[MAX_PORTS];
+/* newly compiled ACL waiting for the port thread to take it */
+static acl_t *acl_pending[MAX_PORTS];
+
+/*
+ * Function    : acl_hash
+ * @params     : src, dest, ethertype -> masked key
+ * Output      : hash of the key (murmur3 finalizer of the combined fields)
+ * */
+static unsigned int acl_hash(unsigned long long src, unsigned long long dest, unsigned int ethertype)
+{
+  unsigned long long v = src ^ (dest * 0x9e3779b97f4a7c15ULL) ^ ((unsigned long long) ethertype << 48);
+  v ^= v >> 33;
+  v *= 0xff51afd7ed558ccdULL;
+  v ^= v >> 33;
+  v *= 0xc4ceb9fe1a85ec53ULL;
+  v ^= v >> 33;
+  return v;
+}
+
+/*
+ * Function    : free_acl
+ * @params     : acl -> compiled ACL, may be NULL
+ * */
+static void free_acl(acl_t *acl)
+{
+  if(acl == NULL)
+  {
+    return;
+  }
+  for(int g = 0; g < acl->group_count; g++)
+  {
+    free(acl->groups[g].slots);
+  }
+  free(acl->groups);
+  free(acl);
+}
+
+/*
+ * Function    : compile_acl
+ * @params     : config -> rules of the port
+ * Output      : compiled ACL, NULL if malloc failed
+ * Description : Caller holds acl_config_lock
+ * */
+static acl_t *compile_acl(const acl_config_t *config)
+{
+  acl_t *acl = calloc(1, sizeof(acl_t));
+  if(acl == NULL)
+  {
+    return NULL;
+  }
+  acl->default_action = config->default_action;
+  /* at most one group per rule */
+  acl->groups = calloc(config->count ? config->count : 1, sizeof(acl_group_t));
+  int *group_of = malloc((config->count ? config->count : 1) * sizeof(int));
+  if(acl->groups == NULL || group_of == NULL)
+  {
+    free(group_of);
+    free_acl(acl);
+    return NULL;
+  }
+
+  /* groups are found in rule order, so they are ordered by their first rule */
+  for(int r = 0; r < config->count; r++)
+  {
+    const acl_rule_t *rule = &config->rules[r];
+    int g;
+    for(g = 0; g < acl->group_count; g++)
+    {
+      acl_group_t *group = &acl->groups[g];
+      if(group->src_mask == rule->src_mask && group->dest_mask == rule->dest_mask &&
+         group->ethertype_mask == rule->ethertype_mask)
+        break;
+    }
+    if(g == acl->group_count)
+    {
+      acl->groups[g].src_mask = rule->src_mask;
+      acl->groups[g].dest_mask = rule->dest_mask;
+      acl->groups[g].ethertype_mask = rule->ethertype_mask;
+      acl->groups[g].first_rule = r;
+      acl->group_count++;
+    }
+    acl->groups[g].count++;
+    group_of[r] = g;
+  }
+
+  for(int g = 0; g < acl->group_count; g++)
+  {
+    acl_group_t *group = &acl->groups[g];
+    unsigned int size = 2;
+    while(size < 2u * group->count)
+      size <<= 1;
+    group->slot_mask = size - 1;
+    group->slots = malloc(size * sizeof(acl_entry_t));
+    if(group->slots == NULL)
+    {
+      free(group_of);
+      free_acl(acl);
+      return NULL;
+    }
+    for(unsigned int i = 0; i < size; i++)
+    {
+      group->slots[i].rule = -1;
+    }
+  }
+
+  /* a key already in the group belongs to a lower numbered rule, which wins */
+  for(int r = 0; r < config->count; r++)
+  {
+    const acl_rule_t *rule = &config->rules[r];
+    acl_group_t *group = &acl->groups[group_of[r]];
+    unsigned long long src = rule->src & group->src_mask, dest = rule->dest & group->dest_mask;
+    unsigned int ethertype = rule->ethertype & group->ethertype_mask;
+    unsigned int i = acl_hash(src, dest, ethertype) & group->slot_mask;
+    for(; group->slots[i].rule != -1; i = (i + 1) & group->slot_mask)
+    {
+      acl_entry_t *entry = &group->slots[i];
+      if(entry->src == src && entry->dest == dest && entry->ethertype == ethertype)
+        break;
+    }
+    if(group->slots[i].rule == -1)
+    {
+      group->slots[i].src = src;
+      group->slots[i].dest = dest;
+      group->slots[i].ethertype = ethertype;
+      group->slots[i].rule = r;
+      group->slots[i].action = rule->action;
+    }
+  }
+  free(group_of);
+  return acl;
+}
+
+/*
+ * Function    : publish_acl
+ * @params     : port_index -> port (0 based)
+ * Output      : 0 -> the port thread uses the port's rules from its next frame, -1 -> malloc failed
+ * Description : Caller holds acl_config_lock
+ * */
+static int publish_acl(int port_index)
+{
+  acl_t *acl = compile_acl(&acl_config[port_index]);
+  if(acl == NULL)
+  {
+    perror("Error in malloc(), ACL is not updated");
+    return -1;
+  }
+  acl_config[port_index].group_count = acl->group_count;
+  /* an ACL the port thread has not taken yet was never used */
+  free_acl(__atomic_exchange_n(&acl_pending[port_index], acl, __ATOMIC_ACQ_REL));
+  return 0;
+}
+
+/*
+ * Function    : init_acls
+ * Description : Every port permits every frame at start
+ * */
+void init_acls()
+{
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    acl_config[i].count = 0;
+    acl_config[i].default_action = ACL_PERMIT;
+    acl_config[i].group_count = 0;
+    acl_active[i] = acl_pending[i] = NULL;
+  }
+}
+
+/*
+ * Function    : acl_check
+ * @params     : port_index -> port the frame was received on (0 based), called from that port's thread only
+ *               f          -> the frame, addresses null terminated
+ * Output      : ACL_PERMIT or ACL_DENY
+ * */
+int acl_check(int port_index, const frame_t *f)
+{
+  /* take a newly compiled ACL, nobody else reads the one it replaces */
+  if(__atomic_load_n(&acl_pending[port_index], __ATOMIC_RELAXED))
+  {
+    acl_t *old = acl_active[port_index];
+    acl_active[port_index] = __atomic_exchange_n(&acl_pending[port_index], NULL, __ATOMIC_ACQ_REL);
+    free_acl(old);
+  }
+  const acl_t *acl = acl_active[port_index];
+  if(acl == NULL)
+  {
+    return ACL_PERMIT;
+  }
+  if(acl->group_count == 0)
+  {
+    return acl->default_action;
+  }
+
+  unsigned long long src = mac_address_value(f->src_mac_address);
+  unsigned long long dest = mac_address_value(f->dest_mac_address);
+  unsigned int ethertype = f->ethertype ? f->ethertype : ETHERTYPE_LOCAL;
+  int best = INT_MAX, action = acl->default_action;
+  /* a group whose first rule comes after the best match can not hold a better one, nor can the groups after it */
+  for(int g = 0; g < acl->group_count && acl->groups[g].first_rule < best; g++)
+  {
+    const acl_group_t *group = &acl->groups[g];
+    unsigned long long s = src & group->src_mask, d = dest & group->dest_mask;
+    unsigned int e = ethertype & group->ethertype_mask;
+    for(unsigned int i = acl_hash(s, d, e) & group->slot_mask; group->slots[i].rule != -1; i = (i + 1) & group->slot_mask)
+    {
+      const acl_entry_t *entry = &group->slots[i];
+      if(entry->src == s && entry->dest == d && entry->ethertype == e)
+      {
+        if(entry->rule < best)
+        {
+          best = entry->rule;
+          action = entry->action;
+        }
+        break;
+      }
+    }
+  }
+  return action;
+}
+
+/*
+ * Function    : acl_add_rule
+ * @params     : port_no -> port of the ACL
+ *               rule    -> rule to add, replaces the rule with the same number
+ * Output      : 0 -> rule added, -1 -> the ACL is full or malloc failed
+ * */
+int acl_add_rule(int port_no, const acl_rule_t *rule)
+{
+  acl_config_t *config = &acl_config[port_no - 1];
+  pthread_mutex_lock(&acl_config_lock);
+  int pos = 0;
+  while(pos < config->count && config->rules[pos].rule_no < rule->rule_no)
+    pos++;
+  if(pos == config->count || config->rules[pos].rule_no != rule->rule_no)
+  {
+    if(config->count == MAX_ACL_RULES)
+    {
+      printf("Error: The ACL of port - %d has %d rules already\n", port_no, MAX_ACL_RULES);
+      pthread_mutex_unlock(&acl_config_lock);
+      return -1;
+    }
+    if(config->count == config->capacity)
+    {
+      int capacity = config->capacity ? config->capacity * 2 : 16;
+      acl_rule_t *rules = realloc(config->rules, capacity * sizeof(acl_rule_t));
+      if(rules == NULL)
+      {
+        perror("Error in realloc()");
+        pthread_mutex_unlock(&acl_config_lock);
+        return -1;
+      }
+      config->rules = rules;
+      config->capacity = capacity;
+    }
+    memmove(&config->rules[pos + 1], &config->rules[pos], (config->count - pos) * sizeof(acl_rule_t));
+    config->count++;
+  }
+  config->rules[pos] = *rule;
+  /* only the compared bits of the addresses are kept */
+  config->rules[pos].src &= rule->src_mask;
+  config->rules[pos].dest &= rule->dest_mask;
+  config->rules[pos].ethertype &= rule->ethertype_mask;
+  int ret = publish_acl(port_no - 1);
+  pthread_mutex_unlock(&acl_config_lock);
+  return ret;
+}
+
+/*
+ * Function    : acl_delete_rule
+ * @params     : port_no -> port of the ACL
+ *               rule_no -> number of the rule
+ * Output      : 0 -> rule deleted, -1 -> no such rule or malloc failed
+ * */
+int acl_delete_rule(int port_no, int rule_no)
+{
+  acl_config_t *config = &acl_config[port_no - 1];
+  pthread_mutex_lock(&acl_config_lock);
+  for(int pos = 0; pos < config->count; pos++)
+  {
+    if(config->rules[pos].rule_no == rule_no)
+    {
+      memmove(&config->rules[pos], &config->rules[pos + 1], (config->count - pos - 1) * sizeof(acl_rule_t));
+      config->count--;
+      int ret = publish_acl(port_no - 1);
+      pthread_mutex_unlock(&acl_config_lock);
+      return ret;
+    }
+  }
+  pthread_mutex_unlock(&acl_config_lock);
+  return -1;
+}
+
+/*
+ * Function    : acl_set_default
+ * @params     : port_no -> port of the ACL
+ *               action  -> ACL_PERMIT or ACL_DENY for frames no rule matches
+ * */
+void acl_set_default(int port_no, int action)
+{
+  pthread_mutex_lock(&acl_config_lock);
+  acl_config[port_no - 1].default_action = action;
+  publish_acl(port_no - 1);
+  pthread_mutex_unlock(&acl_config_lock);
+}
+
+/*
+ * Function    : acl_clear
+ * @params     : port_no -> port of the ACL
+ * Description : Removes every rule, the port permits every frame again
+ * */
+void acl_clear(int port_no)
+{
+  pthread_mutex_lock(&acl_config_lock);
+  acl_config[port_no - 1].count = 0;
+  acl_config[port_no - 1].default_action = ACL_PERMIT;
+  publish_acl(port_no - 1);
+  pthread_mutex_unlock(&acl_config_lock);
+}
+
+/*
+ * Function    : acl_get_rules
+ * @params     : port_no        -> port of the ACL
+ *               rules          -> to store the rules ordered by rule number, room for MAX_ACL_RULES, NULL -> only count
+ *               default_action -> to store the action of frames no rule matches
+ * Output      : number of rules
+ * */
+int acl_get_rules(int port_no, acl_rule_t *rules, int *default_action)
+{
+  acl_config_t *config = &acl_config[port_no - 1];
+  pthread_mutex_lock(&acl_config_lock);
+  int count = config->count;
+  if(rules && count)
+  {
+    memcpy(rules, config->rules, count * sizeof(acl_rule_t));
+  }
+  *default_action = config->default_action;
+  pthread_mutex_unlock(&acl_config_lock);
+  return count;
+}
+
+/*
+ * Function    : acl_restore
+ * @params     : port_no        -> port of the ACL, with no rules
+ *               rules          -> rules saved by acl_get_rules()
+ *               count          -> number of rules
+ *               default_action -> ACL_PERMIT or ACL_DENY
+ * Output      : 0 -> ACL restored, -1 -> invalid rules, left out, or malloc failed
+ * Description : Compiles the ACL once for all the rules, instead of once per rule as acl_add_rule() would
+ * */
+int acl_restore(int port_no, const acl_rule_t *rules, int count, int default_action)
+{
+  if(count < 0 || count > MAX_ACL_RULES || (default_action != ACL_PERMIT && default_action != ACL_DENY))
+  {
+    return -1;
+  }
+  for(int i = 0; i < count; i++)
+  {
+    /* the ACL is looked up in rule number order */
+    if(rules[i].rule_no < 1 || rules[i].rule_no > MAX_ACL_RULE_NO || (i > 0 && rules[i].rule_no <= rules[i-1].rule_no) ||
+       (rules[i].action != ACL_PERMIT && rules[i].action != ACL_DENY))
+    {
+      return -1;
+    }
+  }
+
+  acl_config_t *config = &acl_config[port_no - 1];
+  pthread_mutex_lock(&acl_config_lock);
+  if(count > config->capacity)
+  {
+    acl_rule_t *copy = realloc(config->rules, count * sizeof(acl_rule_t));
+    if(copy == NULL)
+    {
+      perror("Error in realloc()");
+      pthread_mutex_unlock(&acl_config_lock);
+      return -1;
+    }
+    config->rules = copy;
+    config->capacity = count;
+  }
+  if(count)
+  {
+    memcpy(config->rules, rules, count * sizeof(acl_rule_t));
+  }
+  config->count = count;
+  config->default_action = default_action;
+  int ret = publish_acl(port_no - 1);
+  pthread_mutex_unlock(&acl_config_lock);
+  return ret;
+}
+
+/*
+ * Function    : parse_mac_address
+ * @params     : text  -> "XX:XX:XX:XX:XX:XX"
+ *               value -> to store the 48 bit address
+ * Output      : 0 -> valid address, -1 -> invalid
+ * */
+static int parse_mac_address(const char *text, unsigned long long *value)
+{
+  if(strlen(text) != 17)
+  {
+    return -1;
+  }
+  for(int i = 0; i < 17; i++)
+  {
+    char c = text[i];
+    if(i % 3 == 2 ? c != ':' : !((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')))
+      return -1;
+  }
+  *value = mac_address_value(text);
+  return 0;
+}
+
+/*
+ * Function    : acl_parse_mac_match
+ * @params     : text  -> "any", an address, or an address and its mask as "ADDRESS/MASK" or "ADDRESS/PREFIX_LENGTH"
+ *               value -> to store the address
+ *               mask  -> to store the mask
+ * Output      : 0 -> valid match, -1 -> invalid
+ * */
+int acl_parse_mac_match(const char *text, unsigned long long *value, unsigned long long *mask)
+{
+  char address[18];
+  const char *slash = strchr(text, '/');
+
+  if(strcmp(text, "any") == 0)
+  {
+    *value = *mask = 0;
+    return 0;
+  }
+  if(slash == NULL)
+  {
+    *mask = ACL_MAC_MASK;
+    return parse_mac_address(text, value);
+  }
+  if(slash - text != 17)
+  {
+    return -1;
+  }
+  memcpy(address, text, 17);
+  address[17] = '\0';
+  if(parse_mac_address(address, value) == -1)
+  {
+    return -1;
+  }
+  if(strlen(slash + 1) == 17)
+  {
+    return parse_mac_address(slash + 1, mask);
+  }
+  char *end_ptr;
+  long prefix = strtol(slash + 1, &end_ptr, 10);
+  if(slash[1] == '\0' || *end_ptr != '\0' || prefix < 0 || prefix > 48)
+  {
+    return -1;
+  }
+  *mask = prefix ? (ACL_MAC_MASK << (48 - prefix)) & ACL_MAC_MASK : 0;
+  return 0;
+}
+
+/*
+ * Function    : format_mac_match
+ * @params     : value -> address
+ *               mask  -> its mask
+ *               text  -> buffer of 36 bytes
+ * */
+static void format_mac_match(unsigned long long value, unsigned long long mask, char *text)
+{
+  if(mask == 0)
+  {
+    strcpy(text, "any");
+    return;
+  }
+  mac_address_string(value, text);
+  if(mask != ACL_MAC_MASK)
+  {
+    text[17] = '/';
+    mac_address_string(mask, text + 18);
+  }
+}
+
+/*
+ * Function    : display_acls
+ * Description : Displays the rules and default action of every port's ACL
+ * */
+void display_acls()
+{
+  char src[36], dest[36];
+
+  pthread_mutex_lock(&acl_config_lock);
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    acl_config_t *config = &acl_config[i];
+    printf("\nPort - %d : %d rules in %d hash tables, default %s\n", i + 1, config->count, config->group_count,
+           config->default_action == ACL_PERMIT ? "permit" : "deny");
+    for(int r = 0; r < config->count && r < MAX_DISPLAYED_RULES; r++)
+    {
+      acl_rule_t *rule = &config->rules[r];
+      format_mac_match(rule->src, rule->src_mask, src);
+      format_mac_match(rule->dest, rule->dest_mask, dest);
+      printf("  %5d %-6s src %-35s dest %-35s ethertype ", rule->rule_no, rule->action == ACL_PERMIT ? "permit" : "deny",
+             src, dest);
+      if(rule->ethertype_mask)
+        printf("0x%04x\n", rule->ethertype);
+      else
+        printf("any\n");
+    }
+    if(config->count > MAX_DISPLAYED_RULES)
+    {
+      printf("  ... and %d more rules\n", config->count - MAX_DISPLAYED_RULES);
+    }
+  }
+  pthread_mutex_unlock(&acl_config_lock);
+}
+
+/*
+ * Function    : free_acls
+ * Description : Frees the rules and compiled ACLs of every port, once the port threads are stopped
+ * */
+void free_acls()
+{
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    free_acl(acl_active[i]);
+    free_acl(acl_pending[i]);
+    acl_active[i] = acl_pending[i] = NULL;
+    free(acl_config[i].rules);
+    acl_config[i].rules = NULL;
+    acl_config[i].count = acl_config[i].capacity = 0;
+  }
+}
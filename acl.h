@@ -0,0 +1,44 @@
+#ifndef ACL_H
+#define ACL_H
+
+/*
+ * File        : acl.h
+ * Description : Per port ingress ACLs. Rules permit or deny frames by source and destination mac address under a mask
+ *               and by ethertype, the rule with the lowest number that matches decides, and a port's default action
+ *               decides for frames no rule matches. Rules are compiled into one hash table per distinct combination of
+ *               masks, so a frame costs a lookup per combination whatever the number of rules.
+ * */
+
+#include "frame.h"
+
+#define ACL_PERMIT 0
+#define ACL_DENY 1
+
+#define MAX_ACL_RULES 4096      /* rules per port */
+#define MAX_ACL_RULE_NO 65535
+
+#define ACL_MAC_MASK 0xffffffffffffULL
+
+typedef struct acl_rule
+{
+  int rule_no;                    /* 1 .. MAX_ACL_RULE_NO, lower numbers are evaluated first */
+  int action;                     /* ACL_PERMIT or ACL_DENY */
+  unsigned long long src, src_mask;   /* 48 bit address and the bits of it compared, mask 0 -> any address */
+  unsigned long long dest, dest_mask;
+  unsigned int ethertype;         /* compared when ethertype_mask is 0xffff, 0 -> any ethertype */
+  unsigned int ethertype_mask;
+} acl_rule_t;
+
+void init_acls();
+int acl_check(int port_index, const frame_t *f);
+int acl_add_rule(int port_no, const acl_rule_t *rule);
+int acl_delete_rule(int port_no, int rule_no);
+void acl_set_default(int port_no, int action);
+void acl_clear(int port_no);
+int acl_get_rules(int port_no, acl_rule_t *rules, int *default_action);
+int acl_restore(int port_no, const acl_rule_t *rules, int count, int default_action);
+int acl_parse_mac_match(const char *text, unsigned long long *value, unsigned long long *mask);
+void display_acls();
+void free_acls();
+
+#endif
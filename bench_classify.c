@@ -0,0 +1,197 @@
+/*
+ * File        : bench_classify.c
+ * Description : Checks every frame classification kernel available on this cpu against the scalar one, then measures
+ *               the classification cost per frame for each of them at several batch sizes, next to the text path the
+ *               forwarding decision used before (strcmp for broadcast, group bit test, two address parses).
+ *               Build: gcc -O2 -o bench_classify bench_classify.c classify.c mac_util.c
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "frame.h"
+#include "classify.h"
+#include "mac_util.h"
+
+#define FRAMES 4096
+#define ROUNDS 2000
+#define VERIFY_ROUNDS 200
+
+static frame_t frames[FRAMES];
+static const frame_t *frame_ptrs[FRAMES];
+
+static double now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * Function    : random_address
+ * @params     : text -> to store the address
+ * Description : Random unicast, group or broadcast address, in upper or lower case
+ * */
+static void random_address(char *text)
+{
+  unsigned long long value = ((unsigned long long) rand() << 24 ^ rand()) & 0xffffffffffffULL;
+  int kind = rand() % 8;
+  if(kind == 0)
+    value = 0xffffffffffffULL;
+  else if(kind < 3)
+    value |= 1ULL << 40;
+  else
+    value &= ~(1ULL << 40);
+  mac_address_string(value, text);
+  if(rand() % 2)
+  {
+    for(int i = 0; i < 17; i++)
+      if(text[i] >= 'A' && text[i] <= 'F')
+        text[i] |= 0x20;
+  }
+}
+
+/*
+ * Function    : fill_frames
+ * @params     : invalid -> 1 in invalid frames out of that many are damaged, 0 for none
+ *               station -> address used as the source of some frames
+ * */
+static void fill_frames(int invalid, const char *station)
+{
+  static const char garbage[] = "0:gG/@`xz ";
+  for(int i = 0; i < FRAMES; i++)
+  {
+    frame_t *f = &frames[i];
+    memset(f, 0, sizeof(*f));
+    random_address(f->src_mac_address);
+    random_address(f->dest_mac_address);
+    if(rand() % 16 == 0)
+      strcpy(f->src_mac_address, station);
+    if(rand() % 16 == 0)
+      f->flags = rand() % 2 ? FRAME_FLAG_MCAST_JOIN : FRAME_FLAG_MCAST_LEAVE;
+    if(invalid && rand() % invalid == 0)
+    {
+      char *text = rand() % 2 ? f->src_mac_address : f->dest_mac_address;
+      text[rand() % 17] = garbage[rand() % (sizeof(garbage) - 1)];
+    }
+    frame_ptrs[i] = f;
+  }
+}
+
+/*
+ * Function    : verify_kernel
+ * @params     : name -> kernel name to print
+ *               fn   -> kernel to check against classify_scalar
+ * */
+static void verify_kernel(const char *name, classify_fn_t fn, unsigned long long station)
+{
+  frame_class_t expected, got;
+  for(int round = 0; round < VERIFY_ROUNDS; round++)
+  {
+    fill_frames(round % 2 ? 4 : 0, "02:00:00:00:00:01");
+    for(int i = 0; i + CLASSIFY_BATCH <= FRAMES; i += CLASSIFY_BATCH)
+    {
+      /* every batch size, so the tails of the kernels are covered */
+      int count = 1 + (i / CLASSIFY_BATCH) % CLASSIFY_BATCH;
+      memset(&got, 0x5a, sizeof(got));
+      classify_scalar(&frame_ptrs[i], count, station, &expected);
+      fn(&frame_ptrs[i], count, station, &got);
+      for(int j = 0; j < count; j++)
+      {
+        if(got.src[j] != expected.src[j] || got.dest[j] != expected.dest[j] || got.hash[j] != expected.hash[j] ||
+           got.flags[j] != expected.flags[j])
+        {
+          printf("%-10s : WRONG RESULT for \"%.17s\" -> \"%.17s\"\n", name, frame_ptrs[i + j]->src_mac_address,
+                 frame_ptrs[i + j]->dest_mac_address);
+          exit(EXIT_FAILURE);
+        }
+      }
+    }
+  }
+}
+
+/*
+ * Function    : bench_kernel
+ * @params     : name  -> kernel name to print
+ *               fn    -> kernel to measure
+ *               batch -> frames per call
+ * */
+static void bench_kernel(const char *name, classify_fn_t fn, int batch, unsigned long long station)
+{
+  frame_class_t out;
+  unsigned int sink = 0;
+  double start = now_ns();
+  for(int round = 0; round < ROUNDS; round++)
+  {
+    for(int i = 0; i + batch <= FRAMES; i += batch)
+    {
+      fn(&frame_ptrs[i], batch, station, &out);
+      sink += out.hash[0] + out.flags[batch - 1];
+    }
+  }
+  double elapsed = now_ns() - start;
+  double classified = (double) ROUNDS * (FRAMES - FRAMES % batch);
+  printf("%-10s : batch %2d : %6.2f ns/frame (sink %08x)\n", name, batch, elapsed / classified, sink);
+}
+
+/*
+ * Function    : bench_text
+ * Description : The per frame text path of the forwarding decision before the classification step
+ * */
+static void bench_text()
+{
+  unsigned long long sink = 0;
+  double start = now_ns();
+  for(int round = 0; round < ROUNDS; round++)
+  {
+    for(int i = 0; i < FRAMES; i++)
+    {
+      const frame_t *f = frame_ptrs[i];
+      int broadcast = !strcmp(f->dest_mac_address, BROADCAST_MAC_ADDRESS);
+      int group = is_multicast_mac_address(f->dest_mac_address);
+      unsigned long long src = mac_address_value(f->src_mac_address);
+      unsigned long long dest = mac_address_value(f->dest_mac_address);
+      sink += broadcast + group + (src ^ dest);
+    }
+  }
+  double elapsed = now_ns() - start;
+  printf("%-10s : batch  1 : %6.2f ns/frame (sink %08llx)\n", "text", elapsed / ((double) ROUNDS * FRAMES), sink);
+}
+
+int main()
+{
+  const unsigned long long station = 0x020000000001ULL;
+  int batches[] = {1, 4, 8, CLASSIFY_BATCH};
+
+  srand(1);
+  classify_init();
+  printf("selected implementation: %s\n", classify_impl_name());
+
+  if(classify_sse41)
+  {
+    verify_kernel("sse4.1", classify_sse41, station);
+  }
+  if(classify_avx2)
+  {
+    verify_kernel("avx2", classify_avx2, station);
+  }
+  printf("kernels agree with scalar\n");
+
+  /* valid frames, as the switch sees them; the string terminators the switch writes are in place */
+  fill_frames(0, "02:00:00:00:00:01");
+  bench_text();
+  for(int b = 0; b < (int) (sizeof(batches) / sizeof(batches[0])); b++)
+  {
+    bench_kernel("scalar", classify_scalar, batches[b], station);
+    if(classify_sse41)
+    {
+      bench_kernel("sse4.1", classify_sse41, batches[b], station);
+    }
+    if(classify_avx2)
+    {
+      bench_kernel("avx2", classify_avx2, batches[b], station);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * File        : bench_egress.c
+ * Description : Measures the latency of high priority frames through the egress scheduler while low priority traffic
+ *               saturates the port. A consumer thread plays a slow station reading the port mqueue.
+ *               Build: gcc -O2 -o bench_egress bench_egress.c egress_sched.c -lpthread -lrt
+ *               Usage: ./bench_egress [strict|wrr|fifo]   (fifo sends everything with priority 0, as before)
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <mqueue.h>
+#include <pthread.h>
+
+#include "frame.h"
+#include "egress_sched.h"
+#include "port_stats.h"
+
+#define BENCH_MQ "/bench_egress_port"
+#define RUN_SECONDS 2
+#define STATION_SERVICE_NS 50000     /* slow station: sleeps this long after every frame */
+#define TICK_NS 1000000              /* every millisecond the producer offers ... */
+#define LOW_PER_TICK 40              /* ... a burst of low priority frames, above what the station reads */
+#define HIGH_PER_TICK 1              /* ... and one high priority frame */
+#define MAX_SAMPLES 1000000
+
+/* globals the egress scheduler expects from the switch */
+mqd_t mq_send_fd[4];
+port_stats_t *port_stats;
+
+static volatile int running = 1;
+static unsigned long long latencies[2][MAX_SAMPLES];
+static int samples[2];
+
+static unsigned long long now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void make_frame(char *frame, int priority)
+{
+  unsigned long long t = now_ns();
+  memset(frame, 0, FRAME_SIZE);
+  strcpy(frame, "AA:AA:AA:AA:AA:01 AA:AA:AA:AA:AA:02 ");
+  ((frame_t *) frame)->priority = priority;
+  memcpy(((frame_t *) frame)->data, &t, sizeof(t));
+}
+
+/* slow station: records the latency of every frame it reads and sleeps STATION_SERVICE_NS after each one */
+static void *station_thread(void *arg)
+{
+  char frame[FRAME_SIZE];
+  mqd_t fd = mq_open(BENCH_MQ, O_RDONLY);
+  while(running)
+  {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec++;
+    if(mq_timedreceive(fd, frame, FRAME_SIZE, NULL, &deadline) == -1)
+    {
+      continue;
+    }
+    unsigned long long sent;
+    memcpy(&sent, ((frame_t *) frame)->data, sizeof(sent));
+    int high = (((frame_t *) frame)->priority != 0) || frame[36 + 8] == 'H';
+    if(samples[high] < MAX_SAMPLES)
+    {
+      latencies[high][samples[high]++] = now_ns() - sent;
+    }
+    struct timespec service = {0, STATION_SERVICE_NS};
+    nanosleep(&service, NULL);
+  }
+  mq_close(fd);
+  return NULL;
+}
+
+static int compare(const void *a, const void *b)
+{
+  unsigned long long x = *(const unsigned long long *) a, y = *(const unsigned long long *) b;
+  return x < y ? -1 : x > y;
+}
+
+static void report(const char *name, unsigned long long *lat, int n)
+{
+  if(n == 0)
+  {
+    printf("%-14s: no frames received\n", name);
+    return;
+  }
+  qsort(lat, n, sizeof(*lat), compare);
+  printf("%-14s: %7d frames  p50 %8.1f us  p99 %8.1f us  max %8.1f us\n", name, n,
+         lat[n / 2] / 1000.0, lat[(int) (n * 0.99)] / 1000.0, lat[n - 1] / 1000.0);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *mode = argc > 1 ? argv[1] : "strict";
+  int fifo = strcmp(mode, "fifo") == 0;
+  char frame[FRAME_SIZE];
+
+  struct mq_attr attr = {0};
+  attr.mq_maxmsg = 5;
+  attr.mq_msgsize = FRAME_SIZE;
+  mq_unlink(BENCH_MQ);
+  mq_send_fd[0] = mq_open(BENCH_MQ, O_RDWR | O_CREAT, 0600, &attr);
+  if(mq_send_fd[0] == -1)
+  {
+    perror("Error in mq_open()");
+    return EXIT_FAILURE;
+  }
+  port_stats = calloc(4, sizeof(port_stats_t));
+
+  init_egress();
+  if(strcmp(mode, "wrr") == 0)
+  {
+    unsigned int weights[EGRESS_CLASSES] = {1, 2, 4, 8};
+    set_egress_scheduler(1, EGRESS_WRR, weights);
+  }
+  start_egress(1);
+
+  pthread_t station;
+  pthread_create(&station, NULL, station_thread, NULL);
+
+  unsigned long long low_offered = 0, high_offered = 0;
+  struct timespec tick;
+  clock_gettime(CLOCK_MONOTONIC, &tick);
+  for(int t = 0; t < RUN_SECONDS * 1000; t++)
+  {
+    /* low priority burst first, so the high priority frame always finds a full low priority queue ahead of it. With a
+     * single fifo class the burst would fill it and drop every marked frame, so there the marked frame goes first and
+     * waits behind the frames of the previous bursts still queued, which is the head-of-line delay of a fifo */
+    for(int i = 0; i <= LOW_PER_TICK; i++)
+    {
+      if(i == (fifo ? 0 : LOW_PER_TICK))
+      {
+        for(int j = 0; j < HIGH_PER_TICK; j++)
+        {
+          make_frame(frame, fifo ? 0 : 7);
+          /* marks the frame as high priority for the fifo run, where the priority field is 0 */
+          frame[36 + 8] = 'H';
+          egress_enqueue(0, frame, fifo ? 0 : 7);
+          high_offered++;
+        }
+      }
+      if(i < LOW_PER_TICK)
+      {
+        make_frame(frame, 0);
+        egress_enqueue(0, frame, 0);
+        low_offered++;
+      }
+    }
+    tick.tv_nsec += TICK_NS;
+    if(tick.tv_nsec >= 1000000000L)
+    {
+      tick.tv_sec++;
+      tick.tv_nsec -= 1000000000L;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tick, NULL);
+  }
+  running = 0;
+  pthread_join(station, NULL);
+
+  printf("mode %s, %llu low and %llu high priority frames offered, %d received\n", mode, low_offered, high_offered,
+         samples[0] + samples[1]);
+  report("high priority", latencies[1], samples[1]);
+  report("low priority", latencies[0], samples[0]);
+  for(int c = EGRESS_CLASSES - 1; c >= 0; c--)
+  {
+    printf("class %d: sent %llu dropped %llu max depth %llu\n", c, port_stats[0].egress_sent[c],
+           port_stats[0].egress_dropped[c], port_stats[0].egress_max_depth[c]);
+  }
+
+  stop_egress();
+  mq_close(mq_send_fd[0]);
+  mq_unlink(BENCH_MQ);
+  return 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * File        : bench_ingress.c
+ * Description : Measures the share of the forwarding every port gets while all ports send as fast as they can. A
+ *               sender thread per port keeps its port mqueue full and the frames are received either by the deficit
+ *               round robin ingress scheduler or, with -l, by one blocking thread per port as the switch did before.
+ *               Forwarding is simulated by a fixed busy loop per frame, so the receive side is the bottleneck.
+ *               Build: gcc -O2 -o bench_ingress bench_ingress.c ingress_sched.c -lpthread -lrt
+ *               Usage: ./bench_ingress [-w <W1>,<W2>,<W3>,<W4>] [-q <QUANTUM>] [-b] [-c <CAP>] [-t <WORK_US>]
+ *                                      [-s <SECONDS>] [-l]
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <mqueue.h>
+#include <pthread.h>
+
+#include "frame.h"
+#include "ingress_sched.h"
+#include "port_stats.h"
+
+#define MAX_PORTS 4
+#define BENCH_MQ "/bench_ingress_port_%d"
+#define BENCH_MQ_DEPTH 10
+#define WARMUP_NS 500000000ULL
+#define TIMEOUT_NS 100000000L
+
+/* globals the ingress scheduler expects from the switch */
+port_stats_t *port_stats;
+
+static port_stats_t stats[MAX_PORTS];
+static mqd_t recv_fd[MAX_PORTS];
+static char buffers[MAX_PORTS][100];
+static volatile int running = 1;
+static unsigned long long work_ns = 20000;
+static unsigned long long frames[MAX_PORTS];
+static pthread_mutex_t forward_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned long long now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void deadline_in(struct timespec *deadline, long ns)
+{
+  clock_gettime(CLOCK_REALTIME, deadline);
+  deadline->tv_nsec += ns;
+  if(deadline->tv_nsec >= 1000000000L)
+  {
+    deadline->tv_sec++;
+    deadline->tv_nsec -= 1000000000L;
+  }
+}
+
+/* forwarding of one frame: a busy loop of work_ns, one frame at a time like the switch's forwarding path */
+static void forward(int port_no, int len)
+{
+  pthread_mutex_lock(&forward_lock);
+  unsigned long long end = now_ns() + work_ns;
+  while(now_ns() < end)
+    ;
+  frames[port_no - 1]++;
+  pthread_mutex_unlock(&forward_lock);
+}
+
+/* keeps the port mqueue full */
+static void *sender_thread(void *arg)
+{
+  int port_index = (int) (long) arg;
+  char name[64], frame[FRAME_SIZE];
+  snprintf(name, sizeof(name), BENCH_MQ, port_index + 1);
+  mqd_t fd = mq_open(name, O_WRONLY);
+  memset(frame, 0, sizeof(frame));
+  while(running)
+  {
+    struct timespec deadline;
+    deadline_in(&deadline, TIMEOUT_NS);
+    mq_timedsend(fd, frame, FRAME_SIZE, 0, &deadline);
+  }
+  mq_close(fd);
+  return NULL;
+}
+
+/* the switch before the ingress scheduler: a thread per port blocked in mq_receive */
+static void *legacy_thread(void *arg)
+{
+  int port_index = (int) (long) arg;
+  char frame[FRAME_SIZE];
+  while(running)
+  {
+    struct timespec deadline;
+    deadline_in(&deadline, TIMEOUT_NS);
+    int len = mq_timedreceive(recv_fd[port_index], frame, FRAME_SIZE, NULL, &deadline);
+    if(len > 0)
+      forward(port_index + 1, len);
+  }
+  return NULL;
+}
+
+/* weights "1,2,3,4" */
+static int parse_weights(const char *text, unsigned int *weights)
+{
+  return sscanf(text, "%u,%u,%u,%u", &weights[0], &weights[1], &weights[2], &weights[3]) == MAX_PORTS ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned int weights[MAX_PORTS] = {1, 2, 3, 4};
+  unsigned int quantum = INGRESS_DEFAULT_QUANTUM, cap = INGRESS_DEFAULT_CAP;
+  int unit = INGRESS_QUANTUM_FRAMES, legacy = 0, seconds = 3;
+  for(int i = 1; i < argc; i++)
+  {
+    if(strcmp(argv[i], "-w") == 0 && i + 1 < argc && parse_weights(argv[i + 1], weights) == 0)
+      i++;
+    else if(strcmp(argv[i], "-q") == 0 && i + 1 < argc)
+      quantum = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-b") == 0)
+      unit = INGRESS_QUANTUM_BYTES;
+    else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+      cap = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+      work_ns = atoll(argv[++i]) * 1000ULL;
+    else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+      seconds = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-l") == 0)
+      legacy = 1;
+    else
+    {
+      printf("Usage: ./bench_ingress [-w <W1>,<W2>,<W3>,<W4>] [-q <QUANTUM>] [-b] [-c <CAP>] [-t <WORK_US>] [-s <SECONDS>] [-l]\n");
+      printf("  -w : weight of every port (default 1,2,3,4)\n");
+      printf("  -q : quantum per unit of weight, frames or with -b bytes (frames are %d bytes)\n", FRAME_SIZE);
+      printf("  -c : frames of one port per round at most\n");
+      printf("  -t : forwarding cost per frame in us (default 20)\n");
+      printf("  -l : a blocking receive thread per port instead of the ingress scheduler\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  port_stats = stats;
+  struct mq_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.mq_maxmsg = BENCH_MQ_DEPTH;
+  attr.mq_msgsize = FRAME_SIZE;
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    char name[64];
+    snprintf(name, sizeof(name), BENCH_MQ, i + 1);
+    mq_unlink(name);
+    recv_fd[i] = mq_open(name, O_RDONLY | O_CREAT, 0600, &attr);
+    if(recv_fd[i] == -1)
+    {
+      perror("Error in mq_open()");
+      return EXIT_FAILURE;
+    }
+  }
+
+  pthread_t senders[MAX_PORTS], receivers[MAX_PORTS];
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    pthread_create(&senders[i], NULL, sender_thread, (void *) (long) i);
+  }
+  if(legacy)
+  {
+    for(int i = 0; i < MAX_PORTS; i++)
+      pthread_create(&receivers[i], NULL, legacy_thread, (void *) (long) i);
+  }
+  else
+  {
+    init_ingress();
+    for(int i = 0; i < MAX_PORTS; i++)
+      set_ingress_weight(i + 1, weights[i]);
+    set_ingress_quantum(unit, quantum);
+    set_ingress_cap(cap);
+    if(start_ingress(recv_fd, buffers, forward) == -1)
+      return EXIT_FAILURE;
+  }
+
+  /* counted once every mqueue is full */
+  unsigned long long start = now_ns(), before[MAX_PORTS];
+  while(now_ns() - start < WARMUP_NS)
+    ;
+  pthread_mutex_lock(&forward_lock);
+  memcpy(before, frames, sizeof(before));
+  start = now_ns();
+  pthread_mutex_unlock(&forward_lock);
+  struct timespec duration = {seconds, 0};
+  nanosleep(&duration, NULL);
+  pthread_mutex_lock(&forward_lock);
+  unsigned long long elapsed = now_ns() - start, counted[MAX_PORTS], total = 0;
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    counted[i] = frames[i] - before[i];
+    total += counted[i];
+  }
+  pthread_mutex_unlock(&forward_lock);
+
+  running = 0;
+  if(legacy)
+  {
+    for(int i = 0; i < MAX_PORTS; i++)
+      pthread_join(receivers[i], NULL);
+  }
+  else
+  {
+    stop_ingress();
+  }
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    pthread_join(senders[i], NULL);
+  }
+
+  unsigned int weight_sum = 0;
+  for(int i = 0; i < MAX_PORTS; i++)
+    weight_sum += weights[i];
+  if(legacy)
+    printf("receive: blocking thread per port, forwarding %llu us per frame\n", work_ns / 1000);
+  else
+    printf("receive: deficit round robin, quantum %u %s, cap %u, forwarding %llu us per frame\n", quantum,
+           unit == INGRESS_QUANTUM_BYTES ? "bytes" : "frames", cap, work_ns / 1000);
+  printf("%.0f frames/s forwarded\n", total * 1e9 / elapsed);
+  printf("port  weight      frames   share  expected\n");
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    double share = total ? 100.0 * counted[i] / total : 0.0;
+    if(legacy)
+      printf("%4d  %6s  %10llu  %5.1f%%         -\n", i + 1, "-", counted[i], share);
+    else
+      printf("%4d  %6u  %10llu  %5.1f%%    %5.1f%%\n", i + 1, weights[i], counted[i], share,
+             100.0 * weights[i] / weight_sum);
+  }
+
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    char name[64];
+    snprintf(name, sizeof(name), BENCH_MQ, i + 1);
+    mq_close(recv_fd[i]);
+    mq_unlink(name);
+  }
+  return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ * File        : bench_lag.c
+ * Description : Measures the throughput of a LAG with 1 to 4 member ports. Frames of many flows are sent to the LAG
+ *               through the egress scheduler, a consumer thread per member plays a slow station reading the port
+ *               mqueue, so one port alone is capped by its station. Also checks that no flow is reordered.
+ *               Build: gcc -O2 -o bench_lag bench_lag.c lag.c egress_sched.c mac_util.c -lpthread -lrt
+ *               Usage: ./bench_lag
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <mqueue.h>
+#include <pthread.h>
+
+#include "frame.h"
+#include "egress_sched.h"
+#include "port_stats.h"
+#include "lag.h"
+
+#define RUN_SECONDS 1
+#define FLOWS 64
+#define STATION_SERVICE_NS 50000     /* slow station: sleeps this long after every frame */
+#define TICK_NS 1000000              /* every millisecond the producer offers ... */
+#define OFFERED_PER_TICK 100         /* ... this many frames, more than four stations read */
+
+/* globals the egress scheduler expects from the switch */
+mqd_t mq_send_fd[4];
+port_stats_t *port_stats;
+
+/* every port is up, lag.c only sends on ports that are enabled and connected */
+int is_enabled(int port_index)
+{
+  return 1;
+}
+
+pid_t is_connected(int port_index)
+{
+  return 1;
+}
+
+static const char *bench_mq[4] = {"/bench_lag_port1", "/bench_lag_port2", "/bench_lag_port3", "/bench_lag_port4"};
+
+static volatile int running;
+static unsigned long long received[4];
+static unsigned long long reordered;
+static unsigned int last_seq[FLOWS];
+
+/* slow station on one member port, checks the sequence number of every flow */
+static void *station_thread(void *arg)
+{
+  int port_index = (int) (long) arg;
+  char frame[FRAME_SIZE];
+  mqd_t fd = mq_open(bench_mq[port_index], O_RDONLY);
+  while(running)
+  {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += 100000000L;
+    if(deadline.tv_nsec >= 1000000000L)
+    {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+    if(mq_timedreceive(fd, frame, FRAME_SIZE, NULL, &deadline) == -1)
+    {
+      continue;
+    }
+    unsigned int flow, seq;
+    memcpy(&flow, ((frame_t *) frame)->data, sizeof(flow));
+    memcpy(&seq, ((frame_t *) frame)->data + sizeof(flow), sizeof(seq));
+    /* a flow only ever uses one member, so no other thread touches last_seq[flow] */
+    if(seq <= last_seq[flow])
+    {
+      __atomic_add_fetch(&reordered, 1, __ATOMIC_RELAXED);
+    }
+    last_seq[flow] = seq;
+    received[port_index]++;
+    struct timespec service = {0, STATION_SERVICE_NS};
+    nanosleep(&service, NULL);
+  }
+  mq_close(fd);
+  return NULL;
+}
+
+/* runs RUN_SECONDS with a LAG of member_count ports, returns the frames received */
+static unsigned long long run(int member_count)
+{
+  char frame[FRAME_SIZE];
+  char src[FLOWS][18], dst[FLOWS][18];
+  unsigned int seq[FLOWS];
+  pthread_t station[4];
+
+  for(int f = 0; f < FLOWS; f++)
+  {
+    snprintf(src[f], sizeof(src[f]), "AA:AA:AA:AA:AA:%02X", f);
+    snprintf(dst[f], sizeof(dst[f]), "BB:BB:BB:BB:BB:%02X", f);
+    seq[f] = 0;
+    last_seq[f] = 0;
+  }
+  memset(received, 0, sizeof(received));
+  reordered = 0;
+
+  init_egress();
+  init_lags();
+  running = 1;
+  for(int i = 0; i < member_count; i++)
+  {
+    lag_add_port(1, i + 1);
+    start_egress(i + 1);
+    pthread_create(&station[i], NULL, station_thread, (void *) (long) i);
+  }
+
+  unsigned long long offered = 0, dropped = 0;
+  struct timespec tick;
+  clock_gettime(CLOCK_MONOTONIC, &tick);
+  for(int t = 0; t < RUN_SECONDS * 1000; t++)
+  {
+    for(int i = 0; i < OFFERED_PER_TICK; i++, offered++)
+    {
+      int f = offered % FLOWS;
+      memset(frame, 0, FRAME_SIZE);
+      snprintf(frame, FRAME_SIZE, "%s %s ", src[f], dst[f]);
+      seq[f]++;
+      memcpy(((frame_t *) frame)->data, &f, sizeof(f));
+      memcpy(((frame_t *) frame)->data + sizeof(f), &seq[f], sizeof(seq[f]));
+      int port_no = lag_select_port(LAG_PORT(1), src[f], dst[f]);
+      if(egress_enqueue(port_no - 1, frame, 0) == -1)
+      {
+        dropped++;
+      }
+    }
+    tick.tv_nsec += TICK_NS;
+    if(tick.tv_nsec >= 1000000000L)
+    {
+      tick.tv_sec++;
+      tick.tv_nsec -= 1000000000L;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tick, NULL);
+  }
+  running = 0;
+  for(int i = 0; i < member_count; i++)
+  {
+    pthread_join(station[i], NULL);
+  }
+  stop_egress();
+  /* frames left in the mqueues would look reordered to the next run */
+  for(int i = 0; i < member_count; i++)
+  {
+    struct timespec now = {0, 0};
+    while(mq_timedreceive(mq_send_fd[i], frame, FRAME_SIZE, NULL, &now) != -1)
+      ;
+  }
+
+  unsigned long long total = 0;
+  printf("%d member%s: ", member_count, member_count > 1 ? "s" : " ");
+  for(int i = 0; i < member_count; i++)
+  {
+    printf("port %d %6llu  ", i + 1, received[i]);
+    total += received[i];
+  }
+  printf("\n           %llu frames/s (%llu offered, %llu dropped at egress), %llu reordered\n",
+         total / RUN_SECONDS, offered, dropped, reordered);
+  return total;
+}
+
+int main(int argc, char *argv[])
+{
+  struct mq_attr attr = {0};
+  attr.mq_maxmsg = 5;
+  attr.mq_msgsize = FRAME_SIZE;
+  for(int i = 0; i < 4; i++)
+  {
+    mq_unlink(bench_mq[i]);
+    mq_send_fd[i] = mq_open(bench_mq[i], O_RDWR | O_CREAT, 0600, &attr);
+    if(mq_send_fd[i] == -1)
+    {
+      perror("Error in mq_open()");
+      return EXIT_FAILURE;
+    }
+  }
+  port_stats = calloc(4, sizeof(port_stats_t));
+
+  unsigned long long single = 0;
+  for(int members = 1; members <= 4; members++)
+  {
+    unsigned long long total = run(members);
+    if(members == 1)
+    {
+      single = total;
+    }
+    else if(single)
+    {
+      printf("           %.2fx the throughput of one port\n", (double) total / single);
+    }
+  }
+
+  for(int i = 0; i < 4; i++)
+  {
+    mq_close(mq_send_fd[i]);
+    mq_unlink(bench_mq[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,516 @@
+/*
+ * File        : bench_mac_table.c
+ * Description : MAC table microbenchmarks and hash quality analysis. Measures insert, hit lookup, miss lookup, a mixed
+ *               workload (80% hits, 10% misses, 5% new addresses, 5% oldest addresses deleted) and delete, in ns per
+ *               operation and in cache misses per hit lookup and per mixed operation when perf events are allowed:
+ *               - of the mac_table in hash_mac_table.c as the switch uses it, up to -t entries since beyond its
+ *                 TABLE_SIZE buckets every operation walks a chain of about entries / TABLE_SIZE
+ *               - of a chained table with one bucket per entry for every candidate hash function, from 1K to -m
+ *                 entries, with the bucket chain length histogram and the mean entries compared per hit lookup
+ *                 (1.5 for an ideal hash at this load)
+ *               Address sets: random (random unicast addresses), oui (sequential addresses of one vendor, a rack of
+ *               servers) and adversarial (addresses ending in 0:00, whose multiplicative hash is a multiple of 2^13). Misses
+ *               look up the same addresses in another vlan. Every mac_table change should come with these numbers.
+ *               Build: gcc -O2 -o bench_mac_table bench_mac_table.c hash_mac_table.c mac_util.c fcs.c -lpthread
+ *               Usage: ./bench_mac_table [-m <MAX_ENTRIES>] [-t <MAX_MAC_TABLE_ENTRIES>] [-s random|oui|adversarial]
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "mac_util.h"
+#include "fcs.h"
+#include "hash_mac_table.h"
+
+/* timed operations of a phase, and operations times entries compared allowed in one */
+#define MAX_OPS 2000000
+#define MAX_COMPARES 10000000.0
+#define HISTOGRAM_BINS 7
+
+unsigned int hash(int vlan_id, char *mac_address);
+void init_mac_table();
+void add_to_mac_table(int port_no, int vlan_id, char *mac_address);
+int get_port_no_from_mac_table(int vlan_id, char *mac_address);
+void delete_entry_from_mac_table(int vlan_id, char *mac_address);
+void mac_table_quiescent();
+
+typedef unsigned int (*mac_hash_fn_t)(int vlan_id, const char *mac_address);
+
+/* operations of a table under test */
+typedef struct table_ops
+{
+  const char *name;
+  void (*reset)(unsigned int entries);
+  void (*insert)(int vlan_id, char *mac_address);
+  int (*lookup)(int vlan_id, char *mac_address);
+  void (*remove)(int vlan_id, char *mac_address);
+  /* bucket chain lengths, returns the number of buckets */
+  unsigned int (*chains)(unsigned int *lengths);
+} table_ops_t;
+
+static double now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static unsigned long long rng_state = 0x9e3779b97f4a7c15ULL;
+
+static unsigned long long next_random()
+{
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 2685821657736338717ULL;
+}
+
+/* ---------------------------------------------------------------- candidate hash functions */
+
+/*
+ * Function    : hash_multiply
+ * Description : The hash of the mac_table before FNV-1a, with 10 buckets
+ * */
+static unsigned int hash_multiply(int vlan_id, const char *mac_address)
+{
+  unsigned int hash_value = vlan_id;
+  for(int i = 0; i < 17; i++)
+  {
+    hash_value += mac_address[i];
+    hash_value *= mac_address[i];
+  }
+  return hash_value;
+}
+
+/*
+ * Function    : hash_fnv1a
+ * Description : The arithmetic of hash() in hash_mac_table.c before its TABLE_SIZE mask
+ * */
+static unsigned int hash_fnv1a(int vlan_id, const char *mac_address)
+{
+  unsigned int hash_value = 2166136261u ^ vlan_id;
+  for(int i = 0; i < 17; i++)
+  {
+    hash_value = (hash_value ^ (unsigned char) mac_address[i]) * 16777619u;
+  }
+  return hash_value;
+}
+
+static unsigned long long mix64(unsigned long long v)
+{
+  v ^= v >> 33;
+  v *= 0xff51afd7ed558ccdULL;
+  v ^= v >> 33;
+  v *= 0xc4ceb9fe1a85ec53ULL;
+  v ^= v >> 33;
+  return v;
+}
+
+/* the address as its 48 bit value, so the text is parsed once and the mixing is on one word */
+static unsigned int hash_mix64(int vlan_id, const char *mac_address)
+{
+  return mix64(mac_address_value(mac_address) | (unsigned long long) vlan_id << 48);
+}
+
+/* with a key drawn at start, addresses can not be chosen to collide without knowing it */
+static unsigned long long hash_key;
+
+static unsigned int hash_keyed_mix64(int vlan_id, const char *mac_address)
+{
+  return mix64((mac_address_value(mac_address) | (unsigned long long) vlan_id << 48) ^ hash_key);
+}
+
+static unsigned int hash_crc32c(int vlan_id, const char *mac_address)
+{
+  return crc32c(mac_address, 17) ^ ((unsigned int) vlan_id * 0x9e3779b9u);
+}
+
+static const struct
+{
+  const char *name;
+  mac_hash_fn_t fn;
+} candidates[] = {
+  {"multiply", hash_multiply},
+  {"fnv1a", hash_fnv1a},
+  {"mix64", hash_mix64},
+  {"mix64-keyed", hash_keyed_mix64},
+  {"crc32c", hash_crc32c},
+};
+
+#define CANDIDATES (int) (sizeof(candidates) / sizeof(candidates[0]))
+
+/* ---------------------------------------------------------------- chained table of one bucket per entry */
+
+typedef struct node
+{
+  char mac_address[18];
+  short vlan_id;
+  int next;       /* index of the next node of the chain, -1 -> end */
+} node_t;
+
+static node_t *nodes;
+static int node_count;
+static int *buckets;
+static unsigned int bucket_mask;
+static mac_hash_fn_t model_hash;
+
+static void model_reset(unsigned int entries)
+{
+  unsigned int size = 1;
+  while(size < entries)
+    size <<= 1;
+  bucket_mask = size - 1;
+  free(buckets);
+  buckets = malloc(size * sizeof(int));
+  memset(buckets, 0xff, size * sizeof(int));
+  node_count = 0;
+}
+
+/* at the head of the chain without looking for the address, like add_to_mac_table() */
+static void model_insert(int vlan_id, char *mac_address)
+{
+  unsigned int b = model_hash(vlan_id, mac_address) & bucket_mask;
+  node_t *n = &nodes[node_count];
+  memcpy(n->mac_address, mac_address, 18);
+  n->vlan_id = vlan_id;
+  n->next = buckets[b];
+  buckets[b] = node_count++;
+}
+
+static int model_lookup(int vlan_id, char *mac_address)
+{
+  for(int i = buckets[model_hash(vlan_id, mac_address) & bucket_mask]; i != -1; i = nodes[i].next)
+  {
+    if(nodes[i].vlan_id == vlan_id && memcmp(nodes[i].mac_address, mac_address, 17) == 0)
+      return 1;
+  }
+  return -1;
+}
+
+static void model_remove(int vlan_id, char *mac_address)
+{
+  for(int *link = &buckets[model_hash(vlan_id, mac_address) & bucket_mask]; *link != -1; link = &nodes[*link].next)
+  {
+    if(nodes[*link].vlan_id == vlan_id && memcmp(nodes[*link].mac_address, mac_address, 17) == 0)
+    {
+      *link = nodes[*link].next;
+      return;
+    }
+  }
+}
+
+static unsigned int model_chains(unsigned int *lengths)
+{
+  for(unsigned int b = 0; b <= bucket_mask; b++)
+  {
+    lengths[b] = 0;
+    for(int i = buckets[b]; i != -1; i = nodes[i].next)
+      lengths[b]++;
+  }
+  return bucket_mask + 1;
+}
+
+static const table_ops_t model_ops = {NULL, model_reset, model_insert, model_lookup, model_remove, model_chains};
+
+/* ---------------------------------------------------------------- mac_table of hash_mac_table.c */
+
+static void mac_table_reset(unsigned int entries)
+{
+  for(int i = 0; i < TABLE_SIZE; i++)
+  {
+    while(mac_table[i])
+    {
+      mac_table_t *temp = mac_table[i];
+      mac_table[i] = temp->next;
+      free(temp);
+    }
+  }
+  init_mac_table();
+}
+
+static void mac_table_insert(int vlan_id, char *mac_address)
+{
+  add_to_mac_table(1, vlan_id, mac_address);
+}
+
+/* the bench is its only reader, a removed entry is freed right away as the switch does before the next frame */
+static void mac_table_remove(int vlan_id, char *mac_address)
+{
+  delete_entry_from_mac_table(vlan_id, mac_address);
+  mac_table_quiescent();
+}
+
+static unsigned int mac_table_chains(unsigned int *lengths)
+{
+  for(int i = 0; i < TABLE_SIZE; i++)
+  {
+    lengths[i] = 0;
+    for(mac_table_t *temp = mac_table[i]; temp; temp = temp->next)
+      lengths[i]++;
+  }
+  return TABLE_SIZE;
+}
+
+static const table_ops_t mac_table_ops = {"mac_table", mac_table_reset, mac_table_insert, get_port_no_from_mac_table,
+                                          mac_table_remove, mac_table_chains};
+
+/* ---------------------------------------------------------------- cache misses */
+
+static int cache_fd = -1;
+
+/*
+ * Function    : open_cache_counter
+ * Description : Counts the last level cache misses of this process, not available in most containers and vms
+ * */
+static void open_cache_counter()
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  cache_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static unsigned long long read_cache_counter()
+{
+  unsigned long long value = 0;
+  if(cache_fd == -1 || read(cache_fd, &value, sizeof(value)) != sizeof(value))
+    return 0;
+  return value;
+}
+
+/* ---------------------------------------------------------------- address sets and phases */
+
+/*
+ * Function    : make_addresses
+ * @params     : set       -> random, oui or adversarial
+ *               addresses -> count addresses in text form
+ *               count     -> addresses to make, all different
+ * */
+static void make_addresses(const char *set, char (*addresses)[18], int count)
+{
+  unsigned long long base = next_random() & 0xffffff;
+  for(int i = 0; i < count; i++)
+  {
+    unsigned long long value;
+    if(strcmp(set, "oui") == 0)
+    {
+      /* 00:1B:21 followed by consecutive device numbers */
+      value = 0x001b21000000ULL | ((base + i) & 0xffffff);
+    }
+    else if(strcmp(set, "adversarial") == 0)
+    {
+      /* consecutive upper 36 bits from a random start, the address ends in 0:00 */
+      value = (((next_random() & 0xfffffffffULL) & ~0xffffffULL) | ((base + i) & 0xffffff)) << 12;
+    }
+    else
+    {
+      /* unicast, the random high bits make repeats unlikely and the index makes them impossible */
+      value = ((next_random() & 0xfeff00000000ULL) | i) ^ (base << 8);
+    }
+    mac_address_string(value & 0xfeffffffffffULL, addresses[i]);
+  }
+}
+
+typedef struct results
+{
+  double ns[5];               /* insert, hit, miss, mixed, delete */
+  double cache_misses[2];     /* per hit lookup and per mixed operation, -1 -> not counted */
+  double compares;            /* mean entries compared per hit lookup */
+  unsigned int max_chain;
+  double histogram[HISTOGRAM_BINS]; /* % of buckets with 0, 1, 2, 3, 4, 5-8, 9+ entries */
+} results_t;
+
+/*
+ * Function    : run_phases
+ * @params     : ops       -> table to measure
+ *               addresses -> entries addresses, then the addresses inserted by the mixed phase
+ *               order     -> random indices used for lookups
+ *               entries   -> addresses in the table
+ *               r         -> results
+ * */
+static void run_phases(const table_ops_t *ops, char (*addresses)[18], const unsigned int *order, int entries, results_t *r)
+{
+  static unsigned int lengths[1 << 24];
+  ops->reset(entries);
+
+  double start = now_ns();
+  for(int i = 0; i < entries; i++)
+    ops->insert(1, addresses[i]);
+  r->ns[0] = (now_ns() - start) / entries;
+
+  /* quality of the distribution, a hit compares the entries up to the found one */
+  unsigned int bucket_count = ops->chains(lengths);
+  double compares = 0;
+  r->max_chain = 0;
+  memset(r->histogram, 0, sizeof(r->histogram));
+  for(unsigned int b = 0; b < bucket_count; b++)
+  {
+    unsigned int len = lengths[b];
+    compares += (double) len * (len + 1) / 2;
+    if(len > r->max_chain)
+      r->max_chain = len;
+    r->histogram[len <= 4 ? len : len <= 8 ? 5 : 6] += 100.0 / bucket_count;
+  }
+  r->compares = compares / entries;
+
+  /* long chains make a phase cost operations times compares, fewer operations keep it bounded */
+  int op_count = entries < MAX_OPS ? entries : MAX_OPS;
+  if(op_count * r->compares > MAX_COMPARES)
+    op_count = MAX_COMPARES / r->compares > 100 ? (int) (MAX_COMPARES / r->compares) : 100;
+
+  int found = 0;
+  unsigned long long misses = read_cache_counter();
+  start = now_ns();
+  for(int i = 0; i < op_count; i++)
+    found += ops->lookup(1, addresses[order[i] % entries]) != -1;
+  r->ns[1] = (now_ns() - start) / op_count;
+  r->cache_misses[0] = cache_fd == -1 ? -1 : (double) (read_cache_counter() - misses) / op_count;
+  if(found != op_count)
+    printf("  %s: %d of %d hits not found\n", ops->name, op_count - found, op_count);
+
+  start = now_ns();
+  for(int i = 0; i < op_count; i++)
+    found += ops->lookup(2, addresses[order[i] % entries]) != -1;
+  r->ns[2] = (now_ns() - start) / op_count;
+
+  /* addresses [oldest, newest) are in the table, new ones are learned and the oldest age out */
+  int oldest = 0, newest = entries;
+  misses = read_cache_counter();
+  start = now_ns();
+  for(int i = 0; i < op_count; i++)
+  {
+    unsigned int pick = order[i] % 100;
+    char *mac_address = addresses[oldest + (order[i] >> 7) % (newest - oldest)];
+    if(pick < 90 || (pick < 95 && newest == entries + entries / 10) || (pick >= 95 && newest - oldest == 1))
+      ops->lookup(pick < 80 ? 1 : 2, mac_address);
+    else if(pick < 95)
+      ops->insert(1, addresses[newest++]);
+    else
+      ops->remove(1, addresses[oldest++]);
+  }
+  r->ns[3] = (now_ns() - start) / op_count;
+  r->cache_misses[1] = cache_fd == -1 ? -1 : (double) (read_cache_counter() - misses) / op_count;
+
+  /* oldest first, as entries age out */
+  int delete_count = op_count < newest - oldest ? op_count : newest - oldest;
+  start = now_ns();
+  for(int i = 0; i < delete_count; i++)
+    ops->remove(1, addresses[oldest + i]);
+  r->ns[4] = (now_ns() - start) / delete_count;
+}
+
+/*
+ * Function    : print_results
+ * @params     : name -> table or hash function
+ *               r    -> its results
+ * */
+static void print_results(const char *name, const results_t *r)
+{
+  printf("%-12s %8.1f %8.1f %8.1f %8.1f %8.1f", name, r->ns[0], r->ns[1], r->ns[2], r->ns[3], r->ns[4]);
+  if(r->cache_misses[0] < 0)
+    printf("        -        -");
+  else
+    printf(" %8.2f %8.2f", r->cache_misses[0], r->cache_misses[1]);
+  printf(" %10.2f %9u ", r->compares, r->max_chain);
+  for(int i = 0; i < HISTOGRAM_BINS; i++)
+    printf(" %5.1f", r->histogram[i]);
+  printf("\n");
+}
+
+/*
+ * Function    : main
+ * @params     : argc -> count of command line arguments
+ *               argv -> string array of all command line arguments
+ * Description : Runs every address set and size through the mac_table and the candidate hash functions
+ * */
+int main(int argc, char *argv[])
+{
+  static const int sizes[] = {1000, 10000, 100000, 1000000, 10000000};
+  static const char *sets[] = {"random", "oui", "adversarial"};
+  int max_entries = 1000000, max_mac_table = 100000;
+  const char *only_set = NULL;
+  for(int i = 1; i < argc; i++)
+  {
+    if(strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+      max_entries = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+      max_mac_table = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+      only_set = argv[++i];
+    else
+    {
+      printf("Usage: ./bench_mac_table [-m <MAX_ENTRIES>] [-t <MAX_MAC_TABLE_ENTRIES>] [-s random|oui|adversarial]\n");
+      return EXIT_FAILURE;
+    }
+  }
+  if(max_entries < 1000 || max_entries > 10000000)
+  {
+    printf("Error: -m is between 1000 and 10000000\n");
+    return EXIT_FAILURE;
+  }
+
+  crc32c_init();
+  open_cache_counter();
+  hash_key = now_ns() * 0x9e3779b97f4a7c15ULL;
+  if(cache_fd != -1)
+    ioctl(cache_fd, PERF_EVENT_IOC_ENABLE, 0);
+
+  /* the mixed phase learns up to a tenth more addresses */
+  int capacity = max_entries + max_entries / 10 + 1;
+  char (*addresses)[18] = malloc(capacity * sizeof(*addresses));
+  unsigned int *order = malloc(MAX_OPS * sizeof(unsigned int));
+  nodes = malloc(capacity * sizeof(node_t));
+  if(addresses == NULL || order == NULL || nodes == NULL)
+  {
+    perror("Error in malloc()");
+    return EXIT_FAILURE;
+  }
+  for(int i = 0; i < MAX_OPS; i++)
+    order[i] = next_random() >> 32;
+
+  printf("ns per operation, cache misses per hit lookup and per mixed operation (- when perf events are not allowed),\n"
+         "mean entries compared per hit, longest chain and %% of buckets with 0, 1, 2, 3, 4, 5-8, 9+ entries\n");
+  for(int s = 0; s < 3; s++)
+  {
+    if(only_set && strcmp(only_set, sets[s]) != 0)
+      continue;
+    for(int z = 0; z < 5 && sizes[z] <= max_entries; z++)
+    {
+      int entries = sizes[z];
+      make_addresses(sets[s], addresses, entries + entries / 10 + 1);
+      printf("\n%s addresses, %d entries\n", sets[s], entries);
+      printf("%-12s %8s %8s %8s %8s %8s %8s %8s %10s %9s  %5s %5s %5s %5s %5s %5s %5s\n", "TABLE/HASH", "INSERT",
+             "HIT", "MISS", "MIXED", "DELETE", "CM/HIT", "CM/MIX", "CMP/HIT", "MAX CHAIN", "0", "1", "2", "3", "4",
+             "5-8", "9+");
+      results_t r;
+      if(entries <= max_mac_table)
+      {
+        run_phases(&mac_table_ops, addresses, order, entries, &r);
+        print_results("mac_table", &r);
+      }
+      for(int c = 0; c < CANDIDATES; c++)
+      {
+        table_ops_t ops = model_ops;
+        ops.name = candidates[c].name;
+        model_hash = candidates[c].fn;
+        run_phases(&ops, addresses, order, entries, &r);
+        print_results(candidates[c].name, &r);
+      }
+    }
+  }
+  mac_table_reset(0);
+  free(buckets);
+  free(nodes);
+  free(order);
+  free(addresses);
+  return 0;
+}
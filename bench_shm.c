@@ -0,0 +1,130 @@
+/*
+ * File        : bench_shm.c
+ * Description : Measures the latency of forwarding work on a shared memory with every page policy of shm_pages.h. Each
+ *               simulated frame writes a 64 byte record and bumps a counter at random places of the shared memory, like
+ *               the flight recorder and the port counters of a large switch would, and its time is taken. With normal
+ *               pages the first frames to reach a page pay its fault and every frame risks a TLB miss, which shows in
+ *               the tail; prefaulted, locked and huge pages take both out of the forwarding path and into startup.
+ *               Build: gcc -O2 -o bench_shm bench_shm.c shm_pages.c -lrt
+ *               Usage: ./bench_shm [-s <SIZE_MB>] [-n <FRAMES>] [-p normal|prefault|lock|huge]
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "shm_pages.h"
+
+#define BENCH_SHM "/bench_shm"
+#define RECORD_SIZE 64
+
+static const char *policy_names[] = {"normal", "prefault", "lock", "huge"};
+static const int policies[] = {0, SHM_PAGES_PREFAULT, SHM_PAGES_PREFAULT | SHM_PAGES_LOCK, SHM_PAGES_ALL};
+#define POLICY_COUNT 4
+
+static unsigned long long now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int compare(const void *a, const void *b)
+{
+  unsigned long long x = *(const unsigned long long *) a, y = *(const unsigned long long *) b;
+  return x < y ? -1 : x > y;
+}
+
+/*
+ * Function    : run
+ * Description : Maps a new shared memory with the policy, forwards the frames on it and prints the latencies
+ * */
+static int run(int policy_index, size_t size, int frames, unsigned long long *lat)
+{
+  shm_remove(BENCH_SHM);
+  set_shm_page_policy(policies[policy_index]);
+  unsigned long long start = now_ns();
+  char *shm = shm_map(BENCH_SHM, size, PROT_READ | PROT_WRITE, NULL);
+  if(shm == MAP_FAILED)
+    return -1;
+  unsigned long long map_ns = now_ns() - start;
+
+  unsigned long long slots = size / RECORD_SIZE, x = 88172645463325252ULL;
+  char record[RECORD_SIZE];
+  memset(record, 0xab, sizeof(record));
+  for(int i = 0; i < frames; i++)
+  {
+    unsigned long long t = now_ns();
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    memcpy(shm + (x % slots) * RECORD_SIZE, record, RECORD_SIZE);
+    __atomic_fetch_add((unsigned long long *) (shm + ((x >> 32) % slots) * RECORD_SIZE), 1, __ATOMIC_RELAXED);
+    lat[i] = now_ns() - t;
+  }
+
+  display_shm_pages();
+  qsort(lat, frames, sizeof(*lat), compare);
+  printf("%-8s: mapped in %7.1f ms  p50 %6llu ns  p99 %6llu ns  p99.9 %7llu ns  p99.99 %7llu ns  max %8llu ns\n\n",
+         policy_names[policy_index], map_ns / 1e6, lat[frames / 2], lat[frames * 99ULL / 100],
+         lat[frames * 999ULL / 1000], lat[frames * 9999ULL / 10000], lat[frames - 1]);
+
+  shm_unmap(shm, size);
+  shm_remove(BENCH_SHM);
+  return 0;
+}
+
+static int usage()
+{
+  printf("Usage: ./bench_shm [-s <SIZE_MB>] [-n <FRAMES>] [-p normal|prefault|lock|huge]\n");
+  printf("  -s : size of the shared memory (default 256 MB)\n");
+  printf("  -n : frames forwarded (default 1000000)\n");
+  printf("  -p : only this page policy, lock is prefault and lock, huge all of them (default every policy)\n");
+  return EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[])
+{
+  size_t size = 256UL * 1024 * 1024;
+  int frames = 1000000, only = -1;
+  for(int i = 1; i < argc; i++)
+  {
+    if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+      size = atol(argv[++i]) * 1024UL * 1024;
+    else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+      frames = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+    {
+      i++;
+      for(int p = 0; p < POLICY_COUNT; p++)
+      {
+        if(strcmp(argv[i], policy_names[p]) == 0)
+          only = p;
+      }
+      if(only == -1)
+        return usage();
+    }
+    else
+      return usage();
+  }
+  if(size < RECORD_SIZE || frames < 1)
+    return usage();
+
+  unsigned long long *lat = malloc(frames * sizeof(*lat));
+  if(!lat)
+  {
+    perror("Error in malloc()");
+    return EXIT_FAILURE;
+  }
+  /* the latencies themselves must not fault in the timed loop */
+  memset(lat, 0, frames * sizeof(*lat));
+  printf("%d frames on a %zu MB shared memory\n\n", frames, size / (1024 * 1024));
+  for(int p = 0; p < POLICY_COUNT; p++)
+  {
+    if((only == -1 || only == p) && run(p, size, frames, lat) == -1)
+      return EXIT_FAILURE;
+  }
+  free(lat);
+  return EXIT_SUCCESS;
+}
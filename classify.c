@@ -0,0 +1,447 @@
+/*
+ * File        : classify.c
+ * Description : Frame header classification kernels. The addresses are parsed straight from the text header with byte
+ *               shuffles: the 12 hex digits of an address are gathered in reverse octet order, validated, turned into
+ *               nibbles and paired into bytes, which leaves the 48 bit address in the low bytes of a 64 bit lane. AVX2
+ *               parses two frames per instruction, one per 128 bit lane. The address tests and the hash then run on
+ *               whole vectors of parsed addresses, four (AVX2) or two (SSE4.1) tests and eight or four hashes at a
+ *               time. Every kernel gives the same results as the scalar one, which is used when the cpu has neither.
+ * */
+#include <string.h>
+
+#include "classify.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define BROADCAST_VALUE 0xffffffffffffULL
+#define GROUP_BIT (1ULL << 40)
+
+classify_fn_t classify_sse41 = NULL;
+classify_fn_t classify_avx2 = NULL;
+
+/* kernel used by classify_batch(), scalar until classify_init() finds something better */
+static classify_fn_t classify_fn = classify_scalar;
+static const char *classify_name = "scalar";
+
+/*
+ * Function    : classify_hash
+ * @params     : src  -> source address
+ *               dest -> destination address
+ * Output      : hash of the pair, 32 bit multiplies and shifts only so the kernels compute it in vectors
+ * */
+unsigned int classify_hash(unsigned long long src, unsigned long long dest)
+{
+  unsigned int h = (unsigned int) src * 0x9e3779b1u;
+  h ^= h >> 16;
+  h ^= (unsigned int) dest;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h ^= (unsigned int) (src >> 32) | (unsigned int) (dest >> 32) << 16;
+  h *= 0xc2b2ae35u;
+  return h ^ (h >> 16);
+}
+
+/*
+ * Function    : parse_address
+ * @params     : text  -> "XX:XX:XX:XX:XX:XX", upper or lower case
+ *               valid -> cleared if the text is not an address
+ * Output      : the 48 bit address
+ * */
+static unsigned long long parse_address(const char *text, int *valid)
+{
+  unsigned long long value = 0;
+  for(int i = 0; i < 17; i++)
+  {
+    char c = text[i];
+    if(i % 3 == 2)
+    {
+      if(c != ':')
+        *valid = 0;
+      continue;
+    }
+    int digit;
+    if(c >= '0' && c <= '9')
+      digit = c - '0';
+    else if((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+      digit = (c | 0x20) - 'a' + 10;
+    else
+    {
+      digit = 0;
+      *valid = 0;
+    }
+    value = (value << 4) | digit;
+  }
+  return value;
+}
+
+/*
+ * Function    : address_flags
+ * @params     : src, dest -> parsed addresses of a valid frame
+ *               station   -> address of the station on the ingress port
+ * Output      : CLASS_BROADCAST, CLASS_GROUP and CLASS_FROM_STATION flags
+ * */
+static unsigned char address_flags(unsigned long long src, unsigned long long dest, unsigned long long station)
+{
+  return (dest == BROADCAST_VALUE ? CLASS_BROADCAST : 0) | ((dest & GROUP_BIT) ? CLASS_GROUP : 0) |
+         (src == station ? CLASS_FROM_STATION : 0);
+}
+
+static unsigned char control_flags(const frame_t *f)
+{
+  return (f->flags & (FRAME_FLAG_MCAST_JOIN | FRAME_FLAG_MCAST_LEAVE)) ? CLASS_CONTROL : 0;
+}
+
+/*
+ * Function    : classify_scalar
+ * @params     : frames  -> frames to classify, addresses in text form (bytes 17 and 35 are not read)
+ *               count   -> number of frames, at most CLASSIFY_BATCH
+ *               station -> address of the station on the ingress port, CLASSIFY_NO_STATION if none
+ *               out     -> classification of frames[i] at index i
+ * */
+void classify_scalar(const frame_t *const *frames, int count, unsigned long long station, frame_class_t *out)
+{
+  for(int i = 0; i < count; i++)
+  {
+    int valid = 1;
+    unsigned long long src = parse_address(frames[i]->src_mac_address, &valid);
+    unsigned long long dest = parse_address(frames[i]->dest_mac_address, &valid);
+    out->flags[i] = control_flags(frames[i]);
+    if(!valid)
+    {
+      out->src[i] = out->dest[i] = 0;
+      out->hash[i] = 0;
+      out->flags[i] |= CLASS_INVALID;
+      continue;
+    }
+    out->src[i] = src;
+    out->dest[i] = dest;
+    out->hash[i] = classify_hash(src, dest);
+    out->flags[i] |= address_flags(src, dest, station);
+  }
+}
+
+#if defined(__x86_64__)
+
+/* shuffles gathering the digit pairs of octets 5 .. 0 of an address, and its separators. Frame bytes [0, 16) are in
+ * register a, [16, 32) in b and [32, 48) in c: the source is bytes 0 .. 16 and the destination bytes 18 .. 34 */
+#define SHUFFLE_SRC_A 15, -1, 12, 13, 9, 10, 6, 7, 3, 4, 0, 1, -1, -1, -1, -1
+#define SHUFFLE_SRC_B -1, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+#define SHUFFLE_DEST_B -1, -1, 14, 15, 11, 12, 8, 9, 5, 6, 2, 3, -1, -1, -1, -1
+#define SHUFFLE_DEST_C 1, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+#define SHUFFLE_SEP_A 2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+#define SHUFFLE_SEP_B -1, -1, -1, -1, -1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1
+#define SHUFFLE_SEP_C -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, -1, -1, -1, -1, -1, -1
+
+/* 12 digits, 10 separators */
+#define DIGITS_MASK 0x0fff
+#define SEPARATORS_MASK 0x03ff
+
+/*
+ * Function    : hex_digits_sse41
+ * @params     : x     -> digits in bytes 0 .. 11, zero above
+ *               valid -> to store a bit per byte set for hex digits
+ * Output      : the octets of the digit pairs in 16 bit lanes 0 .. 5
+ * */
+__attribute__((target("sse4.1")))
+static inline __m128i hex_digits_sse41(__m128i x, int *valid)
+{
+  __m128i digit = _mm_sub_epi8(x, _mm_set1_epi8('0'));
+  __m128i letter = _mm_sub_epi8(_mm_or_si128(x, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+  __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+  __m128i is_letter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+  *valid = _mm_movemask_epi8(_mm_or_si128(is_digit, is_letter));
+  /* low nibble, plus 9 for letters (bit 6 set) */
+  __m128i letter_bit = _mm_cmpeq_epi8(_mm_and_si128(x, _mm_set1_epi8(0x40)), _mm_set1_epi8(0x40));
+  __m128i nibble = _mm_add_epi8(_mm_and_si128(x, _mm_set1_epi8(0x0f)), _mm_and_si128(letter_bit, _mm_set1_epi8(9)));
+  /* high digit * 16 + low digit */
+  return _mm_maddubs_epi16(nibble, _mm_set1_epi16(0x0110));
+}
+
+/*
+ * Function    : parse_frame_sse41
+ * @params     : frame -> frame to parse
+ *               src   -> to store the source address
+ *               dest  -> to store the destination address
+ * Output      : 1 -> both addresses are valid, 0 -> not
+ * */
+__attribute__((target("sse4.1")))
+static inline int parse_frame_sse41(const frame_t *frame, unsigned long long *src, unsigned long long *dest)
+{
+  const char *p = (const char *) frame;
+  __m128i a = _mm_loadu_si128((const __m128i *) p);
+  __m128i b = _mm_loadu_si128((const __m128i *) (p + 16));
+  __m128i c = _mm_loadu_si128((const __m128i *) (p + 32));
+  __m128i x = _mm_or_si128(_mm_shuffle_epi8(a, _mm_setr_epi8(SHUFFLE_SRC_A)),
+                           _mm_shuffle_epi8(b, _mm_setr_epi8(SHUFFLE_SRC_B)));
+  __m128i y = _mm_or_si128(_mm_shuffle_epi8(b, _mm_setr_epi8(SHUFFLE_DEST_B)),
+                           _mm_shuffle_epi8(c, _mm_setr_epi8(SHUFFLE_DEST_C)));
+  __m128i sep = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, _mm_setr_epi8(SHUFFLE_SEP_A)),
+                                          _mm_shuffle_epi8(b, _mm_setr_epi8(SHUFFLE_SEP_B))),
+                             _mm_shuffle_epi8(c, _mm_setr_epi8(SHUFFLE_SEP_C)));
+  int valid_x, valid_y;
+  __m128i octets = _mm_packus_epi16(hex_digits_sse41(x, &valid_x), hex_digits_sse41(y, &valid_y));
+  *src = _mm_cvtsi128_si64(octets);
+  *dest = _mm_extract_epi64(octets, 1);
+  int valid_sep = _mm_movemask_epi8(_mm_cmpeq_epi8(sep, _mm_set1_epi8(':')));
+  return (valid_x & DIGITS_MASK) == DIGITS_MASK && (valid_y & DIGITS_MASK) == DIGITS_MASK &&
+         (valid_sep & SEPARATORS_MASK) == SEPARATORS_MASK;
+}
+
+/*
+ * Function    : hash_sse41
+ * @params     : src, dest -> four parsed pairs
+ * Output      : classify_hash() of each pair in its 32 bit lane
+ * */
+__attribute__((target("sse4.1")))
+static inline __m128i hash_sse41(const unsigned long long *src, const unsigned long long *dest)
+{
+  __m128 s0 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *) src));
+  __m128 s1 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *) (src + 2)));
+  __m128 d0 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *) dest));
+  __m128 d1 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *) (dest + 2)));
+  __m128i src_lo = _mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(2, 0, 2, 0)));
+  __m128i src_hi = _mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(3, 1, 3, 1)));
+  __m128i dest_lo = _mm_castps_si128(_mm_shuffle_ps(d0, d1, _MM_SHUFFLE(2, 0, 2, 0)));
+  __m128i dest_hi = _mm_castps_si128(_mm_shuffle_ps(d0, d1, _MM_SHUFFLE(3, 1, 3, 1)));
+
+  __m128i h = _mm_mullo_epi32(src_lo, _mm_set1_epi32(0x9e3779b1u));
+  h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+  h = _mm_xor_si128(h, dest_lo);
+  h = _mm_mullo_epi32(h, _mm_set1_epi32(0x85ebca6bu));
+  h = _mm_xor_si128(h, _mm_srli_epi32(h, 13));
+  h = _mm_xor_si128(h, _mm_or_si128(src_hi, _mm_slli_epi32(dest_hi, 16)));
+  h = _mm_mullo_epi32(h, _mm_set1_epi32(0xc2b2ae35u));
+  return _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+}
+
+/*
+ * Function    : classify_sse41_kernel
+ * Description : classify_scalar() with one frame parsed per iteration, two address tests and four hashes at a time
+ * */
+__attribute__((target("sse4.1")))
+static void classify_sse41_kernel(const frame_t *const *frames, int count, unsigned long long station, frame_class_t *out)
+{
+  int i;
+  for(i = 0; i < count; i++)
+  {
+    int valid = parse_frame_sse41(frames[i], &out->src[i], &out->dest[i]);
+    out->flags[i] = control_flags(frames[i]) | (valid ? 0 : CLASS_INVALID);
+  }
+
+  for(i = 0; i + 4 <= count; i += 4)
+  {
+    _mm_storeu_si128((__m128i *) &out->hash[i], hash_sse41(&out->src[i], &out->dest[i]));
+  }
+  for(; i < count; i++)
+  {
+    out->hash[i] = classify_hash(out->src[i], out->dest[i]);
+  }
+
+  const __m128i broadcast = _mm_set1_epi64x(BROADCAST_VALUE), from = _mm_set1_epi64x(station);
+  for(i = 0; i + 2 <= count; i += 2)
+  {
+    __m128i s = _mm_loadu_si128((const __m128i *) &out->src[i]);
+    __m128i d = _mm_loadu_si128((const __m128i *) &out->dest[i]);
+    int is_broadcast = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(d, broadcast)));
+    /* the group bit (bit 40) moved to the sign bit */
+    int is_group = _mm_movemask_pd(_mm_castsi128_pd(_mm_slli_epi64(d, 23)));
+    int is_from = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(s, from)));
+    for(int j = 0; j < 2; j++)
+    {
+      out->flags[i + j] |= ((is_broadcast >> j) & 1) * CLASS_BROADCAST | ((is_group >> j) & 1) * CLASS_GROUP |
+                           ((is_from >> j) & 1) * CLASS_FROM_STATION;
+    }
+  }
+  for(; i < count; i++)
+  {
+    out->flags[i] |= address_flags(out->src[i], out->dest[i], station);
+  }
+
+  /* invalid frames keep only their control flag and zero values */
+  for(i = 0; i < count; i++)
+  {
+    if(out->flags[i] & CLASS_INVALID)
+    {
+      out->flags[i] &= CLASS_INVALID | CLASS_CONTROL;
+      out->src[i] = out->dest[i] = 0;
+      out->hash[i] = 0;
+    }
+  }
+}
+
+/*
+ * Function    : classify_avx2_kernel
+ * Description : classify_scalar() with two frames parsed per iteration, four address tests and eight hashes at a time
+ * */
+__attribute__((target("avx2")))
+static void classify_avx2_kernel(const frame_t *const *frames, int count, unsigned long long station, frame_class_t *out)
+{
+  const __m256i shuffle_src_a = _mm256_setr_epi8(SHUFFLE_SRC_A, SHUFFLE_SRC_A);
+  const __m256i shuffle_src_b = _mm256_setr_epi8(SHUFFLE_SRC_B, SHUFFLE_SRC_B);
+  const __m256i shuffle_dest_b = _mm256_setr_epi8(SHUFFLE_DEST_B, SHUFFLE_DEST_B);
+  const __m256i shuffle_dest_c = _mm256_setr_epi8(SHUFFLE_DEST_C, SHUFFLE_DEST_C);
+  const __m256i shuffle_sep_a = _mm256_setr_epi8(SHUFFLE_SEP_A, SHUFFLE_SEP_A);
+  const __m256i shuffle_sep_b = _mm256_setr_epi8(SHUFFLE_SEP_B, SHUFFLE_SEP_B);
+  const __m256i shuffle_sep_c = _mm256_setr_epi8(SHUFFLE_SEP_C, SHUFFLE_SEP_C);
+  int i;
+
+  for(i = 0; i + 2 <= count; i += 2)
+  {
+    const char *p0 = (const char *) frames[i], *p1 = (const char *) frames[i + 1];
+    /* frame i in the low lane, frame i + 1 in the high lane */
+    __m256i a = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) p0)),
+                                        _mm_loadu_si128((const __m128i *) p1), 1);
+    __m256i b = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (p0 + 16))),
+                                        _mm_loadu_si128((const __m128i *) (p1 + 16)), 1);
+    __m256i c = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (p0 + 32))),
+                                        _mm_loadu_si128((const __m128i *) (p1 + 32)), 1);
+    __m256i x = _mm256_or_si256(_mm256_shuffle_epi8(a, shuffle_src_a), _mm256_shuffle_epi8(b, shuffle_src_b));
+    __m256i y = _mm256_or_si256(_mm256_shuffle_epi8(b, shuffle_dest_b), _mm256_shuffle_epi8(c, shuffle_dest_c));
+    __m256i sep = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a, shuffle_sep_a),
+                                                  _mm256_shuffle_epi8(b, shuffle_sep_b)),
+                                  _mm256_shuffle_epi8(c, shuffle_sep_c));
+
+    /* both addresses of both frames, as in hex_digits_sse41() */
+    __m256i digits[2] = {x, y};
+    unsigned int valid[2];
+    for(int k = 0; k < 2; k++)
+    {
+      __m256i v = digits[k];
+      __m256i digit = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+      __m256i letter = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+      __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+      __m256i is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(5)), letter);
+      valid[k] = _mm256_movemask_epi8(_mm256_or_si256(is_digit, is_letter));
+      __m256i letter_bit = _mm256_cmpeq_epi8(_mm256_and_si256(v, _mm256_set1_epi8(0x40)), _mm256_set1_epi8(0x40));
+      __m256i nibble = _mm256_add_epi8(_mm256_and_si256(v, _mm256_set1_epi8(0x0f)),
+                                       _mm256_and_si256(letter_bit, _mm256_set1_epi8(9)));
+      digits[k] = _mm256_maddubs_epi16(nibble, _mm256_set1_epi16(0x0110));
+    }
+    /* per lane: source in the low 64 bits, destination in the high 64 bits */
+    __m256i octets = _mm256_packus_epi16(digits[0], digits[1]);
+    out->src[i] = _mm256_extract_epi64(octets, 0);
+    out->dest[i] = _mm256_extract_epi64(octets, 1);
+    out->src[i + 1] = _mm256_extract_epi64(octets, 2);
+    out->dest[i + 1] = _mm256_extract_epi64(octets, 3);
+
+    unsigned int valid_sep = _mm256_movemask_epi8(_mm256_cmpeq_epi8(sep, _mm256_set1_epi8(':')));
+    for(int j = 0; j < 2; j++)
+    {
+      int ok = ((valid[0] >> (16 * j)) & DIGITS_MASK) == DIGITS_MASK &&
+               ((valid[1] >> (16 * j)) & DIGITS_MASK) == DIGITS_MASK &&
+               ((valid_sep >> (16 * j)) & SEPARATORS_MASK) == SEPARATORS_MASK;
+      out->flags[i + j] = control_flags(frames[i + j]) | (ok ? 0 : CLASS_INVALID);
+    }
+  }
+  for(; i < count; i++)
+  {
+    int valid = parse_frame_sse41(frames[i], &out->src[i], &out->dest[i]);
+    out->flags[i] = control_flags(frames[i]) | (valid ? 0 : CLASS_INVALID);
+  }
+
+  for(i = 0; i + 8 <= count; i += 8)
+  {
+    /* low and high halves of eight addresses, shuffle_ps works per lane so the order is fixed up after */
+    __m256 s0 = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i *) &out->src[i]));
+    __m256 s1 = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i *) &out->src[i + 4]));
+    __m256 d0 = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i *) &out->dest[i]));
+    __m256 d1 = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i *) &out->dest[i + 4]));
+    __m256i src_lo = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(s0, s1, _MM_SHUFFLE(2, 0, 2, 0))), 0xd8);
+    __m256i src_hi = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(s0, s1, _MM_SHUFFLE(3, 1, 3, 1))), 0xd8);
+    __m256i dest_lo = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(d0, d1, _MM_SHUFFLE(2, 0, 2, 0))), 0xd8);
+    __m256i dest_hi = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(d0, d1, _MM_SHUFFLE(3, 1, 3, 1))), 0xd8);
+
+    __m256i h = _mm256_mullo_epi32(src_lo, _mm256_set1_epi32(0x9e3779b1u));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    h = _mm256_xor_si256(h, dest_lo);
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0x85ebca6bu));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+    h = _mm256_xor_si256(h, _mm256_or_si256(src_hi, _mm256_slli_epi32(dest_hi, 16)));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0xc2b2ae35u));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    _mm256_storeu_si256((__m256i *) &out->hash[i], h);
+  }
+  for(; i + 4 <= count; i += 4)
+  {
+    _mm_storeu_si128((__m128i *) &out->hash[i], hash_sse41(&out->src[i], &out->dest[i]));
+  }
+  for(; i < count; i++)
+  {
+    out->hash[i] = classify_hash(out->src[i], out->dest[i]);
+  }
+
+  const __m256i broadcast = _mm256_set1_epi64x(BROADCAST_VALUE), from = _mm256_set1_epi64x(station);
+  for(i = 0; i + 4 <= count; i += 4)
+  {
+    __m256i s = _mm256_loadu_si256((const __m256i *) &out->src[i]);
+    __m256i d = _mm256_loadu_si256((const __m256i *) &out->dest[i]);
+    int is_broadcast = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(d, broadcast)));
+    int is_group = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_slli_epi64(d, 23)));
+    int is_from = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(s, from)));
+    for(int j = 0; j < 4; j++)
+    {
+      out->flags[i + j] |= ((is_broadcast >> j) & 1) * CLASS_BROADCAST | ((is_group >> j) & 1) * CLASS_GROUP |
+                           ((is_from >> j) & 1) * CLASS_FROM_STATION;
+    }
+  }
+  for(; i < count; i++)
+  {
+    out->flags[i] |= address_flags(out->src[i], out->dest[i], station);
+  }
+
+  for(i = 0; i < count; i++)
+  {
+    if(out->flags[i] & CLASS_INVALID)
+    {
+      out->flags[i] &= CLASS_INVALID | CLASS_CONTROL;
+      out->src[i] = out->dest[i] = 0;
+      out->hash[i] = 0;
+    }
+  }
+}
+#endif
+
+/*
+ * Function    : classify_init
+ * Description : Selects the widest kernel supported by this cpu
+ * */
+void classify_init()
+{
+#if defined(__x86_64__)
+  if(__builtin_cpu_supports("sse4.1"))
+  {
+    classify_sse41 = classify_sse41_kernel;
+    classify_fn = classify_sse41;
+    classify_name = "sse4.1";
+  }
+  if(__builtin_cpu_supports("avx2"))
+  {
+    classify_avx2 = classify_avx2_kernel;
+    classify_fn = classify_avx2;
+    classify_name = "avx2";
+  }
+#endif
+}
+
+/*
+ * Function    : classify_impl_name
+ * Output      : name of the kernel selected by classify_init
+ * */
+const char *classify_impl_name()
+{
+  return classify_name;
+}
+
+/*
+ * Function    : classify_batch
+ * @params     : frames  -> frames to classify
+ *               count   -> number of frames, at most CLASSIFY_BATCH
+ *               station -> address of the station on the ingress port, CLASSIFY_NO_STATION if none
+ *               out     -> classification of frames[i] at index i
+ * */
+void classify_batch(const frame_t *const *frames, int count, unsigned long long station, frame_class_t *out)
+{
+  classify_fn(frames, count, station, out);
+}
@@ -0,0 +1,48 @@
+#ifndef CLASSIFY_H
+#define CLASSIFY_H
+
+/*
+ * File        : classify.h
+ * Description : Classification of frame headers in batches: both addresses parsed from their text form and checked,
+ *               broadcast and group address tests, source equal to the station of the ingress port, and the hash of
+ *               the (source, destination) pair. The kernel (AVX2, SSE4.1 or scalar) is picked at runtime by
+ *               classify_init().
+ * */
+
+#include "frame.h"
+
+/* frames classified by one call */
+#define CLASSIFY_BATCH 32
+
+/* classification flags */
+#define CLASS_BROADCAST 0x01    /* destination is FF:FF:FF:FF:FF:FF */
+#define CLASS_GROUP 0x02        /* destination is a group address (multicast or broadcast) */
+#define CLASS_CONTROL 0x04      /* multicast join/leave frame */
+#define CLASS_FROM_STATION 0x08 /* source is the address of the station on the ingress port */
+#define CLASS_INVALID 0x10      /* an address is not "XX:XX:XX:XX:XX:XX", its values and hash are 0 */
+
+/* no station known on the port, never equal to a source address */
+#define CLASSIFY_NO_STATION (~0ULL)
+
+/* structure of arrays, so the kernels load and store whole vectors */
+typedef struct frame_class
+{
+  unsigned long long src[CLASSIFY_BATCH];   /* 48 bit addresses, first octet in the most significant byte */
+  unsigned long long dest[CLASSIFY_BATCH];
+  unsigned int hash[CLASSIFY_BATCH];
+  unsigned char flags[CLASSIFY_BATCH];
+} frame_class_t;
+
+typedef void (*classify_fn_t)(const frame_t *const *frames, int count, unsigned long long station, frame_class_t *out);
+
+void classify_init();
+const char *classify_impl_name();
+void classify_batch(const frame_t *const *frames, int count, unsigned long long station, frame_class_t *out);
+unsigned int classify_hash(unsigned long long src, unsigned long long dest);
+
+/* individual kernels, NULL when the cpu does not have the instructions */
+void classify_scalar(const frame_t *const *frames, int count, unsigned long long station, frame_class_t *out);
+extern classify_fn_t classify_sse41;
+extern classify_fn_t classify_avx2;
+
+#endif
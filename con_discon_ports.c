@@ -34,7 +34,7 @@ pid_t is_connected(int port_no)
 /*
  * Function    : get_station_port_num
  * @params     : pid -> process id of the station
- * Output      : returns port number on which pid is connected to.
+ * Output      : returns port number on which pid is connected to, 0 if pid is not connected to any port.
  * Description : based on process id, it returns the port number.
  * */
 int get_station_port_num(pid_t pid)
@@ -47,6 +47,7 @@ int get_station_port_num(pid_t pid)
       return i+1;
     }
   }
+  return 0;
 }
 
 /*
@@ -0,0 +1,393 @@
+/*
+ * File        : egress_sched.c
+ * Description : Egress scheduling. Forwarded frames are put into one of EGRESS_CLASSES queues of the destination port
+ *               according to their priority. A scheduler thread per port takes frames out by strict priority or weighted
+ *               round robin and sends them to the port mqueue, using the class as mqueue priority so the station also
+ *               reads high priority frames first. A full queue drops the frame instead of blocking the ingress thread.
+ * */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <mqueue.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "frame.h"
+#include "egress_sched.h"
+#include "port_stats.h"
+
+#define MAX_PORTS 4
+
+/* mqueue wait while sending, the thread rechecks whether it is being stopped after every timeout */
+#define EGRESS_SEND_TIMEOUT_NS 100000000L
+
+/* frames of one traffic class waiting for the port */
+typedef struct egress_queue
+{
+  char frames[EGRESS_QUEUE_DEPTH][FRAME_SIZE];
+  int head;
+  int count;
+} egress_queue_t;
+
+typedef struct egress_port
+{
+  egress_queue_t queues[EGRESS_CLASSES];
+  int pending;                           /* frames queued in all classes */
+  int mode;                              /* EGRESS_STRICT or EGRESS_WRR */
+  unsigned int weights[EGRESS_CLASSES];  /* frames per round for EGRESS_WRR */
+  int wrr_class;                         /* class being served in the current round */
+  unsigned int wrr_left;                 /* frames it may still send */
+  int drop_when_full;                    /* do not wait for room in the port mqueue, the station is a slow consumer */
+  int running;
+  int started;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+} egress_port_t;
+
+static egress_port_t egress_ports[MAX_PORTS];
+
+static const unsigned int default_weights[EGRESS_CLASSES] = {1, 2, 4, 8};
+
+extern mqd_t mq_send_fd[4];
+
+/*
+ * Function    : priority_to_egress_class
+ * @params     : priority -> frame priority (pcp) 0..7
+ * Output      : egress class 0..EGRESS_CLASSES-1, two priorities share a class
+ * */
+int priority_to_egress_class(int priority)
+{
+  return (priority & 0x7) >> 1;
+}
+
+/*
+ * Function    : pick_class
+ * @params     : p -> port with at least one frame pending, lock held
+ * Output      : class to take the next frame from
+ * */
+static int pick_class(egress_port_t *p)
+{
+  if(p->mode == EGRESS_WRR)
+  {
+    /* serve weights[class] frames from each class, walking down from the highest class and wrapping around */
+    for(int tries = 0; tries <= EGRESS_CLASSES; tries++)
+    {
+      if(p->wrr_left > 0 && p->queues[p->wrr_class].count > 0)
+      {
+        p->wrr_left--;
+        return p->wrr_class;
+      }
+      p->wrr_class = (p->wrr_class + EGRESS_CLASSES - 1) % EGRESS_CLASSES;
+      p->wrr_left = p->weights[p->wrr_class];
+    }
+  }
+
+  /* strict priority */
+  for(int c = EGRESS_CLASSES - 1; c > 0; c--)
+  {
+    if(p->queues[c].count > 0)
+    {
+      return c;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Function    : send_to_port
+ * @params     : p          -> egress port
+ *               port_index -> port (0 based)
+ *               frame      -> frame to send
+ *               egress_class -> used as mqueue priority
+ * Output      : 0 -> frame sent, -1 -> frame dropped
+ * Description : Sends the frame to the port mqueue, waiting for room while the scheduler is running
+ * */
+static int send_to_port(egress_port_t *p, int port_index, const char *frame, int egress_class)
+{
+  struct timespec deadline;
+  while(1)
+  {
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    /* a deadline already passed makes the send fail at once on a full mqueue */
+    if(__atomic_load_n(&p->drop_when_full, __ATOMIC_RELAXED))
+    {
+      if(mq_timedsend(mq_send_fd[port_index], frame, FRAME_SIZE, egress_class, &deadline) == 0)
+      {
+        return 0;
+      }
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      if(errno == ETIMEDOUT)
+      {
+        PORT_STAT_ADD(port_index, slow_consumer_dropped, 1);
+      }
+      else
+      {
+        perror("Error in mq_send()");
+      }
+      return -1;
+    }
+    deadline.tv_nsec += EGRESS_SEND_TIMEOUT_NS;
+    if(deadline.tv_nsec >= 1000000000L)
+    {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+    if(mq_timedsend(mq_send_fd[port_index], frame, FRAME_SIZE, egress_class, &deadline) == 0)
+    {
+      return 0;
+    }
+    if(errno == EINTR || (errno == ETIMEDOUT && __atomic_load_n(&p->running, __ATOMIC_RELAXED)))
+    {
+      continue;
+    }
+    if(errno != ETIMEDOUT)
+    {
+      perror("Error in mq_send()");
+    }
+    return -1;
+  }
+}
+
+/*
+ * Function    : egress_port_thread
+ * @params     : arg -> egress port to drain
+ * Description : Scheduler thread of one port, runs until stop_egress() and the queues are drained
+ * */
+static void *egress_port_thread(void *arg)
+{
+  egress_port_t *p = (egress_port_t *) arg;
+  int port_index = p - egress_ports;
+  char frame[FRAME_SIZE];
+
+  /* switch signals are handled by the menu thread */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGUSR1);
+  sigaddset(&set, SIGHUP);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  while(1)
+  {
+    pthread_mutex_lock(&p->lock);
+    while(p->pending == 0 && p->running)
+    {
+      pthread_cond_wait(&p->cond, &p->lock);
+    }
+    if(p->pending == 0)
+    {
+      pthread_mutex_unlock(&p->lock);
+      break;
+    }
+
+    int c = pick_class(p);
+    egress_queue_t *q = &p->queues[c];
+    memcpy(frame, q->frames[q->head], FRAME_SIZE);
+    q->head = (q->head + 1) % EGRESS_QUEUE_DEPTH;
+    q->count--;
+    p->pending--;
+    __atomic_store_n(&port_stats[port_index].egress_depth[c], q->count, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&p->lock);
+
+    if(send_to_port(p, port_index, frame, c) == 0)
+    {
+      PORT_STAT_ADD(port_index, tx_frames, 1);
+      PORT_STAT_ADD(port_index, egress_sent[c], 1);
+      continue;
+    }
+
+    PORT_STAT_ADD(port_index, egress_dropped[c], 1);
+    /* the station stopped reading while we are being stopped, the rest can not be delivered either */
+    pthread_mutex_lock(&p->lock);
+    if(!p->running)
+    {
+      for(int i = 0; i < EGRESS_CLASSES; i++)
+      {
+        PORT_STAT_ADD(port_index, egress_dropped[i], p->queues[i].count);
+        p->queues[i].count = 0;
+        __atomic_store_n(&port_stats[port_index].egress_depth[i], 0, __ATOMIC_RELAXED);
+      }
+      p->pending = 0;
+    }
+    pthread_mutex_unlock(&p->lock);
+  }
+  return NULL;
+}
+
+/*
+ * Function    : init_egress
+ * Description : Initialises the egress queues of every port, strict priority scheduling by default
+ * */
+void init_egress()
+{
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    egress_port_t *p = &egress_ports[i];
+    memset(p->queues, 0, sizeof(p->queues));
+    p->pending = 0;
+    p->mode = EGRESS_STRICT;
+    p->drop_when_full = 0;
+    memcpy(p->weights, default_weights, sizeof(p->weights));
+    p->wrr_class = EGRESS_CLASSES - 1;
+    p->wrr_left = p->weights[p->wrr_class];
+    p->running = 0;
+    p->started = 0;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->cond, NULL);
+    for(int c = 0; c < EGRESS_CLASSES; c++)
+    {
+      port_stats[i].egress_depth[c] = 0;
+    }
+  }
+}
+
+/*
+ * Function    : start_egress
+ * @params     : port_no -> port whose scheduler thread is started
+ * */
+void start_egress(int port_no)
+{
+  egress_port_t *p = &egress_ports[port_no - 1];
+  p->running = 1;
+  if(pthread_create(&p->thread, NULL, egress_port_thread, p) != 0)
+  {
+    perror("Error in pthread_create()");
+    p->running = 0;
+    return;
+  }
+  p->started = 1;
+}
+
+/*
+ * Function    : stop_egress
+ * Description : Lets every scheduler thread send what is queued and waits for them to exit
+ * */
+void stop_egress()
+{
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    egress_port_t *p = &egress_ports[i];
+    pthread_mutex_lock(&p->lock);
+    __atomic_store_n(&p->running, 0, __ATOMIC_RELAXED);
+    pthread_cond_signal(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+  }
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    if(egress_ports[i].started)
+    {
+      pthread_join(egress_ports[i].thread, NULL);
+      egress_ports[i].started = 0;
+    }
+  }
+}
+
+/*
+ * Function    : egress_enqueue
+ * @params     : port_index -> destination port (0 based)
+ *               frame      -> FRAME_SIZE bytes frame in wire format
+ *               priority   -> frame priority 0..7
+ * Output      : 0 -> frame queued, -1 -> queue of its class is full and the frame is dropped
+ * */
+int egress_enqueue(int port_index, const char *frame, int priority)
+{
+  egress_port_t *p = &egress_ports[port_index];
+  int c = priority_to_egress_class(priority);
+  egress_queue_t *q = &p->queues[c];
+
+  pthread_mutex_lock(&p->lock);
+  if(q->count == EGRESS_QUEUE_DEPTH)
+  {
+    pthread_mutex_unlock(&p->lock);
+    PORT_STAT_ADD(port_index, egress_dropped[c], 1);
+    return -1;
+  }
+  memcpy(q->frames[(q->head + q->count) % EGRESS_QUEUE_DEPTH], frame, FRAME_SIZE);
+  q->count++;
+  p->pending++;
+  __atomic_store_n(&port_stats[port_index].egress_depth[c], q->count, __ATOMIC_RELAXED);
+  if((unsigned long long) q->count > port_stats[port_index].egress_max_depth[c])
+  {
+    __atomic_store_n(&port_stats[port_index].egress_max_depth[c], q->count, __ATOMIC_RELAXED);
+  }
+  pthread_cond_signal(&p->cond);
+  pthread_mutex_unlock(&p->lock);
+  return 0;
+}
+
+/*
+ * Function    : set_egress_scheduler
+ * @params     : port_no -> port to configure
+ *               mode    -> EGRESS_STRICT or EGRESS_WRR
+ *               weights -> frames per round of each class for EGRESS_WRR (NULL keeps the current weights)
+ * */
+void set_egress_scheduler(int port_no, int mode, const unsigned int *weights)
+{
+  egress_port_t *p = &egress_ports[port_no - 1];
+  pthread_mutex_lock(&p->lock);
+  p->mode = mode;
+  if(weights)
+  {
+    for(int c = 0; c < EGRESS_CLASSES; c++)
+    {
+      /* a class with weight 0 would never be served */
+      p->weights[c] = weights[c] ? weights[c] : 1;
+    }
+  }
+  p->wrr_class = EGRESS_CLASSES - 1;
+  p->wrr_left = p->weights[p->wrr_class];
+  pthread_mutex_unlock(&p->lock);
+}
+
+/*
+ * Function    : get_egress_scheduler
+ * @params     : port_no -> port
+ *               weights -> to store the frames per round of each class
+ * Output      : EGRESS_STRICT or EGRESS_WRR
+ * */
+int get_egress_scheduler(int port_no, unsigned int *weights)
+{
+  egress_port_t *p = &egress_ports[port_no - 1];
+  pthread_mutex_lock(&p->lock);
+  int mode = p->mode;
+  memcpy(weights, p->weights, sizeof(p->weights));
+  pthread_mutex_unlock(&p->lock);
+  return mode;
+}
+
+/*
+ * Function    : set_egress_drop_when_full
+ * @params     : port_index -> port (0 based)
+ *               drop       -> 1 -> frames are dropped when the port mqueue is full, 0 -> the scheduler waits for room
+ * */
+void set_egress_drop_when_full(int port_index, int drop)
+{
+  __atomic_store_n(&egress_ports[port_index].drop_when_full, drop, __ATOMIC_RELAXED);
+}
+
+/*
+ * Function    : display_egress
+ * Description : Displays the scheduler of every port with depth, high watermark, sent and dropped frames per class
+ * */
+void display_egress()
+{
+  printf("\n+------+--------+-------+--------+-------+-----------+------------+------------+\n");
+  printf("| PORT |  MODE  | CLASS | WEIGHT | DEPTH | MAX DEPTH |    SENT    |   DROPPED  |\n");
+  printf("+------+--------+-------+--------+-------+-----------+------------+------------+\n");
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    egress_port_t *p = &egress_ports[i];
+    for(int c = EGRESS_CLASSES - 1; c >= 0; c--)
+    {
+      printf("|  %d   | %-6s |   %d   | %6u | %5llu | %9llu | %10llu | %10llu |\n", i+1, p->mode == EGRESS_WRR ? "wrr" : "strict",
+             c, p->weights[c], port_stats[i].egress_depth[c], port_stats[i].egress_max_depth[c],
+             port_stats[i].egress_sent[c], port_stats[i].egress_dropped[c]);
+    }
+  }
+  printf("+------+--------+-------+--------+-------+-----------+------------+------------+\n");
+}
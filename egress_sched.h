@@ -0,0 +1,27 @@
+#ifndef EGRESS_SCHED_H
+#define EGRESS_SCHED_H
+
+/*
+ * File        : egress_sched.h
+ * Description : Per port egress queues, one per traffic class, drained into the port mqueue by a scheduler thread
+ * */
+
+/* frame priority (0..7) is mapped to EGRESS_CLASSES classes, class 3 is served first */
+#define EGRESS_CLASSES 4
+#define EGRESS_QUEUE_DEPTH 16
+
+/* scheduling modes */
+#define EGRESS_STRICT 0
+#define EGRESS_WRR 1
+
+int priority_to_egress_class(int priority);
+void init_egress();
+void start_egress(int port_no);
+void stop_egress();
+int egress_enqueue(int port_index, const char *frame, int priority);
+void set_egress_scheduler(int port_no, int mode, const unsigned int *weights);
+int get_egress_scheduler(int port_no, unsigned int *weights);
+void set_egress_drop_when_full(int port_index, int drop);
+void display_egress();
+
+#endif
@@ -0,0 +1,477 @@
+/*
+ * File        : fabric.c
+ * Description : Brings up a fabric of stacked switches with their stations from a topology file. Every switch is
+ *               started with its number and stack ports, then every station, each one on its own pseudo terminal
+ *               (the menus expect a terminal) with its output in fabric_<NODE>.out. Lines typed on the console are
+ *               forwarded to the menu of one node.
+ *               Build: gcc -O2 -o fabric fabric.c instance.c -lpthread -lutil
+ *               Usage: ./fabric [-b <BIN_DIR>] <TOPOLOGY_FILE>
+ *
+ *               Topology file, one statement per line, # starts a comment:
+ *                 switch <SWITCH_NO>
+ *                 link <SWITCH_NO>:<PORT> <SWITCH_NO>:<PORT>
+ *                 station <MAC_ADDRESS> <SWITCH_NO>:<PORT> [station options]
+ *               Links must form a chain or a tree, nothing breaks a loop.
+ *
+ *               Console: <NODE> <INPUT>  sends INPUT to the menu of NODE (sw<N> or a station mac address), ';' in
+ *                                        INPUT separates menu lines, e.g. "AA:AA:AA:AA:AA:01 4;AA:AA:AA:AA:AA:02;100"
+ *                        list            displays the nodes
+ *                        quit            stops the stations, then the switches
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <pty.h>
+
+#include "instance.h"
+
+#define MAX_PORTS 4
+#define MAX_SWITCHES 16
+#define MAX_STATIONS 64
+#define MAX_ARGS 24
+#define READY_TIMEOUT_MS 5000
+
+/* a switch or station process */
+typedef struct node
+{
+  char name[24];
+  char *argv[MAX_ARGS];
+  int argc;
+  pid_t pid;
+  int pty_fd;            /* master side of the node's terminal */
+  FILE *log;             /* fabric_<name>.out */
+  pthread_t output_thread;
+  volatile int ready;    /* set once the node displays its menu */
+} node_t;
+
+typedef struct link
+{
+  int switch_no[2];
+  int port_no[2];
+} link_t;
+
+static node_t switches[MAX_SWITCHES];
+static int switch_no[MAX_SWITCHES];
+static int switch_count = 0;
+
+static node_t stations[MAX_STATIONS];
+static int station_count = 0;
+
+static link_t links[MAX_SWITCHES];
+static int link_count = 0;
+
+/* port of a switch already used by a link or a station */
+static int port_used[MAX_SWITCHES][MAX_PORTS];
+
+/* union-find over switches, to reject links closing a loop */
+static int parent[MAX_SWITCHES];
+
+static const char *bin_dir = ".";
+
+/*
+ * Function    : find_switch
+ * @params     : number -> switch number
+ * Output      : index of the switch in switches, -1 if the topology does not declare it
+ * */
+static int find_switch(int number)
+{
+  for(int i = 0; i < switch_count; i++)
+  {
+    if(switch_no[i] == number)
+      return i;
+  }
+  return -1;
+}
+
+static int find_root(int i)
+{
+  while(parent[i] != i)
+    i = parent[i] = parent[parent[i]];
+  return i;
+}
+
+/*
+ * Function    : parse_endpoint
+ * @params     : text      -> "<SWITCH_NO>:<PORT>"
+ *               line_no   -> line of the topology file, for error messages
+ *               index     -> to store the index of the switch
+ *               port_no   -> to store the port
+ * Output      : 0, -1 if the endpoint is invalid or its port is already used
+ * */
+static int parse_endpoint(const char *text, int line_no, int *index, int *port_no)
+{
+  int number;
+  char end;
+  if(text == NULL || sscanf(text, "%d:%d%c", &number, port_no, &end) != 2 || *port_no < 1 || *port_no > MAX_PORTS)
+  {
+    fprintf(stderr, "line %d: expected <SWITCH_NO>:<PORT>\n", line_no);
+    return -1;
+  }
+  if((*index = find_switch(number)) == -1)
+  {
+    fprintf(stderr, "line %d: switch %d is not declared\n", line_no, number);
+    return -1;
+  }
+  if(port_used[*index][*port_no - 1])
+  {
+    fprintf(stderr, "line %d: port %d of switch %d is already used\n", line_no, *port_no, number);
+    return -1;
+  }
+  port_used[*index][*port_no - 1] = 1;
+  return 0;
+}
+
+/*
+ * Function    : add_arg
+ * @params     : node -> process to start
+ *               arg  -> next argument of its command line
+ * */
+static void add_arg(node_t *node, const char *arg)
+{
+  if(node->argc < MAX_ARGS - 1)
+  {
+    node->argv[node->argc++] = strdup(arg);
+    node->argv[node->argc] = NULL;
+  }
+}
+
+/*
+ * Function    : load_topology
+ * @params     : path -> topology file
+ * Output      : 0, -1 if the file is invalid (errors have been displayed)
+ * */
+static int load_topology(const char *path)
+{
+  FILE *file = fopen(path, "r");
+  if(file == NULL)
+  {
+    perror("Error in fopen()");
+    return -1;
+  }
+
+  char line[256], binary[256];
+  int line_no = 0;
+  while(fgets(line, sizeof(line), file))
+  {
+    line_no++;
+    char *comment = strchr(line, '#');
+    if(comment)
+      *comment = '\0';
+    char *keyword = strtok(line, " \t\n");
+    if(keyword == NULL)
+      continue;
+
+    if(strcmp(keyword, "switch") == 0)
+    {
+      char *arg = strtok(NULL, " \t\n");
+      int number = arg ? atoi(arg) : -1;
+      if(arg == NULL || number < 0 || number > MAX_SWITCH_ID || find_switch(number) != -1 || switch_count == MAX_SWITCHES)
+      {
+        fprintf(stderr, "line %d: invalid or duplicate switch number\n", line_no);
+        return -1;
+      }
+      node_t *node = &switches[switch_count];
+      snprintf(node->name, sizeof(node->name), "sw%d", number);
+      snprintf(binary, sizeof(binary), "%s/switch", bin_dir);
+      add_arg(node, binary);
+      add_arg(node, "-n");
+      add_arg(node, arg);
+      parent[switch_count] = switch_count;
+      switch_no[switch_count++] = number;
+    }
+    else if(strcmp(keyword, "link") == 0)
+    {
+      link_t *link = &links[link_count];
+      int index[2];
+      for(int end = 0; end < 2; end++)
+      {
+        if(parse_endpoint(strtok(NULL, " \t\n"), line_no, &index[end], &link->port_no[end]) == -1)
+          return -1;
+        link->switch_no[end] = switch_no[index[end]];
+      }
+      if(index[0] == index[1] || find_root(index[0]) == find_root(index[1]))
+      {
+        fprintf(stderr, "line %d: link closes a loop, the links must form a chain or a tree\n", line_no);
+        return -1;
+      }
+      parent[find_root(index[0])] = find_root(index[1]);
+      link_count++;
+    }
+    else if(strcmp(keyword, "station") == 0)
+    {
+      char *mac_address = strtok(NULL, " \t\n");
+      int index, port_no;
+      if(mac_address == NULL || strlen(mac_address) != 17 || station_count == MAX_STATIONS)
+      {
+        fprintf(stderr, "line %d: expected station <MAC_ADDRESS> <SWITCH_NO>:<PORT>\n", line_no);
+        return -1;
+      }
+      if(parse_endpoint(strtok(NULL, " \t\n"), line_no, &index, &port_no) == -1)
+        return -1;
+      node_t *node = &stations[station_count++];
+      char text[16];
+      snprintf(node->name, sizeof(node->name), "%s", mac_address);
+      snprintf(binary, sizeof(binary), "%s/station", bin_dir);
+      add_arg(node, binary);
+      add_arg(node, mac_address);
+      snprintf(text, sizeof(text), "%d", port_no);
+      add_arg(node, text);
+      add_arg(node, "-s");
+      snprintf(text, sizeof(text), "%d", switch_no[index]);
+      add_arg(node, text);
+      /* the rest of the line are station options */
+      for(char *option = strtok(NULL, " \t\n"); option; option = strtok(NULL, " \t\n"))
+        add_arg(node, option);
+    }
+    else
+    {
+      fprintf(stderr, "line %d: unknown statement %s\n", line_no, keyword);
+      return -1;
+    }
+  }
+  fclose(file);
+
+  /* both ends of a link are stack ports */
+  for(int i = 0; i < link_count; i++)
+  {
+    for(int end = 0; end < 2; end++)
+    {
+      char arg[32];
+      snprintf(arg, sizeof(arg), "%d:%d:%d", links[i].port_no[end], links[i].switch_no[1 - end], links[i].port_no[1 - end]);
+      node_t *node = &switches[find_switch(links[i].switch_no[end])];
+      add_arg(node, "-t");
+      add_arg(node, arg);
+    }
+  }
+  return switch_count ? 0 : -1;
+}
+
+/*
+ * Function    : copy_output
+ * @params     : arg -> node whose output is copied to its log file
+ * Description : Marks the node ready when its menu shows up, which is after it attached all its ports
+ * */
+static void *copy_output(void *arg)
+{
+  node_t *node = (node_t *) arg;
+  char buf[4096];
+  /* keeps the end of the previous read, the word may be split across two reads */
+  char tail[8] = "";
+  ssize_t n;
+  while((n = read(node->pty_fd, buf, sizeof(buf) - 1)) > 0)
+  {
+    fwrite(buf, 1, n, node->log);
+    fflush(node->log);
+    if(!node->ready)
+    {
+      buf[n] = '\0';
+      char window[sizeof(tail) + sizeof(buf)];
+      snprintf(window, sizeof(window), "%s%s", tail, buf);
+      if(strstr(window, "MENU"))
+        node->ready = 1;
+      strcpy(tail, n >= 7 ? buf + n - 7 : buf);
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Function    : start_node
+ * @params     : node -> process to start
+ * Output      : 0 once the node displays its menu, -1 if it could not be started or exited
+ * */
+static int start_node(node_t *node)
+{
+  char log_name[64];
+  snprintf(log_name, sizeof(log_name), "fabric_%s.out", node->name);
+  if((node->log = fopen(log_name, "w")) == NULL)
+  {
+    perror("Error in fopen()");
+    return -1;
+  }
+
+  node->pid = forkpty(&node->pty_fd, NULL, NULL, NULL);
+  if(node->pid == -1)
+  {
+    perror("Error in forkpty()");
+    return -1;
+  }
+  if(node->pid == 0)
+  {
+    execv(node->argv[0], node->argv);
+    perror("Error in execv()");
+    exit(EXIT_FAILURE);
+  }
+  pthread_create(&node->output_thread, NULL, copy_output, node);
+
+  for(int waited = 0; !node->ready; waited += 10)
+  {
+    if(waited >= READY_TIMEOUT_MS || waitpid(node->pid, NULL, WNOHANG) == node->pid)
+    {
+      fprintf(stderr, "%s did not come up, see %s\n", node->name, log_name);
+      node->pid = 0;
+      return -1;
+    }
+    struct timespec delay = {0, 10000000};
+    nanosleep(&delay, NULL);
+  }
+  return 0;
+}
+
+/*
+ * Function    : stop_node
+ * @params     : node -> process to stop with SIGINT, as ctrl+c on its terminal would
+ * */
+static void stop_node(node_t *node)
+{
+  if(node->pid <= 0)
+    return;
+  kill(node->pid, SIGINT);
+  waitpid(node->pid, NULL, 0);
+  node->pid = 0;
+  /* the output thread sees the end of the terminal once the node has exited */
+  pthread_join(node->output_thread, NULL);
+  close(node->pty_fd);
+  fclose(node->log);
+}
+
+/*
+ * Function    : stop_fabric
+ * Description : Stations first, so every switch sees them leave, then the switches
+ * */
+static void stop_fabric()
+{
+  for(int i = 0; i < station_count; i++)
+    stop_node(&stations[i]);
+  for(int i = 0; i < switch_count; i++)
+    stop_node(&switches[i]);
+}
+
+/*
+ * Function    : find_node
+ * @params     : name -> sw<N> or a station mac address
+ * Output      : the node, NULL if there is none with that name
+ * */
+static node_t *find_node(const char *name)
+{
+  for(int i = 0; i < switch_count; i++)
+  {
+    if(strcmp(switches[i].name, name) == 0)
+      return &switches[i];
+  }
+  for(int i = 0; i < station_count; i++)
+  {
+    if(strcasecmp(stations[i].name, name) == 0)
+      return &stations[i];
+  }
+  return NULL;
+}
+
+static void list_nodes()
+{
+  for(int i = 0; i < switch_count; i++)
+  {
+    printf("%-20s pid %-7d", switches[i].name, switches[i].pid);
+    for(int a = 3; a < switches[i].argc; a++)
+      printf(" %s", switches[i].argv[a]);
+    printf("\n");
+  }
+  for(int i = 0; i < station_count; i++)
+  {
+    printf("%-20s pid %-7d switch %s port %s\n", stations[i].name, stations[i].pid, stations[i].argv[4],
+           stations[i].argv[2]);
+  }
+}
+
+static void ignore_signal(int sig)
+{
+}
+
+int main(int argc, char *argv[])
+{
+  const char *topology = NULL;
+  for(int i = 1; i < argc; i++)
+  {
+    if(strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+      bin_dir = argv[++i];
+    else
+      topology = argv[i];
+  }
+  if(topology == NULL)
+  {
+    printf("Usage: ./fabric [-b <BIN_DIR>] <TOPOLOGY_FILE>\n");
+    return EXIT_FAILURE;
+  }
+  if(load_topology(topology) == -1)
+  {
+    return EXIT_FAILURE;
+  }
+
+  /* ctrl+c interrupts the console read and stops the fabric */
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = ignore_signal;
+  sigaction(SIGINT, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  for(int i = 0; i < switch_count; i++)
+  {
+    if(start_node(&switches[i]) == -1)
+    {
+      stop_fabric();
+      return EXIT_FAILURE;
+    }
+  }
+  for(int i = 0; i < station_count; i++)
+  {
+    if(start_node(&stations[i]) == -1)
+    {
+      stop_fabric();
+      return EXIT_FAILURE;
+    }
+  }
+  printf("Fabric is up: %d switches, %d links, %d stations\n", switch_count, link_count, station_count);
+  list_nodes();
+
+  char line[512];
+  while(printf("fabric> "), fflush(stdout), fgets(line, sizeof(line), stdin))
+  {
+    line[strcspn(line, "\n")] = '\0';
+    char *name = strtok(line, " \t");
+    if(name == NULL)
+      continue;
+    if(strcmp(name, "quit") == 0)
+      break;
+    if(strcmp(name, "list") == 0)
+    {
+      list_nodes();
+      continue;
+    }
+    node_t *node = find_node(name);
+    char *input = strtok(NULL, "");
+    if(node == NULL || node->pid <= 0 || input == NULL)
+    {
+      printf("Usage: <NODE> <INPUT> | list | quit\n");
+      continue;
+    }
+    for(char *c = input; *c; c++)
+    {
+      if(*c == ';')
+        *c = '\n';
+    }
+    if(write(node->pty_fd, input, strlen(input)) == -1 || write(node->pty_fd, "\n", 1) == -1)
+    {
+      printf("%s has exited\n", node->name);
+    }
+  }
+  printf("\nStopping the fabric\n");
+  stop_fabric();
+  return 0;
+}
@@ -0,0 +1,181 @@
+/*
+ * File        : fcs.c
+ * Description : Computes and verifies the CRC32C frame check sequence. Uses the SSE4.2 crc32 instruction on x86-64 or the
+ *               ARMv8 CRC instructions on aarch64 when the cpu supports them, otherwise a table driven implementation.
+ * */
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "frame.h"
+#include "fcs.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+/* reflected Castagnoli polynomial */
+#define CRC32C_POLY 0x82F63B78
+
+static unsigned int crc32c_lookup[256];
+
+crc32c_fn_t crc32c_hw = NULL;
+
+/* implementation used by crc32c(), table driven until crc32c_init() finds something better */
+static crc32c_fn_t crc32c_update = crc32c_table_driven;
+static const char *crc32c_name = "table";
+
+/*
+ * Function    : crc32c_table_driven
+ * @params     : crc -> running crc (already inverted)
+ *               buf -> bytes to add
+ *               len -> number of bytes
+ * Output      : updated crc
+ * Description : Portable byte at a time crc32c using a 256 entry lookup table
+ * */
+unsigned int crc32c_table_driven(unsigned int crc, const void *buf, size_t len)
+{
+  const unsigned char *p = (const unsigned char *) buf;
+  while(len--)
+  {
+    crc = crc32c_lookup[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if defined(__x86_64__)
+/*
+ * Function    : crc32c_sse42
+ * Description : crc32c using the SSE4.2 crc32 instruction, eight bytes per instruction
+ * */
+__attribute__((target("sse4.2")))
+static unsigned int crc32c_sse42(unsigned int crc, const void *buf, size_t len)
+{
+  const unsigned char *p = (const unsigned char *) buf;
+  unsigned long long crc64 = crc;
+  while(len >= 8)
+  {
+    unsigned long long word;
+    memcpy(&word, p, 8);
+    crc64 = _mm_crc32_u64(crc64, word);
+    p += 8;
+    len -= 8;
+  }
+  crc = (unsigned int) crc64;
+  while(len--)
+  {
+    crc = _mm_crc32_u8(crc, *p++);
+  }
+  return crc;
+}
+#elif defined(__aarch64__)
+/*
+ * Function    : crc32c_armv8
+ * Description : crc32c using the ARMv8 crc32c instructions, eight bytes per instruction
+ * */
+__attribute__((target("+crc")))
+static unsigned int crc32c_armv8(unsigned int crc, const void *buf, size_t len)
+{
+  const unsigned char *p = (const unsigned char *) buf;
+  while(len >= 8)
+  {
+    unsigned long long word;
+    memcpy(&word, p, 8);
+    crc = __crc32cd(crc, word);
+    p += 8;
+    len -= 8;
+  }
+  while(len--)
+  {
+    crc = __crc32cb(crc, *p++);
+  }
+  return crc;
+}
+#endif
+
+/*
+ * Function    : crc32c_init
+ * Description : Builds the lookup table and selects the fastest implementation supported by this cpu
+ * */
+void crc32c_init()
+{
+  for(unsigned int i=0; i<256; i++)
+  {
+    unsigned int crc = i;
+    for(int j=0; j<8; j++)
+    {
+      crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : (crc >> 1);
+    }
+    crc32c_lookup[i] = crc;
+  }
+
+#if defined(__x86_64__)
+  if(__builtin_cpu_supports("sse4.2"))
+  {
+    crc32c_hw = crc32c_sse42;
+    crc32c_name = "sse4.2";
+  }
+#elif defined(__aarch64__)
+  if(getauxval(AT_HWCAP) & HWCAP_CRC32)
+  {
+    crc32c_hw = crc32c_armv8;
+    crc32c_name = "armv8-crc";
+  }
+#endif
+  if(crc32c_hw)
+  {
+    crc32c_update = crc32c_hw;
+  }
+}
+
+/*
+ * Function    : crc32c_impl_name
+ * Output      : name of the implementation selected by crc32c_init
+ * */
+const char *crc32c_impl_name()
+{
+  return crc32c_name;
+}
+
+/*
+ * Function    : crc32c
+ * @params     : buf -> bytes to checksum
+ *               len -> number of bytes
+ * Output      : crc32c of buf
+ * */
+unsigned int crc32c(const void *buf, size_t len)
+{
+  return ~crc32c_update(~0U, buf, len);
+}
+
+/*
+ * Function    : frame_set_fcs
+ * @params     : frame -> FRAME_SIZE bytes frame in wire format
+ * Description : Marks the frame as carrying an fcs and stores the crc32c of its first FRAME_FCS_OFFSET bytes in the trailer
+ * */
+void frame_set_fcs(char *frame)
+{
+  frame_t *f = (frame_t *) frame;
+  f->flags |= FRAME_FLAG_FCS;
+  f->fcs = crc32c(frame, FRAME_FCS_OFFSET);
+}
+
+/*
+ * Function    : frame_fcs_ok
+ * @params     : frame -> FRAME_SIZE bytes frame in wire format
+ * Output      : 1 -> frame has no fcs or the fcs matches
+ *               0 -> frame is corrupted
+ * */
+int frame_fcs_ok(const char *frame)
+{
+  const frame_t *f = (const frame_t *) frame;
+  if(!(f->flags & FRAME_FLAG_FCS))
+  {
+    return 1;
+  }
+  return f->fcs == crc32c(frame, FRAME_FCS_OFFSET);
+}
@@ -0,0 +1,25 @@
+#ifndef FCS_H
+#define FCS_H
+
+#include <stddef.h>
+
+/*
+ * File        : fcs.h
+ * Description : CRC32C frame check sequence. The implementation (SSE4.2 crc32, ARMv8 CRC or table driven) is picked at
+ *               runtime by crc32c_init().
+ * */
+
+typedef unsigned int (*crc32c_fn_t)(unsigned int crc, const void *buf, size_t len);
+
+void crc32c_init();
+const char *crc32c_impl_name();
+unsigned int crc32c(const void *buf, size_t len);
+
+/* individual implementations, crc32c_hw is NULL when the cpu has no crc instructions */
+unsigned int crc32c_table_driven(unsigned int crc, const void *buf, size_t len);
+extern crc32c_fn_t crc32c_hw;
+
+void frame_set_fcs(char *frame);
+int frame_fcs_ok(const char *frame);
+
+#endif
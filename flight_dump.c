@@ -0,0 +1,270 @@
+/*
+ * File        : flight_dump.c
+ * Description : Prints the flight recorder of a switch (see flight_recorder.h): the last frames received on every
+ *               port with the decision the switch made, oldest first. It only reads the shared memory, so it works
+ *               after the switch crashed or exited as well as while it runs.
+ *               Build: gcc -O2 -o flight_dump flight_dump.c instance.c shm_pages.c -lrt
+ *               Usage: ./flight_dump [-n <SWITCH_NO>] [-p <PORT_NO>] [-c <COUNT>] [-m] [-r]
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "flight_recorder.h"
+#include "instance.h"
+#include "shm_pages.h"
+#include "probes.h"
+
+static const char *drop_reasons[] = {"", "bad fcs", "vlan", "storm control", "filtered", "queue full", "no port",
+                                     "not multicast", "not for station", "acl"};
+static const char *flood_kinds[] = {"broadcast", "multicast", "unregistered multicast", "unknown unicast"};
+
+/* records of one port that are complete and not overwritten, oldest first */
+typedef struct port_records
+{
+  flight_record_t *records;
+  int count;
+  int next;                     /* next record to print with -m */
+  unsigned long long skipped;   /* written while being read, or left incomplete by a crash */
+} port_records_t;
+
+/*
+ * Function    : format_time
+ * @params     : time_ns -> CLOCK_REALTIME in ns
+ *               buf     -> buffer of at least 32 bytes
+ * */
+static void format_time(unsigned long long time_ns, char *buf)
+{
+  time_t sec = time_ns / 1000000000ULL;
+  struct tm tm;
+  localtime_r(&sec, &tm);
+  int len = strftime(buf, 32, "%Y-%m-%d %H:%M:%S", &tm);
+  snprintf(buf + len, 32 - len, ".%06llu", (time_ns % 1000000000ULL) / 1000);
+}
+
+/*
+ * Function    : print_record
+ * @params     : port_no -> port the frame was received on
+ *               r       -> record to print
+ * */
+static void print_record(int port_no, const flight_record_t *r)
+{
+  char when[32];
+  format_time(r->time_ns, when);
+  printf("%s run %-3u port %d #%-8llu %.17s -> %.17s vlan %-4u prio %u", when, r->run, port_no, r->seq,
+         r->src_mac_address, r->dest_mac_address, r->vlan_id, r->priority);
+  if(r->ethertype)
+    printf(" type 0x%04x", r->ethertype);
+  switch(r->action)
+  {
+    case FORWARD_DROP:
+      printf(" : DROP (%s", r->reason < sizeof(drop_reasons) / sizeof(drop_reasons[0]) ? drop_reasons[r->reason] : "?");
+      if(r->reason == PROBE_DROP_STORM && r->flood < 4)
+        printf(", %s", flood_kinds[r->flood]);
+      printf(")");
+      break;
+    case FORWARD_UNICAST:
+      printf(" : UNICAST to port %d", r->dest_port);
+      break;
+    case FORWARD_FLOOD:
+      printf(" : FLOOD %s to ports", r->flood < 4 ? flood_kinds[r->flood] : "?");
+      for(int i = 0; i < FLIGHT_RECORDER_PORTS; i++)
+        if(r->port_mask & (1u << i))
+          printf(" %d", i + 1);
+      break;
+    case FORWARD_CONTROL:
+      printf(" : %s group", (r->flags & FRAME_FLAG_MCAST_JOIN) ? "JOIN" : "LEAVE");
+      break;
+  }
+  if(r->flow_cache == FLOW_CACHE_HIT)
+    printf(" [flow hit]");
+  printf("\n");
+}
+
+/*
+ * Function    : switch_running
+ * @params     : pid -> switch process of the last run
+ * Output      : 1 if the process still runs, a crashed switch may be left as a zombie until its parent reaps it
+ * */
+static int switch_running(pid_t pid)
+{
+  char path[64], state = 0;
+  snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+  FILE *fp = fopen(path, "r");
+  if(fp)
+  {
+    /* pid (comm) state ..., comm may hold spaces and parentheses */
+    char line[512];
+    if(fgets(line, sizeof(line), fp))
+    {
+      char *end = strrchr(line, ')');
+      if(end && end[1] == ' ')
+        state = end[2];
+    }
+    fclose(fp);
+    return state != 0 && state != 'Z' && state != 'X';
+  }
+  return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+/*
+ * Function    : read_port
+ * @params     : recorder -> mapped flight recorder
+ *               port     -> port index
+ *               count    -> at most this many of the newest records, 0 for all
+ *               out      -> records read
+ * Description : Copies the port's ring. A record is kept only if its sequence number is the one expected at its
+ *               position before and after the copy, which skips records being written by a running switch.
+ * */
+static void read_port(const flight_recorder_t *recorder, int port, int count, port_records_t *out)
+{
+  unsigned long long head = __atomic_load_n(&recorder->port[port].head, __ATOMIC_ACQUIRE);
+  unsigned long long first = head > FLIGHT_RECORDER_ENTRIES ? head - FLIGHT_RECORDER_ENTRIES : 0;
+  if(count > 0 && head - first > (unsigned long long) count)
+    first = head - count;
+
+  out->records = malloc((head - first + 1) * sizeof(flight_record_t));
+  out->count = 0;
+  out->next = 0;
+  out->skipped = 0;
+  for(unsigned long long k = first; k < head; k++)
+  {
+    const flight_record_t *r = &recorder->records[port][k & (FLIGHT_RECORDER_ENTRIES - 1)];
+    flight_record_t copy = *r;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(copy.seq != k + 1 || __atomic_load_n(&r->seq, __ATOMIC_RELAXED) != k + 1)
+    {
+      out->skipped++;
+      continue;
+    }
+    out->records[out->count++] = copy;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int port_no = 0, count = 0, merge = 0, remove = 0;
+  for(int i = 1; i < argc; i++)
+  {
+    if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+    {
+      int switch_id = atoi(argv[++i]);
+      if(switch_id < 0 || switch_id > MAX_SWITCH_ID)
+      {
+        printf("Error: Switch number must be between 0 and %d\n", MAX_SWITCH_ID);
+        return EXIT_FAILURE;
+      }
+      set_switch_instance(switch_id);
+    }
+    else if(strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+    {
+      port_no = atoi(argv[++i]);
+      if(port_no < 1 || port_no > FLIGHT_RECORDER_PORTS)
+      {
+        printf("Error: Port number must be between 1 and %d\n", FLIGHT_RECORDER_PORTS);
+        return EXIT_FAILURE;
+      }
+    }
+    else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+    {
+      count = atoi(argv[++i]);
+    }
+    else if(strcmp(argv[i], "-m") == 0)
+    {
+      merge = 1;
+    }
+    else if(strcmp(argv[i], "-r") == 0)
+    {
+      remove = 1;
+    }
+    else
+    {
+      printf("Usage: ./flight_dump [-n <SWITCH_NO>] [-p <PORT_NO>] [-c <COUNT>] [-m] [-r]\n");
+      printf("  -n : number of the switch (default 0)\n");
+      printf("  -p : only the frames received on PORT_NO\n");
+      printf("  -c : only the last COUNT frames of every port\n");
+      printf("  -m : merge the ports in time order instead of one port after the other\n");
+      printf("  -r : remove the flight recorder after printing it\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  int fd;
+  flight_recorder_t *recorder = shm_map(instance_name(FLIGHT_RECORDER), FLIGHT_RECORDER_SIZE, PROT_READ, &fd);
+  if(recorder == MAP_FAILED)
+  {
+    return EXIT_FAILURE;
+  }
+  if(recorder->magic != FLIGHT_RECORDER_MAGIC || recorder->version != FLIGHT_RECORDER_VERSION ||
+     recorder->ports != FLIGHT_RECORDER_PORTS || recorder->entries != FLIGHT_RECORDER_ENTRIES ||
+     recorder->record_size != sizeof(flight_record_t))
+  {
+    printf("Error: Flight recorder has an unknown layout (version %u)\n", recorder->version);
+    return EXIT_FAILURE;
+  }
+
+  char started[32];
+  format_time(recorder->start_ns, started);
+  int running = switch_running(recorder->pid);
+  printf("Flight recorder of switch %d: run %u, pid %d (%s), started %s\n", get_switch_instance(), recorder->run,
+         recorder->pid, running ? "running" : "not running", started);
+
+  port_records_t ports[FLIGHT_RECORDER_PORTS];
+  for(int i = 0; i < FLIGHT_RECORDER_PORTS; i++)
+  {
+    memset(&ports[i], 0, sizeof(ports[i]));
+    if(port_no != 0 && port_no != i + 1)
+      continue;
+    read_port(recorder, i, count, &ports[i]);
+    printf("Port %d: %llu frames recorded, %d shown", i + 1, recorder->port[i].head, ports[i].count);
+    if(ports[i].skipped)
+      printf(", %llu incomplete", ports[i].skipped);
+    printf("\n");
+  }
+  printf("\n");
+
+  if(merge)
+  {
+    /* oldest first over all ports, every port is already in order */
+    while(1)
+    {
+      int oldest = -1;
+      for(int i = 0; i < FLIGHT_RECORDER_PORTS; i++)
+      {
+        if(ports[i].next < ports[i].count && (oldest == -1 || ports[i].records[ports[i].next].time_ns <
+                                              ports[oldest].records[ports[oldest].next].time_ns))
+          oldest = i;
+      }
+      if(oldest == -1)
+        break;
+      print_record(oldest + 1, &ports[oldest].records[ports[oldest].next++]);
+    }
+  }
+  else
+  {
+    for(int i = 0; i < FLIGHT_RECORDER_PORTS; i++)
+    {
+      for(int j = 0; j < ports[i].count; j++)
+        print_record(i + 1, &ports[i].records[j]);
+    }
+  }
+
+  for(int i = 0; i < FLIGHT_RECORDER_PORTS; i++)
+    free(ports[i].records);
+  shm_unmap(recorder, FLIGHT_RECORDER_SIZE);
+  close(fd);
+  if(remove)
+  {
+    if(running)
+      printf("Switch is running, the flight recorder is not removed\n");
+    else
+      shm_remove(instance_name(FLIGHT_RECORDER));
+  }
+  return EXIT_SUCCESS;
+}
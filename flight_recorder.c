@@ -0,0 +1,110 @@
+/*
+ * File        : flight_recorder.c
+ * Description : Creates or reopens the flight recorder shared memory and writes the records of the ingress worker.
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "flight_recorder.h"
+#include "instance.h"
+#include "shm_pages.h"
+
+flight_recorder_t *flight_recorder;
+
+static int shm_flight_recorder_fd;
+
+/*
+ * Function    : init_flight_recorder
+ * Description : Opens and maps the flight recorder shared memory. The records of previous switch processes are kept,
+ *               unless they were written with another layout, and this process starts a new run.
+ * */
+int init_flight_recorder()
+{
+  flight_recorder = shm_map(instance_name(FLIGHT_RECORDER), FLIGHT_RECORDER_SIZE, PROT_READ | PROT_WRITE,
+                            &shm_flight_recorder_fd);
+  if(flight_recorder == MAP_FAILED)
+  {
+    flight_recorder = NULL;
+    return EXIT_FAILURE;
+  }
+
+  if(flight_recorder->magic != FLIGHT_RECORDER_MAGIC || flight_recorder->version != FLIGHT_RECORDER_VERSION ||
+     flight_recorder->ports != FLIGHT_RECORDER_PORTS || flight_recorder->entries != FLIGHT_RECORDER_ENTRIES ||
+     flight_recorder->record_size != sizeof(flight_record_t))
+  {
+    memset(flight_recorder, 0, FLIGHT_RECORDER_SIZE);
+    flight_recorder->magic = FLIGHT_RECORDER_MAGIC;
+    flight_recorder->version = FLIGHT_RECORDER_VERSION;
+    flight_recorder->ports = FLIGHT_RECORDER_PORTS;
+    flight_recorder->entries = FLIGHT_RECORDER_ENTRIES;
+    flight_recorder->record_size = sizeof(flight_record_t);
+  }
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  flight_recorder->run++;
+  flight_recorder->pid = getpid();
+  flight_recorder->start_ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Function    : flight_record
+ * @params     : port_index -> port the frame was received on, 0 based
+ *               f          -> the frame, addresses may be null terminated
+ *               result     -> decision of the switch for the frame
+ * Description : Appends a record to the port's ring. Only the ingress worker writes to it, so plain stores are
+ *               enough: the record is marked incomplete first and given its sequence number last, the compiler
+ *               barriers keep that order and a crash in between leaves a record that flight_dump skips.
+ * */
+void flight_record(int port_index, const frame_t *f, const forward_result_t *result)
+{
+  if(!flight_recorder)
+    return;
+
+  flight_recorder_port_t *port = &flight_recorder->port[port_index];
+  unsigned long long head = port->head;
+  flight_record_t *r = &flight_recorder->records[port_index][head & (FLIGHT_RECORDER_ENTRIES - 1)];
+  r->seq = 0;
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  r->time_ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  memcpy(r->src_mac_address, f->src_mac_address, sizeof(r->src_mac_address));
+  memcpy(r->dest_mac_address, f->dest_mac_address, sizeof(r->dest_mac_address));
+  r->vlan_id = result->vlan_id == -1 ? f->vlan_id : result->vlan_id;
+  r->ethertype = f->ethertype;
+  r->flags = f->flags;
+  r->priority = f->priority;
+  r->action = result->action;
+  r->reason = result->reason;
+  r->flood = result->flood;
+  r->flow_cache = result->flow_cache;
+  r->dest_port = result->dest_port;
+  r->port_mask = result->port_mask;
+  r->run = flight_recorder->run;
+
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+  r->seq = head + 1;
+  port->head = head + 1;
+}
+
+/*
+ * Function    : close_flight_recorder
+ * Description : Unmaps the flight recorder, the shared memory is left for flight_dump and the next switch process
+ * */
+void close_flight_recorder()
+{
+  if(!flight_recorder)
+    return;
+  shm_unmap(flight_recorder, FLIGHT_RECORDER_SIZE);
+  flight_recorder = NULL;
+  close(shm_flight_recorder_fd);
+}
@@ -0,0 +1,74 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+/*
+ * File        : flight_recorder.h
+ * Description : Always on record of the last frames received on every port and of what the switch decided for them,
+ *               one ring of fixed size records per port in a shared memory. Records are written with plain stores by
+ *               the port's thread and the shared memory is never removed by the switch, so after a crash (or any exit)
+ *               the last FLIGHT_RECORDER_ENTRIES frames of each port can be read with flight_dump. A new switch process
+ *               continues the rings of the previous one under a new run number.
+ * */
+
+#include <sys/types.h>
+
+#include "frame.h"
+#include "forward.h"
+
+#define FLIGHT_RECORDER "/flight_recorder"
+
+#define FLIGHT_RECORDER_MAGIC 0x464c5452 /* "FLTR" */
+#define FLIGHT_RECORDER_VERSION 1
+#define FLIGHT_RECORDER_PORTS 4
+#define FLIGHT_RECORDER_ENTRIES 4096     /* records per port, a power of two */
+
+/* one cache line, written by one port thread only */
+typedef struct flight_record
+{
+  unsigned long long seq;       /* 1 + position in the port's stream of records, 0 while the record is written */
+  unsigned long long time_ns;   /* CLOCK_REALTIME when the decision was made */
+  char src_mac_address[17];     /* as received, not null terminated */
+  char dest_mac_address[17];
+  unsigned short vlan_id;       /* vlan of the decision, the frame's tag if the port does not carry it */
+  unsigned short ethertype;
+  unsigned char flags;          /* FRAME_FLAG_* of the frame */
+  unsigned char priority;
+  unsigned char action;         /* FORWARD_* */
+  unsigned char reason;         /* FORWARD_DROP -> PROBE_DROP_* */
+  unsigned char flood;          /* FLOOD_* of floods and storm control drops */
+  unsigned char flow_cache;     /* FLOW_CACHE_* */
+  signed char dest_port;        /* FORWARD_UNICAST -> destination port */
+  unsigned char port_mask;      /* FORWARD_FLOOD -> destination ports, bit i -> port i+1 */
+  unsigned short run;           /* run of the switch process that wrote the record */
+} flight_record_t;
+
+typedef struct flight_recorder_port
+{
+  unsigned long long head;      /* records written to the port, the next one goes to head % FLIGHT_RECORDER_ENTRIES */
+  char pad[56];                 /* heads of different ports are written by different threads */
+} flight_recorder_port_t;
+
+typedef struct flight_recorder
+{
+  unsigned int magic;
+  unsigned int version;
+  unsigned int ports;
+  unsigned int entries;
+  unsigned int record_size;
+  unsigned int run;             /* incremented by every switch process that opens the recorder */
+  pid_t pid;                    /* switch process of the current run */
+  unsigned long long start_ns;  /* CLOCK_REALTIME when the current run started */
+  char pad[24];
+  flight_recorder_port_t port[FLIGHT_RECORDER_PORTS];
+  flight_record_t records[FLIGHT_RECORDER_PORTS][FLIGHT_RECORDER_ENTRIES];
+} flight_recorder_t;
+
+#define FLIGHT_RECORDER_SIZE sizeof(flight_recorder_t)
+
+extern flight_recorder_t *flight_recorder;
+
+int init_flight_recorder();
+void flight_record(int port_index, const frame_t *f, const forward_result_t *result);
+void close_flight_recorder();
+
+#endif
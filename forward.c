@@ -0,0 +1,304 @@
+/*
+ * File        : forward.c
+ * Description : Forwarding core shared by the switch and the simulator. Frames come in with their addresses null
+ *               terminated (bytes 17 and 35), the caller restores them before sending.
+ * */
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "forward.h"
+#include "storm_control.h"
+#include "mac_util.h"
+#include "multicast_table.h"
+#include "vlan.h"
+#include "lag.h"
+#include "acl.h"
+#include "classify.h"
+#include "mac_learning.h"
+#include "probes.h"
+
+#define MAX_PORTS 4
+
+int is_enabled(int);
+pid_t is_connected(int);
+int get_port_no_from_mac_table(int, char *);
+
+extern unsigned long long mac_table_generation;
+
+/* (vlan, src, dest) of a frame to a known unicast address, whose source was already learned on the ingress port */
+typedef struct flow_entry
+{
+  unsigned long long generation;  /* mac_table_generation when cached, 0 -> empty */
+  unsigned long long src, dest;
+  int vlan_id;
+  int dest_port;                  /* port or LAG of dest in the mac_table */
+} flow_entry_t;
+
+/* direct mapped, one per ingress port and only used by the thread forwarding the port's frames */
+static flow_entry_t flow_cache[MAX_PORTS][FLOW_CACHE_SIZE];
+
+/*
+ * Function    : coarse_now_ns
+ * Output      : monotonic time in nanoseconds
+ * Description : Uses the coarse clock, read from the vdso without a syscall. Its resolution of a few milliseconds is
+ *               fine for the rates in frames per second and the one second windows the forwarding core measures.
+ * */
+static unsigned long long coarse_now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* clock of storm control and the learning limits, the simulator replaces it with its simulated time */
+static unsigned long long (*forward_clock)() = coarse_now_ns;
+
+/*
+ * Function    : set_forward_clock
+ * @params     : now_ns -> returns the time in nanoseconds, NULL -> the coarse monotonic clock
+ * Description : Set before the first frame is forwarded
+ * */
+void set_forward_clock(unsigned long long (*now_ns)())
+{
+  forward_clock = now_ns ? now_ns : coarse_now_ns;
+}
+
+/*
+ * Function    : forward_now_ns
+ * Output      : time of the forwarding core in nanoseconds
+ * */
+unsigned long long forward_now_ns()
+{
+  return forward_clock();
+}
+
+/*
+ * Function    : flow_index
+ * @params     : vlan_id -> vlan of the flow
+ *               hash    -> classify_hash() of the flow's addresses
+ * Output      : slot of the flow in its port's cache
+ * */
+static unsigned int flow_index(int vlan_id, unsigned int hash)
+{
+  return (hash + (unsigned int) vlan_id * 0x9e3779b1u) & (FLOW_CACHE_SIZE - 1);
+}
+
+/*
+ * Function    : forward_drop
+ * @params     : result -> result to fill
+ *               reason -> PROBE_DROP_* reason
+ * */
+static void forward_drop(forward_result_t *result, int reason)
+{
+  result->action = FORWARD_DROP;
+  result->reason = reason;
+}
+
+/*
+ * Function    : forward_flood
+ * @params     : port_no   -> port the frame was received on
+ *               f         -> the frame
+ *               port_mask -> ports of the vlan for broadcast and unknown unicast, of the group in the vlan for multicast
+ *               kind      -> FLOOD_* kind of the frame
+ *               result    -> result to fill
+ * Description : Never back to the port or LAG the frame came from, one copy to every other LAG, and only to enabled
+ *               ports with a station
+ * */
+static void forward_flood(int port_no, frame_t *f, unsigned int port_mask, int kind, forward_result_t *result)
+{
+  port_mask = lag_flood_mask(port_mask & ~lag_port_mask(port_no), f->src_mac_address, f->dest_mac_address);
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    if((port_mask & (1u << i)) && (i == port_no - 1 || !is_enabled(i) || !is_connected(i)))
+    {
+      port_mask &= ~(1u << i);
+    }
+  }
+  result->action = FORWARD_FLOOD;
+  result->flood = kind;
+  result->port_mask = port_mask;
+}
+
+/*
+ * Function    : forward_unicast
+ * @params     : port_no      -> port the frame was received on
+ *               f            -> the frame
+ *               vlan_ports   -> ports of the frame's vlan
+ *               dest_port_no -> port or LAG of the destination in the mac_table
+ *               result       -> result to fill
+ * Description : Port state is in shared memory changed by other processes, so it is checked for every frame, even when
+ *               the mac_table lookup came from the flow cache
+ * */
+static void forward_unicast(int port_no, frame_t *f, unsigned int vlan_ports, int dest_port_no, forward_result_t *result)
+{
+  /* a frame from a LAG to an address learned on the same LAG is filtered like one to its own port */
+  int same_port = lag_logical_port(port_no) == dest_port_no;
+  /* an address learned on a LAG is reached through the member its flow hashes to */
+  dest_port_no = lag_select_port(dest_port_no, f->src_mac_address, f->dest_mac_address);
+  /* unicast the frame only if the dest_port is enabled, still in the vlan and src_port is not equal to dest_port */
+  if(!same_port && dest_port_no != -1 && is_enabled(dest_port_no - 1) && is_connected(dest_port_no - 1) &&
+     (vlan_ports & (1u << (dest_port_no - 1))))
+  {
+    result->action = FORWARD_UNICAST;
+    result->dest_port = dest_port_no;
+  }
+  else
+  {
+    forward_drop(result, PROBE_DROP_FILTERED);
+  }
+}
+
+/*
+ * Function    : forward_frame
+ * @params     : port_no -> port the frame was received on
+ *               f       -> the frame, addresses null terminated
+ *               result  -> what to do with the frame
+ * Description : Learns the source address and decides where the frame goes
+ * */
+void forward_frame(int port_no, frame_t *f, forward_result_t *result)
+{
+  result->reason = 0;
+  result->flood = 0;
+  result->dest_port = -1;
+  result->port_mask = 0;
+  result->flow_cache = FLOW_CACHE_NONE;
+
+  /* addresses parsed, address tests and flow hash, the switch hands over one frame at a time */
+  frame_class_t cls;
+  const frame_t *batch[1] = {f};
+  classify_batch(batch, 1, CLASSIFY_NO_STATION, &cls);
+  int broadcast = cls.flags[0] & CLASS_BROADCAST;
+  /* malformed addresses keep the text test of their first octet */
+  int group = (cls.flags[0] & CLASS_INVALID) ? is_multicast_mac_address(f->dest_mac_address) :
+                                               cls.flags[0] & CLASS_GROUP;
+
+  /* vlan of the frame, from its tag or the port, frames of vlans the port does not carry are dropped */
+  int vlan_id = result->vlan_id = vlan_ingress(port_no - 1, f->vlan_id);
+  if(vlan_id == -1)
+  {
+    forward_drop(result, PROBE_DROP_VLAN);
+    return;
+  }
+  /* the ingress ACL of the port drops frames before they are learned from */
+  if(acl_check(port_no - 1, f) == ACL_DENY)
+  {
+    forward_drop(result, PROBE_DROP_ACL);
+    return;
+  }
+  /* floods never leave the vlan */
+  unsigned int vlan_ports = vlan_member_ports(vlan_id);
+
+  /* a cached flow skips learning and the mac_table lookup, the source is known on this port and the destination's
+   * port is the one cached, unless the mac_table generation changed since */
+  flow_entry_t *flow = NULL;
+  unsigned long long generation = 0, src = cls.src[0], dest = cls.dest[0];
+  if(!(cls.flags[0] & (CLASS_CONTROL | CLASS_GROUP | CLASS_INVALID)))
+  {
+    generation = __atomic_load_n(&mac_table_generation, __ATOMIC_ACQUIRE);
+    flow = &flow_cache[port_no - 1][flow_index(vlan_id, cls.hash[0])];
+    if(flow->generation == generation && flow->src == src && flow->dest == dest && flow->vlan_id == vlan_id)
+    {
+      result->flow_cache = FLOW_CACHE_HIT;
+      PROBE4(mac_lookup_hit, port_no, vlan_id, (char *) f->dest_mac_address, flow->dest_port);
+      forward_unicast(port_no, f, vlan_ports, flow->dest_port, result);
+      return;
+    }
+    result->flow_cache = FLOW_CACHE_MISS;
+  }
+
+  /* mac learning -> if src_mac_address is not available in the vlan's mac_table, add it, if it moved, update its port,
+   * as the learning policy of the port allows. addresses seen on a LAG member are learned on the LAG. A source left
+   * unlearned is no flow to cache, its next frame must try again */
+  if(!mac_learning(port_no, lag_logical_port(port_no), vlan_id, f->src_mac_address))
+  {
+    flow = NULL;
+  }
+
+  /* multicast join/leave control frames update the group table and are not forwarded */
+  if(cls.flags[0] & CLASS_CONTROL)
+  {
+    if(!group || broadcast)
+    {
+      forward_drop(result, PROBE_DROP_NOT_MULTICAST);
+      return;
+    }
+    /* a station behind a LAG is a member on every port of the LAG */
+    unsigned int ports = lag_port_mask(port_no);
+    for(int i = 0; i < MAX_PORTS; i++)
+    {
+      if(!(ports & (1u << i)))
+        continue;
+      if(f->flags & FRAME_FLAG_MCAST_JOIN)
+      {
+        multicast_join(f->dest_mac_address, i+1);
+      }
+      else
+      {
+        multicast_leave(f->dest_mac_address, i+1);
+      }
+    }
+    result->action = FORWARD_CONTROL;
+    return;
+  }
+
+  /* broadcast, storm control drops broadcast above the configured rate */
+  if(broadcast)
+  {
+    result->flood = FLOOD_BROADCAST;
+    if(!storm_control_allow(port_no - 1, STORM_BROADCAST))
+    {
+      forward_drop(result, PROBE_DROP_STORM);
+      return;
+    }
+    forward_flood(port_no, f, vlan_ports, FLOOD_BROADCAST, result);
+  }
+  /* multicast frames go to the member ports of the group, unregistered groups are flooded */
+  else if(group)
+  {
+    result->flood = FLOOD_MULTICAST;
+    if(!storm_control_allow(port_no - 1, STORM_MULTICAST))
+    {
+      forward_drop(result, PROBE_DROP_STORM);
+      return;
+    }
+    unsigned int members;
+    if(multicast_get_ports(f->dest_mac_address, &members))
+    {
+      forward_flood(port_no, f, members & vlan_ports, FLOOD_MULTICAST, result);
+    }
+    else
+    {
+      forward_flood(port_no, f, vlan_ports, FLOOD_UNREGISTERED, result);
+    }
+  }
+  /* if the destination mac_address is in the vlan's mac_table, the frame is unicast to its port */
+  else
+  {
+    int dest_port_no = get_port_no_from_mac_table(vlan_id, f->dest_mac_address);
+    if(dest_port_no == -1)
+    {
+      PROBE3(mac_lookup_miss, port_no, vlan_id, (char *) f->dest_mac_address);
+      /* storm control for unknown unicast */
+      result->flood = FLOOD_UNKNOWN_UNICAST;
+      if(!storm_control_allow(port_no - 1, STORM_UNKNOWN_UNICAST))
+      {
+        forward_drop(result, PROBE_DROP_STORM);
+        return;
+      }
+      forward_flood(port_no, f, vlan_ports, FLOOD_UNKNOWN_UNICAST, result);
+      return;
+    }
+    PROBE4(mac_lookup_hit, port_no, vlan_id, (char *) f->dest_mac_address, dest_port_no);
+    /* generation was read before learning, so a change made since leaves the entry stale */
+    if(flow)
+    {
+      flow->generation = generation;
+      flow->src = src;
+      flow->dest = dest;
+      flow->vlan_id = vlan_id;
+      flow->dest_port = dest_port_no;
+    }
+    forward_unicast(port_no, f, vlan_ports, dest_port_no, result);
+  }
+}
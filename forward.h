@@ -0,0 +1,46 @@
+#ifndef FORWARD_H
+#define FORWARD_H
+
+/*
+ * File        : forward.h
+ * Description : Forwarding decision for a received frame: vlan, ingress ACL, mac learning, multicast join/leave, storm
+ *               control, mac_table lookup and the ports a flood reaches. It does no I/O and keeps no counters, so the
+ *               switch's ingress worker and the simulator (sim.c) run the same code.
+ * */
+
+#include "frame.h"
+
+/* actions */
+#define FORWARD_DROP 0
+#define FORWARD_UNICAST 1
+#define FORWARD_FLOOD 2
+#define FORWARD_CONTROL 3       /* multicast join/leave, applied to the group table and not forwarded */
+
+/* kinds of flooded traffic, also set for frames dropped by storm control */
+#define FLOOD_BROADCAST 0
+#define FLOOD_MULTICAST 1       /* to the member ports of a registered group */
+#define FLOOD_UNREGISTERED 2    /* multicast group nobody joined */
+#define FLOOD_UNKNOWN_UNICAST 3
+
+/* flow cache of the ingress port, for frames to individual addresses */
+#define FLOW_CACHE_SIZE 256     /* entries per port, a power of two */
+#define FLOW_CACHE_NONE 0       /* not looked up: group address, join/leave or dropped before */
+#define FLOW_CACHE_HIT 1
+#define FLOW_CACHE_MISS 2
+
+typedef struct forward_result
+{
+  int action;
+  int reason;                   /* FORWARD_DROP -> PROBE_DROP_* reason */
+  int flood;                    /* FORWARD_FLOOD or storm control drop -> FLOOD_* kind */
+  int vlan_id;                  /* vlan of the frame, -1 if the port does not carry it */
+  int dest_port;                /* FORWARD_UNICAST -> destination port */
+  unsigned int port_mask;       /* FORWARD_FLOOD -> enabled and connected destination ports, bit i -> port i+1 */
+  int flow_cache;               /* FLOW_CACHE_* */
+} forward_result_t;
+
+void forward_frame(int port_no, frame_t *f, forward_result_t *result);
+void set_forward_clock(unsigned long long (*now_ns)());
+unsigned long long forward_now_ns();
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+/*
+ * File        : frame.h
+ * Description : Layout of a frame as it travels through the port mqueues. Every message is FRAME_SIZE bytes: the text
+ *               header "<SRC MAC> <DEST MAC> <DATA>" used since the first version, followed by a binary header extension
+ *               and the optional FCS trailer in the last four bytes.
+ * */
+
+#define FRAME_SIZE 100
+
+#define BROADCAST_MAC_ADDRESS "FF:FF:FF:FF:FF:FF"
+
+/* flags in the header extension */
+#define FRAME_FLAG_FCS 0x01 /* fcs trailer is present and covers bytes [0, FRAME_FCS_OFFSET) */
+#define FRAME_FLAG_MCAST_JOIN 0x02  /* control frame, sending station joins the multicast group in dest_mac_address */
+#define FRAME_FLAG_MCAST_LEAVE 0x04 /* control frame, sending station leaves the multicast group in dest_mac_address */
+#define FRAME_FLAG_ECHO_REQUEST 0x08 /* ping, the destination station answers with an echo reply */
+#define FRAME_FLAG_ECHO_REPLY 0x10   /* answer to a ping, carries the seq and timestamp of the request */
+
+#define FRAME_FCS_OFFSET 96
+
+/* ethertype of frames built by stations (ethertype 0 in the header), IEEE local experimental */
+#define ETHERTYPE_LOCAL 0x88b5
+
+/* frame structure */
+typedef struct frame
+{
+  char src_mac_address[18];
+  char dest_mac_address[18];
+  char data[28];
+  /* header extension, zero filled by stations that do not use it */
+  unsigned char flags;
+  unsigned char priority;   /* 0 (lowest) .. 7, like the 802.1Q PCP */
+  unsigned short vlan_id;   /* 802.1Q VID, 0 for an untagged frame */
+  unsigned int seq;         /* echo request/reply sequence number */
+  unsigned int timestamp;   /* echo request send time, low 32 bits of CLOCK_MONOTONIC in ns, returned in the reply */
+  unsigned short ethertype; /* Ethernet type of a frame replayed from a capture, 0 for frames built by stations */
+  unsigned char reserved[18];
+  /* frame check sequence (CRC32C) */
+  unsigned int fcs;
+} frame_t;
+
+#endif
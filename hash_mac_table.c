@@ -1,39 +1,56 @@
 /*
  * File        : hash_mac_table.c
- * Description : Deals with the mac_table. Performs mac learning, adding (port_no, mac_address) pair into the hash table
+ * Description : Deals with the mac_table. Performs mac learning, adding (port_no, vlan_id, mac_address) entries into the
+ *               hash table. Entries are keyed by (vlan_id, mac_address), so every vlan has its own mac_table.
  * */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
-#define TABLE_SIZE 10
+#include "lag.h"
+#include "hash_mac_table.h"
+#include "probes.h"
 
-/* mac_table entires is of type mac_table_t */
-typedef struct mac_table
-{
-  int port_no;
-  char mac_address[18];
-  struct mac_table *next;
-} mac_table_t;
+/* mac_table to store (port,vlan,mac_address) (used hash_map) */
+mac_table_t *mac_table[TABLE_SIZE];
+
+/* entries are added and removed under the lock. Only the forwarding path looks up and moves entries without it, so
+ * a removed entry is only freed at its next quiescent point, once it can no longer be on it */
+static pthread_mutex_t mac_table_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* entries removed from the mac_table and not freed yet, under mac_table_lock */
+static mac_table_t *retired_entries = NULL;
+
+/* changes whenever an address moves or leaves the mac_table, forwarding decisions cached with an older generation
+ * are looked up again. New addresses leave it as is, they change no decision taken before. 0 is never a generation */
+unsigned long long mac_table_generation = 1;
 
-extern mac_table_t *mac_table[TABLE_SIZE];
+/*
+ * Function    : mac_table_changed
+ * Description : Invalidates the cached forwarding decisions, after the mac_table or a port, vlan or LAG changed
+ * */
+void mac_table_changed()
+{
+  __atomic_add_fetch(&mac_table_generation, 1, __ATOMIC_RELEASE);
+}
 
 /*
  * Function    : hash
- * @params     : mac_address -> to compute the hash value
- * Output      : returns hash value of mac_address
- * Description : Calculates hash value of mac_address
+ * @params     : vlan_id     -> vlan of the entry
+ *               mac_address -> to compute the hash value
+ * Output      : returns hash value of (vlan_id, mac_address)
+ * Description : Calculates hash value of mac_address in vlan_id (FNV-1a), bench_mac_table compares it with the others
  * */
-unsigned int hash(char *mac_address)
+unsigned int hash(int vlan_id, char *mac_address)
 {
-  int len = strlen(mac_address);
-  unsigned int hash_value = 0;
-  for(int i=0; i<len; i++)
+  unsigned int hash_value = 2166136261u ^ vlan_id;
+  for(int i=0; mac_address[i]; i++)
   {
-    hash_value += mac_address[i];
-    hash_value *= mac_address[i];
+    hash_value ^= (unsigned char) mac_address[i];
+    hash_value *= 16777619u;
   }
-  return (hash_value%TABLE_SIZE);
+  return hash_value & (TABLE_SIZE - 1);
 }
 
 /*
@@ -46,46 +63,237 @@ void init_mac_table()
   {
     mac_table[i] = NULL;
   }
+  mac_table_changed();
 }
 
 /*
- * Function    : add_to_mac_table
+ * Function    : new_entry
  * @params     : port_no     -> port_no of the station to which it is connected
+ *               vlan_id     -> vlan the station is in
  *               mac_address -> mac_address of the station
- * Description : Inserts (port_no, mac_address) pair into the hash table (i.e. mac_table)
+ *               is_static   -> 1 if the entry is added by hand
+ * Output      : the new entry, not in the mac_table yet, NULL if out of memory
  * */
-void add_to_mac_table(int port_no, char *mac_address)
+static mac_table_t *new_entry(int port_no, int vlan_id, char *mac_address, int is_static)
 {
   mac_table_t *newnode = (mac_table_t *) malloc(sizeof(mac_table_t));
   if(newnode == NULL)
   {
     perror("Error in malloc()");
-    return;
+    return NULL;
   }
   newnode->port_no = port_no;
+  newnode->vlan_id = vlan_id;
   strcpy(newnode->mac_address, mac_address);
+  newnode->is_static = is_static;
   newnode->next = NULL;
+  return newnode;
+}
+
+/*
+ * Function    : find_entry
+ * @params     : index       -> bucket of (vlan_id, mac_address)
+ *               vlan_id     -> vlan of the entry
+ *               mac_address -> mac_address of the entry
+ * Output      : the entry of (vlan_id, mac_address), NULL if it is not in the mac_table
+ * */
+static mac_table_t *find_entry(int index, int vlan_id, char *mac_address)
+{
+  for(mac_table_t *temp = mac_table[index]; temp; temp = temp->next)
+  {
+    if( temp->vlan_id == vlan_id && strcmp(temp->mac_address, mac_address) == 0 )
+    {
+      return temp;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Function    : add_to_mac_table
+ * @params     : port_no     -> port_no of the station to which it is connected
+ *               vlan_id     -> vlan the station is in
+ *               mac_address -> mac_address of the station
+ * Description : Inserts (port_no, vlan_id, mac_address) into the hash table (i.e. mac_table)
+ * */
+void add_to_mac_table(int port_no, int vlan_id, char *mac_address)
+{
+  mac_table_t *newnode = new_entry(port_no, vlan_id, mac_address, 0);
+  if(newnode == NULL)
+  {
+    return;
+  }
+
+  /* get index based on vlan_id and mac_address */
+  int index = hash(vlan_id, mac_address);
+  /* if some entry is already there, make head points to current entry and current entry's next to already.
+   * the entry is complete before it is published, port threads walking the chain never see it half written */
+  pthread_mutex_lock(&mac_table_lock);
+  newnode->next = mac_table[index];
+  __atomic_store_n(&mac_table[index], newnode, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&mac_table_lock);
+}
+
+/*
+ * Function    : add_static_mac_address
+ * @params     : port_no     -> port or LAG the address is reached through
+ *               vlan_id     -> vlan of the address
+ *               mac_address -> mac_address to add
+ * Description : Adds an entry by hand, learning never moves it and it stays when its port disconnects. An address
+ *               already in the mac_table becomes static on port_no.
+ * */
+void add_static_mac_address(int port_no, int vlan_id, char *mac_address)
+{
+  int index = hash(vlan_id, mac_address);
+  mac_table_t *newnode = new_entry(port_no, vlan_id, mac_address, 1);
+  if(newnode == NULL)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&mac_table_lock);
+  mac_table_t *temp = find_entry(index, vlan_id, mac_address);
+  if(temp)
+  {
+    /* refresh_mac_address() reads both without the lock */
+    __atomic_store_n(&temp->is_static, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&temp->port_no, port_no, __ATOMIC_RELAXED);
+    free(newnode);
+    mac_table_changed();
+  }
+  else
+  {
+    newnode->next = mac_table[index];
+    __atomic_store_n(&mac_table[index], newnode, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&mac_table_lock);
+}
+
+/*
+ * Function    : refresh_mac_address
+ * @params     : port_no     -> port on which mac_address was seen as source
+ *               vlan_id     -> vlan of the frame
+ *               mac_address -> source mac_address of the frame
+ * Output      : 1 -> mac_address is in the mac_table, moved to port_no unless it is static
+ *               0 -> mac_address is unknown, nothing is added
+ * Description : The part of mac learning that never allocates, only for the forwarding path. An address seen on its own
+ *               port takes no lock. A move updates the entry in place under the lock, checking again that the entry
+ *               was not made static meanwhile. An entry removed meanwhile is not freed before mac_table_quiescent(), so
+ *               the walk never reaches freed memory.
+ * */
+int refresh_mac_address(int port_no, int vlan_id, char *mac_address)
+{
+  mac_table_t *temp = find_entry(hash(vlan_id, mac_address), vlan_id, mac_address);
+  if(temp == NULL)
+  {
+    return 0;
+  }
+  if(__atomic_load_n(&temp->port_no, __ATOMIC_RELAXED) != port_no && !__atomic_load_n(&temp->is_static, __ATOMIC_RELAXED))
+  {
+    pthread_mutex_lock(&mac_table_lock);
+    int moved = temp->port_no != port_no && !temp->is_static;
+    if(moved)
+    {
+      __atomic_store_n(&temp->port_no, port_no, __ATOMIC_RELAXED);
+      mac_table_changed();
+    }
+    pthread_mutex_unlock(&mac_table_lock);
+    if(moved)
+    {
+      PROBE4(mac_learn, port_no, vlan_id, mac_address, 1);
+    }
+  }
+  return 1;
+}
+
+/*
+ * Function    : learn_mac_address
+ * @params     : port_no     -> port on which mac_address was seen as source
+ *               vlan_id     -> vlan of the frame
+ *               mac_address -> source mac_address of the frame
+ * Output      : 1 -> mac_address was added, 0 -> it was known already
+ * Description : mac learning. Adds unknown addresses and moves known ones to the port they are now seen on. The chain is
+ *               walked again under the lock before adding, the address may have been added since by the other thread.
+ * */
+int learn_mac_address(int port_no, int vlan_id, char *mac_address)
+{
+  if(refresh_mac_address(port_no, vlan_id, mac_address))
+  {
+    return 0;
+  }
+
+  int index = hash(vlan_id, mac_address);
+  mac_table_t *newnode = new_entry(port_no, vlan_id, mac_address, 0);
+  if(newnode == NULL)
+  {
+    return 0;
+  }
+  pthread_mutex_lock(&mac_table_lock);
+  if(find_entry(index, vlan_id, mac_address))
+  {
+    pthread_mutex_unlock(&mac_table_lock);
+    free(newnode);
+    return 0;
+  }
+  newnode->next = mac_table[index];
+  __atomic_store_n(&mac_table[index], newnode, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&mac_table_lock);
+  PROBE4(mac_learn, port_no, vlan_id, mac_address, 0);
+  return 1;
+}
 
-  /* get index based on mac_address */
-  int index = hash(mac_address);
-  /* if some entry is already there, make head points to current entry and current entry's next to already  */
+/*
+ * Function    : add_learned_mac_address
+ * @params     : port_no     -> port or LAG the address was seen on
+ *               vlan_id     -> vlan of the frame
+ *               mac_address -> source mac_address of the frame
+ * Output      : 1 -> mac_address was added, 0 -> it was known already
+ * Description : learn_mac_address() for the threads other than the forwarding path, the chain is only walked under the
+ *               lock since entries they are on may be removed and freed
+ * */
+int add_learned_mac_address(int port_no, int vlan_id, char *mac_address)
+{
+  int index = hash(vlan_id, mac_address);
+  mac_table_t *newnode = new_entry(port_no, vlan_id, mac_address, 0);
+  if(newnode == NULL)
+  {
+    return 0;
+  }
+  pthread_mutex_lock(&mac_table_lock);
+  mac_table_t *temp = find_entry(index, vlan_id, mac_address);
+  if(temp)
+  {
+    if(temp->port_no != port_no && !temp->is_static)
+    {
+      temp->port_no = port_no;
+      mac_table_changed();
+      PROBE4(mac_learn, port_no, vlan_id, mac_address, 1);
+    }
+    pthread_mutex_unlock(&mac_table_lock);
+    free(newnode);
+    return 0;
+  }
   newnode->next = mac_table[index];
-  mac_table[index] = newnode;
+  __atomic_store_n(&mac_table[index], newnode, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&mac_table_lock);
+  PROBE4(mac_learn, port_no, vlan_id, mac_address, 0);
+  return 1;
 }
 
 /*
  * Function    : get_port_no_from_mac_table
- * @params     : mac_address -> to return port_no related to mac_address
- * Output      : returns port_no
- * Description : Returns port_no related to mac_address from mac_table
+ * @params     : vlan_id     -> vlan of the frame
+ *               mac_address -> to return port_no related to mac_address
+ * Output      : returns port_no, -1 if (vlan_id, mac_address) is not in the mac_table
+ * Description : Returns port_no related to mac_address in vlan_id from mac_table
  * */
-int get_port_no_from_mac_table(char *mac_address)
+int get_port_no_from_mac_table(int vlan_id, char *mac_address)
 {
-  int index = hash(mac_address);
+  int index = hash(vlan_id, mac_address);
   mac_table_t *temp = mac_table[index];
   while(temp)
   {
-    if( strcmp(temp->mac_address, mac_address) == 0 )
+    if( temp->vlan_id == vlan_id && strcmp(temp->mac_address, mac_address) == 0 )
     {
       return temp->port_no;
     }
@@ -96,57 +304,119 @@ int get_port_no_from_mac_table(char *mac_address)
 
 /*
  * Function    : is_available
- * @params     : mac_address -> checks this mac_address is available or not
+ * @params     : vlan_id     -> vlan to look in
+ *               mac_address -> checks this mac_address is available or not
  * Output      : 0 -> if mac_address is not available in mac_table
  *               1 -> if mac_address is available in mac_table
- * Description : Checks whether the given mac_address is available or not in mac_table
+ * Description : Checks whether the given mac_address is available or not in the mac_table of vlan_id
  * */
-int is_available(char *mac_address)
+int is_available(int vlan_id, char *mac_address)
 {
-  int index = hash(mac_address);
-  mac_table_t *temp = mac_table[index];
+  int index = hash(vlan_id, mac_address);
+  pthread_mutex_lock(&mac_table_lock);
+  int available = find_entry(index, vlan_id, mac_address) != NULL;
+  pthread_mutex_unlock(&mac_table_lock);
+  return available;
+}
+
+/*
+ * Function    : retire_entry
+ * @params     : temp -> entry just unlinked from its chain, under mac_table_lock
+ * Description : The entry is freed by mac_table_quiescent(), the forwarding path may still be on it until then
+ * */
+static void retire_entry(mac_table_t *temp)
+{
+  temp->retired_next = retired_entries;
+  __atomic_store_n(&retired_entries, temp, __ATOMIC_RELEASE);
+}
 
+/*
+ * Function    : mac_table_quiescent
+ * Description : Frees the entries removed from the mac_table. Called by the forwarding path before every frame, when it
+ *               is on no entry, or once it stopped. Entries removed while it waits for frames are freed with the next one.
+ * */
+void mac_table_quiescent()
+{
+  if(__atomic_load_n(&retired_entries, __ATOMIC_ACQUIRE) == NULL)
+  {
+    return;
+  }
+  pthread_mutex_lock(&mac_table_lock);
+  mac_table_t *temp = retired_entries;
+  retired_entries = NULL;
+  pthread_mutex_unlock(&mac_table_lock);
   while(temp)
   {
-    if( strcmp(temp->mac_address, mac_address) == 0 )
-    {
-      return 1;
-    }
-    temp = temp->next;
+    mac_table_t *next = temp->retired_next;
+    free(temp);
+    temp = next;
   }
-  return 0;
 }
 
 /*
  * Function    : delete_entry_from_mac_table
- * @params     : mac_address -> deletes mac_address from table
- * Description : deleted mac_address and its port_no pair from the mac_table
+ * @params     : vlan_id     -> vlan of the entry
+ *               mac_address -> deletes mac_address from table
+ * Description : deleted mac_address and its port_no pair from the mac_table of vlan_id
  * */
-void delete_entry_from_mac_table(char *mac_address)
+void delete_entry_from_mac_table(int vlan_id, char *mac_address)
 {
-  int index = hash(mac_address);
+  int index = hash(vlan_id, mac_address);
+  pthread_mutex_lock(&mac_table_lock);
   mac_table_t *temp = mac_table[index];
   mac_table_t *prev = NULL;
 
-  while(temp != NULL && strcmp(temp->mac_address, mac_address) != 0)
+  while(temp != NULL && (temp->vlan_id != vlan_id || strcmp(temp->mac_address, mac_address) != 0))
   {
     prev = temp;
     temp = temp->next;
   }
   if(temp == NULL)
   {
+    pthread_mutex_unlock(&mac_table_lock);
     return;
   }
   if(prev == NULL)
   {
-    mac_table[index] = temp->next;
-    free(temp);
+    __atomic_store_n(&mac_table[index], temp->next, __ATOMIC_RELEASE);
   }
   else
   {
-    prev->next = temp->next;
-    free(temp);
+    __atomic_store_n(&prev->next, temp->next, __ATOMIC_RELEASE);
+  }
+  retire_entry(temp);
+  mac_table_changed();
+  pthread_mutex_unlock(&mac_table_lock);
+}
+
+/*
+ * Function    : flush_port_from_mac_table
+ * @params     : port_no -> port whose entries are removed
+ * Description : Deletes every entry learned on port_no, in every vlan. Used when the station of the port disconnects.
+ *               Static entries stay. Not for signal handlers, it takes the mac_table lock.
+ * */
+void flush_port_from_mac_table(int port_no)
+{
+  pthread_mutex_lock(&mac_table_lock);
+  for(int i=0; i<TABLE_SIZE; i++)
+  {
+    mac_table_t **link = &mac_table[i];
+    while(*link)
+    {
+      mac_table_t *temp = *link;
+      if(temp->port_no == port_no && !temp->is_static)
+      {
+        __atomic_store_n(link, temp->next, __ATOMIC_RELEASE);
+        retire_entry(temp);
+      }
+      else
+      {
+        link = &temp->next;
+      }
+    }
   }
+  mac_table_changed();
+  pthread_mutex_unlock(&mac_table_lock);
 }
 
 /*
@@ -156,9 +426,10 @@ void delete_entry_from_mac_table(char *mac_address)
 void display_mac_table()
 {
 
-  printf("\n\n+--------+----------------------+\n");
-  printf("|  PORT  |      MAC ADDRESS     |\n");
-  printf("+--------+----------------------+\n");
+  printf("\n\n+--------+--------+----------------------+---------+\n");
+  printf("|  PORT  |  VLAN  |      MAC ADDRESS     |   TYPE  |\n");
+  printf("+--------+--------+----------------------+---------+\n");
+  pthread_mutex_lock(&mac_table_lock);
   for(int i=0; i<TABLE_SIZE; i++)
   {
     if(mac_table[i] == NULL)
@@ -171,11 +442,21 @@ void display_mac_table()
 
       while(temp)
       {
-        printf("|    %d   |   %s  |\n", temp->port_no, temp->mac_address);
+        if(IS_LAG_PORT(temp->port_no))
+        {
+          printf("|  lag%d  |  %4d  |   %s  | %-7s |\n", LAG_NO(temp->port_no), temp->vlan_id, temp->mac_address,
+                 temp->is_static ? "static" : "learned");
+        }
+        else
+        {
+          printf("|    %d   |  %4d  |   %s  | %-7s |\n", temp->port_no, temp->vlan_id, temp->mac_address,
+                 temp->is_static ? "static" : "learned");
+        }
         temp=temp->next;
       }
     }
   }  
+  pthread_mutex_unlock(&mac_table_lock);
   
   /*
   if(temp == NULL)
@@ -186,7 +467,7 @@ void display_mac_table()
     return;
   }
   */
-  printf("+--------+----------------------+\n");
+  printf("+--------+--------+----------------------+---------+\n");
 
 }
 
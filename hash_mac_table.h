@@ -0,0 +1,27 @@
+#ifndef HASH_MAC_TABLE_H
+#define HASH_MAC_TABLE_H
+
+/*
+ * File        : hash_mac_table.h
+ * Description : Entries of the mac_table kept in hash_mac_table.c, for the switch, its snapshot and the benchmark that
+ *               walk the table directly.
+ * */
+
+/* buckets of the mac_table, a power of two. Thousands of addresses keep chains of about one entry */
+#define TABLE_SIZE 16384
+
+/* mac_table entires is of type mac_table_t */
+typedef struct mac_table
+{
+  int port_no;
+  int vlan_id;
+  char mac_address[18];
+  int is_static;      /* added by hand, never moved by learning nor flushed with its port */
+  struct mac_table *next;
+  struct mac_table *retired_next;   /* removed entries waiting to be freed, next is left for the readers on them */
+} mac_table_t;
+
+/* mac_table to store (port,vlan,mac_address) (used hash_map), defined in hash_mac_table.c */
+extern mac_table_t *mac_table[TABLE_SIZE];
+
+#endif
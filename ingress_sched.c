@@ -0,0 +1,281 @@
+/*
+ * File        : ingress_sched.c
+ * Description : Ingress scheduling by deficit round robin. The worker thread waits in poll() until a port mqueue has
+ *               frames, then goes round the ports that have some: each one earns quantum * weight frames (or bytes)
+ *               of credit per round and is served while its credit lasts, at most cap frames per visit. A port that
+ *               runs out of frames leaves the round and loses its credit, so an idle port can not save up for a
+ *               burst, and a port that still has frames keeps what is left for the next round. Under overload every
+ *               port gets a share of the frames forwarded proportional to its weight, whatever rate it sends at.
+ * */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <mqueue.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "frame.h"
+#include "ingress_sched.h"
+#include "port_stats.h"
+
+#define MAX_PORTS 4
+
+/* configuration, written by the menu and read by the worker once per round */
+static unsigned int ingress_weights[MAX_PORTS];
+static unsigned int ingress_quantum = INGRESS_DEFAULT_QUANTUM;
+static int ingress_unit = INGRESS_QUANTUM_FRAMES;
+static unsigned int ingress_cap = INGRESS_DEFAULT_CAP;
+
+/* credit left of every port, for display_ingress() */
+static long ingress_deficit[MAX_PORTS];
+
+static mqd_t *ingress_fds;
+static char (*ingress_buffers)[100];
+static ingress_handler_t ingress_handler;
+static pthread_t ingress_id;
+static int ingress_started = 0;
+
+/*
+ * Function    : ingress_thread
+ * Description : Worker receiving and forwarding the frames of every port until stop_ingress()
+ * */
+static void *ingress_thread(void *arg)
+{
+  struct pollfd fds[MAX_PORTS];
+  int active[MAX_PORTS] = {0};
+  long deficit[MAX_PORTS] = {0};
+  /* the port's last visit ended on its credit or the cap, not on an empty mqueue */
+  int carried[MAX_PORTS] = {0};
+
+  /* switch signals are handled by the menu thread, so a handler never runs in the middle of forwarding a frame */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGUSR1);
+  sigaddset(&set, SIGHUP);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  /* a warm restart may only stop the worker in poll(), between two rounds */
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+  while(1)
+  {
+    /* ports that received frames join the round, with no port in the round wait for one */
+    int waiting = 0;
+    for(int i = 0; i < MAX_PORTS; i++)
+    {
+      fds[i].fd = ingress_fds[i];
+      fds[i].events = POLLIN;
+      fds[i].revents = 0;
+      waiting |= active[i];
+    }
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+    int ret = poll(fds, MAX_PORTS, waiting ? 0 : -1);
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    if(ret == -1 && errno != EINTR)
+    {
+      perror("Error in poll()");
+      return NULL;
+    }
+    for(int i = 0; i < MAX_PORTS && ret > 0; i++)
+    {
+      if(fds[i].revents & POLLIN)
+        active[i] = 1;
+    }
+
+    unsigned int quantum = __atomic_load_n(&ingress_quantum, __ATOMIC_RELAXED);
+    int unit = __atomic_load_n(&ingress_unit, __ATOMIC_RELAXED);
+    unsigned int cap = __atomic_load_n(&ingress_cap, __ATOMIC_RELAXED);
+    /* a frame is served once the port has the credit for the largest frame */
+    long cost = unit == INGRESS_QUANTUM_BYTES ? FRAME_SIZE : 1;
+    for(int i = 0; i < MAX_PORTS; i++)
+    {
+      if(!active[i])
+        continue;
+      long credit = (long) quantum * __atomic_load_n(&ingress_weights[i], __ATOMIC_RELAXED);
+      deficit[i] += credit;
+      unsigned int served = 0;
+      while(deficit[i] >= cost && served < cap)
+      {
+        int len = mq_receive(ingress_fds[i], ingress_buffers[i], FRAME_SIZE, NULL);
+        if(len == -1)
+        {
+          if(errno == EINTR)
+            continue;
+          if(errno != EAGAIN)
+            perror("Error in mq_receive()");
+          /* the port's mqueue is empty, it leaves the round and its credit is lost */
+          active[i] = 0;
+          deficit[i] = 0;
+          break;
+        }
+        if(carried[i])
+        {
+          /* frames really were left waiting by the previous visit */
+          PORT_STAT_ADD(i, ingress_deferred, 1);
+          carried[i] = 0;
+        }
+        ingress_handler(i + 1, len);
+        deficit[i] -= unit == INGRESS_QUANTUM_BYTES ? len : 1;
+        served++;
+      }
+      carried[i] = active[i];
+      if(active[i] && deficit[i] > credit)
+      {
+        /* a cap below the credit must not let the credit grow without bound */
+        deficit[i] = credit;
+      }
+      __atomic_store_n(&ingress_deficit[i], deficit[i], __ATOMIC_RELAXED);
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Function    : init_ingress
+ * Description : Every port gets weight 1, the quantum and cap are the defaults
+ * */
+void init_ingress()
+{
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    ingress_weights[i] = 1;
+    ingress_deficit[i] = 0;
+  }
+  ingress_quantum = INGRESS_DEFAULT_QUANTUM;
+  ingress_unit = INGRESS_QUANTUM_FRAMES;
+  ingress_cap = INGRESS_DEFAULT_CAP;
+}
+
+/*
+ * Function    : start_ingress
+ * @params     : fds     -> port mqueues to receive from, made non blocking
+ *               buffers -> buffer of every port the frames are received into
+ *               handler -> called for every frame received
+ * Output      : 0 -> worker started, -1 -> error
+ * */
+int start_ingress(mqd_t *fds, char (*buffers)[100], ingress_handler_t handler)
+{
+  struct mq_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.mq_flags = O_NONBLOCK;
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    if(mq_setattr(fds[i], &attr, NULL) == -1)
+    {
+      perror("Error in mq_setattr()");
+      return -1;
+    }
+  }
+  ingress_fds = fds;
+  ingress_buffers = buffers;
+  ingress_handler = handler;
+  if(pthread_create(&ingress_id, NULL, ingress_thread, NULL) != 0)
+  {
+    perror("Error in pthread_create()");
+    return -1;
+  }
+  ingress_started = 1;
+  return 0;
+}
+
+/*
+ * Function    : stop_ingress
+ * Description : Stops the worker between two rounds and waits for it, frames not received stay in the mqueues
+ * */
+void stop_ingress()
+{
+  if(!ingress_started)
+    return;
+  pthread_cancel(ingress_id);
+  pthread_join(ingress_id, NULL);
+  ingress_started = 0;
+}
+
+/*
+ * Function    : set_ingress_weight
+ * @params     : port_no -> port to configure
+ *               weight  -> 1 .. INGRESS_MAX_WEIGHT, quanta the port earns per round
+ * */
+void set_ingress_weight(int port_no, unsigned int weight)
+{
+  __atomic_store_n(&ingress_weights[port_no - 1], weight ? weight : 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Function    : set_ingress_quantum
+ * @params     : unit    -> INGRESS_QUANTUM_FRAMES or INGRESS_QUANTUM_BYTES
+ *               quantum -> credit per round per unit of weight, at least one frame
+ * */
+void set_ingress_quantum(int unit, unsigned int quantum)
+{
+  unsigned int min = unit == INGRESS_QUANTUM_BYTES ? FRAME_SIZE : 1;
+  __atomic_store_n(&ingress_unit, unit, __ATOMIC_RELAXED);
+  __atomic_store_n(&ingress_quantum, quantum < min ? min : quantum, __ATOMIC_RELAXED);
+}
+
+/*
+ * Function    : set_ingress_cap
+ * @params     : cap -> frames of one port served per round at most, bounds the wait of the other ports
+ * */
+void set_ingress_cap(unsigned int cap)
+{
+  __atomic_store_n(&ingress_cap, cap ? cap : 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Function    : get_ingress_weight
+ * @params     : port_no -> port
+ * Output      : quanta the port earns per round
+ * */
+unsigned int get_ingress_weight(int port_no)
+{
+  return __atomic_load_n(&ingress_weights[port_no - 1], __ATOMIC_RELAXED);
+}
+
+/*
+ * Function    : get_ingress_quantum
+ * @params     : unit -> to store INGRESS_QUANTUM_FRAMES or INGRESS_QUANTUM_BYTES
+ * Output      : credit per round per unit of weight
+ * */
+unsigned int get_ingress_quantum(int *unit)
+{
+  *unit = __atomic_load_n(&ingress_unit, __ATOMIC_RELAXED);
+  return __atomic_load_n(&ingress_quantum, __ATOMIC_RELAXED);
+}
+
+/*
+ * Function    : get_ingress_cap
+ * Output      : frames of one port served per round at most
+ * */
+unsigned int get_ingress_cap()
+{
+  return __atomic_load_n(&ingress_cap, __ATOMIC_RELAXED);
+}
+
+/*
+ * Function    : display_ingress
+ * Description : Displays the quantum, the cap and per port weight, credit, frames received, share and rounds ended
+ *               with frames left
+ * */
+void display_ingress()
+{
+  unsigned long long total = 0;
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    total += port_stats[i].rx_frames;
+  }
+  printf("\nDeficit round robin: quantum %u %s per weight, at most %u frames per port per round\n", ingress_quantum,
+         ingress_unit == INGRESS_QUANTUM_BYTES ? "bytes" : "frames", ingress_cap);
+  printf("+------+--------+--------+------------+--------+------------+\n");
+  printf("| PORT | WEIGHT | CREDIT |  RX FRAMES |  SHARE |  DEFERRED  |\n");
+  printf("+------+--------+--------+------------+--------+------------+\n");
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    printf("|  %d   | %6u | %6ld | %10llu | %5.1f%% | %10llu |\n", i+1, ingress_weights[i], ingress_deficit[i],
+           port_stats[i].rx_frames, total ? 100.0 * port_stats[i].rx_frames / total : 0.0,
+           port_stats[i].ingress_deferred);
+  }
+  printf("+------+--------+--------+------------+--------+------------+\n");
+}
@@ -0,0 +1,34 @@
+#ifndef INGRESS_SCHED_H
+#define INGRESS_SCHED_H
+
+/*
+ * File        : ingress_sched.h
+ * Description : Ingress scheduling. One worker thread receives the frames of every port and serves the ports by
+ *               deficit round robin, so a port blasting frames gets its configured share of the forwarding and no more
+ * */
+
+#include <mqueue.h>
+
+/* the quantum is counted in */
+#define INGRESS_QUANTUM_FRAMES 0
+#define INGRESS_QUANTUM_BYTES 1
+
+#define INGRESS_MAX_WEIGHT 100
+#define INGRESS_DEFAULT_QUANTUM 1   /* frames per round per unit of weight */
+#define INGRESS_DEFAULT_CAP 32      /* frames of one port per round at most */
+
+/* forwards the frame of len bytes just received from port_no into its buffer */
+typedef void (*ingress_handler_t)(int port_no, int len);
+
+void init_ingress();
+int start_ingress(mqd_t *fds, char (*buffers)[100], ingress_handler_t handler);
+void stop_ingress();
+void set_ingress_weight(int port_no, unsigned int weight);
+void set_ingress_quantum(int unit, unsigned int quantum);
+void set_ingress_cap(unsigned int cap);
+unsigned int get_ingress_weight(int port_no);
+unsigned int get_ingress_quantum(int *unit);
+unsigned int get_ingress_cap();
+void display_ingress();
+
+#endif
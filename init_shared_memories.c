@@ -15,6 +15,9 @@
 #include <fcntl.h>           /* For O_* constants */
 #include <sys/stat.h>        /* For mode constants */
 
+#include "instance.h"
+#include "shm_pages.h"
+
 /* shared memory of sizeof(pid_t) bytes to store switch process id */
 #define SWITCH_PID "/switch_pid"
 #define SWITCH_PID_SIZE sizeof(pid_t)
@@ -42,81 +45,31 @@ extern void *shm_switch_pid_ptr, *shm_en_dis_ports_ptr, *shm_con_discon_ports_pt
 
 /*
  * Function    : init_shared_memories
- * Description : initializes all three shared memories
+ * Description : initializes all three shared memories, with the page policy of shm_pages.h
  * */
 int init_shared_memories()
 {
-  int ret;
-  /* opening shared memory to store switch process id */
-  shm_switch_pid_fd = shm_open(SWITCH_PID, _FLAGS, 0777);
-  if(shm_switch_pid_fd == -1)
-  {
-    perror("Error in shm_open()");
-    return EXIT_FAILURE;
-  }
-
-  /* allocating size to shared memory */
-  ret = ftruncate(shm_switch_pid_fd, SWITCH_PID_SIZE);
-  if(ret == -1)
-  {
-    perror("Error in ftruncate()");
-    return EXIT_FAILURE;
-  }
-
-  /* mapping virual address space to memory pages */
-  shm_switch_pid_ptr = mmap(NULL, SWITCH_PID_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm_switch_pid_fd, 0);
+  /* opening and mapping shared memory to store switch process id */
+  shm_switch_pid_ptr = shm_map(instance_name(SWITCH_PID), SWITCH_PID_SIZE, PROT_READ | PROT_WRITE, &shm_switch_pid_fd);
   if(shm_switch_pid_ptr == MAP_FAILED)
   {
-    perror("Error in mmap()");
-    return EXIT_FAILURE;
-  }
-
-  /* opening shared memory to enable/disable port status */
-  shm_en_dis_ports_fd = shm_open(EN_DIS_PORTS, _FLAGS, 0777);
-  if(shm_en_dis_ports_fd == -1)
-  {
-    perror("Error in shm_open()");
     return EXIT_FAILURE;
   }
 
-  /* allocating size to shared memory */
-  ret = ftruncate(shm_en_dis_ports_fd, EN_DIS_PORTS_SIZE);
-  if(ret == -1)
-  {
-    perror("Error in ftruncate()");
-    return EXIT_FAILURE;
-  }
-
-  /* mapping virual address space to memory pages */
-  shm_en_dis_ports_ptr = mmap(NULL, EN_DIS_PORTS_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm_en_dis_ports_fd, 0);
+  /* opening and mapping shared memory to enable/disable port status */
+  shm_en_dis_ports_ptr = shm_map(instance_name(EN_DIS_PORTS), EN_DIS_PORTS_SIZE, PROT_READ | PROT_WRITE,
+                                 &shm_en_dis_ports_fd);
   if(shm_en_dis_ports_ptr == MAP_FAILED)
   {
-    perror("Error in mmap()");
-    return EXIT_FAILURE;
-  }
-
-
-  /* opening shared memory to track whether ports are connected to stations or not, by storing port number and its respective station process id */
-  shm_con_discon_ports_fd = shm_open(CON_DISCON_PORTS, _FLAGS, 0777);
-  if(shm_con_discon_ports_fd == -1)
-  {
-    perror("Error in shm_open()");
-    return EXIT_FAILURE;
-  }
-
-  /* allocating size to shared memory */
-  ret = ftruncate(shm_con_discon_ports_fd, CON_DISCON_PORTS_SIZE);
-  if(ret == -1)
-  {
-    perror("Error in ftruncate()");
     return EXIT_FAILURE;
   }
 
-  /* mapping virual address space to memory pages */
-  shm_con_discon_ports_ptr = mmap(NULL, CON_DISCON_PORTS_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm_con_discon_ports_fd, 0);
+  /* opening and mapping shared memory to track whether ports are connected to stations or not, by storing port number and its respective station process id */
+  shm_con_discon_ports_ptr = shm_map(instance_name(CON_DISCON_PORTS), CON_DISCON_PORTS_SIZE, PROT_READ | PROT_WRITE,
+                                     &shm_con_discon_ports_fd);
   if(shm_con_discon_ports_ptr == MAP_FAILED)
   {
-    perror("Error in mmap()");
     return EXIT_FAILURE;
   }
+  return EXIT_SUCCESS;
 }
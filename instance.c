@@ -0,0 +1,101 @@
+/*
+ * File        : instance.c
+ * Description : Names of the ipc objects and files of one switch instance, see instance.h
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "instance.h"
+
+#define MAX_NAMES 64
+
+static int instance_id = 0;
+
+/* names already prefixed by instance_name(), so every call for a name returns the same string */
+static char *names_in[MAX_NAMES];
+static char *names_out[MAX_NAMES];
+static int name_count = 0;
+
+/*
+ * Function    : set_switch_instance
+ * @params     : switch_id -> number of the switch (0 .. MAX_SWITCH_ID), set once before any ipc object is opened
+ * */
+void set_switch_instance(int switch_id)
+{
+  instance_id = switch_id;
+}
+
+/*
+ * Function    : get_switch_instance
+ * Output      : number of this switch (or of the switch a station attaches to)
+ * */
+int get_switch_instance()
+{
+  return instance_id;
+}
+
+/*
+ * Function    : switch_instance_name
+ * @params     : switch_id -> number of the switch
+ *               name      -> plain name, e.g. "/switch_pid", "sem_recv_1" or "port1.txt"
+ *               buf, size -> to store the name used by that switch, e.g. "/sw2_switch_pid"
+ * */
+void switch_instance_name(int switch_id, const char *name, char *buf, int size)
+{
+  if(switch_id == 0)
+  {
+    snprintf(buf, size, "%s", name);
+  }
+  else if(name[0] == '/')
+  {
+    snprintf(buf, size, "/sw%d_%s", switch_id, name + 1);
+  }
+  else
+  {
+    snprintf(buf, size, "sw%d_%s", switch_id, name);
+  }
+}
+
+/*
+ * Function    : instance_name
+ * @params     : name -> plain name of an ipc object or file
+ * Output      : name used by this switch instance, valid until the process exits
+ * */
+const char *instance_name(const char *name)
+{
+  if(instance_id == 0)
+  {
+    return name;
+  }
+  for(int i = 0; i < name_count; i++)
+  {
+    if(strcmp(names_in[i], name) == 0)
+    {
+      return names_out[i];
+    }
+  }
+  char buf[64];
+  switch_instance_name(instance_id, name, buf, sizeof(buf));
+  if(name_count == MAX_NAMES || (names_in[name_count] = strdup(name)) == NULL ||
+     (names_out[name_count] = strdup(buf)) == NULL)
+  {
+    fprintf(stderr, "Error: cannot name %s for switch %d\n", name, instance_id);
+    exit(EXIT_FAILURE);
+  }
+  return names_out[name_count++];
+}
+
+/*
+ * Function    : apply_instance_names
+ * @params     : names -> table of per port names (mqueues, semaphores, log files)
+ *               count -> number of names in the table
+ * Description : Replaces every name of the table by the name used by this switch instance
+ * */
+void apply_instance_names(char **names, int count)
+{
+  for(int i = 0; i < count; i++)
+  {
+    names[i] = (char *) instance_name(names[i]);
+  }
+}
@@ -0,0 +1,19 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+/*
+ * File        : instance.h
+ * Description : Several switch processes can run side by side, each one numbered with -n. The names of the shared
+ *               memories, mqueues, semaphores and log files of switch N are prefixed with "swN_", switch 0 (the
+ *               default) keeps the plain names.
+ * */
+
+#define MAX_SWITCH_ID 99
+
+void set_switch_instance(int switch_id);
+int get_switch_instance();
+void switch_instance_name(int switch_id, const char *name, char *buf, int size);
+const char *instance_name(const char *name);
+void apply_instance_names(char **names, int count);
+
+#endif
@@ -0,0 +1,402 @@
+/*
+ * File        : lag.c
+ * Description : Link aggregation groups. Every LAG spreads its LAG_BUCKETS hash buckets over its member ports. Adding
+ *               or removing a member only moves the buckets needed to even the load, so flows on the other buckets
+ *               keep their port and the mac_table, which points at the LAG and not at a member, is never flushed.
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "lag.h"
+#include "mac_util.h"
+
+#define MAX_PORTS 4
+#define NO_PORT 0xff
+
+/* function declarations */
+int is_enabled(int);
+pid_t is_connected(int);
+
+typedef struct lag
+{
+  unsigned int members;              /* member ports (bit 0 -> port 1) */
+  unsigned char bucket[LAG_BUCKETS]; /* port index serving each bucket, NO_PORT when the LAG is empty */
+} lag_t;
+
+static lag_t lags[MAX_LAGS];
+/* LAG of every port, 0 when the port is not aggregated. Written under lag_lock with atomic stores, so
+ * lag_logical_port() reads it without the lock from the forwarding path and the station_leaves thread of the switch */
+static int port_lag[MAX_PORTS];
+
+static pthread_rwlock_t lag_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/*
+ * Function    : bucket_count
+ * @params     : lag        -> LAG
+ *               port_index -> member port
+ * Output      : number of buckets served by the member
+ * */
+static int bucket_count(lag_t *lag, int port_index)
+{
+  int count = 0;
+  for(int b = 0; b < LAG_BUCKETS; b++)
+  {
+    count += lag->bucket[b] == port_index;
+  }
+  return count;
+}
+
+/*
+ * Function    : busiest_member
+ * @params     : lag -> LAG
+ *               most -> 1 for the member with the most buckets, 0 for the one with the fewest
+ * Output      : port index of that member
+ * */
+static int busiest_member(lag_t *lag, int most)
+{
+  int best = -1, best_count = 0;
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    if(!(lag->members & (1u << i)))
+      continue;
+    int count = bucket_count(lag, i);
+    if(best == -1 || (most ? count > best_count : count < best_count))
+    {
+      best = i;
+      best_count = count;
+    }
+  }
+  return best;
+}
+
+/*
+ * Function    : remove_member
+ * @params     : port_index -> port to take out of its LAG
+ * Description : Hands the buckets of the port to the members with the fewest buckets, caller holds lag_lock for writing
+ * */
+static void remove_member(int port_index)
+{
+  lag_t *lag = &lags[port_lag[port_index] - 1];
+  lag->members &= ~(1u << port_index);
+  __atomic_store_n(&port_lag[port_index], 0, __ATOMIC_RELEASE);
+  for(int b = 0; b < LAG_BUCKETS; b++)
+  {
+    if(lag->bucket[b] == port_index)
+    {
+      lag->bucket[b] = lag->members ? busiest_member(lag, 0) : NO_PORT;
+    }
+  }
+}
+
+/*
+ * Function    : init_lags
+ * Description : No port is aggregated at start
+ * */
+void init_lags()
+{
+  pthread_rwlock_wrlock(&lag_lock);
+  for(int i = 0; i < MAX_LAGS; i++)
+  {
+    lags[i].members = 0;
+    memset(lags[i].bucket, NO_PORT, LAG_BUCKETS);
+  }
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    __atomic_store_n(&port_lag[i], 0, __ATOMIC_RELEASE);
+  }
+  pthread_rwlock_unlock(&lag_lock);
+}
+
+/*
+ * Function    : lag_add_port
+ * @params     : lag_no  -> LAG 1..MAX_LAGS
+ *               port_no -> physical port to add, it leaves its current LAG first
+ * Output      : 0 -> port added, -1 -> invalid LAG or port
+ * Description : The new member takes its share of buckets from the members serving the most buckets
+ * */
+int lag_add_port(int lag_no, int port_no)
+{
+  if(lag_no < 1 || lag_no > MAX_LAGS || port_no < 1 || port_no > MAX_PORTS)
+  {
+    return -1;
+  }
+  int port_index = port_no - 1;
+  lag_t *lag = &lags[lag_no - 1];
+
+  pthread_rwlock_wrlock(&lag_lock);
+  if(port_lag[port_index] == lag_no)
+  {
+    pthread_rwlock_unlock(&lag_lock);
+    return 0;
+  }
+  if(port_lag[port_index])
+  {
+    remove_member(port_index);
+  }
+  lag->members |= 1u << port_index;
+  __atomic_store_n(&port_lag[port_index], lag_no, __ATOMIC_RELEASE);
+
+  int member_count = __builtin_popcount(lag->members);
+  if(member_count == 1)
+  {
+    memset(lag->bucket, port_index, LAG_BUCKETS);
+  }
+  else
+  {
+    /* steal one bucket at a time from the busiest member */
+    for(int share = LAG_BUCKETS / member_count; share > 0; share--)
+    {
+      int busiest = busiest_member(lag, 1);
+      for(int b = LAG_BUCKETS - 1; b >= 0; b--)
+      {
+        if(lag->bucket[b] == busiest)
+        {
+          lag->bucket[b] = port_index;
+          break;
+        }
+      }
+    }
+  }
+  pthread_rwlock_unlock(&lag_lock);
+  return 0;
+}
+
+/*
+ * Function    : lag_remove_port
+ * @params     : port_no -> physical port to take out of its LAG
+ * Output      : number of members left in the LAG, -1 if the port was not aggregated
+ * */
+int lag_remove_port(int port_no)
+{
+  int left = -1;
+  pthread_rwlock_wrlock(&lag_lock);
+  if(port_lag[port_no - 1])
+  {
+    int lag_no = port_lag[port_no - 1];
+    remove_member(port_no - 1);
+    left = __builtin_popcount(lags[lag_no - 1].members);
+  }
+  pthread_rwlock_unlock(&lag_lock);
+  return left;
+}
+
+/*
+ * Function    : lag_logical_port
+ * @params     : port_no -> physical port a frame was received on
+ * Output      : LAG_PORT() of the port's LAG, port_no itself if the port is not aggregated
+ * Description : Takes no lock, it is called for every frame forwarded and by the station_leaves thread while the menu
+ *               may hold lag_lock for writing
+ * */
+int lag_logical_port(int port_no)
+{
+  int lag_no = __atomic_load_n(&port_lag[port_no - 1], __ATOMIC_ACQUIRE);
+  return lag_no ? LAG_PORT(lag_no) : port_no;
+}
+
+/*
+ * Function    : lag_get_buckets
+ * @params     : lag_no -> LAG 1..MAX_LAGS
+ *               bucket -> to store the port index serving each of the LAG_BUCKETS buckets
+ * Output      : member ports of the LAG (bit 0 -> port 1)
+ * */
+unsigned int lag_get_buckets(int lag_no, unsigned char *bucket)
+{
+  pthread_rwlock_rdlock(&lag_lock);
+  unsigned int members = lags[lag_no - 1].members;
+  memcpy(bucket, lags[lag_no - 1].bucket, LAG_BUCKETS);
+  pthread_rwlock_unlock(&lag_lock);
+  return members;
+}
+
+/*
+ * Function    : lag_restore
+ * @params     : lag_no  -> LAG 1..MAX_LAGS, empty
+ *               members -> member ports, in no other LAG
+ *               bucket  -> member serving each bucket, as saved by lag_get_buckets()
+ * Output      : 0 -> LAG restored, -1 -> invalid LAG, members or buckets, the LAG is left empty
+ * Description : Restores the buckets as they were instead of adding the members again, so every flow keeps its member
+ *               port across a warm restart
+ * */
+int lag_restore(int lag_no, unsigned int members, const unsigned char *bucket)
+{
+  if(lag_no < 1 || lag_no > MAX_LAGS || members >= 1u << MAX_PORTS)
+  {
+    return -1;
+  }
+  for(int b = 0; members && b < LAG_BUCKETS; b++)
+  {
+    if(bucket[b] >= MAX_PORTS || !(members & (1u << bucket[b])))
+    {
+      return -1;
+    }
+  }
+
+  lag_t *lag = &lags[lag_no - 1];
+  pthread_rwlock_wrlock(&lag_lock);
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    if((members & (1u << i)) && port_lag[i])
+    {
+      pthread_rwlock_unlock(&lag_lock);
+      return -1;
+    }
+  }
+  lag->members = members;
+  if(members)
+  {
+    memcpy(lag->bucket, bucket, LAG_BUCKETS);
+  }
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    if(members & (1u << i))
+    {
+      __atomic_store_n(&port_lag[i], lag_no, __ATOMIC_RELEASE);
+    }
+  }
+  pthread_rwlock_unlock(&lag_lock);
+  return 0;
+}
+
+/*
+ * Function    : lag_port_mask
+ * @params     : port_no -> physical port
+ * Output      : member ports of the port's LAG, only the port itself if it is not aggregated
+ * */
+unsigned int lag_port_mask(int port_no)
+{
+  pthread_rwlock_rdlock(&lag_lock);
+  int lag_no = port_lag[port_no - 1];
+  unsigned int mask = lag_no ? lags[lag_no - 1].members : 1u << (port_no - 1);
+  pthread_rwlock_unlock(&lag_lock);
+  return mask;
+}
+
+/*
+ * Function    : select_member
+ * @params     : lag     -> LAG
+ *               allowed -> members the frame may be sent on
+ *               hash    -> flow hash of the frame
+ * Output      : port index, -1 if no member is allowed. Caller holds lag_lock.
+ * Description : The bucket's member if allowed, otherwise the flows of the bucket are spread over the allowed members
+ * */
+static int select_member(lag_t *lag, unsigned int allowed, unsigned int hash)
+{
+  int port_index = lag->bucket[hash % LAG_BUCKETS];
+  if(port_index != NO_PORT && (allowed & (1u << port_index)))
+  {
+    return port_index;
+  }
+  int count = __builtin_popcount(allowed);
+  if(count == 0)
+  {
+    return -1;
+  }
+  for(int n = hash % count; ; n--)
+  {
+    port_index = __builtin_ctz(allowed);
+    if(n == 0)
+    {
+      return port_index;
+    }
+    allowed &= allowed - 1;
+  }
+}
+
+/*
+ * Function    : up_ports
+ * Output      : ports that are enabled and have a station connected
+ * */
+static unsigned int up_ports()
+{
+  unsigned int mask = 0;
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    if(is_enabled(i) && is_connected(i))
+    {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+}
+
+/*
+ * Function    : lag_select_port
+ * @params     : logical_port     -> port from the mac_table, physical or LAG_PORT()
+ *               src_mac_address  -> source mac address of the frame
+ *               dest_mac_address -> destination mac address of the frame
+ * Output      : physical port to send the frame on, -1 if every member of the LAG is down
+ * */
+int lag_select_port(int logical_port, const char *src_mac_address, const char *dest_mac_address)
+{
+  if(!IS_LAG_PORT(logical_port))
+  {
+    return logical_port;
+  }
+  unsigned int hash = mac_flow_hash(src_mac_address, dest_mac_address);
+  unsigned int up = up_ports();
+  pthread_rwlock_rdlock(&lag_lock);
+  lag_t *lag = &lags[LAG_NO(logical_port) - 1];
+  int port_index = select_member(lag, lag->members & up, hash);
+  pthread_rwlock_unlock(&lag_lock);
+  return port_index == -1 ? -1 : port_index + 1;
+}
+
+/*
+ * Function    : lag_flood_mask
+ * @params     : port_mask        -> ports a frame is flooded to (bit 0 -> port 1)
+ *               src_mac_address  -> source mac address of the frame
+ *               dest_mac_address -> destination mac address of the frame
+ * Output      : port_mask with every LAG reduced to the one member the frame's flow hashes to, so a station behind a
+ *               LAG receives a flooded frame once
+ * */
+unsigned int lag_flood_mask(unsigned int port_mask, const char *src_mac_address, const char *dest_mac_address)
+{
+  unsigned int hash = mac_flow_hash(src_mac_address, dest_mac_address);
+  unsigned int up = up_ports();
+  unsigned int mask = port_mask;
+  pthread_rwlock_rdlock(&lag_lock);
+  for(int i = 0; i < MAX_LAGS; i++)
+  {
+    if(!(lags[i].members & port_mask))
+      continue;
+    mask &= ~lags[i].members;
+    int port_index = select_member(&lags[i], lags[i].members & port_mask & up, hash);
+    if(port_index != -1)
+    {
+      mask |= 1u << port_index;
+    }
+  }
+  pthread_rwlock_unlock(&lag_lock);
+  return mask;
+}
+
+/*
+ * Function    : display_lags
+ * Description : Displays the members of every LAG with the number of hash buckets each member serves
+ * */
+void display_lags()
+{
+  printf("\n+------+-------------------------------+\n");
+  printf("| LAG  |  MEMBER PORTS (HASH BUCKETS)  |\n");
+  printf("+------+-------------------------------+\n");
+  pthread_rwlock_rdlock(&lag_lock);
+  for(int i = 0; i < MAX_LAGS; i++)
+  {
+    char members[32] = "";
+    for(int port = 0; port < MAX_PORTS; port++)
+    {
+      if(lags[i].members & (1u << port))
+      {
+        char member[12];
+        snprintf(member, sizeof(member), "%d(%d) ", port + 1, bucket_count(&lags[i], port));
+        strcat(members, member);
+      }
+    }
+    printf("|  %d   | %-29s |\n", i + 1, members);
+  }
+  pthread_rwlock_unlock(&lag_lock);
+  printf("+------+-------------------------------+\n");
+}
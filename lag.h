@@ -0,0 +1,31 @@
+#ifndef LAG_H
+#define LAG_H
+
+/*
+ * File        : lag.h
+ * Description : Link aggregation groups. A LAG is a logical port made of several physical ports, mac addresses seen on
+ *               any member are learned on the LAG, and frames to the LAG are sent on one member chosen by a hash of
+ *               their src/dst mac addresses, so frames of one flow stay in order.
+ * */
+
+#define MAX_LAGS 2
+/* hash buckets of a LAG, every bucket is served by one member port */
+#define LAG_BUCKETS 16
+
+/* logical port number of LAG 1..MAX_LAGS, as stored in the mac_table (physical ports are 1..4) */
+#define LAG_PORT(lag_no) (4 + (lag_no))
+#define IS_LAG_PORT(port_no) ((port_no) > 4)
+#define LAG_NO(port_no) ((port_no) - 4)
+
+void init_lags();
+int lag_add_port(int lag_no, int port_no);
+int lag_remove_port(int port_no);
+int lag_logical_port(int port_no);
+unsigned int lag_get_buckets(int lag_no, unsigned char *bucket);
+int lag_restore(int lag_no, unsigned int members, const unsigned char *bucket);
+unsigned int lag_port_mask(int port_no);
+int lag_select_port(int logical_port, const char *src_mac_address, const char *dest_mac_address);
+unsigned int lag_flood_mask(unsigned int port_mask, const char *src_mac_address, const char *dest_mac_address);
+void display_lags();
+
+#endif
@@ -0,0 +1,318 @@
+/*
+ * File        : mac_learning.c
+ * Description : Per port learning policies and the learner thread. The forwarding thread is the only one to queue new
+ *               addresses and the learner the only one to take them, so the queue is a ring with no lock. An address
+ *               stays in a pending slot until the learner added it, the frames that follow it meanwhile neither queue
+ *               it again nor count against the port's limit.
+ * */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "mac_learning.h"
+#include "mac_util.h"
+#include "port_stats.h"
+#include "forward.h"
+
+#define MAX_PORTS 4
+#define LEARN_PENDING_SIZE 256  /* slots of addresses queued and not learned yet, a power of two */
+
+int refresh_mac_address(int, int, char *);
+int learn_mac_address(int, int, char *);
+int add_learned_mac_address(int, int, char *);
+
+typedef struct learn_policy
+{
+  int mode;                     /* LEARN_* */
+  unsigned int limit;           /* new addresses per second, 0 -> no limit */
+  unsigned long long second;    /* second the count is of, only used by the forwarding thread */
+  unsigned int count;           /* new addresses learned or queued in it */
+} learn_policy_t;
+
+/* a new address for the learner */
+typedef struct learn_request
+{
+  int port_index;               /* ingress port, for its counters */
+  int port_no;                  /* port or LAG to learn it on */
+  int vlan_id;
+  char mac_address[18];
+  unsigned long long key;       /* its pending slot key */
+} learn_request_t;
+
+static learn_policy_t learn_policies[MAX_PORTS];
+
+static learn_request_t learn_queue[LEARN_QUEUE_SIZE];
+static unsigned int queue_head;   /* next request to learn, written by the learner */
+static unsigned int queue_tail;   /* next free request, written by the forwarding thread */
+static unsigned long long learn_pending[LEARN_PENDING_SIZE];
+
+static volatile int learner_running = 0;
+static pthread_t learner_id;
+
+static const char *learn_mode_names[LEARN_MODES] = {"learn", "static only", "deferred"};
+
+/*
+ * Function    : init_mac_learning
+ * Description : Every port learns on the forwarding path with no limit, as a switch without policies does
+ * */
+void init_mac_learning()
+{
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    memset(&learn_policies[i], 0, sizeof(learn_policy_t));
+    learn_policies[i].mode = LEARN_ENABLED;
+  }
+  queue_head = queue_tail = 0;
+  memset(learn_pending, 0, sizeof(learn_pending));
+}
+
+/*
+ * Function    : under_limit
+ * @params     : policy -> learning policy of the ingress port
+ * Output      : 1 -> one more new address may be learned this second, 0 -> the limit is reached
+ * Description : Counts new addresses in one second windows of the forwarding core's clock, the coarse clock read from
+ *               the vdso without a syscall or the simulated time of sim
+ * */
+static int under_limit(learn_policy_t *policy)
+{
+  unsigned int limit = __atomic_load_n(&policy->limit, __ATOMIC_RELAXED);
+  if(limit == 0)
+  {
+    return 1;
+  }
+
+  unsigned long long second = forward_now_ns() / 1000000000ULL;
+  if(second != policy->second)
+  {
+    policy->second = second;
+    policy->count = 0;
+  }
+  if(policy->count >= limit)
+  {
+    return 0;
+  }
+  policy->count++;
+  return 1;
+}
+
+/*
+ * Function    : pending_slot
+ * @params     : key -> vlan and address of a new address
+ * Output      : the pending slot of key
+ * */
+static inline unsigned long long *pending_slot(unsigned long long key)
+{
+  return &learn_pending[(key * 0x9e3779b97f4a7c15ULL) >> 56 & (LEARN_PENDING_SIZE - 1)];
+}
+
+/*
+ * Function    : defer_learning
+ * @params     : port_index    -> ingress port (0 based)
+ *               learn_port_no -> port or LAG the address is learned on
+ *               vlan_id       -> vlan of the frame
+ *               mac_address   -> new source address
+ * Description : Queues a new address for the learner, unless it is queued already
+ * */
+static void defer_learning(int port_index, int learn_port_no, int vlan_id, char *mac_address)
+{
+  unsigned long long key = 1ULL << 63 | (unsigned long long) vlan_id << 48 | mac_address_value(mac_address);
+  unsigned long long *slot = pending_slot(key);
+  if(__atomic_load_n(slot, __ATOMIC_RELAXED) == key)
+  {
+    return;
+  }
+  unsigned int tail = queue_tail;
+  if(tail - __atomic_load_n(&queue_head, __ATOMIC_ACQUIRE) == LEARN_QUEUE_SIZE)
+  {
+    PORT_STAT_ADD(port_index, learn_queue_full, 1);
+    return;
+  }
+  if(!under_limit(&learn_policies[port_index]))
+  {
+    PORT_STAT_ADD(port_index, learn_limited, 1);
+    return;
+  }
+  learn_request_t *request = &learn_queue[tail & (LEARN_QUEUE_SIZE - 1)];
+  request->port_index = port_index;
+  request->port_no = learn_port_no;
+  request->vlan_id = vlan_id;
+  strcpy(request->mac_address, mac_address);
+  request->key = key;
+  __atomic_store_n(slot, key, __ATOMIC_RELAXED);
+  __atomic_store_n(&queue_tail, tail + 1, __ATOMIC_RELEASE);
+  PORT_STAT_ADD(port_index, learn_deferred, 1);
+}
+
+/*
+ * Function    : mac_learning
+ * @params     : port_no       -> port the frame was received on, its policy applies
+ *               learn_port_no -> port or LAG the source is learned on
+ *               vlan_id       -> vlan of the frame
+ *               mac_address   -> source mac_address of the frame
+ * Output      : 1 -> nothing is left to learn from the source, a forwarding decision may be cached for it
+ *               0 -> the source is new and was not learned, it is tried again with the next frame
+ * Description : Applies the learning policy of port_no to the source of a frame, called by the forwarding thread
+ * */
+int mac_learning(int port_no, int learn_port_no, int vlan_id, char *mac_address)
+{
+  learn_policy_t *policy = &learn_policies[port_no - 1];
+  int mode = __atomic_load_n(&policy->mode, __ATOMIC_RELAXED);
+
+  if(mode == LEARN_DISABLED)
+  {
+    return 1;
+  }
+  if(mode == LEARN_ENABLED && __atomic_load_n(&policy->limit, __ATOMIC_RELAXED) == 0)
+  {
+    if(learn_mac_address(learn_port_no, vlan_id, mac_address))
+    {
+      PORT_STAT_ADD(port_no - 1, learned, 1);
+    }
+    return 1;
+  }
+
+  if(refresh_mac_address(learn_port_no, vlan_id, mac_address))
+  {
+    return 1;
+  }
+  if(mode == LEARN_DEFERRED)
+  {
+    defer_learning(port_no - 1, learn_port_no, vlan_id, mac_address);
+    return 0;
+  }
+  if(!under_limit(policy))
+  {
+    PORT_STAT_ADD(port_no - 1, learn_limited, 1);
+    return 0;
+  }
+  if(learn_mac_address(learn_port_no, vlan_id, mac_address))
+  {
+    PORT_STAT_ADD(port_no - 1, learned, 1);
+  }
+  return 1;
+}
+
+/*
+ * Function    : mac_learner
+ * @params     : arg -> unused
+ * Description : Adds the queued addresses to the mac_table until stop_mac_learner()
+ * */
+static void *mac_learner(void *arg)
+{
+  /* switch signals are handled by the menu thread */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGUSR1);
+  sigaddset(&set, SIGHUP);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  while(learner_running)
+  {
+    unsigned int head = queue_head, tail = __atomic_load_n(&queue_tail, __ATOMIC_ACQUIRE);
+    for(; head != tail; head++)
+    {
+      learn_request_t *request = &learn_queue[head & (LEARN_QUEUE_SIZE - 1)];
+      /* not the forwarding path, the chain may only be walked under the mac_table lock */
+      if(add_learned_mac_address(request->port_no, request->vlan_id, request->mac_address))
+      {
+        PORT_STAT_ADD(request->port_index, learned, 1);
+      }
+      /* the address is in the mac_table, a later frame finds it there before looking at its slot. A slot taken by
+       * another address meanwhile is left to it */
+      unsigned long long key = request->key;
+      __atomic_compare_exchange_n(pending_slot(key), &key, 0, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&queue_head, head, __ATOMIC_RELEASE);
+
+    struct timespec tick = {0, LEARN_INTERVAL_MS * 1000000L};
+    nanosleep(&tick, NULL);
+  }
+  return NULL;
+}
+
+/*
+ * Function    : start_mac_learner
+ * Output      : 0 -> learner started, -1 -> thread error
+ * */
+int start_mac_learner()
+{
+  learner_running = 1;
+  if(pthread_create(&learner_id, NULL, mac_learner, NULL) != 0)
+  {
+    perror("Error in pthread_create()");
+    learner_running = 0;
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Function    : stop_mac_learner
+ * Description : Stops the learner thread, before the mac_table is freed. Addresses still queued are not learned, the
+ *               next frames of their stations queue them again.
+ * */
+void stop_mac_learner()
+{
+  if(!learner_running)
+  {
+    return;
+  }
+  learner_running = 0;
+  pthread_join(learner_id, NULL);
+}
+
+/*
+ * Function    : set_mac_learning
+ * @params     : port_no -> port to configure
+ *               mode    -> LEARN_ENABLED, LEARN_DISABLED or LEARN_DEFERRED
+ *               limit   -> new addresses learned per second at most, 0 -> no limit
+ * */
+void set_mac_learning(int port_no, int mode, unsigned int limit)
+{
+  learn_policy_t *policy = &learn_policies[port_no - 1];
+  __atomic_store_n(&policy->limit, limit, __ATOMIC_RELAXED);
+  __atomic_store_n(&policy->mode, mode, __ATOMIC_RELAXED);
+}
+
+/*
+ * Function    : get_mac_learning
+ * @params     : port_no -> port
+ *               limit   -> to store the new addresses learned per second at most, 0 -> no limit
+ * Output      : LEARN_ENABLED, LEARN_DISABLED or LEARN_DEFERRED
+ * */
+int get_mac_learning(int port_no, unsigned int *limit)
+{
+  learn_policy_t *policy = &learn_policies[port_no - 1];
+  *limit = __atomic_load_n(&policy->limit, __ATOMIC_RELAXED);
+  return __atomic_load_n(&policy->mode, __ATOMIC_RELAXED);
+}
+
+/*
+ * Function    : display_mac_learning
+ * Description : Displays the learning policy and learning counters of every port
+ * */
+void display_mac_learning()
+{
+  printf("\n+------+-------------+------------+------------+------------+------------+------------+\n");
+  printf("| PORT |     MODE    |  LIMIT/s   |   LEARNED  |   LIMITED  |  DEFERRED  | QUEUE FULL |\n");
+  printf("+------+-------------+------------+------------+------------+------------+------------+\n");
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    learn_policy_t *policy = &learn_policies[i];
+    char limit[16] = "-";
+    if(policy->limit && policy->mode != LEARN_DISABLED)
+    {
+      snprintf(limit, sizeof(limit), "%u", policy->limit);
+    }
+    printf("|  %d   | %-11s | %10s | %10llu | %10llu | %10llu | %10llu |\n", i+1, learn_mode_names[policy->mode], limit,
+           port_stats[i].learned, port_stats[i].learn_limited, port_stats[i].learn_deferred,
+           port_stats[i].learn_queue_full);
+  }
+  printf("+------+-------------+------------+------------+------------+------------+------------+\n");
+  printf("Learner %s, %u of %d new addresses queued\n", learner_running ? "running" : "stopped",
+         __atomic_load_n(&queue_tail, __ATOMIC_RELAXED) - __atomic_load_n(&queue_head, __ATOMIC_RELAXED),
+         LEARN_QUEUE_SIZE);
+}
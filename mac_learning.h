@@ -0,0 +1,30 @@
+#ifndef MAC_LEARNING_H
+#define MAC_LEARNING_H
+
+/*
+ * File        : mac_learning.h
+ * Description : Learning policy of every port. Source addresses already in the mac_table are refreshed on the
+ *               forwarding path as before, the policy of the ingress port decides what happens to new ones: learned on
+ *               the forwarding path, never learned (static entries only, a frame costs the destination lookup and
+ *               nothing else) or queued for a learner thread, so the malloc of a new entry never runs while forwarding.
+ *               A limit of new addresses per port per second bounds what a flood of source addresses can learn.
+ * */
+
+/* learning modes */
+#define LEARN_ENABLED 0         /* new addresses are added on the forwarding path */
+#define LEARN_DISABLED 1        /* static only, no address is added or moved */
+#define LEARN_DEFERRED 2        /* new addresses are added by the learner thread */
+#define LEARN_MODES 3
+
+#define LEARN_QUEUE_SIZE 1024   /* new addresses waiting for the learner, a power of two */
+#define LEARN_INTERVAL_MS 1     /* the learner empties the queue that often */
+
+void init_mac_learning();
+int mac_learning(int port_no, int learn_port_no, int vlan_id, char *mac_address);
+int start_mac_learner();
+void stop_mac_learner();
+void set_mac_learning(int port_no, int mode, unsigned int limit);
+int get_mac_learning(int port_no, unsigned int *limit);
+void display_mac_learning();
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * File        : mac_set.c
+ * Description : Open addressing hash set of mac addresses with linear probing. The set is kept at most half full, so
+ *               a lookup, hit or miss, usually reads a single cache line.
+ * */
+#include <stdlib.h>
+
+#include "mac_set.h"
+
+/* no mac address is wider than 48 bits */
+#define MAC_SET_EMPTY (~0ULL)
+
+/*
+ * Function    : mac_set_slot
+ * @params     : set -> set
+ *               mac -> mac address
+ * Output      : first slot probed for mac (multiplicative hashing, the high bits of the product are the best mixed)
+ * */
+static unsigned int mac_set_slot(const mac_set_t *set, unsigned long long mac)
+{
+  return (unsigned int) ((mac * 0x9E3779B97F4A7C15ULL) >> 32) & set->mask;
+}
+
+/*
+ * Function    : mac_set_init
+ * @params     : set      -> set to initialize
+ *               capacity -> number of addresses the set will hold
+ * Output      : 0 -> set is ready, -1 -> malloc failed
+ * */
+int mac_set_init(mac_set_t *set, unsigned int capacity)
+{
+  unsigned int slots = 16;
+  while(slots < 2 * capacity)
+  {
+    slots <<= 1;
+  }
+  set->keys = malloc(slots * sizeof(*set->keys));
+  set->values = malloc(slots * sizeof(*set->values));
+  if(set->keys == NULL || set->values == NULL)
+  {
+    free(set->keys);
+    free(set->values);
+    return -1;
+  }
+  for(unsigned int i = 0; i < slots; i++)
+  {
+    set->keys[i] = MAC_SET_EMPTY;
+  }
+  set->mask = slots - 1;
+  set->count = 0;
+  return 0;
+}
+
+/*
+ * Function    : mac_set_add
+ * @params     : set   -> set
+ *               mac   -> mac address to add
+ *               value -> value returned by mac_set_find() for mac
+ * Output      : 0 -> added or updated, -1 -> set is full (more addresses than its capacity)
+ * */
+int mac_set_add(mac_set_t *set, unsigned long long mac, int value)
+{
+  unsigned int slot = mac_set_slot(set, mac);
+  while(set->keys[slot] != MAC_SET_EMPTY && set->keys[slot] != mac)
+  {
+    slot = (slot + 1) & set->mask;
+  }
+  if(set->keys[slot] == MAC_SET_EMPTY)
+  {
+    if(2 * (set->count + 1) > set->mask + 1)
+    {
+      return -1;
+    }
+    set->keys[slot] = mac;
+    set->count++;
+  }
+  set->values[slot] = value;
+  return 0;
+}
+
+/*
+ * Function    : mac_set_find
+ * @params     : set -> set
+ *               mac -> mac address to look up
+ * Output      : value of mac, -1 if mac is not in the set
+ * */
+int mac_set_find(const mac_set_t *set, unsigned long long mac)
+{
+  for(unsigned int slot = mac_set_slot(set, mac); set->keys[slot] != MAC_SET_EMPTY; slot = (slot + 1) & set->mask)
+  {
+    if(set->keys[slot] == mac)
+    {
+      return set->values[slot];
+    }
+  }
+  return -1;
+}
+
+/*
+ * Function    : mac_set_free
+ * @params     : set -> set to release
+ * */
+void mac_set_free(mac_set_t *set)
+{
+  free(set->keys);
+  free(set->values);
+  set->keys = NULL;
+  set->values = NULL;
+  set->count = 0;
+}
@@ -0,0 +1,23 @@
+#ifndef MAC_SET_H
+#define MAC_SET_H
+
+/*
+ * File        : mac_set.h
+ * Description : Open addressing hash set of mac addresses (as 48 bit values from mac_address_value()), every address
+ *               maps to a small integer such as the index of the virtual host owning it
+ * */
+
+typedef struct mac_set
+{
+  unsigned long long *keys; /* MAC_SET_EMPTY for a free slot */
+  int *values;
+  unsigned int mask;        /* slot count - 1, the slot count is a power of two */
+  unsigned int count;
+} mac_set_t;
+
+int mac_set_init(mac_set_t *set, unsigned int capacity);
+int mac_set_add(mac_set_t *set, unsigned long long mac, int value);
+int mac_set_find(const mac_set_t *set, unsigned long long mac);
+void mac_set_free(mac_set_t *set);
+
+#endif
@@ -0,0 +1,331 @@
+/*
+ * File        : mac_table_snapshot.c
+ * Description : Saves the mac_table to a memory-mapped snapshot file on a warm restart and reloads it in bulk when the
+ *               next switch process starts with -w, so forwarding resumes without a relearn storm. The port
+ *               configuration its entries depend on is saved with it: vlans, LAGs, ACLs, storm control, ingress and
+ *               egress scheduling, learning policies, slow consumer detection and multicast group members.
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "instance.h"
+#include "vlan.h"
+#include "lag.h"
+#include "acl.h"
+#include "storm_control.h"
+#include "egress_sched.h"
+#include "ingress_sched.h"
+#include "mac_learning.h"
+#include "queue_monitor.h"
+#include "multicast_table.h"
+#include "hash_mac_table.h"
+
+#define MAX_PORTS 4
+
+#define MAC_TABLE_SNAPSHOT "mac_table.snapshot"
+#define SNAPSHOT_MAGIC 0x564e534d /* "VNSM" */
+#define SNAPSHOT_VERSION 4
+
+/* layout of the snapshot file: header, port configuration, count entries, acl_count ACL rules port after port and
+ * group_count multicast groups */
+typedef struct snapshot_header
+{
+  unsigned int magic;
+  unsigned int version;
+  unsigned int count;
+  unsigned int acl_count;
+  unsigned int group_count;
+  unsigned int reserved;
+} snapshot_header_t;
+
+/* configuration of a port */
+typedef struct snapshot_port
+{
+  vlan_port_config_t vlan;
+  unsigned int storm_rate[STORM_CLASSES];
+  unsigned int storm_burst[STORM_CLASSES];
+  int egress_mode;
+  unsigned int egress_weights[EGRESS_CLASSES];
+  unsigned int ingress_weight;
+  int learn_mode;
+  unsigned int learn_limit;
+  int acl_default;
+  int acl_count;
+} snapshot_port_t;
+
+typedef struct snapshot_config
+{
+  snapshot_port_t ports[MAX_PORTS];
+  unsigned int lag_members[MAX_LAGS];
+  unsigned char lag_buckets[MAX_LAGS][LAG_BUCKETS];
+  int ingress_unit;
+  unsigned int ingress_quantum;
+  unsigned int ingress_cap;
+  unsigned int slow_threshold_ms;
+  int slow_auto_drop;
+} __attribute__((aligned(8))) snapshot_config_t;   /* keeps the ACL rules after the entries aligned */
+
+typedef struct snapshot_entry
+{
+  int port_no;
+  int vlan_id;
+  char mac_address[18];
+  int is_static;
+} snapshot_entry_t;
+
+void add_to_mac_table(int, int, char *);
+void add_static_mac_address(int, int, char *);
+
+/*
+ * Function    : save_config
+ * @params     : config -> to store the port configuration
+ *               rules  -> to store the ACL rules of every port, NULL -> only count them into config
+ * Output      : number of ACL rules of all ports
+ * */
+static unsigned int save_config(snapshot_config_t *config, acl_rule_t *rules)
+{
+  unsigned int acl_count = 0;
+  for(int i=0; i<MAX_PORTS; i++)
+  {
+    snapshot_port_t *port = &config->ports[i];
+    get_vlan_port(i+1, &port->vlan);
+    for(int j=0; j<STORM_CLASSES; j++)
+    {
+      port->storm_rate[j] = get_storm_control(i+1, j, &port->storm_burst[j]);
+    }
+    port->egress_mode = get_egress_scheduler(i+1, port->egress_weights);
+    port->ingress_weight = get_ingress_weight(i+1);
+    port->learn_mode = get_mac_learning(i+1, &port->learn_limit);
+    port->acl_count = acl_get_rules(i+1, rules ? rules + acl_count : NULL, &port->acl_default);
+    acl_count += port->acl_count;
+  }
+  for(int i=0; i<MAX_LAGS; i++)
+  {
+    config->lag_members[i] = lag_get_buckets(i+1, config->lag_buckets[i]);
+  }
+  config->ingress_quantum = get_ingress_quantum(&config->ingress_unit);
+  config->ingress_cap = get_ingress_cap();
+  config->slow_threshold_ms = get_slow_consumer_detection(&config->slow_auto_drop);
+  return acl_count;
+}
+
+/*
+ * Function    : restore_config
+ * @params     : config -> port configuration of the snapshot
+ *               rules  -> ACL rules of every port
+ * Description : Configures the ports as the previous switch process had them, before its mac_table entries are added
+ *               back, so entries learned on a LAG find it with its members. A port setting that is not valid is left
+ *               at its default.
+ * */
+static void restore_config(const snapshot_config_t *config, const acl_rule_t *rules)
+{
+  for(int i=0; i<MAX_PORTS; i++)
+  {
+    const snapshot_port_t *port = &config->ports[i];
+    if(restore_vlan_port(i+1, &port->vlan) == -1)
+    {
+      printf("Warm start: vlans of port - %d are not valid, left at default\n", i+1);
+    }
+    for(int j=0; j<STORM_CLASSES; j++)
+    {
+      set_storm_control(i+1, j, port->storm_rate[j], port->storm_burst[j]);
+    }
+    if(port->egress_mode == EGRESS_STRICT || port->egress_mode == EGRESS_WRR)
+    {
+      set_egress_scheduler(i+1, port->egress_mode, port->egress_weights);
+    }
+    if(port->ingress_weight <= INGRESS_MAX_WEIGHT)
+    {
+      set_ingress_weight(i+1, port->ingress_weight);
+    }
+    if(port->learn_mode >= 0 && port->learn_mode < LEARN_MODES)
+    {
+      set_mac_learning(i+1, port->learn_mode, port->learn_limit);
+    }
+    if(acl_restore(i+1, rules, port->acl_count, port->acl_default) == -1)
+    {
+      printf("Warm start: ACL of port - %d is not valid, left empty\n", i+1);
+    }
+    rules += port->acl_count;
+  }
+  for(int i=0; i<MAX_LAGS; i++)
+  {
+    if(lag_restore(i+1, config->lag_members[i], config->lag_buckets[i]) == -1)
+    {
+      printf("Warm start: lag%d is not valid, left empty\n", i+1);
+    }
+  }
+  if(config->ingress_unit == INGRESS_QUANTUM_FRAMES || config->ingress_unit == INGRESS_QUANTUM_BYTES)
+  {
+    set_ingress_quantum(config->ingress_unit, config->ingress_quantum);
+  }
+  set_ingress_cap(config->ingress_cap);
+  set_slow_consumer_detection(config->slow_threshold_ms, config->slow_auto_drop != 0);
+}
+
+/*
+ * Function    : save_mac_table_snapshot
+ * Output      : number of entries saved, -1 on failure
+ * Description : Writes the port configuration and every (port_no, vlan_id, mac_address) entry of the mac_table into the
+ *               snapshot file through a shared mapping
+ * */
+int save_mac_table_snapshot()
+{
+  unsigned int count = 0;
+  for(int i=0; i<TABLE_SIZE; i++)
+  {
+    for(mac_table_t *temp = mac_table[i]; temp; temp = temp->next)
+    {
+      count++;
+    }
+  }
+  snapshot_config_t config;
+  unsigned int acl_count = save_config(&config, NULL);
+  unsigned int group_count = multicast_get_groups(NULL, 0);
+
+  int fd = open(instance_name(MAC_TABLE_SNAPSHOT), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(fd == -1)
+  {
+    perror("Error in open()");
+    return -1;
+  }
+
+  size_t size = sizeof(snapshot_header_t) + sizeof(snapshot_config_t) + count * sizeof(snapshot_entry_t) +
+                acl_count * sizeof(acl_rule_t) + group_count * sizeof(multicast_members_t);
+  if(ftruncate(fd, size) == -1)
+  {
+    perror("Error in ftruncate()");
+    close(fd);
+    return -1;
+  }
+
+  void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(ptr == MAP_FAILED)
+  {
+    perror("Error in mmap()");
+    return -1;
+  }
+
+  snapshot_header_t *header = (snapshot_header_t *) ptr;
+  snapshot_config_t *saved = (snapshot_config_t *) (header + 1);
+  snapshot_entry_t *entry = (snapshot_entry_t *) (saved + 1);
+  acl_rule_t *rules = (acl_rule_t *) (entry + count);
+  /* only the menu changes the configuration and it is busy with the warm restart, it is the one counted above */
+  save_config(saved, rules);
+  multicast_get_groups((multicast_members_t *) (rules + acl_count), group_count);
+  for(int i=0; i<TABLE_SIZE; i++)
+  {
+    for(mac_table_t *temp = mac_table[i]; temp; temp = temp->next)
+    {
+      entry->port_no = temp->port_no;
+      entry->vlan_id = temp->vlan_id;
+      memcpy(entry->mac_address, temp->mac_address, sizeof(entry->mac_address));
+      entry->is_static = temp->is_static;
+      entry++;
+    }
+  }
+  header->count = count;
+  header->acl_count = acl_count;
+  header->group_count = group_count;
+  header->version = SNAPSHOT_VERSION;
+  /* magic is written last so a half written snapshot is never loaded */
+  header->magic = SNAPSHOT_MAGIC;
+
+  msync(ptr, size, MS_SYNC);
+  munmap(ptr, size);
+  return count;
+}
+
+/*
+ * Function    : load_mac_table_snapshot
+ * Output      : number of entries loaded, -1 if there is no valid snapshot
+ * Description : Maps the snapshot file left by the previous switch process, restores its port configuration, inserts all
+ *               its entries into the mac_table and removes the file so that it is consumed only once
+ * */
+int load_mac_table_snapshot()
+{
+  struct stat st;
+  int fd = open(instance_name(MAC_TABLE_SNAPSHOT), O_RDONLY);
+  if(fd == -1)
+  {
+    return -1;
+  }
+  if(fstat(fd, &st) == -1 || st.st_size < (off_t) sizeof(snapshot_header_t))
+  {
+    close(fd);
+    return -1;
+  }
+
+  void *ptr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  close(fd);
+  if(ptr == MAP_FAILED)
+  {
+    perror("Error in mmap()");
+    return -1;
+  }
+
+  snapshot_header_t *header = (snapshot_header_t *) ptr;
+  if(header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION ||
+     st.st_size < (off_t) (sizeof(snapshot_header_t) + sizeof(snapshot_config_t) +
+                           (unsigned long long) header->count * sizeof(snapshot_entry_t) +
+                           (unsigned long long) header->acl_count * sizeof(acl_rule_t) +
+                           (unsigned long long) header->group_count * sizeof(multicast_members_t)))
+  {
+    munmap(ptr, st.st_size);
+    return -1;
+  }
+
+  snapshot_config_t *config = (snapshot_config_t *) (header + 1);
+  snapshot_entry_t *entry = (snapshot_entry_t *) (config + 1);
+  unsigned int count = header->count;
+  unsigned int acl_count = 0;
+  for(int i=0; i<MAX_PORTS; i++)
+  {
+    /* never read rules past the ones the file holds */
+    if(config->ports[i].acl_count < 0 || config->ports[i].acl_count > (int) (header->acl_count - acl_count))
+    {
+      config->ports[i].acl_count = 0;
+    }
+    acl_count += config->ports[i].acl_count;
+  }
+  acl_rule_t *rules = (acl_rule_t *) (entry + count);
+  restore_config(config, rules);
+  multicast_members_t *groups = (multicast_members_t *) (rules + header->acl_count);
+  for(unsigned int i=0; i<header->group_count; i++)
+  {
+    multicast_restore_group(&groups[i]);
+  }
+
+  for(unsigned int i=0; i<count; i++)
+  {
+    /* snapshot may come from an older binary, never trust its strings */
+    entry[i].mac_address[17] = '\0';
+    if(entry[i].is_static)
+    {
+      add_static_mac_address(entry[i].port_no, entry[i].vlan_id, entry[i].mac_address);
+    }
+    else
+    {
+      add_to_mac_table(entry[i].port_no, entry[i].vlan_id, entry[i].mac_address);
+    }
+  }
+
+  munmap(ptr, st.st_size);
+  unlink(instance_name(MAC_TABLE_SNAPSHOT));
+  return count;
+}
+
+/*
+ * Function    : remove_mac_table_snapshot
+ * Description : Removes a stale snapshot file, used on a cold switch off
+ * */
+void remove_mac_table_snapshot()
+{
+  unlink(instance_name(MAC_TABLE_SNAPSHOT));
+}
@@ -0,0 +1,84 @@
+/*
+ * File        : mac_util.c
+ * Description : Helpers for mac addresses in their "XX:XX:XX:XX:XX:XX" text form
+ * */
+#include <stdio.h>
+
+#include "mac_util.h"
+
+/*
+ * Function    : hex_value
+ * @params     : c -> hex digit
+ * Output      : value of the digit, 0 for anything that is not a hex digit
+ * */
+static int hex_value(char c)
+{
+  if(c >= '0' && c <= '9')
+    return c - '0';
+  if(c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if(c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return 0;
+}
+
+/*
+ * Function    : is_multicast_mac_address
+ * @params     : mac_address -> mac address to check
+ * Output      : 1 -> group address (least significant bit of the first octet is set), includes broadcast
+ *               0 -> individual address
+ * */
+int is_multicast_mac_address(const char *mac_address)
+{
+  return hex_value(mac_address[1]) & 0x1;
+}
+
+/*
+ * Function    : mac_flow_hash
+ * @params     : src_mac_address  -> source mac address of the frame
+ *               dest_mac_address -> destination mac address of the frame
+ * Output      : hash of the (src, dest) pair (FNV-1a), equal for every frame of a flow
+ * */
+unsigned int mac_flow_hash(const char *src_mac_address, const char *dest_mac_address)
+{
+  unsigned int hash_value = 2166136261u;
+  for(int i=0; src_mac_address[i]; i++)
+  {
+    hash_value ^= (unsigned char) src_mac_address[i];
+    hash_value *= 16777619u;
+  }
+  for(int i=0; dest_mac_address[i]; i++)
+  {
+    hash_value ^= (unsigned char) dest_mac_address[i];
+    hash_value *= 16777619u;
+  }
+  /* fold the high bits in, the low bits pick the bucket */
+  return hash_value ^ (hash_value >> 16);
+}
+
+/*
+ * Function    : mac_address_value
+ * @params     : mac_address -> mac address in text form
+ * Output      : the 48 bit address, first octet in the most significant byte
+ * */
+unsigned long long mac_address_value(const char *mac_address)
+{
+  unsigned long long value = 0;
+  for(int octet=0; octet<6; octet++)
+  {
+    value = (value << 8) | (hex_value(mac_address[3 * octet]) << 4) | hex_value(mac_address[3 * octet + 1]);
+  }
+  return value;
+}
+
+/*
+ * Function    : mac_address_string
+ * @params     : value       -> 48 bit address, as returned by mac_address_value()
+ *               mac_address -> buffer of 18 bytes for the text form
+ * */
+void mac_address_string(unsigned long long value, char *mac_address)
+{
+  snprintf(mac_address, 18, "%02X:%02X:%02X:%02X:%02X:%02X", (unsigned int) (value >> 40) & 0xff,
+           (unsigned int) (value >> 32) & 0xff, (unsigned int) (value >> 24) & 0xff, (unsigned int) (value >> 16) & 0xff,
+           (unsigned int) (value >> 8) & 0xff, (unsigned int) value & 0xff);
+}
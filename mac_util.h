@@ -0,0 +1,14 @@
+#ifndef MAC_UTIL_H
+#define MAC_UTIL_H
+
+/*
+ * File        : mac_util.h
+ * Description : Helpers for mac addresses in their "XX:XX:XX:XX:XX:XX" text form
+ * */
+
+int is_multicast_mac_address(const char *mac_address);
+unsigned int mac_flow_hash(const char *src_mac_address, const char *dest_mac_address);
+unsigned long long mac_address_value(const char *mac_address);
+void mac_address_string(unsigned long long value, char *mac_address);
+
+#endif
@@ -0,0 +1,316 @@
+/*
+ * File        : mirror.c
+ * Description : Port mirroring to a pcapng capture file. Port threads and egress paths put a copy of every mirrored
+ *               frame into a bounded multi-producer ring (every slot carries a sequence number telling whether it is
+ *               free or filled, producers claim slots with a compare and swap on the head), so a mirrored frame costs
+ *               a copy and never a lock or a wait. A full ring drops the copy and counts it. A single writer thread
+ *               drains the ring, converts frames back to Ethernet packets and writes them in large sequential writes.
+ *               Every port and direction is an interface of the capture ("port1-rx", "port1-tx", ...).
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "frame.h"
+#include "mirror.h"
+#include "mac_util.h"
+#include "pcap.h"
+
+#define MAX_PORTS 4
+#define CAPTURE_RING_MASK (CAPTURE_RING_SIZE - 1)
+/* the writer's buffer is written out when full, or when the ring is idle and it has waited this long */
+#define CAPTURE_BUFFER_SIZE (256 * 1024)
+#define CAPTURE_FLUSH_NS 100000000LL
+#define ETHERTYPE_VLAN 0x8100
+/* Ethernet header with an 802.1Q tag, and the frame data */
+#define MAX_PACKET_SIZE (18 + 28)
+
+typedef struct capture_slot
+{
+  unsigned long long seq;   /* == position -> free for the producer of position, == position + 1 -> filled */
+  unsigned long long ts_ns;
+  int interface;
+  char frame[FRAME_SIZE];
+} capture_slot_t;
+
+unsigned int mirror_ports[2];
+
+static capture_slot_t ring[CAPTURE_RING_SIZE];
+static unsigned long long ring_head;  /* next position claimed by a producer */
+static unsigned long long ring_tail;  /* next position read by the writer, only the writer touches it */
+
+static unsigned long long captured, ring_dropped, bytes_written;
+static char capture_path[256];
+static int capture_fd = -1;
+static volatile int writer_running = 0;
+static pthread_t writer_id;
+
+/*
+ * Function    : init_mirror
+ * Description : Nothing is mirrored at start, every ring slot is free for its first position
+ * */
+void init_mirror()
+{
+  mirror_ports[MIRROR_INGRESS] = mirror_ports[MIRROR_EGRESS] = 0;
+  for(unsigned long long i = 0; i < CAPTURE_RING_SIZE; i++)
+  {
+    ring[i].seq = i;
+  }
+  ring_head = ring_tail = 0;
+}
+
+/*
+ * Function    : mirror_frame
+ * @params     : port_index -> mirrored port (0 based)
+ *               direction  -> MIRROR_INGRESS or MIRROR_EGRESS
+ *               frame      -> frame received on or forwarded to the port, with its header as sent
+ * Description : Copies the frame into the capture ring, or counts it as dropped if the ring is full
+ * */
+void mirror_frame(int port_index, int direction, const char *frame)
+{
+  unsigned long long pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+  capture_slot_t *slot;
+  while(1)
+  {
+    slot = &ring[pos & CAPTURE_RING_MASK];
+    long long diff = (long long) (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+    if(diff == 0)
+    {
+      /* the slot is free, claim the position unless another producer did */
+      if(__atomic_compare_exchange_n(&ring_head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    }
+    else if(diff < 0)
+    {
+      /* the writer has not freed the slot yet, the ring is full */
+      __atomic_add_fetch(&ring_dropped, 1, __ATOMIC_RELAXED);
+      return;
+    }
+    else
+    {
+      pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+    }
+  }
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  slot->ts_ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  slot->interface = port_index * 2 + direction;
+  memcpy(slot->frame, frame, FRAME_SIZE);
+  /* publish the slot to the writer */
+  __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Function    : frame_to_packet
+ * @params     : frame  -> frame from the ring
+ *               packet -> MAX_PACKET_SIZE bytes for the Ethernet packet
+ * Output      : length of the packet
+ * Description : Addresses, an 802.1Q tag if the frame has a vlan or priority, the ethertype and the frame data
+ * */
+static int frame_to_packet(const char *frame, unsigned char *packet)
+{
+  const frame_t *f = (const frame_t *) frame;
+  unsigned long long dest = mac_address_value(f->dest_mac_address);
+  unsigned long long src = mac_address_value(f->src_mac_address);
+  int len = 0;
+  for(int i = 5; i >= 0; i--, len++)
+  {
+    packet[len] = dest >> (8 * i);
+  }
+  for(int i = 5; i >= 0; i--, len++)
+  {
+    packet[len] = src >> (8 * i);
+  }
+  if(f->vlan_id || f->priority)
+  {
+    unsigned short tci = (f->priority << 13) | (f->vlan_id & 0xfff);
+    packet[len++] = ETHERTYPE_VLAN >> 8;
+    packet[len++] = ETHERTYPE_VLAN & 0xff;
+    packet[len++] = tci >> 8;
+    packet[len++] = tci & 0xff;
+  }
+  unsigned short ethertype = f->ethertype ? f->ethertype : ETHERTYPE_LOCAL;
+  packet[len++] = ethertype >> 8;
+  packet[len++] = ethertype & 0xff;
+  memcpy(packet + len, f->data, sizeof(f->data));
+  return len + sizeof(f->data);
+}
+
+/*
+ * Function    : write_buffer
+ * @params     : buf -> data to write
+ *               len -> length of the data
+ * Description : Writes to the capture file, a failed write stops the capture file from growing but not the switch
+ * */
+static void write_buffer(const unsigned char *buf, int len)
+{
+  while(len > 0 && capture_fd != -1)
+  {
+    ssize_t ret = write(capture_fd, buf, len);
+    if(ret <= 0)
+    {
+      perror("Error in write() of capture file");
+      close(capture_fd);
+      capture_fd = -1;
+      return;
+    }
+    buf += ret;
+    len -= ret;
+    __atomic_add_fetch(&bytes_written, ret, __ATOMIC_RELAXED);
+  }
+}
+
+/*
+ * Function    : capture_writer
+ * @params     : arg -> unused
+ * Description : Drains the capture ring into the capture file until the capture is stopped and the ring is empty
+ * */
+static void *capture_writer(void *arg)
+{
+  /* switch signals are handled by the menu thread */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGUSR1);
+  sigaddset(&set, SIGHUP);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  static unsigned char buffer[CAPTURE_BUFFER_SIZE];
+  int used = 0;
+  struct timespec last_flush, now;
+  clock_gettime(CLOCK_MONOTONIC, &last_flush);
+
+  while(1)
+  {
+    capture_slot_t *slot = &ring[ring_tail & CAPTURE_RING_MASK];
+    if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == ring_tail + 1)
+    {
+      unsigned char packet[MAX_PACKET_SIZE];
+      int len = frame_to_packet(slot->frame, packet);
+      used += pcapng_packet_block(buffer + used, slot->interface, slot->ts_ns, packet, len);
+      /* the slot is free again for the producer one lap later */
+      __atomic_store_n(&slot->seq, ring_tail + CAPTURE_RING_SIZE, __ATOMIC_RELEASE);
+      ring_tail++;
+      captured++;
+      if(used + PCAPNG_PACKET_BLOCK_SIZE(MAX_PACKET_SIZE) > CAPTURE_BUFFER_SIZE)
+      {
+        write_buffer(buffer, used);
+        used = 0;
+        clock_gettime(CLOCK_MONOTONIC, &last_flush);
+      }
+      continue;
+    }
+
+    /* the ring is empty */
+    if(!writer_running)
+      break;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if(used && (now.tv_sec - last_flush.tv_sec) * 1000000000LL + (now.tv_nsec - last_flush.tv_nsec) > CAPTURE_FLUSH_NS)
+    {
+      write_buffer(buffer, used);
+      used = 0;
+      last_flush = now;
+    }
+    struct timespec idle = {0, 1000000};
+    nanosleep(&idle, NULL);
+  }
+  write_buffer(buffer, used);
+  return NULL;
+}
+
+/*
+ * Function    : start_mirror
+ * @params     : path          -> capture file, overwritten
+ *               ingress_ports -> ports whose received frames are captured (bit 0 -> port 1)
+ *               egress_ports  -> ports whose forwarded frames are captured
+ * Output      : 0 -> capture started, -1 -> a capture is running or the file cannot be created
+ * */
+int start_mirror(const char *path, unsigned int ingress_ports, unsigned int egress_ports)
+{
+  if(writer_running)
+  {
+    printf("Error: Capture to %s is running, stop it first\n", capture_path);
+    return -1;
+  }
+  capture_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(capture_fd == -1)
+  {
+    perror("Error in open()");
+    return -1;
+  }
+  snprintf(capture_path, sizeof(capture_path), "%s", path);
+  captured = ring_dropped = bytes_written = 0;
+
+  unsigned char header[512];
+  int len = pcapng_section_header(header);
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    char name[16];
+    snprintf(name, sizeof(name), "port%d-rx", i + 1);
+    len += pcapng_interface_block(header + len, PCAP_LINKTYPE_ETHERNET, name);
+    snprintf(name, sizeof(name), "port%d-tx", i + 1);
+    len += pcapng_interface_block(header + len, PCAP_LINKTYPE_ETHERNET, name);
+  }
+  write_buffer(header, len);
+
+  writer_running = 1;
+  if(pthread_create(&writer_id, NULL, capture_writer, NULL) != 0)
+  {
+    perror("Error in pthread_create()");
+    writer_running = 0;
+    close(capture_fd);
+    capture_fd = -1;
+    return -1;
+  }
+  __atomic_store_n(&mirror_ports[MIRROR_INGRESS], ingress_ports, __ATOMIC_RELAXED);
+  __atomic_store_n(&mirror_ports[MIRROR_EGRESS], egress_ports, __ATOMIC_RELAXED);
+  return 0;
+}
+
+/*
+ * Function    : stop_mirror
+ * Description : Stops mirroring, waits for the writer to save what is in the ring and closes the capture file
+ * */
+void stop_mirror()
+{
+  if(!writer_running)
+  {
+    return;
+  }
+  __atomic_store_n(&mirror_ports[MIRROR_INGRESS], 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&mirror_ports[MIRROR_EGRESS], 0, __ATOMIC_RELAXED);
+  writer_running = 0;
+  pthread_join(writer_id, NULL);
+  if(capture_fd != -1)
+  {
+    close(capture_fd);
+    capture_fd = -1;
+  }
+}
+
+/*
+ * Function    : display_mirror
+ * Description : Displays the mirrored ports and the capture counters
+ * */
+void display_mirror()
+{
+  printf("\n+------+---------+--------+\n");
+  printf("| PORT | INGRESS | EGRESS |\n");
+  printf("+------+---------+--------+\n");
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    printf("|  %d   |   %-3s   |  %-3s   |\n", i + 1, (mirror_ports[MIRROR_INGRESS] & (1u << i)) ? "yes" : "no",
+           (mirror_ports[MIRROR_EGRESS] & (1u << i)) ? "yes" : "no");
+  }
+  printf("+------+---------+--------+\n");
+  if(capture_path[0])
+  {
+    printf("Capture file %s (%s): %llu frames captured, %llu dropped (ring full), %llu bytes written\n",
+           capture_path, writer_running ? "running" : "stopped", captured, ring_dropped, bytes_written);
+  }
+}
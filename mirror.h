@@ -0,0 +1,33 @@
+#ifndef MIRROR_H
+#define MIRROR_H
+
+/*
+ * File        : mirror.h
+ * Description : Port mirroring to a capture file. Frames received on (ingress) or forwarded to (egress) the mirrored
+ *               ports are copied into a lock-free capture ring, and a writer thread saves them to a pcapng file. A
+ *               full ring drops the copy, the frame itself is always forwarded.
+ * */
+
+#define MIRROR_INGRESS 0
+#define MIRROR_EGRESS 1
+
+/* frames waiting for the writer, a power of two */
+#define CAPTURE_RING_SIZE 4096
+
+/* mirrored ports per direction (bit 0 -> port 1) */
+extern unsigned int mirror_ports[2];
+
+/* the forwarding path pays one load and a test when its port is not mirrored */
+#define MIRROR_FRAME(port_index, direction, frame) \
+  do { \
+    if(__atomic_load_n(&mirror_ports[direction], __ATOMIC_RELAXED) & (1u << (port_index))) \
+      mirror_frame(port_index, direction, frame); \
+  } while(0)
+
+void init_mirror();
+int start_mirror(const char *path, unsigned int ingress_ports, unsigned int egress_ports);
+void stop_mirror();
+void mirror_frame(int port_index, int direction, const char *frame);
+void display_mirror();
+
+#endif
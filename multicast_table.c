@@ -0,0 +1,342 @@
+/*
+ * File        : multicast_table.c
+ * Description : Multicast forwarding table (IGMP snooping style). Stations join or leave a group with a control frame
+ *               addressed to the group, the switch records the port in the group's member bitmap and forwards frames
+ *               for the group only to member ports. The table is read by every port thread, so it is protected by a
+ *               read-write lock.
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "multicast_table.h"
+
+#define MULTICAST_TABLE_SIZE 16
+
+/* multicast_table entry */
+typedef struct multicast_group
+{
+  char group[18];
+  unsigned int dynamic_ports;  /* ports that joined with a control frame */
+  unsigned int static_ports;   /* ports configured from the switch menu */
+  struct multicast_group *next;
+} multicast_group_t;
+
+static multicast_group_t *multicast_table[MULTICAST_TABLE_SIZE];
+
+/* groups in multicast_table, and joins dropped because it held MAX_MULTICAST_GROUPS, under multicast_lock */
+static int group_count = 0;
+static unsigned long long dropped_joins = 0;
+
+static pthread_rwlock_t multicast_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/*
+ * Function    : multicast_hash
+ * @params     : group -> group mac address
+ * Output      : bucket of the group in multicast_table (FNV-1a)
+ * */
+static unsigned int multicast_hash(const char *group)
+{
+  unsigned int hash_value = 2166136261u;
+  for(int i=0; group[i]; i++)
+  {
+    hash_value ^= (unsigned char) group[i];
+    hash_value *= 16777619u;
+  }
+  return hash_value % MULTICAST_TABLE_SIZE;
+}
+
+/*
+ * Function    : find_group
+ * @params     : group  -> group mac address
+ *               create -> 1 to add the group if it is not in the table
+ * Output      : entry of the group, NULL if not found (or the table is full or malloc failed)
+ * Description : Caller holds multicast_lock, for writing when create is 1
+ * */
+static multicast_group_t *find_group(const char *group, int create)
+{
+  unsigned int index = multicast_hash(group);
+  for(multicast_group_t *temp = multicast_table[index]; temp; temp = temp->next)
+  {
+    if(strcmp(temp->group, group) == 0)
+    {
+      return temp;
+    }
+  }
+  if(!create || group_count >= MAX_MULTICAST_GROUPS)
+  {
+    return NULL;
+  }
+
+  multicast_group_t *newnode = (multicast_group_t *) malloc(sizeof(multicast_group_t));
+  if(newnode == NULL)
+  {
+    perror("Error in malloc()");
+    return NULL;
+  }
+  strcpy(newnode->group, group);
+  newnode->dynamic_ports = 0;
+  newnode->static_ports = 0;
+  newnode->next = multicast_table[index];
+  multicast_table[index] = newnode;
+  group_count++;
+  return newnode;
+}
+
+/*
+ * Function    : remove_empty_groups
+ * Description : Frees groups without any member port, caller holds multicast_lock for writing
+ * */
+static void remove_empty_groups()
+{
+  for(int i=0; i<MULTICAST_TABLE_SIZE; i++)
+  {
+    multicast_group_t **link = &multicast_table[i];
+    while(*link)
+    {
+      multicast_group_t *temp = *link;
+      if(temp->dynamic_ports == 0 && temp->static_ports == 0)
+      {
+        *link = temp->next;
+        free(temp);
+        group_count--;
+      }
+      else
+      {
+        link = &temp->next;
+      }
+    }
+  }
+}
+
+/*
+ * Function    : init_multicast_table
+ * Description : intitialize multicast_table entries to NULL
+ * */
+void init_multicast_table()
+{
+  for(int i=0; i<MULTICAST_TABLE_SIZE; i++)
+  {
+    multicast_table[i] = NULL;
+  }
+  group_count = 0;
+  dropped_joins = 0;
+}
+
+/*
+ * Function    : update_group
+ * @params     : group   -> group mac address
+ *               port_no -> member port
+ *               join    -> 1 to add the port, 0 to remove it
+ *               is_static -> 1 for the static member bitmap, 0 for the dynamic one
+ * Output      : 0 -> done, -1 -> a join to a new group dropped, the table is full
+ * */
+static int update_group(char *group, int port_no, int join, int is_static)
+{
+  int ret = 0;
+  unsigned int bit = 1u << (port_no - 1);
+  pthread_rwlock_wrlock(&multicast_lock);
+  multicast_group_t *entry = find_group(group, join);
+  if(entry)
+  {
+    unsigned int *ports = is_static ? &entry->static_ports : &entry->dynamic_ports;
+    *ports = join ? (*ports | bit) : (*ports & ~bit);
+    if(!join)
+    {
+      remove_empty_groups();
+    }
+  }
+  else if(join)
+  {
+    dropped_joins++;
+    ret = -1;
+  }
+  pthread_rwlock_unlock(&multicast_lock);
+  return ret;
+}
+
+/*
+ * Function    : multicast_join
+ * @params     : group   -> group mac address
+ *               port_no -> port on which the join frame was received
+ * */
+void multicast_join(char *group, int port_no)
+{
+  update_group(group, port_no, 1, 0);
+}
+
+/*
+ * Function    : multicast_leave
+ * @params     : group   -> group mac address
+ *               port_no -> port on which the leave frame was received
+ * */
+void multicast_leave(char *group, int port_no)
+{
+  update_group(group, port_no, 0, 0);
+}
+
+/*
+ * Function    : multicast_add_static
+ * @params     : group   -> group mac address
+ *               port_no -> port to add to the group until it is removed from the menu
+ * Output      : 0 -> added, -1 -> the group is new and the table is full
+ * */
+int multicast_add_static(char *group, int port_no)
+{
+  return update_group(group, port_no, 1, 1);
+}
+
+/*
+ * Function    : multicast_remove_static
+ * @params     : group   -> group mac address
+ *               port_no -> statically configured port to remove
+ * */
+void multicast_remove_static(char *group, int port_no)
+{
+  update_group(group, port_no, 0, 1);
+}
+
+/*
+ * Function    : multicast_remove_port
+ * @params     : port_no -> port whose station disconnected
+ * Description : Removes the port from every group it joined dynamically
+ * */
+void multicast_remove_port(int port_no)
+{
+  unsigned int bit = 1u << (port_no - 1);
+  pthread_rwlock_wrlock(&multicast_lock);
+  for(int i=0; i<MULTICAST_TABLE_SIZE; i++)
+  {
+    for(multicast_group_t *temp = multicast_table[i]; temp; temp = temp->next)
+    {
+      temp->dynamic_ports &= ~bit;
+    }
+  }
+  remove_empty_groups();
+  pthread_rwlock_unlock(&multicast_lock);
+}
+
+/*
+ * Function    : multicast_get_ports
+ * @params     : group     -> group mac address
+ *               port_mask -> to store the member ports of the group
+ * Output      : 1 -> group is registered, 0 -> unknown group (to be flooded)
+ * */
+int multicast_get_ports(char *group, unsigned int *port_mask)
+{
+  int found = 0;
+  pthread_rwlock_rdlock(&multicast_lock);
+  multicast_group_t *entry = find_group(group, 0);
+  if(entry)
+  {
+    *port_mask = entry->dynamic_ports | entry->static_ports;
+    found = 1;
+  }
+  pthread_rwlock_unlock(&multicast_lock);
+  return found;
+}
+
+/*
+ * Function    : multicast_get_groups
+ * @params     : groups -> to store every group and its members, NULL -> only count them
+ *               max    -> room in groups
+ * Output      : number of groups, stored or not
+ * */
+int multicast_get_groups(multicast_members_t *groups, int max)
+{
+  int count = 0;
+  pthread_rwlock_rdlock(&multicast_lock);
+  for(int i=0; i<MULTICAST_TABLE_SIZE; i++)
+  {
+    for(multicast_group_t *temp = multicast_table[i]; temp; temp = temp->next, count++)
+    {
+      if(groups && count < max)
+      {
+        strcpy(groups[count].group, temp->group);
+        groups[count].dynamic_ports = temp->dynamic_ports;
+        groups[count].static_ports = temp->static_ports;
+      }
+    }
+  }
+  pthread_rwlock_unlock(&multicast_lock);
+  return count;
+}
+
+/*
+ * Function    : multicast_restore_group
+ * @params     : members -> group and member ports saved by multicast_get_groups()
+ * Description : Adds the members to the group, ports that do not exist are left out
+ * */
+void multicast_restore_group(const multicast_members_t *members)
+{
+  unsigned int dynamic_ports = members->dynamic_ports & ALL_PORTS_MASK;
+  unsigned int static_ports = members->static_ports & ALL_PORTS_MASK;
+  if(memchr(members->group, '\0', sizeof(members->group)) == NULL || (dynamic_ports | static_ports) == 0)
+  {
+    return;
+  }
+  pthread_rwlock_wrlock(&multicast_lock);
+  multicast_group_t *entry = find_group(members->group, 1);
+  if(entry)
+  {
+    entry->dynamic_ports |= dynamic_ports;
+    entry->static_ports |= static_ports;
+  }
+  pthread_rwlock_unlock(&multicast_lock);
+}
+
+/*
+ * Function    : display_multicast_table
+ * Description : Displays every group with its member ports, static members are marked with *
+ * */
+void display_multicast_table()
+{
+  printf("\n+----------------------+-------------------+\n");
+  printf("|     GROUP ADDRESS    |   MEMBER PORTS    |\n");
+  printf("+----------------------+-------------------+\n");
+  pthread_rwlock_rdlock(&multicast_lock);
+  for(int i=0; i<MULTICAST_TABLE_SIZE; i++)
+  {
+    for(multicast_group_t *temp = multicast_table[i]; temp; temp = temp->next)
+    {
+      char members[32] = "";
+      for(int port = 0; port < 4; port++)
+      {
+        unsigned int bit = 1u << port;
+        if((temp->dynamic_ports | temp->static_ports) & bit)
+        {
+          char member[8];
+          snprintf(member, sizeof(member), "%d%s ", port + 1, (temp->static_ports & bit) ? "*" : "");
+          strcat(members, member);
+        }
+      }
+      printf("|   %s  | %-17s |\n", temp->group, members);
+    }
+  }
+  int count = group_count;
+  unsigned long long dropped = dropped_joins;
+  pthread_rwlock_unlock(&multicast_lock);
+  printf("+----------------------+-------------------+\n");
+  printf("Groups : %d of %d, joins dropped (table full) : %llu\n", count, MAX_MULTICAST_GROUPS, dropped);
+}
+
+/*
+ * Function    : free_multicast_table
+ * Description : Frees every entry of multicast_table
+ * */
+void free_multicast_table()
+{
+  pthread_rwlock_wrlock(&multicast_lock);
+  for(int i=0; i<MULTICAST_TABLE_SIZE; i++)
+  {
+    while(multicast_table[i])
+    {
+      multicast_group_t *temp = multicast_table[i];
+      multicast_table[i] = temp->next;
+      free(temp);
+    }
+  }
+  group_count = 0;
+  pthread_rwlock_unlock(&multicast_lock);
+}
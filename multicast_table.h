@@ -0,0 +1,34 @@
+#ifndef MULTICAST_TABLE_H
+#define MULTICAST_TABLE_H
+
+/*
+ * File        : multicast_table.h
+ * Description : Multicast forwarding table, maps a group mac address to the bitmap of its member ports
+ *               (bit 0 -> port 1). Members are learned from join/leave frames sent by stations or configured statically.
+ * */
+
+#define ALL_PORTS_MASK 0xF
+/* groups in the table, a join or static member of a new group beyond it is dropped */
+#define MAX_MULTICAST_GROUPS 256
+
+/* a group and its member ports, as kept across a warm restart */
+typedef struct multicast_members
+{
+  char group[18];
+  unsigned int dynamic_ports;
+  unsigned int static_ports;
+} multicast_members_t;
+
+void init_multicast_table();
+void multicast_join(char *group, int port_no);
+void multicast_leave(char *group, int port_no);
+int multicast_add_static(char *group, int port_no);
+void multicast_remove_static(char *group, int port_no);
+void multicast_remove_port(int port_no);
+int multicast_get_ports(char *group, unsigned int *port_mask);
+int multicast_get_groups(multicast_members_t *groups, int max);
+void multicast_restore_group(const multicast_members_t *members);
+void display_multicast_table();
+void free_multicast_table();
+
+#endif
@@ -0,0 +1,360 @@
+/*
+ * File        : pcap.c
+ * Description : Memory mapped reader of pcap and pcapng capture files, in either byte order. pcap records carry their
+ *               own timestamps in us or ns, pcapng enhanced packet blocks are timed with the resolution of their
+ *               interface and simple packet blocks take the time of the previous packet.
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pcap.h"
+
+#define PCAP_MAGIC_US 0xa1b2c3d4
+#define PCAP_MAGIC_NS 0xa1b23c4d
+#define PCAPNG_SHB 0x0a0d0d0a
+#define PCAPNG_IDB 0x00000001
+#define PCAPNG_SPB 0x00000003
+#define PCAPNG_EPB 0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1a2b3c4d
+#define PCAPNG_OPT_NAME 2
+#define PCAPNG_OPT_TSRESOL 9
+
+/*
+ * Function    : read32
+ * @params     : reader -> reader, gives the byte order
+ *               offset -> offset in the file
+ * Output      : 32 bit value at offset
+ * */
+static unsigned int read32(const pcap_reader_t *reader, unsigned long long offset)
+{
+  unsigned int value;
+  memcpy(&value, reader->map + offset, sizeof(value));
+  return reader->swapped ? __builtin_bswap32(value) : value;
+}
+
+/*
+ * Function    : read16
+ * @params     : reader -> reader, gives the byte order
+ *               offset -> offset in the file
+ * Output      : 16 bit value at offset
+ * */
+static unsigned short read16(const pcap_reader_t *reader, unsigned long long offset)
+{
+  unsigned short value;
+  memcpy(&value, reader->map + offset, sizeof(value));
+  return reader->swapped ? __builtin_bswap16(value) : value;
+}
+
+/*
+ * Function    : units_to_ns
+ * @params     : ts    -> timestamp
+ *               units -> timestamp units per second
+ * Output      : timestamp in ns
+ * */
+static unsigned long long units_to_ns(unsigned long long ts, unsigned long long units)
+{
+  return ts / units * 1000000000ULL + ts % units * 1000000000ULL / units;
+}
+
+/*
+ * Function    : pcap_open
+ * @params     : reader -> reader to initialize
+ *               path   -> capture file
+ * Output      : 0 -> reader is at the first packet, -1 -> the file cannot be read or is not a capture (error printed)
+ * */
+int pcap_open(pcap_reader_t *reader, const char *path)
+{
+  memset(reader, 0, sizeof(*reader));
+  int fd = open(path, O_RDONLY);
+  if(fd == -1)
+  {
+    perror("Error in open()");
+    return -1;
+  }
+  struct stat st;
+  if(fstat(fd, &st) == -1 || st.st_size < 24)
+  {
+    printf("Error: %s is not a capture file\n", path);
+    close(fd);
+    return -1;
+  }
+  reader->size = st.st_size;
+  reader->map = mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(reader->map == MAP_FAILED)
+  {
+    perror("Error in mmap()");
+    return -1;
+  }
+  /* packets are read once, front to back */
+  madvise((void *) reader->map, reader->size, MADV_SEQUENTIAL);
+
+  unsigned int magic;
+  memcpy(&magic, reader->map, sizeof(magic));
+  if(magic == PCAPNG_SHB)
+  {
+    /* interfaces are declared by the blocks of the section */
+    reader->pcapng = 1;
+    return 0;
+  }
+  if(magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS)
+  {
+    reader->swapped = 0;
+  }
+  else if(__builtin_bswap32(magic) == PCAP_MAGIC_US || __builtin_bswap32(magic) == PCAP_MAGIC_NS)
+  {
+    reader->swapped = 1;
+    magic = __builtin_bswap32(magic);
+  }
+  else
+  {
+    printf("Error: %s is not a pcap or pcapng file\n", path);
+    pcap_close(reader);
+    return -1;
+  }
+  reader->interface_count = 1;
+  reader->linktype[0] = read32(reader, 20) & 0xffff;
+  reader->ts_units[0] = magic == PCAP_MAGIC_NS ? 1000000000ULL : 1000000ULL;
+  reader->offset = 24;
+  return 0;
+}
+
+/*
+ * Function    : read_idb
+ * @params     : reader -> reader
+ *               block  -> offset of an interface description block
+ *               length -> length of the block
+ * Description : Adds the interface to the section, with its link type and timestamp resolution (default us)
+ * */
+static void read_idb(pcap_reader_t *reader, unsigned long long block, unsigned int length)
+{
+  if(reader->interface_count == PCAP_MAX_INTERFACES)
+  {
+    return;
+  }
+  int id = reader->interface_count++;
+  reader->linktype[id] = read16(reader, block + 8);
+  reader->ts_units[id] = 1000000ULL;
+  /* options: code, length, value padded to 32 bits */
+  for(unsigned long long option = block + 16; option + 4 <= block + length - 4; )
+  {
+    unsigned short code = read16(reader, option), option_length = read16(reader, option + 2);
+    if(code == 0)
+      break;
+    if(code == PCAPNG_OPT_TSRESOL && option_length >= 1)
+    {
+      unsigned char resol = reader->map[option + 4];
+      unsigned long long units = 1;
+      for(int i = 0; i < (resol & 0x7f) && units < 1000000000000000000ULL; i++)
+      {
+        units *= (resol & 0x80) ? 2 : 10;
+      }
+      reader->ts_units[id] = units;
+    }
+    option += 4 + ((option_length + 3) & ~3u);
+  }
+}
+
+/*
+ * Function    : pcap_next
+ * @params     : reader -> reader
+ *               packet -> filled with the next packet
+ * Output      : 1 -> packet returned, 0 -> end of the capture, -1 -> the capture is truncated or corrupted
+ * */
+int pcap_next(pcap_reader_t *reader, pcap_packet_t *packet)
+{
+  if(!reader->pcapng)
+  {
+    if(reader->offset + 16 > reader->size)
+    {
+      return 0;
+    }
+    unsigned long long record = reader->offset;
+    unsigned int caplen = read32(reader, record + 8);
+    if(record + 16 + caplen > reader->size)
+    {
+      return -1;
+    }
+    packet->interface = 0;
+    packet->linktype = reader->linktype[0];
+    packet->ts_ns = read32(reader, record) * 1000000000ULL + units_to_ns(read32(reader, record + 4), reader->ts_units[0]);
+    packet->data = reader->map + record + 16;
+    packet->caplen = caplen;
+    reader->offset = record + 16 + caplen;
+    return 1;
+  }
+
+  /* pcapng: skip blocks until a packet block */
+  while(reader->offset + 12 <= reader->size)
+  {
+    unsigned long long block = reader->offset;
+    unsigned int type;
+    memcpy(&type, reader->map + block, sizeof(type));
+    if(type == PCAPNG_SHB)
+    {
+      /* every section gives its byte order and declares its interfaces again */
+      unsigned int byte_order;
+      memcpy(&byte_order, reader->map + block + 8, sizeof(byte_order));
+      if(byte_order != PCAPNG_BYTE_ORDER_MAGIC && __builtin_bswap32(byte_order) != PCAPNG_BYTE_ORDER_MAGIC)
+      {
+        return -1;
+      }
+      reader->swapped = byte_order != PCAPNG_BYTE_ORDER_MAGIC;
+      reader->interface_count = 0;
+    }
+    else
+    {
+      type = read32(reader, block);
+    }
+    unsigned int length = read32(reader, block + 4);
+    if(length < 12 || length % 4 || block + length > reader->size)
+    {
+      return -1;
+    }
+    reader->offset = block + length;
+
+    if(type == PCAPNG_IDB && length >= 20)
+    {
+      read_idb(reader, block, length);
+    }
+    else if(type == PCAPNG_EPB && length >= 32)
+    {
+      unsigned int id = read32(reader, block + 8);
+      unsigned int caplen = read32(reader, block + 20);
+      if(id >= (unsigned int) reader->interface_count || 28 + caplen > length - 4)
+      {
+        return -1;
+      }
+      unsigned long long ts = ((unsigned long long) read32(reader, block + 12) << 32) | read32(reader, block + 16);
+      packet->interface = id;
+      packet->linktype = reader->linktype[id];
+      packet->ts_ns = reader->last_ts_ns = units_to_ns(ts, reader->ts_units[id]);
+      packet->data = reader->map + block + 28;
+      packet->caplen = caplen;
+      return 1;
+    }
+    else if(type == PCAPNG_SPB && length >= 16 && reader->interface_count > 0)
+    {
+      /* the captured length is whatever of the original length fits in the block */
+      unsigned int caplen = read32(reader, block + 8);
+      if(caplen > length - 16)
+      {
+        caplen = length - 16;
+      }
+      packet->interface = 0;
+      packet->linktype = reader->linktype[0];
+      packet->ts_ns = reader->last_ts_ns;
+      packet->data = reader->map + block + 12;
+      packet->caplen = caplen;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Function    : pcap_close
+ * @params     : reader -> reader to release
+ * */
+void pcap_close(pcap_reader_t *reader)
+{
+  if(reader->map && reader->map != MAP_FAILED)
+  {
+    munmap((void *) reader->map, reader->size);
+  }
+  reader->map = NULL;
+}
+
+/*
+ * Function    : put_block
+ * @params     : buf    -> block to complete, the body is already at buf + 8
+ *               type   -> block type
+ *               body   -> length of the body
+ * Output      : length of the block, with the body padded to 32 bits and both length fields written
+ * */
+static int put_block(unsigned char *buf, unsigned int type, unsigned int body)
+{
+  unsigned int length = 12 + ((body + 3) & ~3u);
+  memset(buf + 8 + body, 0, length - 12 - body);
+  memcpy(buf, &type, 4);
+  memcpy(buf + 4, &length, 4);
+  memcpy(buf + length - 4, &length, 4);
+  return length;
+}
+
+/*
+ * Function    : pcapng_section_header
+ * @params     : buf -> at least 28 bytes
+ * Output      : length of the section header block written to buf, in host byte order and of unknown length
+ * */
+int pcapng_section_header(unsigned char *buf)
+{
+  unsigned int byte_order = PCAPNG_BYTE_ORDER_MAGIC;
+  unsigned short version[2] = {1, 0};
+  long long section_length = -1;
+  memcpy(buf + 8, &byte_order, 4);
+  memcpy(buf + 12, version, 4);
+  memcpy(buf + 16, &section_length, 8);
+  return put_block(buf, PCAPNG_SHB, 16);
+}
+
+/*
+ * Function    : pcapng_interface_block
+ * @params     : buf      -> at least 32 bytes plus the length of name
+ *               linktype -> PCAP_LINKTYPE_* of the interface
+ *               name     -> interface name, shown by wireshark
+ * Output      : length of the interface description block written to buf, with ns timestamps
+ * */
+int pcapng_interface_block(unsigned char *buf, int linktype, const char *name)
+{
+  unsigned short type = linktype, reserved = 0, code, length;
+  unsigned int snaplen = 0;
+  unsigned int body = 8;
+  memcpy(buf + 8, &type, 2);
+  memcpy(buf + 10, &reserved, 2);
+  memcpy(buf + 12, &snaplen, 4);
+
+  code = PCAPNG_OPT_NAME;
+  length = strlen(name);
+  memcpy(buf + 8 + body, &code, 2);
+  memcpy(buf + 10 + body, &length, 2);
+  memcpy(buf + 12 + body, name, length);
+  memset(buf + 12 + body + length, 0, ((length + 3) & ~3u) - length);
+  body += 4 + ((length + 3) & ~3u);
+
+  code = PCAPNG_OPT_TSRESOL;
+  length = 1;
+  memcpy(buf + 8 + body, &code, 2);
+  memcpy(buf + 10 + body, &length, 2);
+  memset(buf + 12 + body, 0, 4);
+  buf[12 + body] = 9; /* 10^-9 s */
+  body += 8;
+
+  /* end of options */
+  memset(buf + 8 + body, 0, 4);
+  body += 4;
+  return put_block(buf, PCAPNG_IDB, body);
+}
+
+/*
+ * Function    : pcapng_packet_block
+ * @params     : buf       -> at least PCAPNG_PACKET_BLOCK_SIZE(len) bytes
+ *               interface -> interface id, in the order of the interface blocks
+ *               ts_ns     -> capture time in ns
+ *               data      -> packet
+ *               len       -> length of the packet
+ * Output      : length of the enhanced packet block written to buf
+ * */
+int pcapng_packet_block(unsigned char *buf, int interface, unsigned long long ts_ns, const unsigned char *data,
+                        unsigned int len)
+{
+  unsigned int fields[5] = {interface, ts_ns >> 32, ts_ns & 0xffffffff, len, len};
+  memcpy(buf + 8, fields, sizeof(fields));
+  memcpy(buf + 28, data, len);
+  return put_block(buf, PCAPNG_EPB, 20 + len);
+}
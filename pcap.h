@@ -0,0 +1,50 @@
+#ifndef PCAP_H
+#define PCAP_H
+
+/*
+ * File        : pcap.h
+ * Description : Memory mapped reader of pcap and pcapng capture files. The file is mapped once and packets are
+ *               returned as pointers into the mapping, so a capture of any size is streamed without copying it.
+ *               The pcapng_* functions format the blocks of a pcapng file into a caller's buffer for writers.
+ * */
+
+#define PCAP_LINKTYPE_ETHERNET 1
+/* interfaces of a pcapng section */
+#define PCAP_MAX_INTERFACES 16
+
+typedef struct pcap_packet
+{
+  int interface;               /* interface id (pcapng), always 0 for pcap */
+  int linktype;                /* PCAP_LINKTYPE_* of the interface */
+  unsigned long long ts_ns;    /* capture time in ns */
+  const unsigned char *data;   /* captured bytes, inside the file mapping */
+  unsigned int caplen;
+} pcap_packet_t;
+
+typedef struct pcap_reader
+{
+  const unsigned char *map;
+  unsigned long long size;
+  unsigned long long offset;   /* next record or block */
+  int pcapng;
+  int swapped;                 /* file was written with the other byte order */
+  /* per interface: link type and timestamp units per second */
+  int linktype[PCAP_MAX_INTERFACES];
+  unsigned long long ts_units[PCAP_MAX_INTERFACES];
+  int interface_count;
+  unsigned long long last_ts_ns; /* simple packet blocks carry no timestamp */
+} pcap_reader_t;
+
+int pcap_open(pcap_reader_t *reader, const char *path);
+int pcap_next(pcap_reader_t *reader, pcap_packet_t *packet);
+void pcap_close(pcap_reader_t *reader);
+
+/* largest block written by pcapng_packet_block() for a packet of len bytes */
+#define PCAPNG_PACKET_BLOCK_SIZE(len) (32 + (((len) + 3) & ~3u))
+
+int pcapng_section_header(unsigned char *buf);
+int pcapng_interface_block(unsigned char *buf, int linktype, const char *name);
+int pcapng_packet_block(unsigned char *buf, int interface, unsigned long long ts_ns, const unsigned char *data,
+                        unsigned int len);
+
+#endif
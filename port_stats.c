@@ -0,0 +1,98 @@
+/*
+ * File        : port_stats.c
+ * Description : Creates the shared memory holding per port counters and displays them.
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "port_stats.h"
+#include "instance.h"
+#include "shm_pages.h"
+
+port_stats_t *port_stats;
+
+static int shm_port_stats_fd;
+
+/*
+ * Function    : init_port_stats
+ * @params     : keep -> 1 to keep the counters of the previous switch process (warm start), 0 to clear them
+ * Description : Opens and maps the port statistics shared memory
+ * */
+int init_port_stats(int keep)
+{
+  port_stats = shm_map(instance_name(PORT_STATS), PORT_STATS_SIZE, PROT_READ | PROT_WRITE, &shm_port_stats_fd);
+  if(port_stats == MAP_FAILED)
+  {
+    port_stats = NULL;
+    return EXIT_FAILURE;
+  }
+
+  if(!keep)
+  {
+    memset(port_stats, 0, PORT_STATS_SIZE);
+  }
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Function    : display_port_stats
+ * Description : Displays the counters of every port
+ * */
+void display_port_stats()
+{
+  printf("\n+------+------------+------------+------------+------------+------------+------------+------------+\n");
+  printf("| PORT |  RX FRAMES |  RX BAD FCS| RX DROPPED |  VLAN DROP |   ACL DENY | RX FLOODED |  TX FRAMES |\n");
+  printf("+------+------------+------------+------------+------------+------------+------------+------------+\n");
+  for(int i=0; i<4; i++)
+  {
+    printf("|  %d   | %10llu | %10llu | %10llu | %10llu | %10llu | %10llu | %10llu |\n", i+1, port_stats[i].rx_frames,
+           port_stats[i].rx_bad_fcs, port_stats[i].rx_dropped, port_stats[i].rx_vlan_dropped, port_stats[i].rx_acl_denied,
+           port_stats[i].rx_flooded, port_stats[i].tx_frames);
+  }
+  printf("+------+------------+------------+------------+------------+------------+------------+------------+\n");
+
+  /* port mqueue occupancy, TX is the station's side to read, RX the switch's */
+  printf("+------+-------+--------+------------+-------+--------+------------+------+------------+\n");
+  printf("| PORT | TX MQ | TX MAX | TX FULL ms | RX MQ | RX MAX | RX FULL ms | SLOW |  SLOW DROP |\n");
+  printf("+------+-------+--------+------------+-------+--------+------------+------+------------+\n");
+  for(int i=0; i<4; i++)
+  {
+    printf("|  %d   | %5llu | %6llu | %10llu | %5llu | %6llu | %10llu | %-4s | %10llu |\n", i+1, port_stats[i].tx_mq_depth,
+           port_stats[i].tx_mq_max_depth, port_stats[i].tx_mq_full_ms, port_stats[i].rx_mq_depth,
+           port_stats[i].rx_mq_max_depth, port_stats[i].rx_mq_full_ms, port_stats[i].slow_consumer ? "yes" : "no",
+           port_stats[i].slow_consumer_dropped);
+  }
+  printf("+------+-------+--------+------------+-------+--------+------------+------+------------+\n");
+
+  /* forwarding decisions served by the flow cache of the ingress port */
+  printf("+------+------------+------------+----------+\n");
+  printf("| PORT |  FLOW HITS | FLOW MISSES| HIT RATE |\n");
+  printf("+------+------------+------------+----------+\n");
+  for(int i=0; i<4; i++)
+  {
+    unsigned long long hits = port_stats[i].flow_cache_hits, misses = port_stats[i].flow_cache_misses;
+    printf("|  %d   | %10llu | %10llu | %7.1f%% |\n", i+1, hits, misses, hits + misses ? 100.0 * hits / (hits + misses) : 0.0);
+  }
+  printf("+------+------------+------------+----------+\n");
+}
+
+/*
+ * Function    : close_port_stats
+ * @params     : remove -> 1 to unlink the shared memory (switch off), 0 to keep it for the next switch process
+ * Description : Unmaps the port statistics shared memory
+ * */
+void close_port_stats(int remove)
+{
+  shm_unmap(port_stats, PORT_STATS_SIZE);
+  port_stats = NULL;
+  close(shm_port_stats_fd);
+  if(remove)
+  {
+    shm_remove(instance_name(PORT_STATS));
+  }
+}
@@ -0,0 +1,60 @@
+#ifndef PORT_STATS_H
+#define PORT_STATS_H
+
+/*
+ * File        : port_stats.h
+ * Description : Per port counters kept in shared memory so that they survive a warm restart and can be read by other
+ *               processes. Counters are only ever incremented, with relaxed atomics since several port threads update
+ *               the tx side of the same port.
+ * */
+
+#define PORT_STATS "/port_stats"
+
+typedef struct port_stats
+{
+  unsigned long long rx_frames;   /* frames received on the port */
+  unsigned long long rx_bad_fcs;  /* frames dropped because the fcs did not match */
+  unsigned long long rx_dropped;  /* frames received on the port that were not forwarded */
+  unsigned long long rx_flooded;  /* broadcast / unknown unicast frames received on the port */
+  unsigned long long rx_vlan_dropped; /* frames of a vlan the port does not carry */
+  unsigned long long rx_acl_denied;   /* frames denied by the port's ingress ACL */
+  unsigned long long tx_frames;   /* frames forwarded to the port */
+  unsigned long long storm_dropped[3]; /* frames dropped by storm control, indexed by STORM_* traffic class */
+  /* egress queues, indexed by egress class */
+  unsigned long long egress_sent[4];
+  unsigned long long egress_dropped[4];   /* queue of the class was full */
+  unsigned long long egress_depth[4];     /* frames queued now */
+  unsigned long long egress_max_depth[4]; /* high watermark */
+  /* port mqueues, sampled by the queue monitor */
+  unsigned long long tx_mq_depth;         /* frames waiting for the station to read them */
+  unsigned long long tx_mq_max_depth;
+  unsigned long long tx_mq_full_ms;       /* time the mqueue was found full */
+  unsigned long long rx_mq_depth;         /* frames of the station waiting for the switch */
+  unsigned long long rx_mq_max_depth;
+  unsigned long long rx_mq_full_ms;
+  unsigned long long slow_consumer;       /* 1 while the station is flagged as a slow consumer */
+  unsigned long long slow_consumer_events;
+  unsigned long long slow_consumer_dropped; /* frames dropped by the drop policy of a slow consumer */
+  /* forwarding decisions of frames to individual addresses found in the port's flow cache, or not */
+  unsigned long long flow_cache_hits;
+  unsigned long long flow_cache_misses;
+  /* rounds of the ingress scheduler the port ended with frames left, because of its weight or the cap */
+  unsigned long long ingress_deferred;
+  /* new source addresses of the port's frames, as its learning policy treated them */
+  unsigned long long learned;             /* added to the mac_table */
+  unsigned long long learn_limited;       /* not learned, over the port's limit of new addresses per second */
+  unsigned long long learn_deferred;      /* queued for the learner thread */
+  unsigned long long learn_queue_full;    /* not learned, the learner's queue was full */
+} port_stats_t;
+
+#define PORT_STATS_SIZE (4 * sizeof(port_stats_t))
+
+extern port_stats_t *port_stats;
+
+#define PORT_STAT_ADD(port_index, field, n) __atomic_fetch_add(&port_stats[port_index].field, (n), __ATOMIC_RELAXED)
+
+int init_port_stats(int keep);
+void display_port_stats();
+void close_port_stats(int remove);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+/*
+ * File        : probes.h
+ * Description : USDT static tracepoints of the switch and the station, provider "vnswitch". With <sys/sdt.h>
+ *               (systemtap-sdt-dev / systemtap-sdt-devel) a probe is a single nop and a note in the binary, arguments
+ *               are only read by an attached tracer. Without the header, or built with -DNO_PROBES, probes compile to
+ *               nothing. List them with: bpftrace -l 'usdt:./switch:*'
+ *               MAC address arguments point to the 17 characters of the address in the frame, read them with
+ *               str(argN, 18). Probes and arguments:
+ *               switch  frame_receive    port, src, dest, vlan tag, seq      every frame read from a port mqueue
+ *                       mac_learn        port, vlan, mac, moved              new address, or one moved to another port
+ *                       mac_lookup_hit   port, vlan, dest, dest port
+ *                       mac_lookup_miss  port, vlan, dest                    unknown unicast
+ *                       flood            port, vlan, port mask, copies       broadcast, multicast and unknown unicast
+ *                       unicast          port, dest port, vlan
+ *                       queue_full       port, dest port, priority           egress queue of dest port was full
+ *                       drop             port, PROBE_DROP_* reason
+ *               station frame_send       port, src, dest, flags, seq
+ *                       frame_receive    port, src, dest, flags, seq
+ *                       drop             port, PROBE_DROP_* reason
+ * */
+
+#if !defined(NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define PROBES_ENABLED 1
+#endif
+#endif
+
+/* drop reasons */
+#define PROBE_DROP_BAD_FCS 1
+#define PROBE_DROP_VLAN 2
+#define PROBE_DROP_STORM 3
+#define PROBE_DROP_FILTERED 4       /* destination is the source port, disabled or out of the vlan */
+#define PROBE_DROP_QUEUE_FULL 5
+#define PROBE_DROP_NO_PORT 6        /* flood with no port to send to */
+#define PROBE_DROP_NOT_MULTICAST 7  /* join/leave for an address that is not a group */
+#define PROBE_DROP_NOT_FOR_STATION 8
+#define PROBE_DROP_ACL 9            /* denied by the ingress ACL of the port */
+
+#ifdef PROBES_ENABLED
+#define PROBE2(name, a, b) STAP_PROBE2(vnswitch, name, a, b)
+#define PROBE3(name, a, b, c) STAP_PROBE3(vnswitch, name, a, b, c)
+#define PROBE4(name, a, b, c, d) STAP_PROBE4(vnswitch, name, a, b, c, d)
+#define PROBE5(name, a, b, c, d, e) STAP_PROBE5(vnswitch, name, a, b, c, d, e)
+#else
+#define PROBE2(name, a, b) do { } while(0)
+#define PROBE3(name, a, b, c) do { } while(0)
+#define PROBE4(name, a, b, c, d) do { } while(0)
+#define PROBE5(name, a, b, c, d, e) do { } while(0)
+#endif
+
+#endif
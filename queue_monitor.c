@@ -0,0 +1,244 @@
+/*
+ * File        : queue_monitor.c
+ * Description : Samples the port mqueues every QUEUE_SAMPLE_MS with mq_getattr(). The mqueue the switch sends to
+ *               fills when its station reads slower than frames arrive, the one the station sends to fills when the
+ *               switch is behind, so the two tell which side is the bottleneck. A station whose mqueue is found full
+ *               for slow_threshold_ms in a row is flagged as a slow consumer, and with auto drop its egress scheduler
+ *               stops waiting for room and drops instead, so frames do not grow stale in the egress queues. The flag
+ *               is cleared once the mqueue has not been full for as long.
+ * */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <mqueue.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/types.h>
+
+#include "queue_monitor.h"
+#include "port_stats.h"
+#include "egress_sched.h"
+
+#define MAX_PORTS 4
+
+pid_t is_connected(int);
+
+extern mqd_t mq_fd[4];
+extern mqd_t mq_send_fd[4];
+extern FILE *fptr[4];
+
+static unsigned int slow_threshold_ms = SLOW_CONSUMER_DEFAULT_MS;
+static int slow_auto_drop = 0;
+/* time the station's mqueue has been full, or not full for a flagged station, in a row */
+static unsigned int full_run_ms[MAX_PORTS];
+static unsigned int clear_run_ms[MAX_PORTS];
+
+static volatile int monitor_running = 0;
+static pthread_t monitor_id;
+static pthread_mutex_t monitor_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Function    : sample_mqueue
+ * @params     : fd        -> mqueue to sample
+ *               depth     -> port statistics depth of the mqueue
+ *               max_depth -> its high watermark
+ *               full_ms   -> its time at full
+ * Output      : 1 -> mqueue is full, 0 -> not full, -1 -> mq_getattr() failed
+ * */
+static int sample_mqueue(mqd_t fd, unsigned long long *depth, unsigned long long *max_depth, unsigned long long *full_ms)
+{
+  struct mq_attr attr;
+  if(mq_getattr(fd, &attr) == -1)
+  {
+    return -1;
+  }
+  __atomic_store_n(depth, attr.mq_curmsgs, __ATOMIC_RELAXED);
+  if((unsigned long long) attr.mq_curmsgs > *max_depth)
+  {
+    __atomic_store_n(max_depth, attr.mq_curmsgs, __ATOMIC_RELAXED);
+  }
+  if(attr.mq_curmsgs >= attr.mq_maxmsg)
+  {
+    __atomic_fetch_add(full_ms, QUEUE_SAMPLE_MS, __ATOMIC_RELAXED);
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * Function    : set_slow_consumer
+ * @params     : port_index -> port (0 based)
+ *               slow       -> 1 to flag the port's station, 0 to clear the flag
+ *               auto_drop  -> the egress scheduler drops frames of a flagged station
+ * Description : monitor_lock held
+ * */
+static void set_slow_consumer(int port_index, int slow, int auto_drop)
+{
+  if(slow == (int) port_stats[port_index].slow_consumer)
+  {
+    return;
+  }
+  __atomic_store_n(&port_stats[port_index].slow_consumer, slow, __ATOMIC_RELAXED);
+  set_egress_drop_when_full(port_index, slow && auto_drop);
+  if(slow)
+  {
+    PORT_STAT_ADD(port_index, slow_consumer_events, 1);
+    fprintf(fptr[port_index], "Station on port - %d is a slow consumer, its mqueue was full for %u ms%s\n", port_index + 1,
+            full_run_ms[port_index], auto_drop ? ", frames are dropped when it is full" : "");
+  }
+  else
+  {
+    fprintf(fptr[port_index], "Station on port - %d is no longer a slow consumer\n", port_index + 1);
+  }
+  full_run_ms[port_index] = clear_run_ms[port_index] = 0;
+}
+
+/*
+ * Function    : queue_monitor
+ * @params     : arg -> unused
+ * Description : Samples the mqueues of every port until stop_queue_monitor()
+ * */
+static void *queue_monitor(void *arg)
+{
+  /* switch signals are handled by the menu thread */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGUSR1);
+  sigaddset(&set, SIGHUP);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  while(monitor_running)
+  {
+    pthread_mutex_lock(&monitor_lock);
+    for(int i = 0; i < MAX_PORTS; i++)
+    {
+      port_stats_t *s = &port_stats[i];
+      int tx_full = sample_mqueue(mq_send_fd[i], &s->tx_mq_depth, &s->tx_mq_max_depth, &s->tx_mq_full_ms);
+      sample_mqueue(mq_fd[i], &s->rx_mq_depth, &s->rx_mq_max_depth, &s->rx_mq_full_ms);
+
+      /* frames left in the mqueue of a station that went away say nothing about a station */
+      if(!is_connected(i) || tx_full == -1 || slow_threshold_ms == 0)
+      {
+        set_slow_consumer(i, 0, 0);
+        full_run_ms[i] = clear_run_ms[i] = 0;
+        continue;
+      }
+      if(tx_full)
+      {
+        full_run_ms[i] += QUEUE_SAMPLE_MS;
+        clear_run_ms[i] = 0;
+      }
+      else
+      {
+        full_run_ms[i] = 0;
+        clear_run_ms[i] += QUEUE_SAMPLE_MS;
+      }
+      if(!s->slow_consumer && full_run_ms[i] >= slow_threshold_ms)
+      {
+        set_slow_consumer(i, 1, slow_auto_drop);
+      }
+      else if(s->slow_consumer && clear_run_ms[i] >= slow_threshold_ms)
+      {
+        set_slow_consumer(i, 0, 0);
+      }
+    }
+    pthread_mutex_unlock(&monitor_lock);
+
+    struct timespec tick = {0, QUEUE_SAMPLE_MS * 1000000L};
+    nanosleep(&tick, NULL);
+  }
+  return NULL;
+}
+
+/*
+ * Function    : start_queue_monitor
+ * Output      : 0 -> monitor started, -1 -> thread error
+ * Description : Started once the port mqueues are open, no station is flagged at start
+ * */
+int start_queue_monitor()
+{
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    port_stats[i].slow_consumer = 0;
+    port_stats[i].tx_mq_depth = port_stats[i].rx_mq_depth = 0;
+    full_run_ms[i] = clear_run_ms[i] = 0;
+  }
+  monitor_running = 1;
+  if(pthread_create(&monitor_id, NULL, queue_monitor, NULL) != 0)
+  {
+    perror("Error in pthread_create()");
+    monitor_running = 0;
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Function    : stop_queue_monitor
+ * Description : Stops the monitor thread, before the port mqueues are closed
+ * */
+void stop_queue_monitor()
+{
+  if(!monitor_running)
+  {
+    return;
+  }
+  monitor_running = 0;
+  pthread_join(monitor_id, NULL);
+}
+
+/*
+ * Function    : set_slow_consumer_detection
+ * @params     : threshold_ms -> time a station's mqueue must stay full to flag it, 0 disables the detection
+ *               auto_drop    -> 1 -> frames to a flagged station are dropped when its mqueue is full
+ * */
+void set_slow_consumer_detection(unsigned int threshold_ms, int auto_drop)
+{
+  pthread_mutex_lock(&monitor_lock);
+  slow_threshold_ms = threshold_ms;
+  slow_auto_drop = auto_drop;
+  /* stations flagged already follow the new policy */
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    set_egress_drop_when_full(i, port_stats[i].slow_consumer && auto_drop);
+  }
+  pthread_mutex_unlock(&monitor_lock);
+}
+
+/*
+ * Function    : get_slow_consumer_detection
+ * @params     : auto_drop -> to store 1 if frames to a flagged station are dropped when its mqueue is full
+ * Output      : time a station's mqueue must stay full to flag it, 0 -> the detection is disabled
+ * */
+unsigned int get_slow_consumer_detection(int *auto_drop)
+{
+  pthread_mutex_lock(&monitor_lock);
+  unsigned int threshold_ms = slow_threshold_ms;
+  *auto_drop = slow_auto_drop;
+  pthread_mutex_unlock(&monitor_lock);
+  return threshold_ms;
+}
+
+/*
+ * Function    : display_queue_monitor
+ * Description : Displays the slow consumer settings and the flagged stations
+ * */
+void display_queue_monitor()
+{
+  if(slow_threshold_ms == 0)
+  {
+    printf("\nSlow consumer detection is disabled\n");
+  }
+  else
+  {
+    printf("\nA station whose mqueue stays full for %u ms is a slow consumer, %s\n", slow_threshold_ms,
+           slow_auto_drop ? "frames to it are then dropped when its mqueue is full" : "it is only reported");
+  }
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    printf("Port - %d : %s, flagged %llu times, %llu frames dropped by the drop policy\n", i + 1,
+           port_stats[i].slow_consumer ? "slow consumer" : "ok", port_stats[i].slow_consumer_events,
+           port_stats[i].slow_consumer_dropped);
+  }
+}
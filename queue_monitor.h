@@ -0,0 +1,20 @@
+#ifndef QUEUE_MONITOR_H
+#define QUEUE_MONITOR_H
+
+/*
+ * File        : queue_monitor.h
+ * Description : Port mqueue occupancy. A monitor thread samples the depth of the mqueues of every port, keeps their
+ *               high watermarks and the time they were full in the port statistics, and flags the station of a port
+ *               whose mqueue stays full longer than a threshold as a slow consumer.
+ * */
+
+#define QUEUE_SAMPLE_MS 10
+#define SLOW_CONSUMER_DEFAULT_MS 1000
+
+int start_queue_monitor();
+void stop_queue_monitor();
+void set_slow_consumer_detection(unsigned int threshold_ms, int auto_drop);
+unsigned int get_slow_consumer_detection(int *auto_drop);
+void display_queue_monitor();
+
+#endif
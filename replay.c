@@ -0,0 +1,443 @@
+/*
+ * File        : replay.c
+ * Description : Replays an Ethernet capture (pcap or pcapng) into the switch. The replay connects to the switch's ports
+ *               like a station, converts the Ethernet header of every packet into a frame (addresses, 802.1Q tag,
+ *               ethertype) and sends it on the port its capture interface is mapped to, at the recorded timing, a
+ *               multiple of it or as fast as the switch takes frames. Frames the switch sends back to the replay ports
+ *               are read and counted. At the end the injection rate and the switch's port counters are reported.
+ *               Build: gcc -O2 -o replay replay.c pcap.c con_discon_ports.c en_dis_ports.c init_shared_memories.c
+ *                      init_semaphores.c switch_pid.c port_stats.c fcs.c mac_util.c instance.c shm_pages.c -lpthread -lrt
+ *               Usage: ./replay [-n <SWITCH_NO>] [-i <INTERFACE>:<PORT_NO>]... [-x <SPEED> | -a] [-f] <CAPTURE_FILE>
+ * */
+
+#include "switch.h"
+#include "frame.h"
+#include "fcs.h"
+#include "mac_util.h"
+#include "instance.h"
+#include "port_stats.h"
+#include "pcap.h"
+
+#define MAX_PORTS 4
+#define ETHERTYPE_VLAN 0x8100
+/* the switch's counters are read again once they stop changing, or after this long */
+#define SETTLE_TIMEOUT_MS 1000
+
+/* function declarations */
+void connect_port(int, char *);
+int is_enabled(int);
+pid_t is_connected(int);
+pid_t get_switch_pid();
+int init_shared_memories();
+void init_semaphore(int);
+
+mqd_t mq_send_fd[MAX_PORTS];
+mqd_t mq_recv_fd[MAX_PORTS];
+sem_t *s_recv[4];
+sem_t *s_send[4];
+/* port log files of en_dis_ports.c, only written by the switch */
+FILE *fptr[4];
+
+/* port every capture interface is replayed on, 0 -> its packets are skipped */
+int interface_port[PCAP_MAX_INTERFACES];
+/* ports the replay is connected to (bit 0 -> port 1) */
+unsigned int replay_ports = 0;
+/* set by -x, 0 with -a */
+double speed = 1.0;
+int use_fcs = 0;
+volatile sig_atomic_t stop = 0;
+
+/* counters of the switch summed over its ports */
+typedef struct switch_totals
+{
+  unsigned long long rx_frames;
+  unsigned long long rx_bad_fcs;
+  unsigned long long rx_dropped;
+  unsigned long long rx_vlan_dropped;
+  unsigned long long storm_dropped;
+  unsigned long long egress_sent;
+  unsigned long long egress_dropped;
+} switch_totals_t;
+
+/* frames the switch forwarded to the replay ports */
+unsigned long long returned[MAX_PORTS];
+pthread_t drain_id[MAX_PORTS];
+
+/*
+ * Function    : drain_port
+ * @params     : arg -> port index
+ * Description : Reads the frames the switch sends to a replay port, so its egress queues never fill up
+ * */
+void *drain_port(void *arg)
+{
+  int port_index = (int) (long) arg;
+  char frame[FRAME_SIZE];
+  while(1)
+  {
+    if(mq_receive(mq_recv_fd[port_index], frame, FRAME_SIZE, NULL) == -1)
+    {
+      return NULL;
+    }
+    __atomic_add_fetch(&returned[port_index], 1, __ATOMIC_RELAXED);
+  }
+}
+
+/*
+ * Function    : build_frame
+ * @params     : packet -> Ethernet packet from the capture
+ *               frame  -> FRAME_SIZE bytes to fill
+ * Output      : priority of the frame, -1 if the packet is too short to have an Ethernet header
+ * Description : The addresses, 802.1Q tag and ethertype of the packet go to the frame header, the first bytes of the
+ *               payload go to the frame data
+ * */
+int build_frame(const pcap_packet_t *packet, char *frame)
+{
+  const unsigned char *eth = packet->data;
+  unsigned int header = 14;
+  if(packet->caplen < header)
+  {
+    return -1;
+  }
+  frame_t *f = (frame_t *) frame;
+  memset(frame, 0, FRAME_SIZE);
+  unsigned long long dest = 0, src = 0;
+  for(int i = 0; i < 6; i++)
+  {
+    dest = (dest << 8) | eth[i];
+    src = (src << 8) | eth[6 + i];
+  }
+  mac_address_string(src, f->src_mac_address);
+  mac_address_string(dest, f->dest_mac_address);
+  frame[17] = ' ';
+  frame[35] = ' ';
+
+  unsigned short ethertype = (eth[12] << 8) | eth[13];
+  if(ethertype == ETHERTYPE_VLAN && packet->caplen >= 18)
+  {
+    unsigned short tci = (eth[14] << 8) | eth[15];
+    f->priority = tci >> 13;
+    f->vlan_id = tci & 0xfff;
+    ethertype = (eth[16] << 8) | eth[17];
+    header = 18;
+  }
+  f->ethertype = ethertype;
+  unsigned int payload = packet->caplen - header;
+  memcpy(f->data, eth + header, payload < sizeof(f->data) ? payload : sizeof(f->data));
+  if(use_fcs)
+  {
+    frame_set_fcs(frame);
+  }
+  return f->priority;
+}
+
+/*
+ * Function    : attach_ports
+ * Output      : EXIT_SUCCESS, EXIT_FAILURE if a port cannot be used
+ * Description : Connects the replay to every port an interface is mapped to, like a station does
+ * */
+int attach_ports()
+{
+  mq_port_attr.mq_maxmsg = 5;
+  mq_port_attr.mq_msgsize = FRAME_SIZE;
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    if(!(replay_ports & (1u << i)))
+      continue;
+    if(!is_enabled(i))
+    {
+      printf("Error: Port is disabled, cannot connect to port - %d\n", i + 1);
+      return EXIT_FAILURE;
+    }
+    if(is_connected(i))
+    {
+      printf("Error: Port - %d is alread connected to a station\n", i + 1);
+      return EXIT_FAILURE;
+    }
+    mq_send_fd[i] = mq_open(recv_mq[i], _FLAGS, 0777, &mq_port_attr);
+    mq_recv_fd[i] = mq_open(send_mq[i], _FLAGS, 0777, &mq_port_attr);
+    if(mq_send_fd[i] == -1 || mq_recv_fd[i] == -1)
+    {
+      perror("Error in mq_open()");
+      return EXIT_FAILURE;
+    }
+    init_semaphore(i + 1);
+    connect_port(i + 1, "REPLAY");
+    pthread_create(&drain_id[i], NULL, drain_port, (void *) (long) i);
+  }
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Function    : sum_stats
+ * @params     : totals -> filled with the counters of the switch summed over its ports
+ * */
+void sum_stats(switch_totals_t *totals)
+{
+  memset(totals, 0, sizeof(*totals));
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    totals->rx_frames += port_stats[i].rx_frames;
+    totals->rx_bad_fcs += port_stats[i].rx_bad_fcs;
+    totals->rx_dropped += port_stats[i].rx_dropped;
+    totals->rx_vlan_dropped += port_stats[i].rx_vlan_dropped;
+    for(int c = 0; c < 3; c++)
+    {
+      totals->storm_dropped += port_stats[i].storm_dropped[c];
+    }
+    for(int c = 0; c < 4; c++)
+    {
+      totals->egress_sent += port_stats[i].egress_sent[c];
+      totals->egress_dropped += port_stats[i].egress_dropped[c];
+    }
+  }
+}
+
+/*
+ * Function    : replay_sigint
+ * @params     : sig -> signal number
+ * Description : Ctrl+c stops the replay, which still reports what was sent
+ * */
+void replay_sigint(int sig)
+{
+  stop = 1;
+}
+
+/*
+ * Function    : main
+ * @params     : argc -> count of command line arguments
+ *               argv -> string array of all command line arguments
+ * Description : Replays the capture and reports the rate and the drops
+ * */
+int main(int argc, char *argv[])
+{
+  const char *path = NULL;
+  int mapped = 0;
+
+  for(int i = 1; i < argc; i++)
+  {
+    if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+    {
+      int switch_id = atoi(argv[++i]);
+      if(switch_id < 0 || switch_id > MAX_SWITCH_ID)
+      {
+        printf("Error: Switch number must be between 0 and %d\n", MAX_SWITCH_ID);
+        return EXIT_FAILURE;
+      }
+      set_switch_instance(switch_id);
+    }
+    else if(strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+    {
+      int interface, port;
+      if(sscanf(argv[++i], "%d:%d", &interface, &port) != 2 || interface < 0 || interface >= PCAP_MAX_INTERFACES ||
+         port < 1 || port > MAX_PORTS)
+      {
+        printf("Error: Invalid interface mapping %s\n", argv[i]);
+        return EXIT_FAILURE;
+      }
+      interface_port[interface] = port;
+      mapped = 1;
+    }
+    else if(strcmp(argv[i], "-x") == 0 && i + 1 < argc)
+    {
+      speed = atof(argv[++i]);
+      if(speed <= 0)
+      {
+        printf("Error: Speed must be greater than 0\n");
+        return EXIT_FAILURE;
+      }
+    }
+    else if(strcmp(argv[i], "-a") == 0)
+    {
+      speed = 0;
+    }
+    else if(strcmp(argv[i], "-f") == 0)
+    {
+      use_fcs = 1;
+    }
+    else if(argv[i][0] != '-' && path == NULL)
+    {
+      path = argv[i];
+    }
+    else
+    {
+      path = NULL;
+      break;
+    }
+  }
+  if(path == NULL)
+  {
+    printf("Usage: ./replay [-n <SWITCH_NO>] [-i <INTERFACE>:<PORT_NO>]... [-x <SPEED> | -a] [-f] <CAPTURE_FILE>\n");
+    printf("  -n <SWITCH_NO>         : replay into this switch (default 0)\n");
+    printf("  -i <INTERFACE>:<PORT_NO>: replay the packets of capture interface INTERFACE on port PORT_NO\n");
+    printf("                           (default: interface 0 on port 1, 1 on port 2, ...)\n");
+    printf("  -x <SPEED>             : replay SPEED times as fast as recorded, e.g. 10 or 0.5 (default 1)\n");
+    printf("  -a                     : replay as fast as the switch takes frames\n");
+    printf("  -f                     : append a CRC32C frame check sequence to the frames\n");
+    return EXIT_FAILURE;
+  }
+  if(!mapped)
+  {
+    for(int i = 0; i < MAX_PORTS; i++)
+    {
+      interface_port[i] = i + 1;
+    }
+  }
+
+  pcap_reader_t reader;
+  if(pcap_open(&reader, path) == -1)
+  {
+    return EXIT_FAILURE;
+  }
+
+  /* the ports to connect to are the ones used by the capture, which are known after a first pass */
+  pcap_packet_t packet;
+  int ret;
+  unsigned long long packets = 0;
+  while((ret = pcap_next(&reader, &packet)) == 1)
+  {
+    if(interface_port[packet.interface])
+    {
+      replay_ports |= 1u << (interface_port[packet.interface] - 1);
+    }
+    packets++;
+  }
+  if(ret == -1)
+  {
+    printf("Error: %s is truncated or corrupted after %llu packets\n", path, packets);
+    return EXIT_FAILURE;
+  }
+  pcap_close(&reader);
+  if(replay_ports == 0)
+  {
+    printf("Error: No packet of %s is mapped to a port\n", path);
+    return EXIT_FAILURE;
+  }
+
+  apply_instance_names(send_mq, 4);
+  apply_instance_names(recv_mq, 4);
+  apply_instance_names(sem_recv_names, 4);
+  apply_instance_names(sem_send_names, 4);
+  if(init_shared_memories() == EXIT_FAILURE || init_port_stats(1) == EXIT_FAILURE)
+  {
+    return EXIT_FAILURE;
+  }
+  crc32c_init();
+  if(attach_ports() == EXIT_FAILURE)
+  {
+    kill(get_switch_pid(), SIGUSR1);
+    return EXIT_FAILURE;
+  }
+  /* no SA_RESTART, so ctrl+c also interrupts an mq_send waiting for a full port */
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = replay_sigint;
+  sigaction(SIGINT, &sa, NULL);
+
+  switch_totals_t before, after;
+  sum_stats(&before);
+
+  pcap_open(&reader, path);
+  unsigned long long sent = 0, skipped = 0, late = 0, first_ts = 0;
+  struct timespec start, now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  char frame[FRAME_SIZE];
+  while(!stop && pcap_next(&reader, &packet) == 1)
+  {
+    int port = interface_port[packet.interface];
+    int priority;
+    if(port == 0 || packet.linktype != PCAP_LINKTYPE_ETHERNET || (priority = build_frame(&packet, frame)) == -1)
+    {
+      skipped++;
+      continue;
+    }
+    if(sent == 0)
+    {
+      first_ts = packet.ts_ns;
+    }
+    if(speed > 0)
+    {
+      /* wait for the packet's time in the capture, scaled by speed, since the first packet */
+      unsigned long long offset_ns = (packet.ts_ns - first_ts) / speed;
+      struct timespec due = start;
+      due.tv_sec += offset_ns / 1000000000ULL;
+      due.tv_nsec += offset_ns % 1000000000ULL;
+      if(due.tv_nsec >= 1000000000L)
+      {
+        due.tv_sec++;
+        due.tv_nsec -= 1000000000L;
+      }
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      if(now.tv_sec < due.tv_sec || (now.tv_sec == due.tv_sec && now.tv_nsec < due.tv_nsec))
+      {
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+      }
+      else if((now.tv_sec - due.tv_sec) * 1000000000LL + (now.tv_nsec - due.tv_nsec) > 1000000)
+      {
+        /* more than a millisecond behind the capture, the port was full */
+        late++;
+      }
+    }
+    sem_wait(s_recv[port - 1]);
+    ret = mq_send(mq_send_fd[port - 1], frame, FRAME_SIZE, priority);
+    sem_post(s_recv[port - 1]);
+    if(ret == -1)
+    {
+      if(errno == EINTR)
+        break;
+      perror("Error in mq_send()");
+      break;
+    }
+    sent++;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double seconds = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+  pcap_close(&reader);
+
+  /* let the switch forward what is still queued */
+  for(int waited = 0; waited < SETTLE_TIMEOUT_MS; waited += 10)
+  {
+    sum_stats(&after);
+    if(after.rx_frames - before.rx_frames >= sent)
+    {
+      usleep(10000);
+      break;
+    }
+    usleep(10000);
+  }
+  sum_stats(&after);
+
+  unsigned long long total_returned = 0;
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    total_returned += returned[i];
+  }
+  printf("Replayed %llu of %llu packets in %.3f s, %.0f frames/s", sent, packets, seconds, seconds > 0 ? sent / seconds : 0);
+  if(speed > 0)
+  {
+    printf(" (%.4gx recorded speed, %llu frames more than 1 ms late)", speed, late);
+  }
+  printf("\n");
+  if(skipped)
+  {
+    printf("Skipped %llu packets that are unmapped, not Ethernet or too short\n", skipped);
+  }
+  printf("Switch: %llu received, %llu forwarded to ports, %llu returned to the replay ports\n",
+         after.rx_frames - before.rx_frames, after.egress_sent - before.egress_sent, total_returned);
+  printf("Drops : %llu not forwarded (%llu vlan, %llu storm control), %llu bad fcs, %llu egress queue full\n",
+         after.rx_dropped - before.rx_dropped, after.rx_vlan_dropped - before.rx_vlan_dropped,
+         after.storm_dropped - before.storm_dropped, after.rx_bad_fcs - before.rx_bad_fcs,
+         after.egress_dropped - before.egress_dropped);
+
+  /* disconnect like a station, the switch flushes the addresses learned on the replay ports */
+  kill(get_switch_pid(), SIGUSR1);
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    if(replay_ports & (1u << i))
+    {
+      mq_close(mq_send_fd[i]);
+      mq_close(mq_recv_fd[i]);
+    }
+  }
+  close_port_stats(0);
+  return 0;
+}
@@ -0,0 +1,320 @@
+/*
+ * File        : sflow.c
+ * Description : sFlow style sampling. Every port thread counts down a random skip (mean sflow_rate, drawn from its
+ *               own xorshift generator) and copies a sampled frame into the port's single-producer ring, so sampling
+ *               takes no lock and costs a decrement per frame. An exporter thread drains the rings, turns the frames
+ *               into flow samples and sends them to the collector, with the port counters every interval.
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "frame.h"
+#include "sflow.h"
+#include "port_stats.h"
+#include "mac_util.h"
+#include "instance.h"
+
+#define MAX_PORTS 4
+/* sampled frames waiting for the exporter, per port, a power of two */
+#define SFLOW_RING_SIZE 256
+#define SFLOW_POLL_NS 10000000L
+
+typedef struct sflow_slot
+{
+  char frame[FRAME_SIZE];
+  unsigned long long pool;
+} sflow_slot_t;
+
+/* written by the port thread only, except tail */
+typedef struct sflow_port
+{
+  unsigned int rng;                 /* xorshift32 state */
+  unsigned long long head;          /* next slot written by the port thread */
+  unsigned long long tail;          /* next slot read by the exporter */
+  unsigned long long samples;
+  unsigned long long samples_dropped;
+  sflow_slot_t ring[SFLOW_RING_SIZE];
+} sflow_port_t;
+
+volatile unsigned int sflow_rate = 0;
+int sflow_skip[MAX_PORTS];
+
+static sflow_port_t sflow_ports[MAX_PORTS];
+static int sflow_fd = -1;
+static struct sockaddr_in collector_addr;
+static char collector_name[80];
+static unsigned int counter_interval;
+static unsigned int datagrams_sent;
+static volatile int exporter_running = 0;
+static pthread_t exporter_id;
+
+/*
+ * Function    : next_skip
+ * @params     : port -> port whose generator is used
+ * Output      : frames until the next sample, uniform in [1, 2 * sflow_rate - 1] so one in sflow_rate is sampled
+ * */
+static int next_skip(sflow_port_t *port)
+{
+  unsigned int x = port->rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  port->rng = x;
+  unsigned int rate = sflow_rate;
+  return rate <= 1 ? 1 : 1 + x % (2 * rate - 1);
+}
+
+/*
+ * Function    : sflow_sample
+ * @params     : port_index -> port the frame was received on (0 based)
+ *               frame      -> the received frame
+ * Description : Called by the port thread when its skip reaches 0. Copies the frame into the port's ring, or counts
+ *               it as dropped if the exporter is behind, and draws the next skip.
+ * */
+void sflow_sample(int port_index, const char *frame)
+{
+  sflow_port_t *port = &sflow_ports[port_index];
+  sflow_skip[port_index] = next_skip(port);
+  unsigned long long tail = __atomic_load_n(&port->tail, __ATOMIC_ACQUIRE);
+  if(port->head - tail == SFLOW_RING_SIZE)
+  {
+    __atomic_add_fetch(&port->samples_dropped, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  sflow_slot_t *slot = &port->ring[port->head % SFLOW_RING_SIZE];
+  memcpy(slot->frame, frame, FRAME_SIZE);
+  slot->pool = port_stats[port_index].rx_frames;
+  __atomic_store_n(&port->head, port->head + 1, __ATOMIC_RELEASE);
+  __atomic_add_fetch(&port->samples, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Function    : fill_flow_sample
+ * @params     : sample     -> flow sample to fill
+ *               port_index -> port the frame was received on
+ *               slot       -> sampled frame
+ * */
+static void fill_flow_sample(sflow_flow_sample_t *sample, int port_index, const sflow_slot_t *slot)
+{
+  const frame_t *f = (const frame_t *) slot->frame;
+  unsigned long long src = mac_address_value(f->src_mac_address);
+  unsigned long long dest = mac_address_value(f->dest_mac_address);
+  for(int i = 0; i < 6; i++)
+  {
+    sample->src_mac[i] = src >> (8 * (5 - i));
+    sample->dest_mac[i] = dest >> (8 * (5 - i));
+  }
+  sample->vlan_id = f->vlan_id;
+  sample->ethertype = f->ethertype;
+  sample->port_no = port_index + 1;
+  sample->priority = f->priority;
+  sample->flags = f->flags;
+  sample->reserved = 0;
+  sample->rate = sflow_rate;
+  sample->pool = slot->pool;
+}
+
+/*
+ * Function    : send_datagram
+ * @params     : datagram -> header followed by the samples and counters
+ *               header   -> header of the datagram, its counts are filled
+ *               len      -> length of the datagram
+ *               start    -> time sampling was started
+ * Description : A collector that is not running only loses the datagram
+ * */
+static void send_datagram(char *datagram, sflow_datagram_header_t *header, int len, const struct timespec *start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  header->magic = SFLOW_MAGIC;
+  header->switch_id = get_switch_instance();
+  header->seq = ++datagrams_sent;
+  header->uptime_ms = (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+  memcpy(datagram, header, sizeof(*header));
+  sendto(sflow_fd, datagram, len, 0, (struct sockaddr *) &collector_addr, sizeof(collector_addr));
+}
+
+/*
+ * Function    : sflow_exporter
+ * @params     : arg -> unused
+ * Description : Drains the sample rings into datagrams, sent when full or every poll, and adds the port counters
+ *               every counter_interval seconds
+ * */
+static void *sflow_exporter(void *arg)
+{
+  /* switch signals are handled by the menu thread */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGUSR1);
+  sigaddset(&set, SIGHUP);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  char datagram[sizeof(sflow_datagram_header_t) + SFLOW_MAX_SAMPLES * sizeof(sflow_flow_sample_t) +
+                MAX_PORTS * sizeof(sflow_counter_sample_t)];
+  sflow_datagram_header_t header;
+  struct timespec start, now, last_counters;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  last_counters = start;
+
+  while(exporter_running)
+  {
+    memset(&header, 0, sizeof(header));
+    int len = sizeof(header);
+    for(int i = 0; i < MAX_PORTS; i++)
+    {
+      sflow_port_t *port = &sflow_ports[i];
+      unsigned long long head = __atomic_load_n(&port->head, __ATOMIC_ACQUIRE);
+      while(port->tail != head)
+      {
+        fill_flow_sample((sflow_flow_sample_t *) (datagram + len), i, &port->ring[port->tail % SFLOW_RING_SIZE]);
+        len += sizeof(sflow_flow_sample_t);
+        __atomic_store_n(&port->tail, port->tail + 1, __ATOMIC_RELEASE);
+        if(++header.sample_count == SFLOW_MAX_SAMPLES)
+        {
+          send_datagram(datagram, &header, len, &start);
+          memset(&header, 0, sizeof(header));
+          len = sizeof(header);
+        }
+      }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if(now.tv_sec - last_counters.tv_sec >= counter_interval)
+    {
+      last_counters = now;
+      for(int i = 0; i < MAX_PORTS; i++)
+      {
+        sflow_counter_sample_t *counters = (sflow_counter_sample_t *) (datagram + len);
+        counters->port_no = i + 1;
+        counters->reserved = 0;
+        counters->rx_frames = port_stats[i].rx_frames;
+        counters->rx_dropped = port_stats[i].rx_dropped;
+        counters->rx_flooded = port_stats[i].rx_flooded;
+        counters->tx_frames = port_stats[i].tx_frames;
+        counters->samples_dropped = sflow_ports[i].samples_dropped;
+        len += sizeof(sflow_counter_sample_t);
+        header.counter_count++;
+      }
+    }
+    if(header.sample_count || header.counter_count)
+    {
+      send_datagram(datagram, &header, len, &start);
+    }
+    struct timespec poll = {0, SFLOW_POLL_NS};
+    nanosleep(&poll, NULL);
+  }
+  return NULL;
+}
+
+/*
+ * Function    : start_sflow
+ * @params     : rate      -> 1 in rate frames is sampled
+ *               collector -> "HOST:PORT" or "HOST" of the collector (default port SFLOW_DEFAULT_PORT)
+ *               interval  -> seconds between port counter exports
+ * Output      : 0 -> sampling started, -1 -> invalid collector or socket error
+ * Description : Restarts sampling with the new settings if it is already running
+ * */
+int start_sflow(unsigned int rate, const char *collector, unsigned int interval)
+{
+  char host[64];
+  int port = SFLOW_DEFAULT_PORT;
+  snprintf(host, sizeof(host), "%s", collector);
+  char *colon = strchr(host, ':');
+  if(colon)
+  {
+    *colon = '\0';
+    port = atoi(colon + 1);
+  }
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if(port < 1 || port > 65535 || inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+  {
+    printf("Error: Invalid collector address %s\n", collector);
+    return -1;
+  }
+
+  stop_sflow();
+  sflow_fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if(sflow_fd == -1)
+  {
+    perror("Error in socket()");
+    return -1;
+  }
+  collector_addr = addr;
+  snprintf(collector_name, sizeof(collector_name), "%s:%d", host, port);
+  counter_interval = interval;
+  datagrams_sent = 0;
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    /* head and tail only move forward, samples left by a previous exporter are exported by this one */
+    sflow_ports[i].rng = 2463534242u ^ (i * 0x9e3779b9u) ^ (unsigned int) time(NULL);
+    sflow_ports[i].samples = sflow_ports[i].samples_dropped = 0;
+  }
+
+  exporter_running = 1;
+  if(pthread_create(&exporter_id, NULL, sflow_exporter, NULL) != 0)
+  {
+    perror("Error in pthread_create()");
+    exporter_running = 0;
+    close(sflow_fd);
+    sflow_fd = -1;
+    return -1;
+  }
+  /* the port threads start counting down with their first skip */
+  sflow_rate = rate;
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    sflow_skip[i] = next_skip(&sflow_ports[i]);
+  }
+  return 0;
+}
+
+/*
+ * Function    : stop_sflow
+ * Description : Stops sampling and the exporter, samples still in the rings are not exported
+ * */
+void stop_sflow()
+{
+  sflow_rate = 0;
+  if(!exporter_running)
+  {
+    return;
+  }
+  exporter_running = 0;
+  pthread_join(exporter_id, NULL);
+  close(sflow_fd);
+  sflow_fd = -1;
+}
+
+/*
+ * Function    : display_sflow
+ * Description : Displays the sampling settings and the samples taken per port
+ * */
+void display_sflow()
+{
+  if(!exporter_running)
+  {
+    printf("\nsFlow sampling is disabled\n");
+    return;
+  }
+  printf("\nsFlow: 1 in %u frames sampled, exported to %s, counters every %u s, %u datagrams sent\n", sflow_rate,
+         collector_name, counter_interval, datagrams_sent);
+  printf("+------+------------+------------+\n");
+  printf("| PORT |   SAMPLES  |   DROPPED  |\n");
+  printf("+------+------------+------------+\n");
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    printf("|  %d   | %10llu | %10llu |\n", i + 1, sflow_ports[i].samples, sflow_ports[i].samples_dropped);
+  }
+  printf("+------+------------+------------+\n");
+}
@@ -0,0 +1,66 @@
+#ifndef SFLOW_H
+#define SFLOW_H
+
+/*
+ * File        : sflow.h
+ * Description : sFlow style sampling. One in sflow_rate frames received on a port is sampled at random, and the
+ *               samples and the port counters are exported as UDP datagrams to a collector (sflow_collector.c).
+ *               Datagrams are in host byte order, collector and switch run on the same machine.
+ * */
+
+#define SFLOW_MAGIC 0x56534631 /* "VSF1" */
+#define SFLOW_DEFAULT_PORT 6343
+/* samples of a datagram, it is sent earlier if the export interval is over */
+#define SFLOW_MAX_SAMPLES 32
+
+typedef struct sflow_datagram_header
+{
+  unsigned int magic;
+  unsigned int switch_id;
+  unsigned int seq;             /* datagram sequence number, a gap means lost datagrams */
+  unsigned int uptime_ms;       /* since sampling was started */
+  unsigned short sample_count;  /* sflow_flow_sample_t following the header */
+  unsigned short counter_count; /* sflow_counter_sample_t following the samples */
+} sflow_datagram_header_t;
+
+typedef struct sflow_flow_sample
+{
+  unsigned char src_mac[6];
+  unsigned char dest_mac[6];
+  unsigned short vlan_id;       /* tag of the frame, 0 when untagged */
+  unsigned short ethertype;
+  unsigned char port_no;
+  unsigned char priority;
+  unsigned char flags;          /* FRAME_FLAG_* */
+  unsigned char reserved;
+  unsigned int rate;            /* 1 in rate frames is sampled */
+  unsigned long long pool;      /* frames received on the port so far */
+} sflow_flow_sample_t;
+
+typedef struct sflow_counter_sample
+{
+  unsigned int port_no;
+  unsigned int reserved;
+  unsigned long long rx_frames;
+  unsigned long long rx_dropped;
+  unsigned long long rx_flooded;
+  unsigned long long tx_frames;
+  unsigned long long samples_dropped; /* samples lost because the exporter fell behind */
+} sflow_counter_sample_t;
+
+extern volatile unsigned int sflow_rate;
+extern int sflow_skip[4];
+
+/* the port thread counts down a random skip and only samples when it reaches 0, no lock and no call otherwise */
+#define SFLOW_SAMPLE(port_index, frame) \
+  do { \
+    if(sflow_rate && --sflow_skip[port_index] <= 0) \
+      sflow_sample(port_index, frame); \
+  } while(0)
+
+int start_sflow(unsigned int rate, const char *collector, unsigned int interval);
+void stop_sflow();
+void sflow_sample(int port_index, const char *frame);
+void display_sflow();
+
+#endif
@@ -0,0 +1,239 @@
+/*
+ * File        : sflow_collector.c
+ * Description : Reference collector for the switch's sFlow style datagrams. Every flow sample stands for rate frames
+ *               of its conversation (source, destination, vlan), so the collector adds rate per sample and displays
+ *               the top conversations with their estimated frame counts and share of the traffic, and the last port
+ *               counters, every report interval.
+ *               Build: gcc -O2 -o sflow_collector sflow_collector.c
+ *               Usage: ./sflow_collector [-p <UDP_PORT>] [-i <REPORT_SECONDS>] [-k <TOP_K>]
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "sflow.h"
+
+#define MAX_PORTS 4
+/* conversations kept, a power of two, the table is reset when it is full */
+#define CONVERSATION_TABLE_SIZE 65536
+
+typedef struct conversation
+{
+  unsigned long long key;  /* 0 -> free slot */
+  unsigned char src_mac[6];
+  unsigned char dest_mac[6];
+  unsigned short vlan_id;
+  unsigned long long samples;
+  unsigned long long frames; /* estimated, sum of the rates of its samples */
+} conversation_t;
+
+static conversation_t conversations[CONVERSATION_TABLE_SIZE];
+static unsigned int conversation_count;
+static unsigned long long total_frames, total_samples, datagrams, lost_datagrams;
+static unsigned int last_seq;
+static sflow_counter_sample_t last_counters[MAX_PORTS];
+
+/*
+ * Function    : conversation_key
+ * @params     : sample -> flow sample
+ * Output      : hash of the sample's source, destination and vlan, never 0
+ * */
+static unsigned long long conversation_key(const sflow_flow_sample_t *sample)
+{
+  unsigned long long hash_value = 14695981039346656037ULL;
+  for(int i = 0; i < 6; i++)
+  {
+    hash_value = (hash_value ^ sample->src_mac[i]) * 1099511628211ULL;
+    hash_value = (hash_value ^ sample->dest_mac[i]) * 1099511628211ULL;
+  }
+  hash_value = (hash_value ^ sample->vlan_id) * 1099511628211ULL;
+  return hash_value ? hash_value : 1;
+}
+
+/*
+ * Function    : add_sample
+ * @params     : sample -> flow sample of a datagram
+ * Description : Adds the sample's rate to its conversation
+ * */
+static void add_sample(const sflow_flow_sample_t *sample)
+{
+  unsigned long long key = conversation_key(sample);
+  unsigned int slot = key & (CONVERSATION_TABLE_SIZE - 1);
+  while(conversations[slot].key && (conversations[slot].key != key ||
+        memcmp(conversations[slot].src_mac, sample->src_mac, 6) || memcmp(conversations[slot].dest_mac, sample->dest_mac, 6) ||
+        conversations[slot].vlan_id != sample->vlan_id))
+  {
+    slot = (slot + 1) & (CONVERSATION_TABLE_SIZE - 1);
+  }
+  conversation_t *c = &conversations[slot];
+  if(c->key == 0)
+  {
+    /* keep the table at most three quarters full */
+    if(conversation_count == CONVERSATION_TABLE_SIZE / 4 * 3)
+    {
+      printf("Conversation table is full, starting over\n");
+      memset(conversations, 0, sizeof(conversations));
+      conversation_count = 0;
+      add_sample(sample);
+      return;
+    }
+    c->key = key;
+    memcpy(c->src_mac, sample->src_mac, 6);
+    memcpy(c->dest_mac, sample->dest_mac, 6);
+    c->vlan_id = sample->vlan_id;
+    conversation_count++;
+  }
+  c->samples++;
+  c->frames += sample->rate;
+  total_samples++;
+  total_frames += sample->rate;
+}
+
+/*
+ * Function    : compare_frames
+ * Output      : orders conversations by decreasing estimated frames
+ * */
+static int compare_frames(const void *a, const void *b)
+{
+  const conversation_t *x = *(const conversation_t * const *) a, *y = *(const conversation_t * const *) b;
+  return x->frames < y->frames ? 1 : x->frames > y->frames ? -1 : 0;
+}
+
+/*
+ * Function    : report
+ * @params     : top_k -> conversations displayed
+ * Description : Displays the top conversations and the last port counters
+ * */
+static void report(int top_k)
+{
+  static conversation_t *sorted[CONVERSATION_TABLE_SIZE];
+  int n = 0;
+  for(int i = 0; i < CONVERSATION_TABLE_SIZE; i++)
+  {
+    if(conversations[i].key)
+    {
+      sorted[n++] = &conversations[i];
+    }
+  }
+  qsort(sorted, n, sizeof(sorted[0]), compare_frames);
+
+  printf("\n%llu datagrams (%llu lost), %llu samples, ~%llu frames in %u conversations\n", datagrams, lost_datagrams,
+         total_samples, total_frames, conversation_count);
+  printf("+-------------------+-------------------+------+--------------+----------+--------+\n");
+  printf("|       SOURCE      |    DESTINATION    | VLAN |  EST. FRAMES |  SAMPLES |  SHARE |\n");
+  printf("+-------------------+-------------------+------+--------------+----------+--------+\n");
+  for(int i = 0; i < n && i < top_k; i++)
+  {
+    const unsigned char *s = sorted[i]->src_mac, *d = sorted[i]->dest_mac;
+    printf("| %02X:%02X:%02X:%02X:%02X:%02X | %02X:%02X:%02X:%02X:%02X:%02X | %4u | %12llu | %8llu | %5.1f%% |\n",
+           s[0], s[1], s[2], s[3], s[4], s[5], d[0], d[1], d[2], d[3], d[4], d[5], sorted[i]->vlan_id,
+           sorted[i]->frames, sorted[i]->samples, 100.0 * sorted[i]->frames / total_frames);
+  }
+  printf("+-------------------+-------------------+------+--------------+----------+--------+\n");
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    if(last_counters[i].port_no)
+    {
+      printf("port %d: rx %llu, tx %llu, dropped %llu, flooded %llu, samples lost %llu\n", i + 1,
+             last_counters[i].rx_frames, last_counters[i].tx_frames, last_counters[i].rx_dropped,
+             last_counters[i].rx_flooded, last_counters[i].samples_dropped);
+    }
+  }
+  fflush(stdout);
+}
+
+/*
+ * Function    : main
+ * @params     : argc -> count of command line arguments
+ *               argv -> string array of all command line arguments
+ * Description : Receives datagrams and reports every interval
+ * */
+int main(int argc, char *argv[])
+{
+  int port = SFLOW_DEFAULT_PORT, interval = 5, top_k = 10;
+  for(int i = 1; i < argc; i++)
+  {
+    if(strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+      port = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+      interval = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+      top_k = atoi(argv[++i]);
+    else
+    {
+      printf("Usage: ./sflow_collector [-p <UDP_PORT>] [-i <REPORT_SECONDS>] [-k <TOP_K>]\n");
+      return EXIT_FAILURE;
+    }
+  }
+  if(port < 1 || port > 65535 || interval < 1 || top_k < 1)
+  {
+    printf("Error: Invalid option value\n");
+    return EXIT_FAILURE;
+  }
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if(fd == -1 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1)
+  {
+    perror("Error in bind()");
+    return EXIT_FAILURE;
+  }
+  /* wake up for the report even when no datagram arrives */
+  struct timeval timeout = {1, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  printf("Collecting on udp port %d\n", port);
+  fflush(stdout);
+
+  time_t next_report = time(NULL) + interval;
+  char datagram[65536];
+  while(1)
+  {
+    ssize_t len = recv(fd, datagram, sizeof(datagram), 0);
+    if(len >= (ssize_t) sizeof(sflow_datagram_header_t))
+    {
+      sflow_datagram_header_t header;
+      memcpy(&header, datagram, sizeof(header));
+      size_t expected = sizeof(header) + header.sample_count * sizeof(sflow_flow_sample_t) +
+                        header.counter_count * sizeof(sflow_counter_sample_t);
+      if(header.magic == SFLOW_MAGIC && (size_t) len == expected)
+      {
+        datagrams++;
+        /* a restarted exporter starts again at 1 */
+        if(last_seq && header.seq > last_seq + 1)
+        {
+          lost_datagrams += header.seq - last_seq - 1;
+        }
+        last_seq = header.seq;
+        char *p = datagram + sizeof(header);
+        for(int i = 0; i < header.sample_count; i++, p += sizeof(sflow_flow_sample_t))
+        {
+          sflow_flow_sample_t sample;
+          memcpy(&sample, p, sizeof(sample));
+          add_sample(&sample);
+        }
+        for(int i = 0; i < header.counter_count; i++, p += sizeof(sflow_counter_sample_t))
+        {
+          sflow_counter_sample_t counters;
+          memcpy(&counters, p, sizeof(counters));
+          if(counters.port_no >= 1 && counters.port_no <= MAX_PORTS)
+          {
+            last_counters[counters.port_no - 1] = counters;
+          }
+        }
+      }
+    }
+    if(time(NULL) >= next_report)
+    {
+      report(top_k);
+      next_report = time(NULL) + interval;
+    }
+  }
+}
@@ -0,0 +1,437 @@
+/*
+ * File        : shm_pages.c
+ * Description : Maps the shared memories with the page policy of the switch. Huge pages come from the first hugetlbfs
+ *               mount, where the shared memory is a file of the same name, or else are asked for as transparent huge
+ *               pages of the /dev/shm shared memory. Prefaulting and locking follow the huge page hint so that the
+ *               pages faulted in are the huge ones. Every step that fails falls back and says so, the switch runs with
+ *               whatever pages it got. display_shm_pages() reports what was obtained, as the kernel accounts it.
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+
+#include "shm_pages.h"
+
+#define _FLAGS O_RDWR | O_CREAT
+
+#define SHM_PAGES_MAX 16
+#define THP_SIZE_FILE "/sys/kernel/mm/transparent_hugepage/hpage_pmd_size"
+#define THP_DEFAULT_SIZE (2UL * 1024 * 1024)
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_READ 22
+#define MADV_POPULATE_WRITE 23
+#endif
+
+/* a shared memory mapped by this process */
+typedef struct shm_mapping
+{
+  char name[64];
+  void *ptr;
+  size_t size;        /* mapped, rounded up to the huge page size */
+  size_t page_size;   /* huge page size asked for, 0 for normal pages */
+  int hugetlbfs;      /* 1 -> file of the hugetlbfs mount, 0 -> /dev/shm */
+  int locked;         /* 1 -> locked, -1 -> mlock() failed */
+} shm_mapping_t;
+
+static int page_policy = 0;
+static shm_mapping_t mappings[SHM_PAGES_MAX];
+
+/* hugetlbfs mount, looked up once */
+static int hugetlbfs_checked = 0;
+static char hugetlbfs_dir[256];
+static size_t hugetlbfs_page_size;
+
+/*
+ * Function    : set_shm_page_policy
+ * @params     : policy -> SHM_PAGES_* flags for the shared memories mapped from now on
+ * */
+void set_shm_page_policy(int policy)
+{
+  page_policy = policy;
+}
+
+int get_shm_page_policy()
+{
+  return page_policy;
+}
+
+/*
+ * Function    : find_hugetlbfs
+ * Output      : the directory hugetlbfs is mounted on, NULL if there is none
+ * */
+static const char *find_hugetlbfs()
+{
+  if(!hugetlbfs_checked)
+  {
+    hugetlbfs_checked = 1;
+    FILE *mounts = fopen("/proc/mounts", "r");
+    char device[256], dir[256], type[64];
+    while(mounts && fscanf(mounts, "%255s %255s %63s %*[^\n]", device, dir, type) == 3)
+    {
+      struct statfs fs;
+      if(strcmp(type, "hugetlbfs") == 0 && statfs(dir, &fs) == 0)
+      {
+        snprintf(hugetlbfs_dir, sizeof(hugetlbfs_dir), "%s", dir);
+        hugetlbfs_page_size = fs.f_bsize;
+        break;
+      }
+    }
+    if(mounts)
+      fclose(mounts);
+  }
+  return hugetlbfs_dir[0] ? hugetlbfs_dir : NULL;
+}
+
+/*
+ * Function    : hugetlbfs_path
+ * @params     : name -> shared memory name, starting with '/'
+ *               path -> buffer for the file of the hugetlbfs mount
+ * Output      : 0 -> path built, -1 -> no hugetlbfs mount
+ * */
+static int hugetlbfs_path(const char *name, char *path, int size)
+{
+  const char *dir = find_hugetlbfs();
+  if(!dir)
+    return -1;
+  snprintf(path, size, "%s%s", dir, name);
+  return 0;
+}
+
+/*
+ * Function    : thp_size
+ * Output      : size of a transparent huge page
+ * */
+static size_t thp_size()
+{
+  unsigned long size = 0;
+  FILE *f = fopen(THP_SIZE_FILE, "r");
+  if(f)
+  {
+    if(fscanf(f, "%lu", &size) != 1)
+      size = 0;
+    fclose(f);
+  }
+  return size ? size : THP_DEFAULT_SIZE;
+}
+
+static size_t round_up(size_t size, size_t page_size)
+{
+  return (size + page_size - 1) / page_size * page_size;
+}
+
+/*
+ * Function    : grow
+ * @params     : fd   -> shared memory
+ *               size -> size it needs at least
+ * Description : Only ever grows the shared memory, a process mapping it with normal pages must not cut the huge page
+ *               the switch rounded it up to
+ * */
+static int grow(int fd, size_t size)
+{
+  struct stat st;
+  if(fstat(fd, &st) == -1)
+  {
+    perror("Error in fstat()");
+    return -1;
+  }
+  if((size_t) st.st_size < size && ftruncate(fd, size) == -1)
+  {
+    perror("Error in ftruncate()");
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Function    : map_aligned
+ * Description : Maps fd at an address aligned to align, so that transparent huge pages can back it
+ * */
+static void *map_aligned(size_t size, size_t align, int prot, int fd)
+{
+  char *area = mmap(NULL, size + align, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if(area == MAP_FAILED)
+    return MAP_FAILED;
+  char *ptr = (char *) (((unsigned long) area + align - 1) & ~(align - 1));
+  if(ptr > area)
+    munmap(area, ptr - area);
+  munmap(ptr + size, area + align - ptr);
+  return mmap(ptr, size, prot, MAP_SHARED | MAP_FIXED, fd, 0);
+}
+
+/*
+ * Function    : prefault
+ * Description : Faults every page in after the huge page hint was given. MADV_POPULATE_* (Linux 5.14) does it in one
+ *               call, older kernels get every page touched.
+ * */
+static void prefault(void *ptr, size_t size, int prot)
+{
+  if(madvise(ptr, size, prot & PROT_WRITE ? MADV_POPULATE_WRITE : MADV_POPULATE_READ) == 0)
+    return;
+  long page = sysconf(_SC_PAGESIZE);
+  for(size_t offset = 0; offset < size; offset += page)
+  {
+    char *p = (char *) ptr + offset;
+    if(prot & PROT_WRITE)
+      __atomic_fetch_or(p, 0, __ATOMIC_RELAXED);   /* a write fault that can not lose a store of another process */
+    else
+      (void) *(volatile char *) p;
+  }
+}
+
+/*
+ * Function    : open_hugetlbfs
+ * @params     : name   -> shared memory name
+ *               size   -> size needed
+ *               prot   -> PROT_READ or PROT_READ | PROT_WRITE
+ *               create -> 1 to create the file when it does not exist
+ *               m      -> filled in when mapped
+ * Output      : the mapping, MAP_FAILED when the shared memory is not on hugetlbfs or no huge page was free
+ * */
+static void *open_hugetlbfs(const char *name, size_t size, int prot, int create, shm_mapping_t *m, int *fd_out)
+{
+  char path[512];
+  if(hugetlbfs_path(name, path, sizeof(path)) == -1)
+    return MAP_FAILED;
+
+  int created = 0, fd = open(path, prot & PROT_WRITE ? O_RDWR : O_RDONLY);
+  if(fd == -1 && errno == ENOENT && create)
+  {
+    fd = open(path, _FLAGS | O_EXCL, 0777);
+    created = fd != -1;
+  }
+  if(fd == -1)
+    return MAP_FAILED;
+
+  size_t mapped = round_up(size, hugetlbfs_page_size);
+  int flags = MAP_SHARED | (page_policy & SHM_PAGES_PREFAULT ? MAP_POPULATE : 0);
+  void *ptr = MAP_FAILED;
+  if(!(prot & PROT_WRITE) || grow(fd, mapped) == 0)
+    ptr = mmap(NULL, mapped, prot, flags, fd, 0);
+  if(ptr == MAP_FAILED)
+  {
+    /* the huge pages are reserved when mapped, ENOMEM means none are free */
+    printf("Shared memory %s: no huge pages from %s (%s), using /dev/shm\n", name, hugetlbfs_dir,
+           strerror(errno));
+    close(fd);
+    if(created)
+      unlink(path);
+    return MAP_FAILED;
+  }
+  m->size = mapped;
+  m->page_size = hugetlbfs_page_size;
+  m->hugetlbfs = 1;
+  *fd_out = fd;
+  return ptr;
+}
+
+/*
+ * Function    : shm_map
+ * @params     : name -> shared memory name, as given to shm_open()
+ *               size -> size of the shared memory
+ *               prot -> PROT_READ | PROT_WRITE to create the shared memory if needed, PROT_READ to only attach to it
+ *               fd   -> set to the shared memory's fd, may be NULL
+ * Output      : the mapping, MAP_FAILED on error
+ * Description : Attaches to the shared memory wherever it is, creating it with the page policy if it does not exist.
+ *               A shared memory on hugetlbfs is used whatever the policy, so processes that only attach follow the
+ *               switch. With SHM_PAGES_HUGE a new one is created on hugetlbfs, if mounted with free huge pages, else
+ *               in /dev/shm with a transparent huge page hint. SHM_PAGES_PREFAULT and SHM_PAGES_LOCK then fault in
+ *               and lock every page of it.
+ * */
+void *shm_map(const char *name, size_t size, int prot, int *fd)
+{
+  shm_mapping_t m;
+  memset(&m, 0, sizeof(m));
+  snprintf(m.name, sizeof(m.name), "%s", name);
+  int shm_fd = -1, writable = (prot & PROT_WRITE) != 0;
+
+  void *ptr = open_hugetlbfs(name, size, prot, writable && (page_policy & SHM_PAGES_HUGE), &m, &shm_fd);
+  if(ptr == MAP_FAILED)
+  {
+    shm_fd = shm_open(name, writable ? _FLAGS : O_RDONLY, 0777);
+    if(shm_fd == -1)
+    {
+      perror("Error in shm_open()");
+      return MAP_FAILED;
+    }
+
+    if(page_policy & SHM_PAGES_HUGE)
+    {
+      /* a transparent huge page needs the whole aligned huge page within the shared memory */
+      m.page_size = thp_size();
+      m.size = round_up(size, m.page_size);
+      if(writable && grow(shm_fd, m.size) == -1)
+      {
+        close(shm_fd);
+        return MAP_FAILED;
+      }
+      ptr = map_aligned(m.size, m.page_size, prot, shm_fd);
+      if(ptr != MAP_FAILED && madvise(ptr, m.size, MADV_HUGEPAGE) == -1)
+        printf("Shared memory %s: no transparent huge pages (%s), using normal pages\n", name, strerror(errno));
+      if(ptr != MAP_FAILED && (page_policy & SHM_PAGES_PREFAULT))
+        prefault(ptr, m.size, prot);
+    }
+    else
+    {
+      m.size = size;
+      if(writable && grow(shm_fd, m.size) == -1)
+      {
+        close(shm_fd);
+        return MAP_FAILED;
+      }
+      int flags = MAP_SHARED | (page_policy & SHM_PAGES_PREFAULT ? MAP_POPULATE : 0);
+      ptr = mmap(NULL, m.size, prot, flags, shm_fd, 0);
+    }
+    if(ptr == MAP_FAILED)
+    {
+      perror("Error in mmap()");
+      close(shm_fd);
+      return MAP_FAILED;
+    }
+  }
+
+  if(page_policy & SHM_PAGES_LOCK)
+  {
+    m.locked = 1;
+    if(mlock(ptr, m.size) == -1)
+    {
+      printf("Shared memory %s: pages not locked (%s), raise the memlock limit (ulimit -l)\n", name, strerror(errno));
+      m.locked = -1;
+    }
+  }
+
+  m.ptr = ptr;
+  for(int i = 0; i < SHM_PAGES_MAX; i++)
+  {
+    if(!mappings[i].ptr)
+    {
+      mappings[i] = m;
+      break;
+    }
+  }
+  if(fd)
+    *fd = shm_fd;
+  return ptr;
+}
+
+/*
+ * Function    : shm_unmap
+ * @params     : ptr  -> mapping returned by shm_map()
+ *               size -> size given to shm_map()
+ * Description : Unmaps the shared memory with the size it was really mapped with
+ * */
+void shm_unmap(void *ptr, size_t size)
+{
+  if(!ptr)
+    return;
+  for(int i = 0; i < SHM_PAGES_MAX; i++)
+  {
+    if(mappings[i].ptr == ptr)
+    {
+      size = mappings[i].size;
+      mappings[i].ptr = NULL;
+      break;
+    }
+  }
+  munmap(ptr, size);
+}
+
+/*
+ * Function    : shm_remove
+ * @params     : name -> shared memory name
+ * Description : Unlinks the shared memory, from hugetlbfs and /dev/shm
+ * */
+void shm_remove(const char *name)
+{
+  char path[512];
+  if(hugetlbfs_path(name, path, sizeof(path)) == 0)
+    unlink(path);
+  shm_unlink(name);
+}
+
+/*
+ * Function    : smaps_usage
+ * @params     : ptr -> start of a mapping of this process
+ * Description : Reads the kB of the mapping that are resident, in transparent huge pages, in hugetlbfs pages and
+ *               locked, from /proc/self/smaps
+ * */
+static void smaps_usage(void *ptr, unsigned long *rss, unsigned long *thp, unsigned long *hugetlb,
+                        unsigned long *locked)
+{
+  *rss = *thp = *hugetlb = *locked = 0;
+  FILE *smaps = fopen("/proc/self/smaps", "r");
+  if(!smaps)
+    return;
+  char line[256], key[64];
+  unsigned long start, end, kb;
+  int found = 0;
+  while(fgets(line, sizeof(line), smaps))
+  {
+    if(sscanf(line, "%lx-%lx ", &start, &end) == 2)
+    {
+      if(found)
+        break;
+      found = start == (unsigned long) ptr;
+      continue;
+    }
+    if(!found || sscanf(line, "%63[^:]: %lu kB", key, &kb) != 2)
+      continue;
+    if(strcmp(key, "Rss") == 0)
+      *rss = kb;
+    else if(strcmp(key, "ShmemPmdMapped") == 0 || strcmp(key, "FilePmdMapped") == 0)
+      *thp += kb;
+    else if(strcmp(key, "Shared_Hugetlb") == 0 || strcmp(key, "Private_Hugetlb") == 0)
+      *hugetlb += kb;
+    else if(strcmp(key, "Locked") == 0)
+      *locked = kb;
+  }
+  fclose(smaps);
+}
+
+/*
+ * Function    : display_shm_pages
+ * Description : Displays the page policy and, for every shared memory mapped, the pages it really got: their size,
+ *               how much is resident and how much is locked
+ * */
+void display_shm_pages()
+{
+  printf("Shared memory pages:%s%s%s%s\n", page_policy & SHM_PAGES_HUGE ? " huge" : "",
+         page_policy & SHM_PAGES_PREFAULT ? " prefaulted" : "", page_policy & SHM_PAGES_LOCK ? " locked" : "",
+         page_policy ? "" : " normal, faulted in on first use");
+  printf("+----------------------+----------+-----------+---------+-------------+-----------+\n");
+  printf("| SHARED MEMORY        |  SIZE kB | PAGES     | PAGE kB | RESIDENT kB | LOCKED kB |\n");
+  printf("+----------------------+----------+-----------+---------+-------------+-----------+\n");
+  for(int i = 0; i < SHM_PAGES_MAX; i++)
+  {
+    shm_mapping_t *m = &mappings[i];
+    if(!m->ptr)
+      continue;
+    unsigned long rss, thp, hugetlb, locked;
+    smaps_usage(m->ptr, &rss, &thp, &hugetlb, &locked);
+    const char *pages = "normal";
+    unsigned long page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    if(m->hugetlbfs)
+    {
+      /* hugetlbfs pages are never swapped, mlock() leaves them out of Locked */
+      pages = "hugetlbfs";
+      page_kb = m->page_size / 1024;
+      rss += hugetlb;
+      if(m->locked == 1)
+        locked = hugetlb;
+    }
+    else if(thp)
+    {
+      pages = "THP";
+      page_kb = m->page_size / 1024;
+    }
+    printf("| %-20.20s | %8lu | %-9s | %7lu | %11lu | %9lu |\n", m->name, (unsigned long) m->size / 1024, pages,
+           page_kb, rss, locked);
+  }
+  printf("+----------------------+----------+-----------+---------+-------------+-----------+\n");
+}
@@ -0,0 +1,29 @@
+#ifndef SHM_PAGES_H
+#define SHM_PAGES_H
+
+/*
+ * File        : shm_pages.h
+ * Description : Opening and mapping of the switch's shared memories. By default a shared memory is a POSIX shared
+ *               memory with normal pages, mapped on first touch. With the page policy of the switch (-M) it is backed
+ *               by huge pages when it can be, from a hugetlbfs mount or else as transparent huge pages of /dev/shm, is
+ *               prefaulted when mapped and locked in memory, so forwarding never takes a page fault or a TLB miss per
+ *               4 kB on it. Whatever can not be obtained falls back to what the system gives. Processes that only
+ *               attach (stations, replay, flight_dump) find a shared memory wherever the switch created it.
+ * */
+
+#include <stddef.h>
+
+/* page policy */
+#define SHM_PAGES_HUGE 0x01      /* huge pages: hugetlbfs, else transparent huge pages */
+#define SHM_PAGES_PREFAULT 0x02  /* every page is allocated and mapped before use */
+#define SHM_PAGES_LOCK 0x04      /* pages are locked in memory */
+#define SHM_PAGES_ALL (SHM_PAGES_HUGE | SHM_PAGES_PREFAULT | SHM_PAGES_LOCK)
+
+void set_shm_page_policy(int policy);
+int get_shm_page_policy();
+void *shm_map(const char *name, size_t size, int prot, int *fd);
+void shm_unmap(void *ptr, size_t size);
+void shm_remove(const char *name);
+void display_shm_pages();
+
+#endif
@@ -0,0 +1,322 @@
+/*
+ * File        : sim.c
+ * Description : Discrete event simulator of the forwarding core. Simulated hosts spread over the 4 ports send frames
+ *               at exponentially distributed intervals of simulated time, to a random host, to broadcast or to an
+ *               unknown address. Every host sends at the same rate, so the frames of all hosts are one Poisson stream
+ *               of hosts * rate frames per second whose sender is a uniformly drawn host, and the next event is drawn
+ *               in constant time whatever the number of hosts. Every event runs forward_frame() on the frame as a port
+ *               thread would and the frame's deliveries are counted per port. There are no mqueues, processes or
+ *               threads, so the run measures the forwarding decision alone. The same seed gives the same frames and
+ *               decisions, summed up in a digest that must not change unless forwarding does. -a installs an ACL of
+ *               that many deny rules on every port, for address pairs and an address block no host uses, so the
+ *               digest stays the same and the rate shows the cost of the ACL. -c limits the unicast frames of every
+ *               host to that many conversations, drawn at start, where by default every frame goes to a random host.
+ *               -S polices the broadcasts of every port with storm control and -L limits the new addresses every port
+ *               learns per second. Both run on the simulated time of the frames, so they drop the same frames in
+ *               every run of a seed.
+ *               Frames are drawn SIM_BATCH at a time and then forwarded, only the forwarding is timed for the rate, the
+ *               drawing (random numbers, the exponential interval, copying addresses) takes about as long again with
+ *               few hosts and is reported apart.
+ *               Build: gcc -O2 -o sim sim.c forward.c hash_mac_table.c vlan.c lag.c multicast_table.c storm_control.c mac_util.c acl.c classify.c
+ *                      mac_learning.c -lpthread -lm
+ *               Usage: ./sim [-s <SEED>] [-H <HOSTS>] [-n <FRAMES>] [-r <FRAMES_PER_S_PER_HOST>] [-b <BROADCAST_%>] [-u <UNKNOWN_%>]
+ *                            [-a <ACL_RULES>] [-c <CONVERSATIONS_PER_HOST>] [-S <BROADCASTS_PER_S>] [-L <NEW_ADDRESSES_PER_S>]
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "frame.h"
+#include "forward.h"
+#include "port_stats.h"
+#include "mac_util.h"
+#include "acl.h"
+#include "classify.h"
+#include "mac_learning.h"
+#include "storm_control.h"
+
+#define MAX_PORTS 4
+#define MAX_HOSTS 1000000
+#define MAX_CONVERSATIONS 64
+#define SIM_BATCH 256     /* frames drawn before they are forwarded */
+#define SIM_STORM_BURST_MS 100  /* -S allows bursts of that many ms of its rate */
+
+void init_mac_table();
+void init_vlans();
+void init_lags();
+void init_multicast_table();
+
+/*
+ * Function    : install_acl_rules
+ * @params     : rules -> deny rules per port
+ * Description : One rule for the block 02:03:00:00:00:00/24 and exact (source, destination) rules for addresses
+ *               of that block, no frame of the simulation matches any of them
+ * */
+static void install_acl_rules(int rules)
+{
+  for(int port_no = 1; port_no <= MAX_PORTS; port_no++)
+  {
+    for(int r = 0; r < rules; r++)
+    {
+      acl_rule_t rule;
+      memset(&rule, 0, sizeof(rule));
+      rule.rule_no = r + 1;
+      rule.action = ACL_DENY;
+      rule.src = 0x020300000000ULL | r;
+      rule.src_mask = r ? ACL_MAC_MASK : ACL_MAC_MASK << 24 & ACL_MAC_MASK;
+      rule.dest = 0x020300800000ULL | r;
+      rule.dest_mask = r ? ACL_MAC_MASK : 0;
+      acl_add_rule(port_no, &rule);
+    }
+  }
+}
+
+/* every virtual port is enabled and has a station */
+static port_stats_t sim_port_stats[MAX_PORTS];
+port_stats_t *port_stats = sim_port_stats;
+
+int is_enabled(int port_index)
+{
+  return 1;
+}
+
+pid_t is_connected(int port_index)
+{
+  return 1;
+}
+
+/* simulated time of the frame being forwarded, the clock of the forwarding core */
+static unsigned long long sim_clock_ns;
+
+/*
+ * Function    : sim_now_ns
+ * Output      : simulated time of the frame being forwarded in nanoseconds
+ * */
+static unsigned long long sim_now_ns()
+{
+  return sim_clock_ns;
+}
+
+static char (*host_mac)[18];
+/* with -c, the hosts every host sends its unicast frames to */
+static int *peers;
+static unsigned long long rng_state;
+
+/*
+ * Function    : next_random
+ * Output      : 64 random bits from the seeded xorshift64* generator
+ * */
+static unsigned long long next_random()
+{
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 2685821657736338717ULL;
+}
+
+/*
+ * Function    : next_interval
+ * @params     : rate -> frames per second
+ * Output      : simulated ns until the next frame, exponentially distributed
+ * */
+static unsigned long long next_interval(double rate)
+{
+  /* uniform in (0, 1] */
+  double u = ((next_random() >> 11) + 1) * (1.0 / 9007199254740992.0);
+  return (unsigned long long) (-log(u) / rate * 1e9) + 1;
+}
+
+/*
+ * Function    : main
+ * @params     : argc -> count of command line arguments
+ *               argv -> string array of all command line arguments
+ * Description : Runs the simulation and prints the decisions, the per port deliveries, the rate and the digest
+ * */
+int main(int argc, char *argv[])
+{
+  unsigned long long seed = 1, frames = 10000000;
+  int hosts = 4096, broadcast_percent = 1, unknown_percent = 1, acl_rules = 0, conversations = 0;
+  long storm_rate = 0, learn_limit = 0;
+  double rate = 1000;
+  for(int i = 1; i < argc; i++)
+  {
+    if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+      seed = strtoull(argv[++i], NULL, 10);
+    else if(strcmp(argv[i], "-H") == 0 && i + 1 < argc)
+      hosts = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+      frames = strtoull(argv[++i], NULL, 10);
+    else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+      rate = atof(argv[++i]);
+    else if(strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+      broadcast_percent = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-u") == 0 && i + 1 < argc)
+      unknown_percent = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-a") == 0 && i + 1 < argc)
+      acl_rules = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+      conversations = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-S") == 0 && i + 1 < argc)
+      storm_rate = atol(argv[++i]);
+    else if(strcmp(argv[i], "-L") == 0 && i + 1 < argc)
+      learn_limit = atol(argv[++i]);
+    else
+    {
+      printf("Usage: ./sim [-s <SEED>] [-H <HOSTS>] [-n <FRAMES>] [-r <FRAMES_PER_S_PER_HOST>] [-b <BROADCAST_%%>] [-u <UNKNOWN_%%>] [-a <ACL_RULES>] [-c <CONVERSATIONS_PER_HOST>] [-S <BROADCASTS_PER_S>] [-L <NEW_ADDRESSES_PER_S>]\n");
+      return EXIT_FAILURE;
+    }
+  }
+  if(hosts < 2 || hosts > MAX_HOSTS || rate <= 0 || broadcast_percent < 0 || unknown_percent < 0 ||
+     broadcast_percent + unknown_percent > 100 || acl_rules < 0 || acl_rules > MAX_ACL_RULES ||
+     conversations < 0 || conversations > MAX_CONVERSATIONS || storm_rate < 0 || storm_rate > 100000000 ||
+     learn_limit < 0 || learn_limit > 100000000)
+  {
+    printf("Error: Invalid option value\n");
+    return EXIT_FAILURE;
+  }
+
+  init_mac_table();
+  init_vlans();
+  init_lags();
+  init_multicast_table();
+  init_storm_control();
+  init_mac_learning();
+  init_acls();
+  classify_init();
+  install_acl_rules(acl_rules);
+  set_forward_clock(sim_now_ns);
+  for(int port_no = 1; port_no <= MAX_PORTS; port_no++)
+  {
+    if(storm_rate)
+    {
+      long burst = storm_rate * SIM_STORM_BURST_MS / 1000;
+      set_storm_control(port_no, STORM_BROADCAST, storm_rate, burst ? burst : 1);
+    }
+    set_mac_learning(port_no, LEARN_ENABLED, learn_limit);
+  }
+
+  /* host h is on port h % 4 + 1, its address is 02:00:00 followed by h */
+  host_mac = malloc(hosts * sizeof(*host_mac));
+  if(host_mac == NULL)
+  {
+    perror("Error in malloc()");
+    return EXIT_FAILURE;
+  }
+  rng_state = seed * 0x9e3779b97f4a7c15ULL + 0x632be59bd9b4e019ULL;
+  for(int h = 0; h < hosts; h++)
+  {
+    mac_address_string(0x020000000000ULL | h, host_mac[h]);
+  }
+  if(conversations)
+  {
+    peers = malloc((size_t) hosts * conversations * sizeof(int));
+    if(peers == NULL)
+    {
+      perror("Error in malloc()");
+      return EXIT_FAILURE;
+    }
+    for(int h = 0; h < hosts; h++)
+    {
+      for(int c = 0; c < conversations; c++)
+      {
+        int dest = next_random() % (hosts - 1);
+        peers[h * conversations + c] = dest >= h ? dest + 1 : dest;
+      }
+    }
+  }
+
+  unsigned long long actions[4] = {0}, delivered[MAX_PORTS] = {0}, digest = 14695981039346656037ULL;
+  unsigned long long flow_cache[3] = {0};
+  unsigned long long sim_time_ns = 0;
+  static frame_t batch[SIM_BATCH];
+  static int batch_port[SIM_BATCH];
+  static unsigned long long batch_time[SIM_BATCH];
+  memset(batch, 0, sizeof(batch));
+  double forwarding = 0;
+  struct timespec start, end, forward_start, forward_end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for(unsigned long long n = 0; n < frames; n += SIM_BATCH)
+  {
+    int count = frames - n < SIM_BATCH ? frames - n : SIM_BATCH;
+    for(int k = 0; k < count; k++)
+    {
+      frame_t *f = &batch[k];
+      /* the next frame of any host */
+      sim_time_ns += next_interval(rate * hosts);
+      batch_time[k] = sim_time_ns;
+      int host = next_random() % hosts;
+      batch_port[k] = host % MAX_PORTS + 1;
+
+      /* the frame of the event, to a random other host, broadcast or an address nobody has */
+      unsigned int pick = next_random() % 100;
+      memcpy(f->src_mac_address, host_mac[host], 18);
+      if(pick < (unsigned int) broadcast_percent)
+      {
+        memcpy(f->dest_mac_address, BROADCAST_MAC_ADDRESS, 18);
+      }
+      else if(pick < (unsigned int) (broadcast_percent + unknown_percent))
+      {
+        mac_address_string(0x020100000000ULL | (next_random() & 0xffffffff), f->dest_mac_address);
+      }
+      else if(conversations)
+      {
+        memcpy(f->dest_mac_address, host_mac[peers[host * conversations + next_random() % conversations]], 18);
+      }
+      else
+      {
+        int dest = next_random() % (hosts - 1);
+        memcpy(f->dest_mac_address, host_mac[dest >= host ? dest + 1 : dest], 18);
+      }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &forward_start);
+    for(int k = 0; k < count; k++)
+    {
+      forward_result_t result;
+      sim_clock_ns = batch_time[k];
+      forward_frame(batch_port[k], &batch[k], &result);
+
+      actions[result.action]++;
+      flow_cache[result.flow_cache]++;
+      if(result.action == FORWARD_UNICAST)
+      {
+        delivered[result.dest_port - 1]++;
+      }
+      else if(result.action == FORWARD_FLOOD)
+      {
+        for(int i = 0; i < MAX_PORTS; i++)
+        {
+          delivered[i] += (result.port_mask >> i) & 1;
+        }
+      }
+      digest = (digest ^ (result.action | (result.dest_port & 0xff) << 8 | result.port_mask << 16)) * 1099511628211ULL;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &forward_end);
+    forwarding += (forward_end.tv_sec - forward_start.tv_sec) + (forward_end.tv_nsec - forward_start.tv_nsec) / 1e9;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double wall = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("Simulated %llu frames of %d hosts in %.3f s of simulated time, seed %llu\n", frames, hosts,
+         sim_time_ns / 1e9, seed);
+  printf("Decisions : %llu unicast, %llu flooded, %llu dropped, %llu control\n", actions[FORWARD_UNICAST],
+         actions[FORWARD_FLOOD], actions[FORWARD_DROP], actions[FORWARD_CONTROL]);
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    printf("Port %d    : %llu frames delivered\n", i + 1, delivered[i]);
+  }
+  printf("Flow cache: %llu hits, %llu misses, %.1f%% hit rate\n", flow_cache[FLOW_CACHE_HIT],
+         flow_cache[FLOW_CACHE_MISS], flow_cache[FLOW_CACHE_HIT] + flow_cache[FLOW_CACHE_MISS] ?
+         100.0 * flow_cache[FLOW_CACHE_HIT] / (flow_cache[FLOW_CACHE_HIT] + flow_cache[FLOW_CACHE_MISS]) : 0.0);
+  printf("Forwarding: %.3f s, %.2f M frames/s, %.1f ns per frame\n", forwarding, frames / forwarding / 1e6,
+         forwarding * 1e9 / frames);
+  printf("Wall time : %.3f s, %.1f ns per frame drawing the frames\n", wall, (wall - forwarding) * 1e9 / frames);
+  printf("Digest    : %016llx\n", digest);
+  free(peers);
+  free(host_mac);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+/*
+ * File        : stack.c
+ * Description : Configuration of the stack ports of this switch, see stack.h
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "stack.h"
+#include "instance.h"
+
+#define MAX_PORTS 4
+
+/* switch and port at the other end of every stack port, -1 when the port is not a stack port */
+static int peer_switch[MAX_PORTS];
+static int peer_port[MAX_PORTS];
+
+/*
+ * Function    : init_stack_ports
+ * Description : No port is a stack port until configured with parse_stack_port()
+ * */
+void init_stack_ports()
+{
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    peer_switch[i] = -1;
+    peer_port[i] = -1;
+  }
+}
+
+/*
+ * Function    : parse_stack_port
+ * @params     : arg -> "<PORT>:<PEER_SWITCH>:<PEER_PORT>", argument of -t
+ * Output      : 0 -> stack port configured, -1 -> invalid argument (an error message has been displayed)
+ * */
+int parse_stack_port(const char *arg)
+{
+  int port_no, switch_id, port_of_peer;
+  char end;
+  if(sscanf(arg, "%d:%d:%d%c", &port_no, &switch_id, &port_of_peer, &end) != 3 || port_no < 1 || port_no > MAX_PORTS ||
+     switch_id < 0 || switch_id > MAX_SWITCH_ID || port_of_peer < 1 || port_of_peer > MAX_PORTS)
+  {
+    printf("Error: Invalid stack port %s, expected <PORT>:<PEER_SWITCH>:<PEER_PORT>\n", arg);
+    return -1;
+  }
+  if(switch_id == get_switch_instance())
+  {
+    printf("Error: Port - %d cannot be stacked to its own switch\n", port_no);
+    return -1;
+  }
+  peer_switch[port_no - 1] = switch_id;
+  peer_port[port_no - 1] = port_of_peer;
+  return 0;
+}
+
+/*
+ * Function    : is_stack_port
+ * @params     : port_index -> port (0 based)
+ * Output      : 1 if the port connects to another switch
+ * */
+int is_stack_port(int port_index)
+{
+  return peer_switch[port_index] != -1;
+}
+
+/*
+ * Function    : stack_peer_mq
+ * @params     : port_index -> stack port (0 based)
+ *               buf, size  -> to store the name of the mqueue the peer switch sends the frames for this link to
+ * */
+void stack_peer_mq(int port_index, char *buf, int size)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "/send_mq_port_%d", peer_port[port_index]);
+  switch_instance_name(peer_switch[port_index], name, buf, size);
+}
+
+/*
+ * Function    : display_stack_ports
+ * Description : Displays the stack ports with the switch and port at their other end
+ * */
+void display_stack_ports()
+{
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    if(is_stack_port(i))
+    {
+      printf("Port - %d is stacked to port - %d of switch %d\n", i + 1, peer_port[i], peer_switch[i]);
+    }
+  }
+}
@@ -0,0 +1,17 @@
+#ifndef STACK_H
+#define STACK_H
+
+/*
+ * File        : stack.h
+ * Description : Stack ports connect two switch processes. Switch A's port P is stacked to port Q of switch B when A
+ *               reads the frames B sends to Q, and B reads the frames A sends to P (each side is started with -t).
+ *               Addresses behind the peer are learned on the stack port like the address of a station.
+ * */
+
+void init_stack_ports();
+int parse_stack_port(const char *arg);
+int is_stack_port(int port_index);
+void stack_peer_mq(int port_index, char *buf, int size);
+void display_stack_ports();
+
+#endif
@@ -4,6 +4,20 @@
  * */
 
 #include "switch.h"
+#include "frame.h"
+#include "fcs.h"
+#include "mac_util.h"
+#include "instance.h"
+#include "mac_set.h"
+#include "probes.h"
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#define MAX_GROUPS 16
+#define MAX_VIRTUAL_HOSTS 65536
+/* the virtual hosts' send timer fires every millisecond */
+#define VIRTUAL_TICK_NS 1000000
 
 /* function declarations */
 void connect_port(int, char *);
@@ -14,18 +28,11 @@ pid_t get_switch_pid();
 int init_shared_memories();
 int station_user_menu();
 void init_semaphore(int);
+int transmit(const char *, const char *, unsigned char, const char *, unsigned int, unsigned int);
 
-/* frame structure */
-typedef struct frame
-{
-  char src_mac_address[18];
-  char dest_mac_address[18];
-  char data[28];
-} frame_t;
-
-/* file descriptors to access message queues */
-mqd_t mq_recv_fd;
-mqd_t mq_send_fd;
+/* file descriptors to access message queues, one pair per port of the station */
+mqd_t mq_recv_fd[4];
+mqd_t mq_send_fd[4];
 
 sem_t *s_recv[4];
 sem_t *s_send[4];
@@ -33,90 +40,322 @@ sem_t *s_send[4];
 /* log file names */
 char *station_log[4] = {"log_station1.txt", "log_station2.txt", "log_station3.txt", "log_station4.txt"};
 
-/* buffers related to send frames and receiving frames */
-char recv_buffer[100];
+/* buffer related to send frames, every receiving thread has its own buffer */
 char send_buffer[100];
 /* to store src mac address and dest mac address */
 char src_mac_address[18];
 char dest_mac_address[19];
 int port_no;
-/* thread id*/
-pthread_t id;
+/* ports the station is connected to, port_nos[0] is port_no and the others are added with -l to aggregate them */
+int port_nos[4];
+int port_count = 0;
+/* thread ids, one receiving thread per port */
+pthread_t id[4];
 frame_t f;
 /* to store file descriptor */
 FILE *fptr;
+/* set by -f, append an fcs to every frame sent */
+int use_fcs = 0;
+/* set by -p, priority (0..7) of every frame sent */
+int priority = 0;
+/* set by -v, 802.1Q vlan tag of every frame sent, 0 sends them untagged */
+int vlan_tag = 0;
+/* ping in progress, set by ping_station() and completed by the receiving thread that gets the reply */
+pthread_mutex_t ping_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t ping_cond = PTHREAD_COND_INITIALIZER;
+unsigned int ping_seq = 0;
+int ping_done = 0;
+unsigned int ping_rtt_ns;
+/* frames discarded because of a bad fcs */
+unsigned long long rx_bad_fcs = 0;
+/* multicast groups this station has joined, frames to them are accepted */
+char joined_groups[MAX_GROUPS][18];
+int joined_count = 0;
+pthread_mutex_t groups_lock = PTHREAD_MUTEX_INITIALIZER;
+/* set by -m, number of virtual hosts behind the ports, their mac addresses count up from src_mac_address */
+int virtual_count = 1;
+/* set by -r, frames per second sent by the virtual hosts, round robin, 0 -> the hosts only answer */
+int virtual_rate = 1000;
+/* receive filter of the virtual hosts, mac address -> host index */
+mac_set_t virtual_hosts;
+unsigned long long virtual_sent = 0, virtual_accepted = 0;
+
+/*
+ * Function    : is_joined_group
+ * @params     : mac_address -> destination mac address of a received frame
+ * Output      : 1 -> station is a member of this multicast group, 0 -> otherwise
+ * */
+int is_joined_group(char *mac_address)
+{
+  int found = 0;
+  pthread_mutex_lock(&groups_lock);
+  for(int i=0; i<joined_count && !found; i++)
+  {
+    found = strcmp(joined_groups[i], mac_address) == 0;
+  }
+  pthread_mutex_unlock(&groups_lock);
+  return found;
+}
+
+/*
+ * Function    : is_station_address
+ * @params     : mac_address -> destination mac address of a received frame
+ * Output      : 1 -> the address is the station's own, or one of its virtual hosts', 0 -> otherwise
+ * */
+int is_station_address(const char *mac_address)
+{
+  if(virtual_count == 1)
+  {
+    return strcmp(mac_address, src_mac_address) == 0;
+  }
+  return mac_set_find(&virtual_hosts, mac_address_value(mac_address)) != -1;
+}
+
+/*
+ * Function    : now_ns
+ * Output      : CLOCK_MONOTONIC time in ns, truncated to the 32 bits of the echo timestamp
+ * */
+unsigned int now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned int) (ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+/*
+ * Function    : echo_reply_received
+ * @params     : seq       -> sequence number of the reply
+ *               timestamp -> send time of the request
+ * Description : Wakes up ping_station() if the reply answers the ping it is waiting for
+ * */
+void echo_reply_received(unsigned int seq, unsigned int timestamp)
+{
+  pthread_mutex_lock(&ping_lock);
+  if(seq == ping_seq && !ping_done)
+  {
+    /* unsigned arithmetic survives the wrap of the 32 bit timestamp */
+    ping_rtt_ns = now_ns() - timestamp;
+    ping_done = 1;
+    pthread_cond_signal(&ping_cond);
+  }
+  pthread_mutex_unlock(&ping_lock);
+}
+
+/*
+ * Function    : process_frame
+ * @params     : port_no      -> port the frame was received on
+ *               recv_buffer  -> the frame
+ * Description : Checks the frame and accepts or discards it, answers pings and completes the ping in progress
+ * */
+void process_frame(int port_no, char *recv_buffer)
+{
+  /* a corrupted frame is dropped before its header is looked at */
+  if(!frame_fcs_ok(recv_buffer))
+  {
+    unsigned long long bad = __atomic_add_fetch(&rx_bad_fcs, 1, __ATOMIC_RELAXED);
+    PROBE2(drop, port_no, PROBE_DROP_BAD_FCS);
+    fprintf(fptr, "\nFrame received on port - %d has a bad FCS and is discarded (%llu so far)\n", port_no, bad);
+    return;
+  }
+
+  void *temp = recv_buffer;
+  /* type casting for easy access */
+  frame_t *f = (frame_t *) temp;
+  PROBE5(frame_receive, port_no, (char *) f->src_mac_address, (char *) f->dest_mac_address, f->flags, f->seq);
+  /* modifiying the frame for easy access of dest_mac_address and src_mac_address of the frame */
+  recv_buffer[17]='\0';
+  recv_buffer[35]='\0';
+
+  fprintf(fptr, "\nFrame received on port - %d. Frame's Destination address is %s, Frame's Source Address is %s\n", port_no, f->dest_mac_address, f->src_mac_address);
+  if(f->vlan_id)
+  {
+    fprintf(fptr, "Frame is tagged with vlan %d\n", f->vlan_id);
+  }
+
+  /* if the frame is a broacast, accept it, or
+   * if the frame's destination mac address is the
+   * station's mac address (or a virtual host's), accept the frame, or
+   * if the frame is for a multicast group the station joined, accept it.
+   * Otherwise discard the frame
+   * */
+  int is_own = is_station_address(f->dest_mac_address);
+  if( strcmp(f->dest_mac_address, BROADCAST_MAC_ADDRESS) == 0 || is_own || is_joined_group(f->dest_mac_address) )
+  {
+    fprintf(fptr,"Frame with Dest - %s, Src - %s is accepted\n\n", f->dest_mac_address, f->src_mac_address);
+    __atomic_add_fetch(&virtual_accepted, 1, __ATOMIC_RELAXED);
+    /* pings to this station are answered by the pinged host, replies are handed to the pinging menu */
+    if(f->flags & FRAME_FLAG_ECHO_REQUEST && is_own)
+    {
+      transmit(f->dest_mac_address, f->src_mac_address, FRAME_FLAG_ECHO_REPLY, f->data, f->seq, f->timestamp);
+    }
+    else if(f->flags & FRAME_FLAG_ECHO_REPLY)
+    {
+      echo_reply_received(f->seq, f->timestamp);
+    }
+  }
+  else
+  {
+    PROBE2(drop, port_no, PROBE_DROP_NOT_FOR_STATION);
+    fprintf(fptr, "Frame is discarded\n\n");
+  }
+}
 
 /*
  * Function    : receive_frames
- * @params     : arg -> arguments to this thread
+ * @params     : arg -> index of the port in port_nos
  * Description : It listens on port for incoming frames.
  * */
 void *receive_frames(void *arg)
 {
   int ret;
+  int link = (int) (long) arg;
+  int port_no = port_nos[link];
+  char recv_buffer[100];
 
   while(1)
   {
     //sem_wait(s_send[port_no - 1]);
     /* receive frame from mqueue and stores it in recv_buffer */
-    ret = mq_receive(mq_recv_fd, recv_buffer, 100, NULL);
+    ret = mq_receive(mq_recv_fd[link], recv_buffer, 100, NULL);
     //sem_post(s_send[port_no - 1]);
     if(ret == -1)
     {
       perror("Error in mq_receive()");
       return NULL;
     }
+    process_frame(port_no, recv_buffer);
+  }
+  /* release all threads memory when thread is killed */
+  pthread_detach(pthread_self());
+}
 
-    void *temp = recv_buffer;
-    /* type casting for easy access */
-    frame_t *f = (frame_t *) temp;
-    /* modifiying the frame for easy access of dest_mac_address and src_mac_address of the frame */
-    recv_buffer[17]='\0';
-    recv_buffer[35]='\0';
-
-    fprintf(fptr, "\nFrame received on port - %d. Frame's Destination address is %s, Frame's Source Address is %s\n", port_no, f->dest_mac_address, f->src_mac_address);
-
-    /* if the frame is a broacast, accept it, or
-     * if the frame's destination mac address and
-     * station's mac address are equal, accept the frame.
-     * Otherwise discard the frame
-     * */
-    if( strcmp(f->dest_mac_address, "FF:FF:FF:FF:FF:FF") == 0 || strcmp(f->dest_mac_address, src_mac_address) == 0 )
+/*
+ * Function    : send_virtual_frame
+ * @params     : host -> index of the virtual host
+ * Description : The host sends a frame to the next virtual host, so the switch learns (or refreshes) its address.
+ *               Once both are learned the frame is dropped by the switch, as source and destination share a port.
+ * */
+void send_virtual_frame(int host)
+{
+  char src[18], dest[18];
+  unsigned long long base = mac_address_value(src_mac_address);
+  mac_address_string(base + host, src);
+  mac_address_string(base + (host + 1) % virtual_count, dest);
+  if(transmit(src, dest, 0, "*** VIRTUAL HOST ***", 0, 0) == EXIT_SUCCESS)
+  {
+    __atomic_add_fetch(&virtual_sent, 1, __ATOMIC_RELAXED);
+  }
+}
+
+/*
+ * Function    : virtual_host_loop
+ * @params     : arg -> unused
+ * Description : Event loop of a station hosting virtual hosts (-m). One thread waits with epoll on the receive mqueue
+ *               of every port and on a timer, drains the mqueues through the virtual hosts' receive filter and sends
+ *               virtual_rate frames per second from the hosts in turn.
+ * */
+void *virtual_host_loop(void *arg)
+{
+  struct epoll_event event, events[5];
+  int epoll_fd = epoll_create1(0);
+  if(epoll_fd == -1)
+  {
+    perror("Error in epoll_create1()");
+    return NULL;
+  }
+  for(int link=0; link<port_count; link++)
+  {
+    /* posix mqueue descriptors are file descriptors on linux */
+    event.events = EPOLLIN;
+    event.data.u32 = link;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, mq_recv_fd[link], &event);
+  }
+  int timer_fd = -1;
+  if(virtual_rate)
+  {
+    struct itimerspec period = {{0, VIRTUAL_TICK_NS}, {0, VIRTUAL_TICK_NS}};
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+    timerfd_settime(timer_fd, 0, &period, NULL);
+    /* the timer comes after the links */
+    event.events = EPOLLIN;
+    event.data.u32 = port_count;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &event);
+  }
+
+  /* frames per second times ticks, a frame is sent for every 1000 (ticks per second) of credit */
+  unsigned long long credit = 0;
+  int next_host = 0;
+  char recv_buffer[FRAME_SIZE];
+  while(1)
+  {
+    int ready = epoll_wait(epoll_fd, events, 5, -1);
+    if(ready == -1)
     {
-      fprintf(fptr,"Frame with Dest - %s, Src - %s is accepted\n\n", f->dest_mac_address, f->src_mac_address);
+      if(errno == EINTR)
+        continue;
+      perror("Error in epoll_wait()");
+      return NULL;
     }
-    else
+    for(int e=0; e<ready; e++)
     {
-      fprintf(fptr, "Frame is discarded\n\n");
+      int link = events[e].data.u32;
+      if(link == port_count)
+      {
+        unsigned long long expirations;
+        if(read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+          continue;
+        credit += expirations * virtual_rate;
+        /* after a stall, catch up with at most a second of frames */
+        if(credit > virtual_rate * 1000ULL)
+          credit = virtual_rate * 1000ULL;
+        for(; credit >= 1000; credit -= 1000)
+        {
+          send_virtual_frame(next_host);
+          next_host = (next_host + 1) % virtual_count;
+        }
+        continue;
+      }
+      /* the receive mqueues of the loop are non blocking, so each one is drained */
+      while(mq_receive(mq_recv_fd[link], recv_buffer, FRAME_SIZE, NULL) != -1)
+      {
+        process_frame(port_nos[link], recv_buffer);
+      }
+      if(errno != EAGAIN)
+      {
+        perror("Error in mq_receive()");
+        return NULL;
+      }
     }
   }
-  /* release all threads memory when thread is killed */
-  pthread_detach(pthread_self());
 }
 
 /*
  * Function    : connect_to_port
- * Description : connect station to port by opening respective message queues and log file.
+ * Description : connect station to its ports by opening respective message queues and log file.
  * */
 void connect_to_port()
 {
   mq_port_attr.mq_maxmsg = 5; // max msgs in queue is 5
   mq_port_attr.mq_msgsize = 100; // max size of msg in queue is 100
 
-  mq_send_fd = mq_open(recv_mq[port_no - 1], _FLAGS, 0777, &mq_port_attr);
-  if(mq_send_fd == -1)
-  {
-    perror("error in mq_open()");
-    return;
-  }
-  mq_recv_fd = mq_open(send_mq[port_no - 1], _FLAGS, 0777, &mq_port_attr);
-  if(mq_recv_fd == -1)
+  for(int link=0; link<port_count; link++)
   {
-    perror("error in mq_open()");
-    return;
-  }
+    mq_send_fd[link] = mq_open(recv_mq[port_nos[link] - 1], _FLAGS, 0777, &mq_port_attr);
+    if(mq_send_fd[link] == -1)
+    {
+      perror("error in mq_open()");
+      return;
+    }
+    /* the event loop of the virtual hosts drains the mqueue until it is empty */
+    mq_recv_fd[link] = mq_open(send_mq[port_nos[link] - 1], virtual_count > 1 ? _FLAGS | O_NONBLOCK : _FLAGS, 0777, &mq_port_attr);
+    if(mq_recv_fd[link] == -1)
+    {
+      perror("error in mq_open()");
+      return;
+    }
 
-  init_semaphore(port_no);
+    init_semaphore(port_nos[link]);
+  }
 
   time_t t;
   time(&t);
@@ -130,43 +369,247 @@ void connect_to_port()
   fprintf(fptr, "\n+------------------------------------------------------------------------+\n");
   fprintf(fptr, "      Opened the file for logging data on %s", ctime(&t));
   fprintf(fptr, "  STATION WITH MAC ADDRESS - %s IS CONNECTED ON PORT - %d\n", src_mac_address, port_no);
+  for(int link=1; link<port_count; link++)
+  {
+    fprintf(fptr, "  AGGREGATED WITH PORT - %d\n", port_nos[link]);
+  }
+  if(virtual_count > 1)
+  {
+    char last[18];
+    mac_address_string(mac_address_value(src_mac_address) + virtual_count - 1, last);
+    fprintf(fptr, "  HOSTING %d VIRTUAL HOSTS, %s TO %s\n", virtual_count, src_mac_address, last);
+  }
   fprintf(fptr, "+------------------------------------------------------------------------+\n");
 
-  /* update the shared memory with port_no and station's mac address */
-  connect_port(port_no, src_mac_address);
+  for(int link=0; link<port_count; link++)
+  {
+    /* update the shared memory with port_no and station's mac address */
+    connect_port(port_nos[link], src_mac_address);
 
-  /* create thread to listen incoming frames */
-  pthread_create(&id, NULL, receive_frames, NULL);
+    /* create thread to listen incoming frames, virtual hosts share one event loop for all ports */
+    if(virtual_count == 1)
+    {
+      pthread_create(&id[link], NULL, receive_frames, (void *) (long) link);
+    }
+  }
+  if(virtual_count > 1)
+  {
+    pthread_create(&id[0], NULL, virtual_host_loop, NULL);
+  }
 
 }
 
 /*
- * Function    : send_frame
- * Description : Sends the frame from station to switch's port
+ * Function    : transmit
+ * @params     : src       -> source mac address, the station's or a virtual host's
+ *               dest      -> destination mac address
+ *               flags     -> FRAME_FLAG_* control flags of the frame
+ *               data      -> data carried by the frame
+ *               seq       -> echo sequence number
+ *               timestamp -> echo timestamp
+ * Output      : EXIT_SUCCESS or EXIT_FAILURE
+ * Description : Builds a frame from src to dest and sends it to switch's port. The frame is built on the stack, so the
+ *               receiving threads can answer pings while the menu sends.
  * */
-int send_frame()
+int transmit(const char *src, const char *dest, unsigned char flags, const char *data, unsigned int seq, unsigned int timestamp)
 {
   int ret;
+  char frame[FRAME_SIZE];
+  memset(frame, 0, FRAME_SIZE);
   /* add src_mac_address in frame */
-  strcpy(send_buffer, src_mac_address);
-  send_buffer[17] = ' ';
+  strcpy(frame, src);
+  frame[17] = ' ';
   /* add dest_mac_address in frame */
-  strcat(send_buffer, dest_mac_address);
-  send_buffer[35] = ' ';
+  strcat(frame, dest);
+  frame[35] = ' ';
 
   /* add data to the frame */
-  strcat(send_buffer, "*** THIS IS DATA ***");
+  strncat(frame, data, sizeof(((frame_t *) frame)->data) - 1);
+  ((frame_t *) frame)->flags = flags;
+  ((frame_t *) frame)->priority = priority;
+  ((frame_t *) frame)->vlan_id = vlan_tag;
+  ((frame_t *) frame)->seq = seq;
+  ((frame_t *) frame)->timestamp = timestamp;
+
+  /* fcs is computed over the complete frame, so it is added last */
+  if(use_fcs)
+  {
+    frame_set_fcs(frame);
+  }
+
+  /* with aggregated ports, every flow is sent on one port so its frames stay in order */
+  int link = port_count > 1 ? mac_flow_hash(src, dest) % port_count : 0;
 
-  sem_wait(s_recv[port_no - 1]);
+  sem_wait(s_recv[port_nos[link] - 1]);
   /* send the frame to switch */
-  ret = mq_send(mq_send_fd, send_buffer, 100, 0);
-  sem_post(s_recv[port_no - 1]);
+  /* mqueue priority lets the switch read high priority frames of this port first */
+  ret = mq_send(mq_send_fd[link], frame, FRAME_SIZE, priority);
+  sem_post(s_recv[port_nos[link] - 1]);
   if(ret == -1)
   {
     perror("Error in mq_send()");
     return EXIT_FAILURE;
   }
+  PROBE5(frame_send, port_nos[link], src, dest, flags, seq);
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Function    : transmit_frame
+ * @params     : flags -> FRAME_FLAG_* control flags of the frame
+ *               data  -> data carried by the frame
+ * Output      : EXIT_SUCCESS or EXIT_FAILURE
+ * Description : Sends a frame from src_mac_address to dest_mac_address
+ * */
+int transmit_frame(unsigned char flags, char *data)
+{
+  return transmit(src_mac_address, dest_mac_address, flags, data, 0, 0);
+}
+
+/*
+ * Function    : send_frame
+ * Description : Sends the frame from station to switch's port
+ * */
+int send_frame()
+{
+  if(transmit_frame(0, "*** THIS IS DATA ***") == EXIT_FAILURE)
+  {
+    return EXIT_FAILURE;
+  }
   fprintf(fptr, "Frame with destination mac address - %s, source mac address - %s has been sent from station-%d\n\n", dest_mac_address, src_mac_address, port_no);
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Function    : join_multicast_group
+ * Description : Joins the multicast group in dest_mac_address, the switch learns it from the join frame and the station
+ *               accepts frames sent to the group from now on
+ * Output      : EXIT_SUCCESS, EXIT_FAILURE if the frame could not be sent
+ * */
+int join_multicast_group()
+{
+  if(!is_multicast_mac_address(dest_mac_address) || strcmp(dest_mac_address, BROADCAST_MAC_ADDRESS) == 0)
+  {
+    printf("Error: %s is not a multicast group address\n\n", dest_mac_address);
+    return EXIT_SUCCESS;
+  }
+  if(is_joined_group(dest_mac_address))
+  {
+    printf("Already a member of group %s\n\n", dest_mac_address);
+    return EXIT_SUCCESS;
+  }
+  pthread_mutex_lock(&groups_lock);
+  if(joined_count == MAX_GROUPS)
+  {
+    pthread_mutex_unlock(&groups_lock);
+    printf("Error: A station can join at most %d groups\n\n", MAX_GROUPS);
+    return EXIT_SUCCESS;
+  }
+  strcpy(joined_groups[joined_count++], dest_mac_address);
+  pthread_mutex_unlock(&groups_lock);
+
+  if(transmit_frame(FRAME_FLAG_MCAST_JOIN, "*** JOIN ***") == EXIT_FAILURE)
+  {
+    return EXIT_FAILURE;
+  }
+  fprintf(fptr, "Joined multicast group %s\n\n", dest_mac_address);
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Function    : leave_multicast_group
+ * Description : Leaves the multicast group in dest_mac_address
+ * Output      : EXIT_SUCCESS, EXIT_FAILURE if the frame could not be sent
+ * */
+int leave_multicast_group()
+{
+  int found = 0;
+  pthread_mutex_lock(&groups_lock);
+  for(int i=0; i<joined_count; i++)
+  {
+    if(strcmp(joined_groups[i], dest_mac_address) == 0)
+    {
+      strcpy(joined_groups[i], joined_groups[--joined_count]);
+      found = 1;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&groups_lock);
+  if(!found)
+  {
+    printf("Not a member of group %s\n\n", dest_mac_address);
+    return EXIT_SUCCESS;
+  }
+
+  if(transmit_frame(FRAME_FLAG_MCAST_LEAVE, "*** LEAVE ***") == EXIT_FAILURE)
+  {
+    return EXIT_FAILURE;
+  }
+  fprintf(fptr, "Left multicast group %s\n\n", dest_mac_address);
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Function    : ping_station
+ * @params     : count -> number of echo requests
+ * Output      : EXIT_SUCCESS, EXIT_FAILURE if a frame could not be sent
+ * Description : Sends count echo requests to dest_mac_address one after the other, waiting up to a second for each
+ *               reply, and displays the round trip times
+ * */
+int ping_station(int count)
+{
+  unsigned long long total_ns = 0;
+  unsigned int min_ns = 0, max_ns = 0;
+  int replies = 0;
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for(int i = 0; i < count; i++)
+  {
+    pthread_mutex_lock(&ping_lock);
+    unsigned int seq = ++ping_seq;
+    ping_done = 0;
+    pthread_mutex_unlock(&ping_lock);
+
+    if(transmit(src_mac_address, dest_mac_address, FRAME_FLAG_ECHO_REQUEST, "*** PING ***", seq, now_ns()) == EXIT_FAILURE)
+    {
+      return EXIT_FAILURE;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec++;
+    pthread_mutex_lock(&ping_lock);
+    while(!ping_done && pthread_cond_timedwait(&ping_cond, &ping_lock, &deadline) == 0)
+      ;
+    int done = ping_done;
+    unsigned int rtt = ping_rtt_ns;
+    /* a late reply must not complete the next ping */
+    ping_done = 1;
+    pthread_mutex_unlock(&ping_lock);
+
+    if(done)
+    {
+      if(replies == 0 || rtt < min_ns)
+        min_ns = rtt;
+      if(rtt > max_ns)
+        max_ns = rtt;
+      total_ns += rtt;
+      replies++;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  printf("%d echo requests to %s, %d replies", count, dest_mac_address, replies);
+  if(replies)
+  {
+    printf(", rtt min/avg/max %.1f/%.1f/%.1f us, %.0f pings/s", min_ns / 1000.0, total_ns / 1000.0 / replies,
+           max_ns / 1000.0, count / seconds);
+  }
+  printf("\n\n");
+  fprintf(fptr, "Pinged %s: %d of %d replies\n\n", dest_mac_address, replies, count);
+  return EXIT_SUCCESS;
 }
 
 /*
@@ -176,12 +619,23 @@ int send_frame()
 void close_station()
 {
   //disconnect_port(port_no);
+  if(rx_bad_fcs)
+  {
+    fprintf(fptr, "%llu frames were discarded because of a bad FCS\n", rx_bad_fcs);
+  }
+  if(virtual_count > 1)
+  {
+    fprintf(fptr, "%d virtual hosts sent %llu frames and accepted %llu frames\n", virtual_count, virtual_sent, virtual_accepted);
+  }
   fprintf(fptr, "***** STATION WITH MAC ADDRESS - %s IS DISCONNECTED FROM PORT - %d *****\n", src_mac_address, port_no);
   /* closes log file descriptor */
   fclose(fptr);
   /* closing message queues */
-  mq_close(mq_send_fd);
-  mq_close(mq_recv_fd);
+  for(int link=0; link<port_count; link++)
+  {
+    mq_close(mq_send_fd[link]);
+    mq_close(mq_recv_fd[link]);
+  }
   /* unmap all shared memories */
   munmap(NULL, SWITCH_PID_SIZE);
   munmap(NULL, CON_DISCON_PORTS_SIZE);
@@ -244,21 +698,110 @@ int main(int argc, char *argv[])
   sa2.sa_flags = SA_SIGINFO;
   sa2.sa_restorer = NULL;
 
-  /* initialize all shared memories */
-  if(init_shared_memories() == EXIT_FAILURE)
+  if(argc < 3)
   {
+    printf("Usage: ./station <MAC_ADDRESS> <PORT_NO> [-s <SWITCH_NO>] [-f] [-p <PRIORITY>] [-v <VLAN>] [-l <PORT_NO>]... [-m <COUNT> [-r <RATE>]]\n");
+    printf("  -s <SWITCH_NO>: connect to this switch when several switches run side by side (default 0)\n");
+    printf("  -f            : append a CRC32C frame check sequence to sent frames\n");
+    printf("  -p <PRIORITY> : priority 0 (lowest) to 7 of sent frames\n");
+    printf("  -v <VLAN>     : tag sent frames with vlan 1 to 4094 (for a trunk port)\n");
+    printf("  -l <PORT_NO>  : also connect to this port, aggregated with PORT_NO (the ports must be in one LAG)\n");
+    printf("  -m <COUNT>    : host COUNT virtual hosts, with mac addresses counting up from MAC_ADDRESS\n");
+    printf("  -r <RATE>     : frames per second sent by the virtual hosts in turn (default 1000, 0 -> none)\n");
     return EXIT_FAILURE;
   }
 
-  if(argc != 3)
+  /* stores port number, -l adds more ports */
+  port_no = atoi(argv[2]);
+  port_nos[port_count++] = port_no;
+
+  /* optional arguments */
+  for(int i=3; i<argc; i++)
+  {
+    if(strcmp(argv[i], "-f") == 0)
+    {
+      use_fcs = 1;
+    }
+    else if(strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+    {
+      priority = atoi(argv[++i]);
+      if(priority < 0 || priority > 7)
+      {
+        printf("Error: Priority must be between 0 and 7\n");
+        return EXIT_FAILURE;
+      }
+    }
+    else if(strcmp(argv[i], "-v") == 0 && i + 1 < argc)
+    {
+      vlan_tag = atoi(argv[++i]);
+      if(vlan_tag < 1 || vlan_tag > 4094)
+      {
+        printf("Error: VLAN must be between 1 and 4094\n");
+        return EXIT_FAILURE;
+      }
+    }
+    else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+    {
+      int switch_id = atoi(argv[++i]);
+      if(switch_id < 0 || switch_id > MAX_SWITCH_ID)
+      {
+        printf("Error: Switch number must be between 0 and %d\n", MAX_SWITCH_ID);
+        return EXIT_FAILURE;
+      }
+      set_switch_instance(switch_id);
+    }
+    else if(strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+    {
+      if(port_count == 4)
+      {
+        printf("Error: A station can connect to at most 4 ports\n");
+        return EXIT_FAILURE;
+      }
+      port_nos[port_count++] = atoi(argv[++i]);
+    }
+    else if(strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+    {
+      virtual_count = atoi(argv[++i]);
+      if(virtual_count < 1 || virtual_count > MAX_VIRTUAL_HOSTS)
+      {
+        printf("Error: Number of virtual hosts must be between 1 and %d\n", MAX_VIRTUAL_HOSTS);
+        return EXIT_FAILURE;
+      }
+    }
+    else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+    {
+      virtual_rate = atoi(argv[++i]);
+      if(virtual_rate < 0 || virtual_rate > 1000000)
+      {
+        printf("Error: Rate must be between 0 and 1000000 frames per second\n");
+        return EXIT_FAILURE;
+      }
+    }
+    else
+    {
+      printf("Error: Unknown option %s\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  /* the mqueues, semaphores and log files of the station are named after its switch */
+  apply_instance_names(send_mq, 4);
+  apply_instance_names(recv_mq, 4);
+  apply_instance_names(sem_recv_names, 4);
+  apply_instance_names(sem_send_names, 4);
+  apply_instance_names(station_log, 4);
+
+  /* initialize all shared memories */
+  if(init_shared_memories() == EXIT_FAILURE)
   {
-    printf("Usage: ./station <MAC_ADDRESS> <PORT_NO>\n");
     return EXIT_FAILURE;
   }
 
-  /* stores mac address and port number */
+  /* received frames are always checked, the fcs is optional per sender */
+  crc32c_init();
+
+  /* stores mac address */
   strcpy(src_mac_address, argv[1]);
-  port_no = atoi(argv[2]);
 
   /* check for valid mac_address */
   if(strlen(src_mac_address) != 17 )
@@ -267,25 +810,57 @@ int main(int argc, char *argv[])
     return EXIT_FAILURE;
   }
 
-  /* check for valid port number */
-  if(port_no == 0 || port_no > 4)
+  /* the receive filter of the virtual hosts */
+  if(virtual_count > 1)
   {
-    printf("Error: Invalid port number\n");
-    return EXIT_FAILURE;
+    unsigned long long base = mac_address_value(src_mac_address);
+    if(is_multicast_mac_address(src_mac_address) || base + virtual_count - 1 > 0xFFFFFFFFFFFFULL)
+    {
+      printf("Error: %d virtual hosts do not fit after %s\n", virtual_count, src_mac_address);
+      return EXIT_FAILURE;
+    }
+    if(mac_set_init(&virtual_hosts, virtual_count) == -1)
+    {
+      perror("Error in malloc()");
+      return EXIT_FAILURE;
+    }
+    for(int host=0; host<virtual_count; host++)
+    {
+      mac_set_add(&virtual_hosts, base + host, host);
+    }
   }
 
-  /* connect the station to the port only if the port is enabled */
-  if(!is_enabled(port_no - 1))
+  for(int link=0; link<port_count; link++)
   {
-    printf("Error: Port is disabled, cannot connect to port - %d\n", port_no);
-    return EXIT_FAILURE;
-  }
+    int port = port_nos[link];
+    /* check for valid port number */
+    if(port <= 0 || port > 4)
+    {
+      printf("Error: Invalid port number\n");
+      return EXIT_FAILURE;
+    }
+    for(int other=0; other<link; other++)
+    {
+      if(port_nos[other] == port)
+      {
+        printf("Error: Port - %d is given twice\n", port);
+        return EXIT_FAILURE;
+      }
+    }
 
-  /* connect the station to the port only if the port is not connected to anyother station */
-  if(is_connected(port_no - 1))
-  {
-    printf("Error: Port is alread connected to a station\n");
-    return EXIT_FAILURE;
+    /* connect the station to the port only if the port is enabled */
+    if(!is_enabled(port - 1))
+    {
+      printf("Error: Port is disabled, cannot connect to port - %d\n", port);
+      return EXIT_FAILURE;
+    }
+
+    /* connect the station to the port only if the port is not connected to anyother station */
+    if(is_connected(port - 1))
+    {
+      printf("Error: Port - %d is alread connected to a station\n", port);
+      return EXIT_FAILURE;
+    }
   }
 
   /* connect the station to the port */
@@ -9,6 +9,9 @@
 
 /* function declarations */
 int send_frame();
+int join_multicast_group();
+int leave_multicast_group();
+int ping_station(int);
 pid_t get_switch_pid();
 void close_station();
 int is_enabled(int);
@@ -33,7 +36,10 @@ int station_user_menu()
     printf("|       STATION MENU          |\n");
     printf("+-----------------------------+\n");
     printf("  [1] Send Frame\n");
-    printf("  [2] Exit\n");
+    printf("  [2] Join Multicast Group\n");
+    printf("  [3] Leave Multicast Group\n");
+    printf("  [4] Ping Station\n");
+    printf("  [5] Exit\n");
     printf("-------------------------------\n");
 
     printf("Enter your option:");
@@ -66,6 +72,41 @@ int station_user_menu()
         continue;
 
       case 2:
+      case 3:
+        printf("Enter multicast group MAC address:");
+        fgets(dest_mac_address, 19, stdin);
+        dest_mac_address[strlen(dest_mac_address) - 1] = '\0';
+
+        /* join or leave the group, the switch learns membership from the control frame */
+        ret = (choice == 2) ? join_multicast_group() : leave_multicast_group();
+        if(ret == EXIT_FAILURE)
+        {
+          return EXIT_FAILURE;
+        }
+        continue;
+
+      case 4:
+        printf("Enter destination MAC address:");
+        fgets(dest_mac_address, 19, stdin);
+        dest_mac_address[strlen(dest_mac_address) - 1] = '\0';
+        printf("Number of pings:");
+        fgets(input_buffer, 50, stdin);
+        input_buffer[strlen(input_buffer) - 1] = '\0';
+        int count = strtol(input_buffer, &end_ptr, 10);
+        if(*end_ptr != '\0' || count < 1 || count > 1000000)
+        {
+          printf("Invalid input\n\n");
+          continue;
+        }
+
+        /* round trip times to dest_mac_address, across every switch on the way */
+        if( ping_station(count) == EXIT_FAILURE )
+        {
+          return EXIT_FAILURE;
+        }
+        continue;
+
+      case 5:
         /* send signal to switch and close the station */
         kill(get_switch_pid(), SIGUSR1);
         close_station();
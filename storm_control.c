@@ -0,0 +1,159 @@
+/*
+ * File        : storm_control.c
+ * Description : Storm control. Broadcast, multicast and unknown unicast frames received on a port are policed by one token
+ *               bucket per traffic class before they are flooded, so a single misbehaving station cannot fill the queues of
+ *               every other port. The tokens are only used by the ingress worker, which forwards the frames of every
+ *               port. The menu thread publishes the rate and burst of a bucket together in one atomic word, and the
+ *               worker refills the bucket itself when it finds them changed, so it never sees half a configuration.
+ * */
+#include <stdio.h>
+
+#include "storm_control.h"
+#include "port_stats.h"
+#include "forward.h"
+
+#define MAX_PORTS 4
+#define NSEC_PER_SEC 1000000000ULL
+
+/* rate in the high half of the configuration word, burst in the low half */
+#define STORM_CONFIG(rate, burst) ((unsigned long long) (rate) << 32 | (burst))
+#define STORM_RATE(config) ((unsigned int) ((config) >> 32))
+#define STORM_BURST(config) ((unsigned int) (config))
+
+/* token bucket, tokens are kept in frame-nanoseconds so the refill needs no division */
+typedef struct token_bucket
+{
+  unsigned long long config;  /* STORM_CONFIG(frames per second, burst in frames), rate 0 -> not policed */
+  unsigned long long applied; /* config the tokens were filled for, only used by the ingress worker */
+  unsigned long long tokens;  /* NSEC_PER_SEC tokens per frame */
+  unsigned long long last_ns;
+} token_bucket_t;
+
+static token_bucket_t storm_buckets[MAX_PORTS][STORM_CLASSES];
+
+static const char *storm_class_names[STORM_CLASSES] = {"broadcast", "multicast", "unknown unicast"};
+
+/*
+ * Function    : init_storm_control
+ * Description : Storm control starts disabled on every port and traffic class
+ * */
+void init_storm_control()
+{
+  for(int i=0; i<MAX_PORTS; i++)
+  {
+    for(int j=0; j<STORM_CLASSES; j++)
+    {
+      storm_buckets[i][j].config = 0;
+      storm_buckets[i][j].applied = 0;
+    }
+  }
+}
+
+/*
+ * Function    : storm_control_allow
+ * @params     : port_index    -> ingress port (0 based)
+ *               traffic_class -> STORM_BROADCAST, STORM_MULTICAST or STORM_UNKNOWN_UNICAST
+ * Output      : 1 -> frame may be flooded
+ *               0 -> frame exceeds the configured rate and must be dropped
+ * */
+int storm_control_allow(int port_index, int traffic_class)
+{
+  token_bucket_t *bucket = &storm_buckets[port_index][traffic_class];
+  unsigned long long config = __atomic_load_n(&bucket->config, __ATOMIC_RELAXED);
+  unsigned int rate = STORM_RATE(config);
+  if(rate == 0)
+  {
+    return 1;
+  }
+
+  /* the coarse clock delays refills by a few milliseconds at most, or the simulated time of sim */
+  unsigned long long now = forward_now_ns();
+  unsigned long long capacity = STORM_BURST(config) * NSEC_PER_SEC;
+  /* a new configuration starts with a full bucket */
+  if(config != bucket->applied)
+  {
+    bucket->applied = config;
+    bucket->tokens = capacity;
+    bucket->last_ns = now;
+  }
+  unsigned long long elapsed = now - bucket->last_ns;
+  unsigned long long room = capacity - bucket->tokens;
+  bucket->last_ns = now;
+
+  /* refill, comparing against room / rate first so elapsed * rate can not overflow */
+  if(elapsed >= room / rate)
+  {
+    bucket->tokens = capacity;
+  }
+  else
+  {
+    bucket->tokens += elapsed * rate;
+  }
+
+  if(bucket->tokens >= NSEC_PER_SEC)
+  {
+    bucket->tokens -= NSEC_PER_SEC;
+    return 1;
+  }
+
+  PORT_STAT_ADD(port_index, storm_dropped[traffic_class], 1);
+  return 0;
+}
+
+/*
+ * Function    : set_storm_control
+ * @params     : port_no       -> port to configure
+ *               traffic_class -> STORM_BROADCAST, STORM_MULTICAST or STORM_UNKNOWN_UNICAST
+ *               rate          -> allowed frames per second, 0 disables storm control for this class
+ *               burst         -> frames that may be flooded back to back
+ * Description : Publishes the rate and burst of one token bucket, the ingress worker fills it with the next frame
+ * */
+void set_storm_control(int port_no, int traffic_class, unsigned int rate, unsigned int burst)
+{
+  token_bucket_t *bucket = &storm_buckets[port_no - 1][traffic_class];
+  __atomic_store_n(&bucket->config, rate ? STORM_CONFIG(rate, burst ? burst : 1) : 0, __ATOMIC_RELAXED);
+}
+
+/*
+ * Function    : get_storm_control
+ * @params     : port_no       -> port
+ *               traffic_class -> STORM_BROADCAST, STORM_MULTICAST or STORM_UNKNOWN_UNICAST
+ *               burst         -> to store the burst in frames
+ * Output      : rate in frames per second, 0 -> not policed
+ * */
+unsigned int get_storm_control(int port_no, int traffic_class, unsigned int *burst)
+{
+  unsigned long long config = __atomic_load_n(&storm_buckets[port_no - 1][traffic_class].config, __ATOMIC_RELAXED);
+  *burst = STORM_BURST(config);
+  return STORM_RATE(config);
+}
+
+/*
+ * Function    : display_storm_control
+ * Description : Displays the storm control configuration and drop counters of every port
+ * */
+void display_storm_control()
+{
+  printf("\n+------+-----------------+------------+------------+------------+\n");
+  printf("| PORT |  TRAFFIC CLASS  | RATE (f/s) |    BURST   |   DROPPED  |\n");
+  printf("+------+-----------------+------------+------------+------------+\n");
+  for(int i=0; i<MAX_PORTS; i++)
+  {
+    for(int j=0; j<STORM_CLASSES; j++)
+    {
+      unsigned long long config = __atomic_load_n(&storm_buckets[i][j].config, __ATOMIC_RELAXED);
+      if(STORM_RATE(config))
+      {
+        printf("|  %d   | %-15s | %10u | %10u | %10llu |\n", i+1, storm_class_names[j], STORM_RATE(config),
+               STORM_BURST(config),
+               port_stats[i].storm_dropped[j]);
+      }
+      else
+      {
+        printf("|  %d   | %-15s |   disabled |          - | %10llu |\n", i+1, storm_class_names[j],
+               port_stats[i].storm_dropped[j]);
+      }
+    }
+  }
+  printf("+------+-----------------+------------+------------+------------+\n");
+}
@@ -0,0 +1,21 @@
+#ifndef STORM_CONTROL_H
+#define STORM_CONTROL_H
+
+/*
+ * File        : storm_control.h
+ * Description : Per port, per traffic class token bucket policers for flooded traffic
+ * */
+
+/* traffic classes policed by storm control */
+#define STORM_BROADCAST 0
+#define STORM_MULTICAST 1
+#define STORM_UNKNOWN_UNICAST 2
+#define STORM_CLASSES 3
+
+void init_storm_control();
+int storm_control_allow(int port_index, int traffic_class);
+void set_storm_control(int port_no, int traffic_class, unsigned int rate, unsigned int burst);
+unsigned int get_storm_control(int port_no, int traffic_class, unsigned int *burst);
+void display_storm_control();
+
+#endif
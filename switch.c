@@ -4,9 +4,32 @@
  * */
 
 #include "switch.h"
+#include "frame.h"
+#include "fcs.h"
+#include "port_stats.h"
+#include "storm_control.h"
+#include "mac_util.h"
+#include "egress_sched.h"
+#include "multicast_table.h"
+#include "vlan.h"
+#include "lag.h"
+#include "instance.h"
+#include "stack.h"
+#include "mirror.h"
+#include "sflow.h"
+#include "top_talkers.h"
+#include "probes.h"
+#include "queue_monitor.h"
+#include "forward.h"
+#include "acl.h"
+#include "classify.h"
+#include "flight_recorder.h"
+#include "ingress_sched.h"
+#include "shm_pages.h"
+#include "mac_learning.h"
+#include "hash_mac_table.h"
 
 #define MAX_PORTS 4
-#define TABLE_SIZE 10
 
 /* function declarations */
 int is_enabled(int);
@@ -14,48 +37,31 @@ void disable_port(int);
 void enable_port(int);
 void display_en_ports();
 pid_t is_connected(int);
-void connect_port(int);
+void connect_port(int, char *);
 void disconnect_port(int);
 void init_mac_table();
-void add_to_mac_table(int, char *);
-void delete_entry_from_mac_table(char *);
+void add_to_mac_table(int, int, char *);
+int learn_mac_address(int, int, char *);
+void delete_entry_from_mac_table(int, char *);
+void flush_port_from_mac_table(int);
+void mac_table_quiescent();
 void display_mac_table();
-int get_port_no_from_mac_table(char *);
-int is_available(char *);
+int get_port_no_from_mac_table(int, char *);
+int is_available(int, char *);
 int get_station_port_num(pid_t);
 char *get_station_mac_addr(pid_t);
 int init_shared_memories();
 int switch_user_menu();
 void init_semaphores();
-
-/* frame structure */
-typedef struct frame
-{
-  char src_mac_address[18];
-  char dest_mac_address[18];
-  char data[28];
-} frame_t;
-
-/* mac_table entry structure */
-typedef struct mac_table
-{
-  int port_no;
-  char mac_address[18];
-  struct mac_table *next;
-} mac_table_t;
-
-/* mac_table to store (port,mac_address) (used hash_map) */
-mac_table_t *mac_table[TABLE_SIZE];
-
-/* to store thread ids for each port */
-pthread_t id[4];
+int save_mac_table_snapshot();
+int load_mac_table_snapshot();
+void remove_mac_table_snapshot();
+void switch_off();
+void switch_warm_restart();
 
 /* a buffer size of 100 bytes for each port to store data receiving from mqueue */
 char buffer[4][100];
 
-/* to store port no */
-int port[4];
-
 /* to store file descriptors returned by mq_open for each port */
 mqd_t mq_fd[4];
 mqd_t mq_send_fd[4];
@@ -67,41 +73,91 @@ sem_t *s_send[4];
 /* to store file descriptors of files opened by each port to log data */
 FILE *fptr[4];
 
+/* set by -w, reattach to the ports and mac_table left behind by a warm restart */
+int warm_start = 0;
+
+/* set by -l, every frame and how it was forwarded is written to the port log. Off by default, the flight recorder keeps
+ * the recent frames of every port without a formatted write per frame */
+int frame_log = 0;
+
+#define FRAME_LOG(port_index, ...) do { if(frame_log) fprintf(fptr[port_index], __VA_ARGS__); } while(0)
+
+/* ports whose station left (bit 0 -> port 1), set by the SIGUSR1 handler and cleaned up by the station leave thread.
+ * The handler only records them: the cleanup takes locks the interrupted menu thread may be holding */
+static unsigned int leaving_ports = 0;
+static sem_t leave_sem;
+static volatile int leave_running = 0;
+static pthread_t leave_id;
+
+/* SIGINT and SIGHUP only record what was asked and post stop_sem, the stop thread switches off or warm restarts. Both
+ * join threads and take locks the interrupted menu thread may be holding */
+#define STOP_SWITCH_OFF 1
+#define STOP_WARM_RESTART 2
+static volatile sig_atomic_t stop_request = 0;
+static sem_t stop_sem;
+/* set by the first of the menu and the stop thread to switch off or warm restart */
+static int switch_stopping = 0;
+
+/*
+ * Function    : set_egress_vlan_tag
+ * @params     : frame      -> frame about to be queued
+ *               port_index -> destination port (0 based)
+ *               vlan_id    -> vlan of the frame
+ * Description : Tags the frame for a trunk port or untags it for an access port, and recomputes its fcs if the
+ *               header had to be changed
+ * */
+void set_egress_vlan_tag(char *frame, int port_index, int vlan_id)
+{
+  frame_t *f = (frame_t *) frame;
+  unsigned short tag = vlan_egress_tag(port_index, vlan_id);
+  if(f->vlan_id != tag)
+  {
+    f->vlan_id = tag;
+    if(f->flags & FRAME_FLAG_FCS)
+    {
+      frame_set_fcs(frame);
+    }
+  }
+}
+
 /*
  * Function    : broadcast
- * @params     : port_no -> to access port_no related buffer to send data
- * Description : This function forwards the frame to all active and connected ports. It also takes care of traffic filtering.
+ * @params     : port_no   -> to access port_no related buffer to send data
+ *               port_mask -> ports the frame is flooded to (bit 0 -> port 1), as decided by forward_frame()
+ *               vlan_id   -> vlan of the frame
+ * Description : This function forwards the frame to all ports in port_mask.
  * */
-void broadcast(int port_no)
+void broadcast(int port_no, unsigned int port_mask, int vlan_id)
 {
-  int ret, count = 0;
+  int count = 0;
+  int priority = ((frame_t *) buffer[port_no - 1])->priority;
+  PORT_STAT_ADD(port_no - 1, rx_flooded, 1);
+  top_talker_flooded(port_no - 1);
   for(int i=0; i<MAX_PORTS; i++)
   {
-    // send frame only if the destination port is enabled and connected to a station and dont send frame on which port it is received
-    if(is_enabled(i) && is_connected(i) && (i != (port_no - 1)) )
+    if(port_mask & (1u << i))
     {
-      /* restoring the original buffer */
-      buffer[i][17] = ' ';
-      buffer[i][35] = ' ';
-
-      sem_wait(s_send[i+1]);
-      /* sending the frame to destination port */
-      ret = mq_send(mq_send_fd[i], buffer[port_no - 1], 100, 0);
-      sem_post(s_send[i+1]);
-      if(ret == -1)
+      set_egress_vlan_tag(buffer[port_no - 1], i, vlan_id);
+      /* queue the frame for the destination port, its scheduler sends it to the port mqueue */
+      if(egress_enqueue(i, buffer[port_no - 1], priority) == -1)
       {
-        perror("Error in mq_send()");
-        return;
+        PROBE3(queue_full, port_no, i+1, priority);
+        FRAME_LOG(port_no - 1, "Egress queue of port - %d is full, frame is not forwarded to it\n", i+1);
+        continue;
       }
+      MIRROR_FRAME(i, MIRROR_EGRESS, buffer[port_no - 1]);
       count++;
       /* logging data to file */
-      fprintf(fptr[port_no - 1], "Frame is forwarded to port - %d\n", i+1);
+      FRAME_LOG(port_no - 1, "Frame is forwarded to port - %d\n", i+1);
     }
   }
+  PROBE4(flood, port_no, vlan_id, port_mask, count);
   /* if no port is enabled or connected, log that information to file */
   if(count == 0)
   {
-    fprintf(fptr[port_no - 1], "No port is enabled or connected to a station. So frame is not forwarded to any port.\n");
+    PORT_STAT_ADD(port_no - 1, rx_dropped, 1);
+    PROBE2(drop, port_no, PROBE_DROP_NO_PORT);
+    FRAME_LOG(port_no - 1, "No port is enabled or connected to a station. So frame is not forwarded to any port.\n");
   }
 }
 
@@ -109,115 +165,156 @@ void broadcast(int port_no)
  * Function    : unicast
  * @params     : dest_port -> destination port number to forward the frame
  *               src_port  -> port number to access related buffer
+ *               vlan_id   -> vlan of the frame
  * Description : This function forwards the frame to dest_port
  * */
-void unicast(int dest_port, int src_port)
+void unicast(int dest_port, int src_port, int vlan_id)
 {
-  int ret;
-  /* forwards the frame to destination port mqueue */
-  sem_wait(s_send[dest_port]);
-  ret = mq_send(mq_send_fd[dest_port - 1], buffer[src_port - 1], 100, 0);
-  sem_post(s_send[dest_port]);
-  if(ret == -1)
+  int priority = ((frame_t *) buffer[src_port - 1])->priority;
+  set_egress_vlan_tag(buffer[src_port - 1], dest_port - 1, vlan_id);
+  /* queue the frame for the destination port, its scheduler sends it to the port mqueue */
+  if(egress_enqueue(dest_port - 1, buffer[src_port - 1], priority) == -1)
   {
-    perror("Error in mq_send()");
+    PORT_STAT_ADD(src_port - 1, rx_dropped, 1);
+    PROBE3(queue_full, src_port, dest_port, priority);
+    PROBE2(drop, src_port, PROBE_DROP_QUEUE_FULL);
+    FRAME_LOG(src_port - 1, "Egress queue of port - %d is full, frame is dropped\n", dest_port);
     return;
   }
+  MIRROR_FRAME(dest_port - 1, MIRROR_EGRESS, buffer[src_port - 1]);
+  PROBE3(unicast, src_port, dest_port, vlan_id);
   /* log data to file */
-  fprintf(fptr[src_port - 1], "Frame is forwarded to port - %d\n", dest_port);
+  FRAME_LOG(src_port - 1, "Frame is forwarded to port - %d\n", dest_port);
 }
 
 /*
- * Function    : listen_port
- * @params     : port_no -> pointer to this thread's port_no
- * Description : This function is invoked by init_port function for every port. It will take care of listening traffic on port, mac learning and sends the received frame to its
- *               destination port.
+ * Function    : forward_port_frame
+ * @params     : port_no -> port the frame was received on, it is in the port's buffer
+ *               len     -> bytes received
+ * Description : Checks, logs and forwards one frame, called by the ingress scheduler for every frame it receives
  * */
-void *listen_port(void *port_no)
+void forward_port_frame(int port_no, int len)
 {
-  int *temp_port_no = (int *) port_no;
-
-  int ret;
-  while(1)
+  /* between two frames the worker is on no mac_table entry, the ones removed meanwhile can be freed */
+  mac_table_quiescent();
+
+  PORT_STAT_ADD(port_no - 1, rx_frames, 1);
+  PROBE5(frame_receive, port_no, (char *) buffer[port_no - 1], buffer[port_no - 1] + 18,
+         ((frame_t *) buffer[port_no - 1])->vlan_id, ((frame_t *) buffer[port_no - 1])->seq);
+  /* received frames are mirrored as they arrived, even the ones dropped below */
+  MIRROR_FRAME(port_no - 1, MIRROR_INGRESS, buffer[port_no - 1]);
+  SFLOW_SAMPLE(port_no - 1, buffer[port_no - 1]);
+
+  /* frames with a bad fcs are dropped before they can be learned from or forwarded */
+  if(!frame_fcs_ok(buffer[port_no - 1]))
   {
-    //sem_wait(s_recv[*temp_port_no]);
-    /* Receiving frame from port and stores it in port's related buffer */
-    ret = mq_receive(mq_fd[*temp_port_no - 1], buffer[*temp_port_no - 1], 100, NULL);
-    //sem_post(s_recv[*temp_port_no]);
-    if(ret == -1)
-    {
-      perror("Error in mq_receive()");
-      return NULL;
-    }
-
-    void *temp = buffer[*temp_port_no - 1];
-    /* typecasting buffer to easily access destination mac address and source mac address */
-    frame_t *f = (frame_t *) temp;
-    /* modifying space with null character for easy access and will restore back to default while sending frame to its destination port */
-    buffer[*temp_port_no - 1][17]='\0';
-    buffer[*temp_port_no - 1][35]='\0';
-
-    /* logging data to file */
-    fprintf(fptr[*temp_port_no - 1], "\nFrame received on port - %d. Frame's Destination mac address is %s, Frame's Source mac address is %s\n", *temp_port_no, f->dest_mac_address, f->src_mac_address);
-
-    /* mac learning -> if src_mac_address is not available in mac_table, add it to mac_table */
-    if(!is_available(f->src_mac_address))
-    {
-      add_to_mac_table(*temp_port_no, f->src_mac_address);
-    }
-
-    /* If the frame is a broadcast frame, broadcast it */
-    if(strcmp(f->dest_mac_address, "FF:FF:FF:FF:FF:FF") == 0)
-    {
-      fprintf(fptr[*temp_port_no - 1], "Broadcasting the frame:\n");
-      /* broadcasting the frame */
-      broadcast(*temp_port_no);
-      fprintf(fptr[*temp_port_no - 1], "\n");
+    PORT_STAT_ADD(port_no - 1, rx_bad_fcs, 1);
+    PROBE2(drop, port_no, PROBE_DROP_BAD_FCS);
+    forward_result_t bad_fcs = {FORWARD_DROP, PROBE_DROP_BAD_FCS, 0, -1, -1, 0, FLOW_CACHE_NONE};
+    flight_record(port_no - 1, (frame_t *) buffer[port_no - 1], &bad_fcs);
+    FRAME_LOG(port_no - 1, "\nFrame received on port - %d has a bad FCS and is dropped\n", port_no);
+    return;
+  }
 
-    }
-    /* if the destination mac_address is in mac_table, then extract dest_port_no and unicast the frame (forwards the frame to dest_port_no) */
-    else if( is_available(f->dest_mac_address) )
-    {
-      /* extract dest_port_no from mac_table by passing dest_mac_address */
-      int dest_port_no = get_port_no_from_mac_table(f->dest_mac_address);
-      /* unicast the frame only if the dest_port is enabled and src_port is not equal to dest_port */
-      if( is_enabled(dest_port_no - 1) && is_connected(dest_port_no - 1) && *temp_port_no != dest_port_no)
+  void *temp = buffer[port_no - 1];
+  /* typecasting buffer to easily access destination mac address and source mac address */
+  frame_t *f = (frame_t *) temp;
+  /* every frame with a good fcs is counted for its pair, even if it is dropped below */
+  top_talker_update(port_no - 1, f->src_mac_address, f->dest_mac_address);
+  /* modifying space with null character for easy access and will restore back to default while sending frame to its destination port */
+  buffer[port_no - 1][17]='\0';
+  buffer[port_no - 1][35]='\0';
+
+  /* logging data to file */
+  FRAME_LOG(port_no - 1, "\nFrame received on port - %d. Frame's Destination mac address is %s, Frame's Source mac address is %s\n", port_no, f->dest_mac_address, f->src_mac_address);
+
+  /* vlan, mac learning, multicast join/leave, storm control and mac_table lookup */
+  forward_result_t result;
+  forward_frame(port_no, f, &result);
+  if(result.flow_cache == FLOW_CACHE_HIT)
+    PORT_STAT_ADD(port_no - 1, flow_cache_hits, 1);
+  else if(result.flow_cache == FLOW_CACHE_MISS)
+    PORT_STAT_ADD(port_no - 1, flow_cache_misses, 1);
+  flight_record(port_no - 1, f, &result);
+
+  switch(result.action)
+  {
+    case FORWARD_DROP:
+      PORT_STAT_ADD(port_no - 1, rx_dropped, 1);
+      PROBE2(drop, port_no, result.reason);
+      if(result.reason == PROBE_DROP_VLAN)
+      {
+        PORT_STAT_ADD(port_no - 1, rx_vlan_dropped, 1);
+        FRAME_LOG(port_no - 1, "Port - %d does not carry vlan %d, frame is dropped\n\n", port_no, f->vlan_id);
+      }
+      else if(result.reason == PROBE_DROP_STORM)
       {
-        /* restoring buffer */
-        buffer[*temp_port_no - 1][17] = ' ';
-        buffer[*temp_port_no - 1][35] = ' ';
-        fprintf(fptr[*temp_port_no - 1], "Unicast the frame to port - %d\n", dest_port_no);
-        /* unicast the frame */
-        unicast(dest_port_no, *temp_port_no);
-        fprintf(fptr[*temp_port_no - 1], "\n");
+        FRAME_LOG(port_no - 1, "%s storm control: frame is dropped\n\n", result.flood == FLOOD_BROADCAST ?
+                "Broadcast" : result.flood == FLOOD_UNKNOWN_UNICAST ? "Unknown unicast" : "Multicast");
+      }
+      else if(result.reason == PROBE_DROP_ACL)
+      {
+        PORT_STAT_ADD(port_no - 1, rx_acl_denied, 1);
+        FRAME_LOG(port_no - 1, "Frame with Dest - %s, Src - %s is denied by the ACL of port - %d\n\n", f->dest_mac_address, f->src_mac_address, port_no);
+      }
+      else if(result.reason == PROBE_DROP_NOT_MULTICAST)
+      {
+        FRAME_LOG(port_no - 1, "Join/leave frame for %s is not a multicast group and is dropped\n\n", f->dest_mac_address);
       }
       else
       {
         /* log data to file if the frame is dropped */
-        fprintf(fptr[*temp_port_no - 1], "Frame with Dest - %s, Src - %s is dropped\n\n", f->dest_mac_address, f->src_mac_address);
+        FRAME_LOG(port_no - 1, "Frame with Dest - %s, Src - %s is dropped\n\n", f->dest_mac_address, f->src_mac_address);
       }
-    }
-    else
-    {
-      fprintf(fptr[*temp_port_no - 1], "Unknown Unicast the frame\n");
-      /* Unknown unicast the frame */
-      broadcast(*temp_port_no);
-      fprintf(fptr[*temp_port_no - 1], "\n");
-    }
+      break;
+    case FORWARD_CONTROL:
+      FRAME_LOG(port_no - 1, "Port - %d %s multicast group %s\n\n", port_no, (f->flags & FRAME_FLAG_MCAST_JOIN) ? "joined" : "left", f->dest_mac_address);
+      break;
+    case FORWARD_UNICAST:
+      FRAME_LOG(port_no - 1, "Unicast the frame to port - %d\n", result.dest_port);
+      /* restoring buffer, the fcs covers the frame as it was received */
+      buffer[port_no - 1][17] = ' ';
+      buffer[port_no - 1][35] = ' ';
+      /* unicast the frame */
+      unicast(result.dest_port, port_no, result.vlan_id);
+      FRAME_LOG(port_no - 1, "\n");
+      break;
+    case FORWARD_FLOOD:
+      if(result.flood == FLOOD_BROADCAST)
+        FRAME_LOG(port_no - 1, "Broadcasting the frame:\n");
+      else if(result.flood == FLOOD_MULTICAST)
+        FRAME_LOG(port_no - 1, "Multicast the frame to the members of group %s:\n", f->dest_mac_address);
+      else if(result.flood == FLOOD_UNREGISTERED)
+        FRAME_LOG(port_no - 1, "Unregistered multicast group, flooding the frame:\n");
+      else
+        FRAME_LOG(port_no - 1, "Unknown Unicast the frame\n");
+      /* restoring buffer, the fcs covers the frame as it was received */
+      buffer[port_no - 1][17] = ' ';
+      buffer[port_no - 1][35] = ' ';
+      broadcast(port_no, result.port_mask, result.vlan_id);
+      FRAME_LOG(port_no - 1, "\n");
+      break;
   }
-  /* when thread is killed release all memory */
-  pthread_detach(pthread_self());
 }
 
 /*
  * Function    : init_port
  * @params     : port_no -> port_no to open its related message queues
- * Description : This function openes two message queues related to port port_no and created seperate thread for each port so that each port will listen for incoming frames
+ * Description : This function openes two message queues related to port port_no and starts the egress scheduler of the port, its frames are received by the ingress worker
  * */
 void init_port(int port_no)
 {
-  /* open message queue and store its descriptor */
-  mq_fd[port_no - 1] = mq_open(recv_mq[port_no - 1], _FLAGS, 0777, &mq_port_attr);
+  /* open message queue and store its descriptor, a stack port receives what the peer switch sends to its end of the link */
+  char peer_mq[64];
+  if(is_stack_port(port_no - 1))
+  {
+    stack_peer_mq(port_no - 1, peer_mq, sizeof(peer_mq));
+    mq_fd[port_no - 1] = mq_open(peer_mq, _FLAGS, 0777, &mq_port_attr);
+  }
+  else
+  {
+    mq_fd[port_no - 1] = mq_open(recv_mq[port_no - 1], _FLAGS, 0777, &mq_port_attr);
+  }
   if(mq_fd[port_no - 1] == -1)
   {
     perror("error in mq_open()");
@@ -230,8 +327,8 @@ void init_port(int port_no)
     return;
   }
 
-  /* create thread for each port to listen for incoming frames */
-  pthread_create(&id[port_no - 1], NULL, listen_port, &port[port_no - 1]);
+  /* scheduler thread sending queued frames to the port */
+  start_egress(port_no);
 }
 
 /*
@@ -255,9 +352,167 @@ void open_file(int port_no)
   fprintf(fptr[port_no - 1], "+----------------------------------------------------------------+\n");
 }
 
+/*
+ * Function    : reattach_stations
+ * Description : On a warm start the port state in shared memory is kept as it was. Stations that exited while no switch was
+ *               running could not signal us, so their ports are disconnected here and their mac_table entries and
+ *               multicast memberships removed.
+ * */
+void reattach_stations()
+{
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    pid_t station_pid = is_connected(i);
+    if(station_pid && kill(station_pid, 0) == -1 && errno == ESRCH)
+    {
+      flush_port_from_mac_table(lag_logical_port(i+1));
+      multicast_remove_port(i+1);
+      disconnect_port(i+1);
+      fprintf(fptr[i], "Station with pid %d left during warm restart, port - %d is disconnected\n", station_pid, i+1);
+    }
+  }
+}
+
+/*
+ * Function    : station_leaves
+ * @params     : arg -> unused
+ * Description : Removes the mac_table entries and multicast memberships of the ports whose station left and disconnects
+ *               them, each time the SIGUSR1 handler posts leave_sem, until stop_station_leaves()
+ * */
+static void *station_leaves(void *arg)
+{
+  /* switch signals are handled by the menu thread */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGUSR1);
+  sigaddset(&set, SIGHUP);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  while(1)
+  {
+    while(sem_wait(&leave_sem) == -1 && errno == EINTR);
+    unsigned int ports = __atomic_exchange_n(&leaving_ports, 0, __ATOMIC_ACQUIRE);
+    for(int i=0; i<MAX_PORTS; i++)
+    {
+      if(ports & (1u << i))
+      {
+        /* the station's address is learned in every vlan it sent frames in, on the port or on its LAG */
+        flush_port_from_mac_table(lag_logical_port(i+1));
+        multicast_remove_port(i+1);
+        disconnect_port(i+1);
+      }
+    }
+    /* stations that left just before the stop are cleaned up first */
+    if(!leave_running)
+    {
+      return NULL;
+    }
+  }
+}
+
+/*
+ * Function    : start_station_leaves
+ * Output      : 0 -> thread started, -1 -> thread error
+ * */
+int start_station_leaves()
+{
+  sem_init(&leave_sem, 0, 0);
+  leave_running = 1;
+  if(pthread_create(&leave_id, NULL, station_leaves, NULL) != 0)
+  {
+    perror("Error in pthread_create()");
+    leave_running = 0;
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Function    : stop_station_leaves
+ * Description : Stops the station leave thread once it has cleaned up the ports already signalled
+ * */
+void stop_station_leaves()
+{
+  if(!leave_running)
+  {
+    return;
+  }
+  leave_running = 0;
+  sem_post(&leave_sem);
+  pthread_join(leave_id, NULL);
+  sem_destroy(&leave_sem);
+}
+
+/*
+ * Function    : begin_switch_stop
+ * Description : Lets only the first caller of switch_off() or switch_warm_restart() go on. A later caller, the menu
+ *               or the stop thread, waits here until the first one exits the process
+ * */
+static void begin_switch_stop()
+{
+  if(__atomic_exchange_n(&switch_stopping, 1, __ATOMIC_ACQ_REL))
+  {
+    while(1)
+    {
+      pause();
+    }
+  }
+}
+
+/*
+ * Function    : switch_stopper
+ * @params     : arg -> unused
+ * Description : Waits for the SIGINT or SIGHUP handler to post stop_sem, then switches off or warm restarts the switch
+ *               and exits the process
+ * */
+static void *switch_stopper(void *arg)
+{
+  /* switch signals are handled by the menu thread */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGUSR1);
+  sigaddset(&set, SIGHUP);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  while(sem_wait(&stop_sem) == -1 && errno == EINTR);
+  if(stop_request == STOP_WARM_RESTART)
+  {
+    printf("\nWARM RESTARTING SWITCH.....\n");
+    switch_warm_restart();
+  }
+  else
+  {
+    printf("\nTERMINATING SWITCH.....\n");
+    switch_off();
+  }
+  exit(0);
+}
+
+/*
+ * Function    : start_switch_stopper
+ * Output      : 0 -> thread started, -1 -> thread error
+ * Description : Started before the SIGINT and SIGHUP handlers are installed, the thread runs until the process exits
+ * */
+int start_switch_stopper()
+{
+  pthread_t stop_id;
+  sem_init(&stop_sem, 0, 0);
+  if(pthread_create(&stop_id, NULL, switch_stopper, NULL) != 0)
+  {
+    perror("Error in pthread_create()");
+    return -1;
+  }
+  pthread_detach(stop_id);
+  return 0;
+}
+
 /*
  * Function    : init_ports
  * Descripton  : This function will initialise each port like enabling the port, make sure every port is disconnected when switch is on and calls init_port function.
+ *               On a warm start ports keep their enabled/connected state, and their configuration and the mac_table are
+ *               reloaded from the snapshot before forwarding starts.
  * */
 void init_ports()
 {
@@ -268,17 +523,84 @@ void init_ports()
 
   init_mac_table();
 
+  init_storm_control();
+
+  init_egress();
+
+  init_multicast_table();
+
+  init_vlans();
+
+  init_lags();
+
+  init_mirror();
+
+  init_top_talkers();
+
+  init_acls();
+
+  init_ingress();
+
+  init_mac_learning();
+
+  if(warm_start)
+  {
+    int count = load_mac_table_snapshot();
+    if(count == -1)
+    {
+      printf("No valid mac_table snapshot found, starting with the default configuration and an empty mac_table\n");
+    }
+    else
+    {
+      printf("Warm start: reloaded the port configuration and %d mac_table entries\n", count);
+    }
+  }
+
   for(int i = 0; i < MAX_PORTS; i++)
   {
-    port[i]=i+1;
     /* opening file related to each port*/
     open_file(i+1);
-    /* enable port */
-    enable_port(i+1);
-    disconnect_port(i+1);
+    if(!warm_start)
+    {
+      /* enable port */
+      enable_port(i+1);
+      disconnect_port(i+1);
+    }
+  }
+
+  if(warm_start)
+  {
+    reattach_stations();
+  }
+
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    if(is_stack_port(i))
+    {
+      /* the switch itself is the station of a stack port, so no station can attach to it */
+      connect_port(i+1, "");
+      /* frames of every vlan cross the stack */
+      set_trunk_port(i+1, DEFAULT_VLAN, "all");
+    }
+  }
+
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
     /* initialise each port */
     init_port(i+1);
   }
+
+  /* cleans up after the stations that leave */
+  start_station_leaves();
+
+  /* adds the new addresses of ports with deferred learning */
+  start_mac_learner();
+
+  /* one worker receives the frames of every port, served by deficit round robin */
+  start_ingress(mq_fd, buffer, forward_port_frame);
+
+  /* samples the port mqueues opened above */
+  start_queue_monitor();
 }
 
 /*
@@ -287,6 +609,18 @@ void init_ports()
  * */
 void switch_off()
 {
+  begin_switch_stop();
+  /* stop forwarding before the mac_table, mqueues and log files it uses go away */
+  stop_ingress();
+  stop_egress();
+  /* save the frames still in the capture ring */
+  stop_mirror();
+  stop_sflow();
+  stop_top_talkers();
+  stop_queue_monitor();
+  stop_mac_learner();
+  stop_station_leaves();
+
   /* freeing entries from hash table */
   for(int i=0; i<TABLE_SIZE; i++)
   {
@@ -299,10 +633,14 @@ void switch_off()
       temp = mac_table[i];
     }
   }
+  /* the worker is stopped, the entries removed since its last frame are freed too */
+  mac_table_quiescent();
+  free_multicast_table();
+  free_acls();
 
   for(int i=0; i<MAX_PORTS; i++)
   {
-    if(is_connected(i))
+    if(is_connected(i) && !is_stack_port(i))
     {
       /* inform all connected stations that switch has been closed */
       kill(is_connected(i), SIGUSR1);
@@ -312,10 +650,6 @@ void switch_off()
     fclose(fptr[i]);
   }
 
-  shm_switch_pid_ptr = NULL;
-  shm_en_dis_ports_ptr = NULL;
-  shm_con_discon_ports_ptr = NULL;
-
   /* unlink all message queus */
   for(int i=0; i<MAX_PORTS; i++)
   {
@@ -325,16 +659,19 @@ void switch_off()
 
   for(int i=0; i<MAX_PORTS; i++)
   {
-    sem_close(s_recv[i+1]);
-    sem_close(s_send[i+1]);
+    sem_close(s_recv[i]);
+    sem_close(s_send[i]);
     sem_unlink(sem_recv_names[i]);
     sem_unlink(sem_send_names[i]);
   }
   
-  /* unmap the shared memory */
-  munmap(NULL, SWITCH_PID_SIZE);
-  munmap(NULL, CON_DISCON_PORTS_SIZE);
-  munmap(NULL, EN_DIS_PORTS_SIZE);
+  /* unmap the shared memory, no thread is left to use it */
+  shm_unmap(shm_switch_pid_ptr, SWITCH_PID_SIZE);
+  shm_unmap(shm_con_discon_ports_ptr, CON_DISCON_PORTS_SIZE);
+  shm_unmap(shm_en_dis_ports_ptr, EN_DIS_PORTS_SIZE);
+  shm_switch_pid_ptr = NULL;
+  shm_en_dis_ports_ptr = NULL;
+  shm_con_discon_ports_ptr = NULL;
   
   /* close shared memory fds */
   close(shm_switch_pid_fd);
@@ -342,10 +679,83 @@ void switch_off()
   close(shm_con_discon_ports_fd);
 
   /* unlink shared memories */
-  shm_unlink(SWITCH_PID);
-  shm_unlink(EN_DIS_PORTS);
-  shm_unlink(CON_DISCON_PORTS);
+  shm_remove(instance_name(SWITCH_PID));
+  shm_remove(instance_name(EN_DIS_PORTS));
+  shm_remove(instance_name(CON_DISCON_PORTS));
+  close_port_stats(1);
+  /* the flight recorder is left in place for flight_dump */
+
+  /* a cold switch off must not let a later -w start pick up an old mac_table */
+  remove_mac_table_snapshot();
+}
 
+/*
+ * Function    : switch_warm_restart
+ * Description : Stops forwarding and exits the switch process while leaving mqueues, semaphores, shared memories and
+ *               connected stations in place. The port configuration and the mac_table are saved to a snapshot file, so a
+ *               new switch started with -w reattaches to everything and continues forwarding. Frames sent meanwhile wait in the port mqueues.
+ * */
+void switch_warm_restart()
+{
+  begin_switch_stop();
+  /* stop the ingress worker, it finishes the round it is in and the frames not received stay in the mqueues */
+  stop_ingress();
+  /* frames already forwarded are handed to the port mqueues before exiting */
+  stop_egress();
+  stop_mirror();
+  stop_sflow();
+  stop_top_talkers();
+  stop_queue_monitor();
+  stop_mac_learner();
+  stop_station_leaves();
+
+  int count = save_mac_table_snapshot();
+  printf("Saved %d mac_table entries, start the switch with -w to resume\n", count);
+
+  /* freeing entries from hash table */
+  for(int i=0; i<TABLE_SIZE; i++)
+  {
+    mac_table_t *temp = mac_table[i];
+
+    while(temp)
+    {
+      mac_table[i] = temp->next;
+      free(temp);
+      temp = mac_table[i];
+    }
+  }
+  /* the worker is stopped, the entries removed since its last frame are freed too */
+  mac_table_quiescent();
+  free_multicast_table();
+  free_acls();
+
+  for(int i=0; i<MAX_PORTS; i++)
+  {
+    fprintf(fptr[i], "Switch is warm restarting, port state is kept\n");
+    mq_close(mq_fd[i]);
+    mq_close(mq_send_fd[i]);
+    fclose(fptr[i]);
+  }
+
+  for(int i=0; i<MAX_PORTS; i++)
+  {
+    sem_close(s_recv[i]);
+    sem_close(s_send[i]);
+  }
+
+  /* unmap the shared memory, they are not unlinked so the next switch process finds them as they are */
+  shm_unmap(shm_switch_pid_ptr, SWITCH_PID_SIZE);
+  shm_unmap(shm_con_discon_ports_ptr, CON_DISCON_PORTS_SIZE);
+  shm_unmap(shm_en_dis_ports_ptr, EN_DIS_PORTS_SIZE);
+  shm_switch_pid_ptr = NULL;
+  shm_en_dis_ports_ptr = NULL;
+  shm_con_discon_ports_ptr = NULL;
+
+  close(shm_switch_pid_fd);
+  close(shm_en_dis_ports_fd);
+  close(shm_con_discon_ports_fd);
+  close_port_stats(0);
+  close_flight_recorder();
 }
 
 /*
@@ -353,13 +763,33 @@ void switch_off()
  * @params     : sig      -> signal number
  *               info     -> extra information about the signal being handled
  *               ucontext -> user context of the process
- * Description : When ctrl+c is pressed, this function will handle that SIGINT signal and terminates switch by calling switch_off function
+ * Description : When ctrl+c is pressed, this function will handle that SIGINT signal and has the stop thread terminate
+ *               the switch by calling switch_off function
  * */
 void switch_sigaction_terminator(int sig, siginfo_t *info, void *ucontext)
 {
-  printf("\nTERMINATING SWITCH.....\n");
-  switch_off();
-  exit(0);
+  if(stop_request == 0)
+  {
+    stop_request = STOP_SWITCH_OFF;
+    sem_post(&stop_sem);
+  }
+}
+
+/*
+ * Function    : switch_sigaction_warm_restart
+ * @params     : sig      -> signal number
+ *               info     -> extra information about the signal being handled
+ *               ucontext -> user context of the process
+ * Description : SIGHUP asks for a warm restart, so an upgrade script can replace the switch binary without the menu.
+ *               The stop thread carries it out
+ * */
+void switch_sigaction_warm_restart(int sig, siginfo_t *info, void *ucontext)
+{
+  if(stop_request == 0)
+  {
+    stop_request = STOP_WARM_RESTART;
+    sem_post(&stop_sem);
+  }
 }
 
 /*
@@ -367,47 +797,147 @@ void switch_sigaction_terminator(int sig, siginfo_t *info, void *ucontext)
  * @params     : sig      -> signal number
  *               info     -> extra information about the signal being handled
  *               ucontext -> user context of the process
- * Description : It handles SIGUSR1 signal generated by station. It removes respective station's entry from mac_table and disconnect that station from the port.
+ * Description : It handles SIGUSR1 signal generated by station. It finds the ports of the station and hands them to the
+ *               station leave thread, which removes the entries learned on them from mac_table and disconnects them.
+ *               Only async-signal-safe work is done here: reading the port table, an atomic or and sem_post().
  * */
 void switch_sigaction_handler(int sig, siginfo_t *info, void *ucontext)
 {
   pid_t station_pid = info->si_pid;
-  /* gets mac_address of respective station using station's process id (used shared memory to store pid,mac_address pair)*/
-  char *mac_address = get_station_mac_addr(station_pid);
-  if(strlen(mac_address) != 0)
+  unsigned int ports = 0;
+  /* a process attached several times through libvnstation queues the signal with the ports it leaves (bit 0 for
+   * port 1), its other attachments stay connected */
+  int port_mask = info->si_code == SI_QUEUE ? info->si_value.sival_int : 0;
+  if(!leave_running || shm_con_discon_ports_ptr == NULL)
+  {
+    return;
+  }
+  /* gets the ports of respective station using station's process id (used shared memory to store pid,mac_address
+   * pair), a station aggregating several ports is connected on each of them */
+  for(int i=0; i<MAX_PORTS; i++)
   {
-    delete_entry_from_mac_table(mac_address);
+    if((!port_mask || (port_mask & (1 << i))) && is_connected(i) == station_pid)
+    {
+      ports |= 1u << i;
+    }
+  }
+  if(ports)
+  {
+    __atomic_fetch_or(&leaving_ports, ports, __ATOMIC_RELEASE);
+    sem_post(&leave_sem);
   }
-  int station_port_num = get_station_port_num(station_pid);
-  //delete_entry_from_mac_table((con_discon_t *) shm_con_discon_ports_ptr[station_port_num - 1]->mac_address);
-  disconnect_port(station_port_num);
 }
 
 /*
  * Function    : main
+ * @params     : argc -> count of command line arguments
+ *               argv -> string array of all command line arguments
  * Description : It initialises shared memories, ports and displays switch_user_menu
  * */
-int main()
+int main(int argc, char *argv[])
 {
   int ret;
 
+  init_stack_ports();
+  for(int i=1; i<argc; i++)
+  {
+    if(strcmp(argv[i], "-w") == 0)
+    {
+      warm_start = 1;
+    }
+    else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+    {
+      int switch_id = atoi(argv[++i]);
+      if(switch_id < 0 || switch_id > MAX_SWITCH_ID)
+      {
+        printf("Error: Switch number must be between 0 and %d\n", MAX_SWITCH_ID);
+        return EXIT_FAILURE;
+      }
+      set_switch_instance(switch_id);
+    }
+    else if(strcmp(argv[i], "-l") == 0)
+    {
+      frame_log = 1;
+    }
+    else if(strcmp(argv[i], "-M") == 0)
+    {
+      set_shm_page_policy(SHM_PAGES_ALL);
+    }
+    else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+    {
+      /* checked against the switch number, so -n has to come first */
+      if(parse_stack_port(argv[++i]) == -1)
+      {
+        return EXIT_FAILURE;
+      }
+    }
+    else
+    {
+      printf("Usage: ./switch [-w] [-n <SWITCH_NO>] [-l] [-M] [-t <PORT>:<PEER_SWITCH_NO>:<PEER_PORT>]...\n");
+      printf("  -w : warm start, resume the ports and mac_table of the previous switch process\n");
+      printf("  -n : number of this switch when several switches run side by side (default 0)\n");
+      printf("  -l : log every frame and its forwarding to the port log files, for debugging\n");
+      printf("  -M : back the shared memories with huge pages, prefaulted and locked, as far as the system allows\n");
+      printf("  -t : stack PORT to PEER_PORT of another switch, that switch is started with the reverse -t\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  /* every ipc object and log file of this switch is named after its number */
+  apply_instance_names(send_mq, MAX_PORTS);
+  apply_instance_names(recv_mq, MAX_PORTS);
+  apply_instance_names(file_name, MAX_PORTS);
+  apply_instance_names(sem_recv_names, MAX_PORTS);
+  apply_instance_names(sem_send_names, MAX_PORTS);
 
   /* initialising sigaction structs */
-  struct sigaction sa1, sa2;
+  struct sigaction sa1, sa2, sa3;
   sa1.sa_sigaction = switch_sigaction_handler;
+  sigemptyset(&sa1.sa_mask);
   sa1.sa_flags = SA_SIGINFO;
   sa1.sa_restorer = NULL;
 
   sa2.sa_sigaction = switch_sigaction_terminator;
+  sigemptyset(&sa2.sa_mask);
   sa2.sa_flags = SA_SIGINFO;
   sa2.sa_restorer = NULL;
 
+  sa3.sa_sigaction = switch_sigaction_warm_restart;
+  sigemptyset(&sa3.sa_mask);
+  sa3.sa_flags = SA_SIGINFO;
+  sa3.sa_restorer = NULL;
+
   /* initialising shared_memories */
   if(init_shared_memories() == EXIT_FAILURE)
   {
     return EXIT_FAILURE;
   }
 
+  /* port counters are kept across a warm restart */
+  if(init_port_stats(warm_start) == EXIT_FAILURE)
+  {
+    return EXIT_FAILURE;
+  }
+
+  /* the records of the previous switch process stay readable until overwritten */
+  if(init_flight_recorder() == EXIT_FAILURE)
+  {
+    printf("Flight recorder is not available, frames are not recorded\n");
+  }
+
+  /* what the shared memories were backed with, huge pages may not have been obtained */
+  if(get_shm_page_policy())
+  {
+    display_shm_pages();
+  }
+
+  /* pick the crc32c implementation used to check frame fcs */
+  crc32c_init();
+  printf("Frame check sequence: crc32c (%s)\n", crc32c_impl_name());
+  /* and the frame classification kernel of the forwarding decision */
+  classify_init();
+  printf("Frame classification: %s\n", classify_impl_name());
+
   /* updating switch_pid shared memory with switch process id */
   pid_t *temp_pid_ptr = (pid_t *) shm_switch_pid_ptr;
   *temp_pid_ptr = getpid();
@@ -417,9 +947,16 @@ int main()
   /* intialise ports */
   init_ports();
 
-  /* handle SIGUSR1 and SIGINT signals */
+  /* switches off or warm restarts the switch when SIGINT or SIGHUP arrives */
+  if(start_switch_stopper() == -1)
+  {
+    return EXIT_FAILURE;
+  }
+
+  /* handle SIGUSR1, SIGINT and SIGHUP signals */
   sigaction(SIGUSR1, &sa1, NULL);
   sigaction(SIGINT, &sa2, NULL);
+  sigaction(SIGHUP, &sa3, NULL);
 
   /* display switch_user_menu */
   if( switch_user_menu() == EXIT_SUCCESS)
@@ -6,6 +6,20 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "egress_sched.h"
+#include "multicast_table.h"
+#include "mac_util.h"
+#include "vlan.h"
+#include "lag.h"
+#include "stack.h"
+#include "mirror.h"
+#include "sflow.h"
+#include "top_talkers.h"
+#include "queue_monitor.h"
+#include "acl.h"
+#include "ingress_sched.h"
+#include "mac_learning.h"
+
 /* function declarations */
 int is_enabled(int);
 void enable_port(int);
@@ -13,6 +27,587 @@ void disable_port(int);
 void display_en_ports();
 void display_mac_table();
 void switch_off();
+void switch_warm_restart();
+void display_port_stats();
+void set_storm_control(int, int, unsigned int, unsigned int);
+void display_storm_control();
+void flush_port_from_mac_table(int);
+void mac_table_changed();
+void add_static_mac_address(int, int, char *);
+void delete_entry_from_mac_table(int, char *);
+int is_available(int, char *);
+
+/*
+ * Function    : read_number
+ * @params     : prompt -> text displayed before reading the number
+ *               min    -> smallest accepted value
+ *               max    -> largest accepted value
+ *               value  -> to store the number read
+ * Output      : 0 -> valid number stored in value
+ *               -1 -> invalid input, an error message has been displayed
+ * Description : Reads one number from stdin for the configuration menus
+ * */
+static int read_number(const char *prompt, long min, long max, long *value)
+{
+  char input_buffer[50];
+  char *end_ptr;
+
+  printf("%s", prompt);
+  if(fgets(input_buffer, 50, stdin) == NULL || strlen(input_buffer) <= 1)
+  {
+    printf("Invalid input\n\n");
+    return -1;
+  }
+  input_buffer[strlen(input_buffer) - 1] = '\0';
+  *value = strtol(input_buffer, &end_ptr, 10);
+  if(*end_ptr != '\0' || *value < min || *value > max)
+  {
+    printf("Invalid input.. Input value between %ld and %ld are allowed\n\n", min, max);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Function    : read_mac_address
+ * @params     : prompt      -> text displayed before reading the mac address
+ *               mac_address -> to store the mac address read (18 bytes)
+ * Output      : 0 -> valid mac address stored, -1 -> invalid input
+ * */
+static int read_mac_address(const char *prompt, char *mac_address)
+{
+  char input_buffer[50];
+
+  printf("%s", prompt);
+  if(fgets(input_buffer, 50, stdin) == NULL)
+  {
+    return -1;
+  }
+  input_buffer[strcspn(input_buffer, "\n")] = '\0';
+  if(strlen(input_buffer) != 17)
+  {
+    printf("Error: Invalid MAC address\n\n");
+    return -1;
+  }
+  strcpy(mac_address, input_buffer);
+  return 0;
+}
+
+/*
+ * Function    : configure_storm_control
+ * Description : Reads port, traffic class, rate and burst and configures the storm control token bucket
+ * */
+static void configure_storm_control()
+{
+  long port_num, traffic_class, rate, burst = 0;
+
+  display_storm_control();
+  if(read_number("Enter port number : ", 1, 4, &port_num) == -1)
+    return;
+  if(read_number("Traffic class [1] Broadcast [2] Multicast [3] Unknown Unicast : ", 1, 3, &traffic_class) == -1)
+    return;
+  if(read_number("Rate in frames per second (0 to disable) : ", 0, 10000000, &rate) == -1)
+    return;
+  if(rate && read_number("Burst in frames : ", 1, 10000000, &burst) == -1)
+    return;
+
+  set_storm_control(port_num, traffic_class - 1, rate, burst);
+  printf("Storm control updated on port - %ld\n\n", port_num);
+}
+
+/*
+ * Function    : configure_egress_scheduler
+ * Description : Reads port and scheduling mode (and class weights for weighted round robin) and configures the port
+ * */
+static void configure_egress_scheduler()
+{
+  long port_num, mode, weight;
+  unsigned int weights[EGRESS_CLASSES];
+  char prompt[64];
+
+  display_egress();
+  if(read_number("Enter port number : ", 1, 4, &port_num) == -1)
+    return;
+  if(read_number("Scheduler [1] Strict Priority [2] Weighted Round Robin : ", 1, 2, &mode) == -1)
+    return;
+  if(mode == 1)
+  {
+    set_egress_scheduler(port_num, EGRESS_STRICT, NULL);
+  }
+  else
+  {
+    for(int c = EGRESS_CLASSES - 1; c >= 0; c--)
+    {
+      snprintf(prompt, sizeof(prompt), "Weight of class %d (frames per round) : ", c);
+      if(read_number(prompt, 1, 1000, &weight) == -1)
+        return;
+      weights[c] = weight;
+    }
+    set_egress_scheduler(port_num, EGRESS_WRR, weights);
+  }
+  printf("Egress scheduler updated on port - %ld\n\n", port_num);
+}
+
+/*
+ * Function    : configure_ingress_scheduler
+ * Description : Reads the weight of a port, or the quantum and the cap per round of the deficit round robin
+ * */
+static void configure_ingress_scheduler()
+{
+  long choice, port_num, weight, unit, quantum, cap;
+
+  display_ingress();
+  if(read_number("[1] Port weight [2] Quantum [3] Frames per port per round : ", 1, 3, &choice) == -1)
+    return;
+  if(choice == 1)
+  {
+    if(read_number("Enter port number : ", 1, 4, &port_num) == -1)
+      return;
+    if(read_number("Weight (quanta per round) : ", 1, INGRESS_MAX_WEIGHT, &weight) == -1)
+      return;
+    set_ingress_weight(port_num, weight);
+  }
+  else if(choice == 2)
+  {
+    if(read_number("Quantum in [1] Frames [2] Bytes : ", 1, 2, &unit) == -1)
+      return;
+    if(unit == 1 && read_number("Frames per round per unit of weight : ", 1, 1000, &quantum) == -1)
+      return;
+    if(unit == 2 && read_number("Bytes per round per unit of weight : ", 100, 100000, &quantum) == -1)
+      return;
+    set_ingress_quantum(unit == 1 ? INGRESS_QUANTUM_FRAMES : INGRESS_QUANTUM_BYTES, quantum);
+  }
+  else
+  {
+    if(read_number("Frames of one port per round at most : ", 1, 10000, &cap) == -1)
+      return;
+    set_ingress_cap(cap);
+  }
+  display_ingress();
+}
+
+/*
+ * Function    : configure_mac_learning
+ * Description : Reads the learning policy of a port, or adds or deletes a static mac_table entry
+ * */
+static void configure_mac_learning()
+{
+  long choice, port_num, mode, limit = 0, vlan_id;
+  char mac_address[18];
+
+  display_mac_learning();
+  if(read_number("[1] Port policy [2] Add static address [3] Delete address [4] Back : ", 1, 4, &choice) == -1 ||
+     choice == 4)
+    return;
+  if(choice == 1)
+  {
+    if(read_number("Enter port number : ", 1, 4, &port_num) == -1)
+      return;
+    if(read_number("Learning [1] On forwarding [2] Static only [3] Deferred to the learner : ", 1, 3, &mode) == -1)
+      return;
+    if(mode != 2 && read_number("New addresses per second (0 for no limit) : ", 0, 10000000, &limit) == -1)
+      return;
+    set_mac_learning(port_num, mode == 1 ? LEARN_ENABLED : mode == 2 ? LEARN_DISABLED : LEARN_DEFERRED, limit);
+    printf("MAC learning updated on port - %ld\n\n", port_num);
+    return;
+  }
+
+  if(read_number("Enter vlan : ", 1, MAX_VLANS - 2, &vlan_id) == -1)
+    return;
+  if(read_mac_address("MAC address : ", mac_address) == -1)
+    return;
+  if(choice == 3)
+  {
+    if(!is_available(vlan_id, mac_address))
+    {
+      printf("%s is not in the mac_table of vlan %ld\n\n", mac_address, vlan_id);
+      return;
+    }
+    delete_entry_from_mac_table(vlan_id, mac_address);
+    printf("%s deleted from the mac_table of vlan %ld\n\n", mac_address, vlan_id);
+    return;
+  }
+  if(is_multicast_mac_address(mac_address))
+  {
+    printf("Error: %s is a group address, see Configure Multicast Groups\n\n", mac_address);
+    return;
+  }
+  if(read_number("Enter port number : ", 1, 4, &port_num) == -1)
+    return;
+  /* an address behind a LAG member is reached through the LAG */
+  add_static_mac_address(lag_logical_port(port_num), vlan_id, mac_address);
+  printf("%s added to the mac_table of vlan %ld on port - %ld\n\n", mac_address, vlan_id, port_num);
+}
+
+/*
+ * Function    : configure_multicast_groups
+ * Description : Displays the multicast table and adds or removes a static member port of a group
+ * */
+static void configure_multicast_groups()
+{
+  long action, port_num;
+  char group[18];
+
+  display_multicast_table();
+  if(read_number("[1] Add Static Member [2] Remove Static Member [3] Back : ", 1, 3, &action) == -1 || action == 3)
+    return;
+  if(read_mac_address("Enter multicast group MAC address : ", group) == -1)
+    return;
+  if(!is_multicast_mac_address(group) || strcmp(group, "FF:FF:FF:FF:FF:FF") == 0)
+  {
+    printf("Error: %s is not a multicast group address\n\n", group);
+    return;
+  }
+  if(read_number("Enter port number : ", 1, 4, &port_num) == -1)
+    return;
+
+  if(action == 1)
+  {
+    if(multicast_add_static(group, port_num) == -1)
+    {
+      printf("Error: multicast table is full (%d groups), port - %ld not added to group %s\n\n", MAX_MULTICAST_GROUPS,
+             port_num, group);
+      return;
+    }
+    printf("Port - %ld added to group %s\n\n", port_num, group);
+  }
+  else
+  {
+    multicast_remove_static(group, port_num);
+    printf("Port - %ld removed from group %s\n\n", port_num, group);
+  }
+}
+
+/*
+ * Function    : configure_vlans
+ * Description : Displays the vlan configuration and makes a port an access port of one vlan or a trunk port
+ * */
+static void configure_vlans()
+{
+  long action, port_num, vlan_id;
+  char allowed[256];
+
+  display_vlans();
+  if(read_number("[1] Access Port [2] Trunk Port [3] Back : ", 1, 3, &action) == -1 || action == 3)
+    return;
+  if(read_number("Enter port number : ", 1, 4, &port_num) == -1)
+    return;
+  if(read_number(action == 1 ? "Access vlan : " : "Native vlan : ", 1, MAX_VLANS - 2, &vlan_id) == -1)
+    return;
+
+  if(action == 1)
+  {
+    set_access_port(port_num, vlan_id);
+    mac_table_changed();
+    printf("Port - %ld is an access port of vlan %ld\n\n", port_num, vlan_id);
+    return;
+  }
+
+  printf("Tagged vlans (e.g. 10,20,30-39 or all) : ");
+  if(fgets(allowed, sizeof(allowed), stdin) == NULL)
+    return;
+  allowed[strcspn(allowed, "\n")] = '\0';
+  if(set_trunk_port(port_num, vlan_id, allowed) == -1)
+  {
+    printf("Invalid vlan list.. vlans between 1 and %d are allowed\n\n", MAX_VLANS - 2);
+    return;
+  }
+  mac_table_changed();
+  printf("Port - %ld is a trunk port\n\n", port_num);
+}
+
+/*
+ * Function    : configure_lags
+ * Description : Displays the LAGs and adds a port to a LAG or removes it from its LAG
+ * */
+static void configure_lags()
+{
+  long action, lag_no, port_num;
+
+  display_lags();
+  if(read_number("[1] Add Port to LAG [2] Remove Port from LAG [3] Back : ", 1, 3, &action) == -1 || action == 3)
+    return;
+  if(read_number("Enter port number : ", 1, 4, &port_num) == -1)
+    return;
+
+  if(action == 1)
+  {
+    if(read_number("Enter LAG number : ", 1, MAX_LAGS, &lag_no) == -1)
+      return;
+    int old_port = lag_logical_port(port_num);
+    lag_add_port(lag_no, port_num);
+    /* cached flows of the port learned their source on the port alone */
+    mac_table_changed();
+    /* addresses learned on the port alone are relearned on the LAG */
+    if(!IS_LAG_PORT(old_port))
+    {
+      flush_port_from_mac_table(port_num);
+    }
+    printf("Port - %ld added to LAG %ld\n\n", port_num, lag_no);
+    return;
+  }
+
+  int lag_port = lag_logical_port(port_num);
+  int left = lag_remove_port(port_num);
+  if(left == -1)
+  {
+    printf("Port - %ld is not in a LAG\n\n", port_num);
+    return;
+  }
+  mac_table_changed();
+  /* the remaining members keep serving the addresses of the LAG, only an empty LAG forgets them */
+  if(left == 0)
+  {
+    flush_port_from_mac_table(lag_port);
+  }
+  printf("Port - %ld removed from LAG %d\n\n", port_num, LAG_NO(lag_port));
+}
+
+/*
+ * Function    : read_port_list
+ * @params     : prompt -> text displayed before reading the list
+ *               ports  -> to store the ports read (bit 0 -> port 1)
+ * Output      : 0 -> valid list stored in ports, -1 -> invalid input
+ * Description : Reads ports like "1,3" or "all", an empty line is no port
+ * */
+static int read_port_list(const char *prompt, unsigned int *ports)
+{
+  char input_buffer[50];
+
+  printf("%s", prompt);
+  if(fgets(input_buffer, 50, stdin) == NULL)
+  {
+    return -1;
+  }
+  input_buffer[strcspn(input_buffer, "\n")] = '\0';
+  *ports = 0;
+  if(strcmp(input_buffer, "all") == 0)
+  {
+    *ports = 0xF;
+    return 0;
+  }
+  for(char *p = input_buffer; *p; p++)
+  {
+    if(*p >= '1' && *p <= '4')
+    {
+      *ports |= 1u << (*p - '1');
+    }
+    else if(*p != ',' && *p != ' ')
+    {
+      printf("Invalid input.. Ports between 1 and 4 are allowed\n\n");
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Function    : configure_port_mirroring
+ * Description : Displays the mirrored ports and starts or stops capturing them to a pcapng file
+ * */
+static void configure_port_mirroring()
+{
+  long action;
+  unsigned int ingress_ports, egress_ports;
+  char path[256];
+
+  display_mirror();
+  if(read_number("[1] Start Capture [2] Stop Capture [3] Back : ", 1, 3, &action) == -1 || action == 3)
+    return;
+  if(action == 2)
+  {
+    stop_mirror();
+    display_mirror();
+    return;
+  }
+
+  printf("Capture file : ");
+  if(fgets(path, sizeof(path), stdin) == NULL)
+    return;
+  path[strcspn(path, "\n")] = '\0';
+  if(path[0] == '\0')
+  {
+    printf("Invalid input\n\n");
+    return;
+  }
+  if(read_port_list("Ingress ports (e.g. 1,3 or all) : ", &ingress_ports) == -1)
+    return;
+  if(read_port_list("Egress ports (e.g. 1,3 or all) : ", &egress_ports) == -1)
+    return;
+  if((ingress_ports | egress_ports) == 0)
+  {
+    printf("No port to mirror\n\n");
+    return;
+  }
+  if(start_mirror(path, ingress_ports, egress_ports) == 0)
+  {
+    printf("Capturing to %s\n\n", path);
+  }
+}
+
+/*
+ * Function    : configure_sflow
+ * Description : Displays the sampling settings and starts, changes or stops sampling
+ * */
+static void configure_sflow()
+{
+  long action, rate, interval;
+  char collector[64];
+
+  display_sflow();
+  if(read_number("[1] Start/Change Sampling [2] Stop Sampling [3] Back : ", 1, 3, &action) == -1 || action == 3)
+    return;
+  if(action == 2)
+  {
+    stop_sflow();
+    printf("sFlow sampling is disabled\n\n");
+    return;
+  }
+
+  if(read_number("Sample 1 in N frames, N : ", 1, 1000000, &rate) == -1)
+    return;
+  printf("Collector HOST:PORT (empty for 127.0.0.1:%d) : ", SFLOW_DEFAULT_PORT);
+  if(fgets(collector, sizeof(collector), stdin) == NULL)
+    return;
+  collector[strcspn(collector, "\n")] = '\0';
+  if(collector[0] == '\0')
+  {
+    strcpy(collector, "127.0.0.1");
+  }
+  if(read_number("Counter export interval in seconds : ", 1, 3600, &interval) == -1)
+    return;
+  if(start_sflow(rate, collector, interval) == 0)
+  {
+    display_sflow();
+  }
+}
+
+/*
+ * Function    : configure_slow_consumers
+ * Description : Displays and changes the slow consumer threshold and drop policy
+ * */
+static void configure_slow_consumers()
+{
+  long threshold, auto_drop;
+
+  display_queue_monitor();
+  if(read_number("Flag a station whose mqueue stays full for ms (0 disables) : ", 0, 3600000, &threshold) == -1)
+    return;
+  if(read_number("[1] Only report slow consumers [2] Drop frames to them when their mqueue is full : ", 1, 2,
+                 &auto_drop) == -1)
+    return;
+  set_slow_consumer_detection(threshold, auto_drop == 2);
+  display_queue_monitor();
+}
+
+/*
+ * Function    : read_text
+ * @params     : prompt -> text displayed before reading the line
+ *               text   -> to store the line read, without its newline
+ *               size   -> size of text
+ * Output      : 0 -> non empty line stored, -1 -> no input
+ * */
+static int read_text(const char *prompt, char *text, int size)
+{
+  printf("%s", prompt);
+  if(fgets(text, size, stdin) == NULL)
+  {
+    return -1;
+  }
+  text[strcspn(text, "\n")] = '\0';
+  if(text[0] == '\0')
+  {
+    printf("Invalid input\n\n");
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Function    : configure_acls
+ * Description : Displays the ACLs and adds or deletes a rule, sets the default action or clears the ACL of a port
+ * */
+static void configure_acls()
+{
+  long action, port_num, rule_no, permit;
+  char input_buffer[64];
+  acl_rule_t rule;
+
+  display_acls();
+  if(read_number("[1] Add Rule [2] Delete Rule [3] Default Action [4] Clear ACL [5] Back : ", 1, 5, &action) == -1 ||
+     action == 5)
+    return;
+  if(read_number("Enter port number : ", 1, 4, &port_num) == -1)
+    return;
+
+  if(action == 2)
+  {
+    if(read_number("Rule number : ", 1, MAX_ACL_RULE_NO, &rule_no) == -1)
+      return;
+    if(acl_delete_rule(port_num, rule_no) == -1)
+      printf("Port - %ld has no rule %ld\n\n", port_num, rule_no);
+    else
+      printf("Rule %ld deleted from the ACL of port - %ld\n\n", rule_no, port_num);
+    return;
+  }
+  if(action == 3)
+  {
+    if(read_number("Frames no rule matches [1] Permit [2] Deny : ", 1, 2, &permit) == -1)
+      return;
+    acl_set_default(port_num, permit == 1 ? ACL_PERMIT : ACL_DENY);
+    printf("Default action of port - %ld updated\n\n", port_num);
+    return;
+  }
+  if(action == 4)
+  {
+    acl_clear(port_num);
+    printf("ACL of port - %ld cleared\n\n", port_num);
+    return;
+  }
+
+  memset(&rule, 0, sizeof(rule));
+  if(read_number("Rule number (lower numbers are evaluated first) : ", 1, MAX_ACL_RULE_NO, &rule_no) == -1)
+    return;
+  rule.rule_no = rule_no;
+  if(read_number("[1] Permit [2] Deny : ", 1, 2, &permit) == -1)
+    return;
+  rule.action = permit == 1 ? ACL_PERMIT : ACL_DENY;
+  if(read_text("Source MAC (ADDRESS, ADDRESS/MASK, ADDRESS/PREFIX_LENGTH or any) : ", input_buffer,
+               sizeof(input_buffer)) == -1)
+    return;
+  if(acl_parse_mac_match(input_buffer, &rule.src, &rule.src_mask) == -1)
+  {
+    printf("Error: Invalid MAC address or mask\n\n");
+    return;
+  }
+  if(read_text("Destination MAC (ADDRESS, ADDRESS/MASK, ADDRESS/PREFIX_LENGTH or any) : ", input_buffer,
+               sizeof(input_buffer)) == -1)
+    return;
+  if(acl_parse_mac_match(input_buffer, &rule.dest, &rule.dest_mask) == -1)
+  {
+    printf("Error: Invalid MAC address or mask\n\n");
+    return;
+  }
+  if(read_text("EtherType (e.g. 0x0806, frames built by stations are 0x88b5, or any) : ", input_buffer,
+               sizeof(input_buffer)) == -1)
+    return;
+  if(strcmp(input_buffer, "any") != 0)
+  {
+    char *end_ptr;
+    long ethertype = strtol(input_buffer, &end_ptr, 16);
+    if(*end_ptr != '\0' || ethertype < 1 || ethertype > 0xffff)
+    {
+      printf("Error: Invalid EtherType\n\n");
+      return;
+    }
+    rule.ethertype = ethertype;
+    rule.ethertype_mask = 0xffff;
+  }
+  if(acl_add_rule(port_num, &rule) == 0)
+  {
+    printf("Rule %ld added to the ACL of port - %ld\n\n", rule_no, port_num);
+  }
+}
 
 /*
  * Function    : switch_user_menu
@@ -32,7 +627,20 @@ int switch_user_menu()
     printf("  [2] Disable Port\n");
     printf("  [3] Show All Enabled Ports\n");
     printf("  [4] Display MAC Table\n");
-    printf("  [5] Exit\n");
+    printf("  [5] Display Port Statistics\n");
+    printf("  [6] Configure Storm Control\n");
+    printf("  [7] Configure Egress Scheduler\n");
+    printf("  [8] Configure Multicast Groups\n");
+    printf("  [9] Configure VLANs\n");
+    printf("  [10] Configure Link Aggregation\n");
+    printf("  [11] Configure Port Mirroring\n");
+    printf("  [12] Configure sFlow Sampling\n");
+    printf("  [13] Configure Slow Consumer Detection\n");
+    printf("  [14] Configure ACLs\n");
+    printf("  [15] Configure Ingress Scheduler\n");
+    printf("  [16] Configure MAC Learning\n");
+    printf("  [17] Warm Restart (keep ports and stations)\n");
+    printf("  [18] Exit\n");
     printf("-------------------------------\n");
     printf("Enter your choice : ");
     fgets(input_buffer, 50, stdin);
@@ -41,7 +649,7 @@ int switch_user_menu()
     choice = strtol(input_buffer, &end_ptr, 10);
     if(*end_ptr != '\0')
     {
-      printf("Invalid input.. Input value between 1 and 5 are allowed\n\n");
+      printf("Invalid input.. Input value between 1 and 18 are allowed\n\n");
       continue;
     }
 
@@ -72,6 +680,7 @@ int switch_user_menu()
         {
           /* enable port */
           enable_port(port_num);
+          mac_table_changed();
           printf("Port - %d is enabled\n\n", port_num);
         }
         continue;
@@ -99,18 +708,73 @@ int switch_user_menu()
         {
           /* disable port */
           disable_port(port_num);
+          mac_table_changed();
           printf("Port - %d is disabled\n\n", port_num);
         }
         continue;
       case 3:
         /* display all enabled ports */
         display_en_ports();
+        display_stack_ports();
         continue;
       case 4:
         /* display mac_table */
         display_mac_table();
         continue;
       case 5:
+        /* display per port counters */
+        display_port_stats();
+        display_top_talkers();
+        continue;
+      case 6:
+        /* rate limit flooded traffic per port */
+        configure_storm_control();
+        continue;
+      case 7:
+        /* strict priority or weighted round robin between egress classes */
+        configure_egress_scheduler();
+        continue;
+      case 8:
+        /* static multicast group members */
+        configure_multicast_groups();
+        continue;
+      case 9:
+        /* access and trunk ports */
+        configure_vlans();
+        continue;
+      case 10:
+        /* LAG members */
+        configure_lags();
+        continue;
+      case 11:
+        /* capture ports to a pcapng file */
+        configure_port_mirroring();
+        continue;
+      case 12:
+        /* sampled frames and counters to a collector */
+        configure_sflow();
+        continue;
+      case 13:
+        /* mqueue full threshold and drop policy */
+        configure_slow_consumers();
+        continue;
+      case 14:
+        /* per port ingress permit/deny rules */
+        configure_acls();
+        continue;
+      case 15:
+        /* share of the forwarding of every port under overload */
+        configure_ingress_scheduler();
+        continue;
+      case 16:
+        /* learning policy per port and static addresses */
+        configure_mac_learning();
+        continue;
+      case 17:
+        /* leave ports and stations attached, the next switch is started with -w */
+        switch_warm_restart();
+        return EXIT_SUCCESS;
+      case 18:
         /* turn off the switch */
         switch_off();
         return EXIT_SUCCESS;
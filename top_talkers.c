@@ -0,0 +1,442 @@
+/*
+ * File        : top_talkers.c
+ * Description : Space-saving sketches of the (source, destination) pairs received on every port. A sketch is a min
+ *               heap of counters on their count with a small open addressing index from pair to heap position, so an
+ *               update is a lookup and a sift. A pair that is not in a full sketch takes over the counter with the
+ *               smallest count and inherits it as its error, so a count is never below the real one and never above
+ *               it by more than the error.
+ *               Only the port thread writes its sketch, under a sequence lock the merger thread reads it with. When the
+ *               merger starts a new window, the port thread moves its sketch to the published copy at its next frame,
+ *               so a window is merged from whichever copy still holds it and no frame is lost between windows.
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "top_talkers.h"
+#include "mac_util.h"
+
+#define MAX_PORTS 4
+#define TOP_TALKER_INDEX_SIZE (2 * TOP_TALKER_COUNTERS)
+#define TOP_TALKER_INDEX_MASK (TOP_TALKER_INDEX_SIZE - 1)
+
+typedef struct talker
+{
+  unsigned long long src;   /* mac_address_value() of the addresses */
+  unsigned long long dest;
+  unsigned int count;       /* frames counted, at most error more than the real count */
+  unsigned int error;
+  unsigned int flooded;     /* frames counted while the pair held the counter that were flooded */
+  unsigned int slot;        /* index slot pointing to this counter */
+} talker_t;
+
+typedef struct sketch
+{
+  unsigned int epoch;       /* window the sketch counts */
+  int size;
+  unsigned long long frames;
+  talker_t heap[TOP_TALKER_COUNTERS];
+} sketch_t;
+
+typedef struct talker_port
+{
+  unsigned int seq;         /* odd while the port thread changes the sketch */
+  int last;                 /* heap position of the pair of the frame being forwarded, -1 -> none */
+  unsigned char index[TOP_TALKER_INDEX_SIZE]; /* heap position + 1, 0 -> free slot */
+  sketch_t live;
+  sketch_t published;       /* the previous window, kept until the merger reads it */
+} talker_port_t;
+
+/* merged report of the last closed window */
+typedef struct talker_report
+{
+  talker_t talker;
+  unsigned int ports;       /* bit i -> received on port i+1 */
+} talker_report_t;
+
+static talker_port_t talker_ports[MAX_PORTS];
+static unsigned int talker_epoch;
+
+static talker_report_t report[TOP_TALKER_REPORT];
+static int report_size;
+static unsigned long long report_frames;
+static pthread_mutex_t report_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static volatile int merger_running = 0;
+static pthread_t merger_id;
+static pthread_mutex_t merger_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t merger_cond = PTHREAD_COND_INITIALIZER;
+
+/*
+ * Function    : pair_slot
+ * Output      : home slot of the pair in a port's index
+ * */
+static unsigned int pair_slot(unsigned long long src, unsigned long long dest)
+{
+  unsigned long long h = (src * 0x9e3779b97f4a7c15ULL) ^ (dest * 0xc2b2ae3d27d4eb4fULL);
+  return (h ^ (h >> 29)) & TOP_TALKER_INDEX_MASK;
+}
+
+/*
+ * Function    : place
+ * @params     : port -> port whose sketch is changed
+ *               pos  -> heap position
+ *               t    -> counter stored at pos
+ * Description : Stores the counter and points its index slot at it
+ * */
+static void place(talker_port_t *port, int pos, const talker_t *t)
+{
+  port->live.heap[pos] = *t;
+  port->index[t->slot] = pos + 1;
+}
+
+/*
+ * Function    : sift_down
+ * @params     : port -> port whose sketch is changed
+ *               pos  -> heap position of a counter whose count grew
+ * Output      : new heap position of the counter
+ * */
+static int sift_down(talker_port_t *port, int pos)
+{
+  sketch_t *s = &port->live;
+  talker_t t = s->heap[pos];
+  while(1)
+  {
+    int child = 2 * pos + 1;
+    if(child >= s->size)
+      break;
+    if(child + 1 < s->size && s->heap[child + 1].count < s->heap[child].count)
+      child++;
+    if(s->heap[child].count >= t.count)
+      break;
+    place(port, pos, &s->heap[child]);
+    pos = child;
+  }
+  place(port, pos, &t);
+  return pos;
+}
+
+/*
+ * Function    : sift_up
+ * @params     : port -> port whose sketch is changed
+ *               pos  -> heap position of a new counter
+ * Output      : new heap position of the counter
+ * */
+static int sift_up(talker_port_t *port, int pos)
+{
+  sketch_t *s = &port->live;
+  talker_t t = s->heap[pos];
+  while(pos > 0 && s->heap[(pos - 1) / 2].count > t.count)
+  {
+    place(port, pos, &s->heap[(pos - 1) / 2]);
+    pos = (pos - 1) / 2;
+  }
+  place(port, pos, &t);
+  return pos;
+}
+
+/*
+ * Function    : remove_slot
+ * @params     : port -> port whose sketch is changed
+ *               slot -> index slot to free
+ * Description : Moves back the slots that probed past the freed one, so lookups never stop at a hole
+ * */
+static void remove_slot(talker_port_t *port, unsigned int slot)
+{
+  unsigned int i = slot, j = slot;
+  while(1)
+  {
+    j = (j + 1) & TOP_TALKER_INDEX_MASK;
+    if(port->index[j] == 0)
+      break;
+    talker_t *t = &port->live.heap[port->index[j] - 1];
+    unsigned int home = pair_slot(t->src, t->dest);
+    /* a slot whose home is cyclically in (i, j] stays where it is */
+    if(i <= j ? (i < home && home <= j) : (i < home || home <= j))
+      continue;
+    port->index[i] = port->index[j];
+    t->slot = i;
+    i = j;
+  }
+  port->index[i] = 0;
+}
+
+/*
+ * Function    : top_talker_update
+ * @params     : port_index       -> port the frame was received on (0 based)
+ *               src_mac_address  -> source of the frame
+ *               dest_mac_address -> destination of the frame
+ * Description : Counts the frame in the port's sketch, called by the port thread only
+ * */
+void top_talker_update(int port_index, const char *src_mac_address, const char *dest_mac_address)
+{
+  talker_port_t *port = &talker_ports[port_index];
+  sketch_t *s = &port->live;
+  unsigned long long src = mac_address_value(src_mac_address);
+  unsigned long long dest = mac_address_value(dest_mac_address);
+
+  __atomic_store_n(&port->seq, port->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  unsigned int epoch = __atomic_load_n(&talker_epoch, __ATOMIC_RELAXED);
+  if(s->epoch != epoch)
+  {
+    /* the merger started a new window, keep this one for it */
+    port->published = *s;
+    memset(port->index, 0, sizeof(port->index));
+    s->epoch = epoch;
+    s->size = 0;
+    s->frames = 0;
+  }
+
+  unsigned int slot = pair_slot(src, dest);
+  int pos;
+  while(port->index[slot] && (s->heap[port->index[slot] - 1].src != src || s->heap[port->index[slot] - 1].dest != dest))
+  {
+    slot = (slot + 1) & TOP_TALKER_INDEX_MASK;
+  }
+  if(port->index[slot])
+  {
+    pos = port->index[slot] - 1;
+    s->heap[pos].count++;
+    pos = sift_down(port, pos);
+  }
+  else if(s->size < TOP_TALKER_COUNTERS)
+  {
+    talker_t t = {src, dest, 1, 0, 0, slot};
+    s->heap[s->size] = t;
+    pos = sift_up(port, s->size++);
+  }
+  else
+  {
+    /* the pair takes over the smallest counter, which is at the root */
+    unsigned int min = s->heap[0].count;
+    remove_slot(port, s->heap[0].slot);
+    slot = pair_slot(src, dest);
+    while(port->index[slot])
+    {
+      slot = (slot + 1) & TOP_TALKER_INDEX_MASK;
+    }
+    talker_t t = {src, dest, min + 1, min, 0, slot};
+    place(port, 0, &t);
+    pos = sift_down(port, 0);
+  }
+  port->last = pos;
+  s->frames++;
+
+  __atomic_store_n(&port->seq, port->seq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Function    : top_talker_flooded
+ * @params     : port_index -> port the frame was received on (0 based)
+ * Description : The frame last counted on the port is flooded, called by the port thread only
+ * */
+void top_talker_flooded(int port_index)
+{
+  talker_port_t *port = &talker_ports[port_index];
+  if(port->last == -1)
+  {
+    return;
+  }
+  __atomic_store_n(&port->seq, port->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  port->live.heap[port->last].flooded++;
+  __atomic_store_n(&port->seq, port->seq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Function    : read_sketch
+ * @params     : port  -> port whose sketch is read
+ *               epoch -> window to read
+ *               out   -> copy of the port's sketch of the window, empty if the port counted no frame in it
+ * */
+static void read_sketch(talker_port_t *port, unsigned int epoch, sketch_t *out)
+{
+  unsigned int seq;
+  do
+  {
+    while((seq = __atomic_load_n(&port->seq, __ATOMIC_ACQUIRE)) & 1)
+      ;
+    if(port->live.epoch == epoch)
+      *out = port->live;
+    else if(port->published.epoch == epoch)
+      *out = port->published;
+    else
+      out->size = out->frames = 0;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while(__atomic_load_n(&port->seq, __ATOMIC_RELAXED) != seq);
+}
+
+/*
+ * Function    : compare_count
+ * Output      : orders merged pairs by decreasing count
+ * */
+static int compare_count(const void *a, const void *b)
+{
+  const talker_report_t *x = a, *y = b;
+  return x->talker.count < y->talker.count ? 1 : x->talker.count > y->talker.count ? -1 : 0;
+}
+
+/*
+ * Function    : merge_window
+ * @params     : epoch -> window to merge
+ * Description : A pair missing from a full sketch may have had up to the sketch's smallest count on that port, so
+ *               the merged count and error of a pair add the smallest count of every full sketch it is missing from
+ * */
+static void merge_window(unsigned int epoch)
+{
+  static sketch_t sketches[MAX_PORTS];
+  static talker_report_t merged[MAX_PORTS * TOP_TALKER_COUNTERS];
+  unsigned int min[MAX_PORTS], min_sum = 0;
+  unsigned long long frames = 0;
+  int n = 0;
+
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    read_sketch(&talker_ports[i], epoch, &sketches[i]);
+    min[i] = sketches[i].size == TOP_TALKER_COUNTERS ? sketches[i].heap[0].count : 0;
+    min_sum += min[i];
+    frames += sketches[i].frames;
+  }
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    for(int k = 0; k < sketches[i].size; k++)
+    {
+      talker_t *t = &sketches[i].heap[k];
+      int m = 0;
+      while(m < n && (merged[m].talker.src != t->src || merged[m].talker.dest != t->dest))
+        m++;
+      if(m == n)
+      {
+        memset(&merged[n], 0, sizeof(merged[n]));
+        merged[n].talker.src = t->src;
+        merged[n].talker.dest = t->dest;
+        merged[n].talker.count = merged[n].talker.error = min_sum;
+        n++;
+      }
+      merged[m].talker.count += t->count - min[i];
+      merged[m].talker.error = merged[m].talker.error + t->error - min[i];
+      merged[m].talker.flooded += t->flooded;
+      merged[m].ports |= 1u << i;
+    }
+  }
+  qsort(merged, n, sizeof(merged[0]), compare_count);
+
+  pthread_mutex_lock(&report_mutex);
+  report_size = n < TOP_TALKER_REPORT ? n : TOP_TALKER_REPORT;
+  memcpy(report, merged, report_size * sizeof(report[0]));
+  report_frames = frames;
+  pthread_mutex_unlock(&report_mutex);
+}
+
+/*
+ * Function    : top_talker_merger
+ * @params     : arg -> unused
+ * Description : Closes a window every TOP_TALKER_WINDOW seconds and merges it
+ * */
+static void *top_talker_merger(void *arg)
+{
+  /* switch signals are handled by the menu thread */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGUSR1);
+  sigaddset(&set, SIGHUP);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  pthread_mutex_lock(&merger_mutex);
+  while(merger_running)
+  {
+    deadline.tv_sec += TOP_TALKER_WINDOW;
+    while(merger_running && pthread_cond_timedwait(&merger_cond, &merger_mutex, &deadline) == 0)
+      ;
+    if(!merger_running)
+      break;
+    unsigned int epoch = __atomic_add_fetch(&talker_epoch, 1, __ATOMIC_RELAXED) - 1;
+    merge_window(epoch);
+  }
+  pthread_mutex_unlock(&merger_mutex);
+  return NULL;
+}
+
+/*
+ * Function    : init_top_talkers
+ * Output      : 0 -> merger started, -1 -> thread error
+ * Description : Empties the sketches and starts the merger thread, called before the port threads start
+ * */
+int init_top_talkers()
+{
+  memset(talker_ports, 0, sizeof(talker_ports));
+  talker_epoch = 1;
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    talker_ports[i].last = -1;
+    talker_ports[i].live.epoch = talker_epoch;
+  }
+  report_size = 0;
+  report_frames = 0;
+
+  merger_running = 1;
+  if(pthread_create(&merger_id, NULL, top_talker_merger, NULL) != 0)
+  {
+    perror("Error in pthread_create()");
+    merger_running = 0;
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Function    : stop_top_talkers
+ * Description : Stops the merger thread
+ * */
+void stop_top_talkers()
+{
+  if(!merger_running)
+  {
+    return;
+  }
+  pthread_mutex_lock(&merger_mutex);
+  merger_running = 0;
+  pthread_cond_signal(&merger_cond);
+  pthread_mutex_unlock(&merger_mutex);
+  pthread_join(merger_id, NULL);
+}
+
+/*
+ * Function    : display_top_talkers
+ * Description : Displays the pairs with the most frames in the last window. FRAMES is at most ERROR above the real
+ *               count, FLOODED counts the flooded frames among them, PORTS are the ports they were received on.
+ * */
+void display_top_talkers()
+{
+  pthread_mutex_lock(&report_mutex);
+  printf("\nTop talkers, last %d s: %llu frames\n", TOP_TALKER_WINDOW, report_frames);
+  printf("+-------------------+-------------------+------------+----------+--------+------------+---------+\n");
+  printf("|       SOURCE      |    DESTINATION    |   FRAMES   |   ERROR  |  SHARE |   FLOODED  |  PORTS  |\n");
+  printf("+-------------------+-------------------+------------+----------+--------+------------+---------+\n");
+  for(int i = 0; i < report_size; i++)
+  {
+    char src[18], dest[18], ports[12];
+    int len = 0;
+    mac_address_string(report[i].talker.src, src);
+    mac_address_string(report[i].talker.dest, dest);
+    ports[0] = '\0';
+    for(int k = 0; k < MAX_PORTS; k++)
+    {
+      if(report[i].ports & (1u << k))
+        len += snprintf(ports + len, sizeof(ports) - len, len ? ",%d" : "%d", k + 1);
+    }
+    printf("| %s | %s | %10u | %8u | %5.1f%% | %10u | %-7s |\n", src, dest, report[i].talker.count,
+           report[i].talker.error, report_frames ? 100.0 * report[i].talker.count / report_frames : 0.0,
+           report[i].talker.flooded, ports);
+  }
+  printf("+-------------------+-------------------+------------+----------+--------+------------+---------+\n");
+  pthread_mutex_unlock(&report_mutex);
+}
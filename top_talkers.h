@@ -0,0 +1,23 @@
+#ifndef TOP_TALKERS_H
+#define TOP_TALKERS_H
+
+/*
+ * File        : top_talkers.h
+ * Description : Top talker detection. Every port thread counts the (source, destination) pairs it receives in its
+ *               own space-saving sketch of TOP_TALKER_COUNTERS counters, so memory stays bounded however many
+ *               addresses are seen. A merger thread closes a window every TOP_TALKER_WINDOW seconds, merges the
+ *               sketches of the ports and keeps the TOP_TALKER_REPORT pairs with the most frames for the stats display.
+ * */
+
+/* counters of a port's sketch, a pair with more than 1/TOP_TALKER_COUNTERS of the port's frames is always kept */
+#define TOP_TALKER_COUNTERS 64
+#define TOP_TALKER_REPORT 10
+#define TOP_TALKER_WINDOW 1
+
+int init_top_talkers();
+void stop_top_talkers();
+void top_talker_update(int port_index, const char *src_mac_address, const char *dest_mac_address);
+void top_talker_flooded(int port_index);
+void display_top_talkers();
+
+#endif
@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# File        : trace_perf.sh
+# Description : perf version of trace_port_rates.bt for hosts without bpftrace. Adds the switch's USDT probes
+#               (probes.h) as perf events, prints the rate of every probe each second, then records frame_receive and
+#               counts frames per ingress port (arg1 of the probe) and second.
+#               Usage: sudo ./trace_perf.sh [<SWITCH_BINARY>] [<SECONDS>]
+#
+
+BIN=${1:-./switch}
+SECONDS_TRACED=${2:-10}
+PROBES="frame_receive mac_learn mac_lookup_hit mac_lookup_miss flood unicast queue_full drop"
+
+# perf finds the probes of a binary through its build-id cache
+perf buildid-cache --add "$BIN" || exit 1
+for probe in $PROBES; do
+  perf probe -q -x "$BIN" -a "%sdt_vnswitch:$probe" || exit 1
+done
+
+echo "Probe rates for $SECONDS_TRACED s:"
+perf stat -a -I 1000 -e 'sdt_vnswitch:*' -- sleep "$SECONDS_TRACED"
+
+echo "Frames received per port and second for $SECONDS_TRACED s:"
+perf record -q -a -o /tmp/trace_perf.data -e sdt_vnswitch:frame_receive -- sleep "$SECONDS_TRACED"
+perf script -i /tmp/trace_perf.data -F time,trace | awk '
+  {
+    second = int($1)
+    for(i = 2; i <= NF; i++)
+      if($i ~ /^arg1=/)
+      {
+        split($i, kv, "=")
+        frames[second, kv[2]]++
+        seconds[second] = 1
+      }
+  }
+  END {
+    for(s in seconds)
+      for(p = 1; p <= 4; p++)
+        if((s, p) in frames)
+          printf("%d port %d: %d frames\n", s, p, frames[s, p])
+  }' | sort -n
+
+perf probe -q -d 'sdt_vnswitch:*'
+rm -f /tmp/trace_perf.data
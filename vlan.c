@@ -0,0 +1,262 @@
+/*
+ * File        : vlan.c
+ * Description : Port vlan configuration. The member ports of every vlan are kept precomputed in vlan_members, so a
+ *               flood only has to mask the ports with one byte read and never looks at ports outside the vlan.
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vlan.h"
+
+#define MAX_PORTS 4
+
+static int port_mode[MAX_PORTS];
+/* access vlan of an access port, native (untagged) vlan of a trunk port */
+static int port_pvid[MAX_PORTS];
+/* vlans allowed on a trunk port, one bit per vlan */
+static unsigned char trunk_allowed[MAX_PORTS][MAX_VLANS / 8];
+
+/* member ports of every vlan (bit 0 -> port 1) */
+static unsigned char vlan_members[MAX_VLANS];
+
+/*
+ * Function    : is_port_member
+ * @params     : port_index -> port (0 based)
+ *               vlan_id    -> vlan
+ * Output      : 1 if the port carries the vlan
+ * */
+static int is_port_member(int port_index, int vlan_id)
+{
+  if(vlan_id == port_pvid[port_index])
+  {
+    return 1;
+  }
+  return port_mode[port_index] == VLAN_TRUNK && (trunk_allowed[port_index][vlan_id / 8] & (1 << (vlan_id % 8)));
+}
+
+/*
+ * Function    : compute_vlan_members
+ * Description : Rebuilds vlan_members after a port configuration change
+ * */
+static void compute_vlan_members()
+{
+  for(int vlan_id = 0; vlan_id < MAX_VLANS; vlan_id++)
+  {
+    unsigned char members = 0;
+    for(int i = 0; i < MAX_PORTS; i++)
+    {
+      if(vlan_id != 0 && is_port_member(i, vlan_id))
+      {
+        members |= 1 << i;
+      }
+    }
+    vlan_members[vlan_id] = members;
+  }
+}
+
+/*
+ * Function    : init_vlans
+ * Description : Every port starts as an access port of DEFAULT_VLAN, which behaves like the switch without vlans
+ * */
+void init_vlans()
+{
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    port_mode[i] = VLAN_ACCESS;
+    port_pvid[i] = DEFAULT_VLAN;
+    memset(trunk_allowed[i], 0, sizeof(trunk_allowed[i]));
+  }
+  compute_vlan_members();
+}
+
+/*
+ * Function    : vlan_ingress
+ * @params     : port_index -> port the frame was received on (0 based)
+ *               tag        -> vlan_id of the frame header, 0 for an untagged frame
+ * Output      : vlan the frame belongs to, -1 if the port does not accept it
+ * */
+int vlan_ingress(int port_index, int tag)
+{
+  if(tag == 0 || tag == port_pvid[port_index])
+  {
+    return port_pvid[port_index];
+  }
+  if(tag < MAX_VLANS && port_mode[port_index] == VLAN_TRUNK && (trunk_allowed[port_index][tag / 8] & (1 << (tag % 8))))
+  {
+    return tag;
+  }
+  return -1;
+}
+
+/*
+ * Function    : vlan_egress_tag
+ * @params     : port_index -> port the frame is sent to (0 based)
+ *               vlan_id    -> vlan of the frame
+ * Output      : vlan_id to put in the frame header, 0 to send it untagged
+ * */
+int vlan_egress_tag(int port_index, int vlan_id)
+{
+  if(port_mode[port_index] == VLAN_TRUNK && vlan_id != port_pvid[port_index])
+  {
+    return vlan_id;
+  }
+  return 0;
+}
+
+/*
+ * Function    : vlan_member_ports
+ * @params     : vlan_id -> vlan
+ * Output      : bitmap of the ports carrying the vlan
+ * */
+unsigned int vlan_member_ports(int vlan_id)
+{
+  return vlan_members[vlan_id];
+}
+
+/*
+ * Function    : set_access_port
+ * @params     : port_no -> port to configure
+ *               vlan_id -> vlan carried untagged by the port
+ * */
+void set_access_port(int port_no, int vlan_id)
+{
+  port_mode[port_no - 1] = VLAN_ACCESS;
+  port_pvid[port_no - 1] = vlan_id;
+  compute_vlan_members();
+}
+
+/*
+ * Function    : set_trunk_port
+ * @params     : port_no     -> port to configure
+ *               native_vlan -> vlan carried untagged by the port
+ *               allowed     -> vlans carried tagged, as a list like "10,20,30-39" or "all"
+ * Output      : 0 -> port configured, -1 -> allowed list is invalid
+ * */
+int set_trunk_port(int port_no, int native_vlan, const char *allowed)
+{
+  unsigned char bits[MAX_VLANS / 8];
+  memset(bits, 0, sizeof(bits));
+
+  if(strcmp(allowed, "all") == 0)
+  {
+    memset(bits, 0xff, sizeof(bits));
+  }
+  else
+  {
+    const char *p = allowed;
+    while(*p)
+    {
+      char *end;
+      long first = strtol(p, &end, 10), last = first;
+      if(end == p)
+      {
+        return -1;
+      }
+      if(*end == '-')
+      {
+        p = end + 1;
+        last = strtol(p, &end, 10);
+        if(end == p)
+        {
+          return -1;
+        }
+      }
+      if(first < 1 || last >= MAX_VLANS || first > last)
+      {
+        return -1;
+      }
+      for(long vlan_id = first; vlan_id <= last; vlan_id++)
+      {
+        bits[vlan_id / 8] |= 1 << (vlan_id % 8);
+      }
+      if(*end == ',')
+      {
+        end++;
+      }
+      else if(*end != '\0')
+      {
+        return -1;
+      }
+      p = end;
+    }
+  }
+  /* vlan 0 means untagged and 4095 is reserved */
+  bits[0] &= ~1;
+  bits[(MAX_VLANS - 1) / 8] &= ~(1 << ((MAX_VLANS - 1) % 8));
+
+  memcpy(trunk_allowed[port_no - 1], bits, sizeof(bits));
+  port_pvid[port_no - 1] = native_vlan;
+  port_mode[port_no - 1] = VLAN_TRUNK;
+  compute_vlan_members();
+  return 0;
+}
+
+/*
+ * Function    : get_vlan_port
+ * @params     : port_no -> port
+ *               config  -> to store the port's vlan configuration
+ * */
+void get_vlan_port(int port_no, vlan_port_config_t *config)
+{
+  config->mode = port_mode[port_no - 1];
+  config->pvid = port_pvid[port_no - 1];
+  memcpy(config->allowed, trunk_allowed[port_no - 1], sizeof(config->allowed));
+}
+
+/*
+ * Function    : restore_vlan_port
+ * @params     : port_no -> port to configure
+ *               config  -> vlan configuration saved by get_vlan_port()
+ * Output      : 0 -> port configured, -1 -> invalid configuration, the port is left as is
+ * */
+int restore_vlan_port(int port_no, const vlan_port_config_t *config)
+{
+  if((config->mode != VLAN_ACCESS && config->mode != VLAN_TRUNK) || config->pvid < 1 || config->pvid >= MAX_VLANS - 1)
+  {
+    return -1;
+  }
+  memcpy(trunk_allowed[port_no - 1], config->allowed, sizeof(config->allowed));
+  /* vlan 0 means untagged and 4095 is reserved */
+  trunk_allowed[port_no - 1][0] &= ~1;
+  trunk_allowed[port_no - 1][(MAX_VLANS - 1) / 8] &= ~(1 << ((MAX_VLANS - 1) % 8));
+  port_pvid[port_no - 1] = config->pvid;
+  port_mode[port_no - 1] = config->mode;
+  compute_vlan_members();
+  return 0;
+}
+
+/*
+ * Function    : display_vlans
+ * Description : Displays the vlan configuration of every port
+ * */
+void display_vlans()
+{
+  printf("\n+------+--------+------+---------------------------------+\n");
+  printf("| PORT |  MODE  | PVID |          TAGGED VLANS           |\n");
+  printf("+------+--------+------+---------------------------------+\n");
+  for(int i = 0; i < MAX_PORTS; i++)
+  {
+    char list[34] = "";
+    if(port_mode[i] == VLAN_TRUNK)
+    {
+      /* print the allowed vlans as ranges */
+      int len = 0;
+      for(int vlan_id = 1; vlan_id < MAX_VLANS && len < (int) sizeof(list); vlan_id++)
+      {
+        if(!(trunk_allowed[i][vlan_id / 8] & (1 << (vlan_id % 8))))
+          continue;
+        int last = vlan_id;
+        while(last + 1 < MAX_VLANS && (trunk_allowed[i][(last + 1) / 8] & (1 << ((last + 1) % 8))))
+          last++;
+        if(last == vlan_id)
+          len += snprintf(list + len, sizeof(list) - len, "%s%d", len ? "," : "", vlan_id);
+        else
+          len += snprintf(list + len, sizeof(list) - len, "%s%d-%d", len ? "," : "", vlan_id, last);
+        vlan_id = last;
+      }
+    }
+    printf("|  %d   | %-6s | %4d | %-31.31s |\n", i+1, port_mode[i] == VLAN_TRUNK ? "trunk" : "access", port_pvid[i], list);
+  }
+  printf("+------+--------+------+---------------------------------+\n");
+}
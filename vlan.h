@@ -0,0 +1,35 @@
+#ifndef VLAN_H
+#define VLAN_H
+
+/*
+ * File        : vlan.h
+ * Description : 802.1Q style vlans. Access ports carry the frames of one vlan untagged, trunk ports carry several vlans
+ *               tagged (vlan_id in the frame header) and their native vlan untagged.
+ * */
+
+#define MAX_VLANS 4096
+#define DEFAULT_VLAN 1
+
+/* port modes */
+#define VLAN_ACCESS 0
+#define VLAN_TRUNK 1
+
+/* vlan configuration of a port, as kept across a warm restart */
+typedef struct vlan_port_config
+{
+  int mode;                               /* VLAN_ACCESS or VLAN_TRUNK */
+  int pvid;                               /* access vlan or native vlan */
+  unsigned char allowed[MAX_VLANS / 8];   /* vlans of a trunk port, one bit per vlan */
+} vlan_port_config_t;
+
+void init_vlans();
+int vlan_ingress(int port_index, int tag);
+int vlan_egress_tag(int port_index, int vlan_id);
+unsigned int vlan_member_ports(int vlan_id);
+void set_access_port(int port_no, int vlan_id);
+int set_trunk_port(int port_no, int native_vlan, const char *allowed);
+void get_vlan_port(int port_no, vlan_port_config_t *config);
+int restore_vlan_port(int port_no, const vlan_port_config_t *config);
+void display_vlans();
+
+#endif
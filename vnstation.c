@@ -0,0 +1,538 @@
+/*
+ * File        : vnstation.c
+ * Description : libvnstation, see vnstation.h. A station attaches like station.c does: it checks that its ports are
+ *               enabled and free in the switch's shared memories, opens their mqueues and writes its pid and address
+ *               as the ports' station. It leaves by queueing SIGUSR1 to the switch with the ports it leaves, so the
+ *               other stations of the same process stay connected. Every mqueue is non blocking; the receive mqueues
+ *               are always in the station's epoll set, a send mqueue only while send_batch is waiting for room in it.
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <mqueue.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+
+#include "vnstation.h"
+#include "fcs.h"
+#include "instance.h"
+#include "mac_util.h"
+#include "shm_pages.h"
+
+/* shared memories and mqueues of the switch, as in switch.h */
+#define SWITCH_PID "/switch_pid"
+#define SWITCH_PID_SIZE sizeof(pid_t)
+#define EN_DIS_PORTS "/en_dis_ports"
+#define EN_DIS_PORTS_SIZE (4 * sizeof(int))
+#define CON_DISCON_PORTS "/con_discon_ports"
+#define CON_DISCON_PORTS_SIZE (4 * sizeof(con_discon_t))
+#define SEND_MQ "/send_mq_port_%d"  /* switch to station */
+#define RECV_MQ "/recv_mq_port_%d"  /* station to switch */
+
+/* vnstation_detach() waits for the switch to free the ports, signalling it again every 10 ms for a second */
+#define DETACH_RETRY_NS 10000000L
+#define DETACH_ATTEMPTS 100
+
+/* struct to store in shared memory */
+typedef struct con_discon
+{
+  pid_t pid;
+  char mac_address[18];
+} con_discon_t;
+
+struct vnstation
+{
+  char mac_address[18];
+  int port_nos[VNSTATION_MAX_PORTS];
+  int port_count;
+  int options;
+  unsigned char priority;
+  unsigned short vlan_id;
+  pid_t *switch_pid;
+  int *en_dis_ports;
+  con_discon_t *con_discon_ports;
+  mqd_t send_fd[VNSTATION_MAX_PORTS];
+  mqd_t recv_fd[VNSTATION_MAX_PORTS];
+  int epoll_fd;
+  unsigned int waiting_room;      /* links whose send mqueue is in the epoll set, bit 0 for port_nos[0] */
+  int next_link;                  /* first link recv_batch drains */
+  vnstation_filter_t filter;
+  void *filter_arg;
+  vnstation_stats_t stats;
+};
+
+static int crc32c_ready = 0;
+
+/*
+ * Function    : map_switch_memory
+ * @params     : switch_no -> number of the switch
+ *               name      -> plain name of the shared memory
+ *               prot      -> PROT_READ, which never creates the shared memory, or PROT_READ | PROT_WRITE
+ * Output      : the mapping, MAP_FAILED on error
+ * */
+static void *map_switch_memory(int switch_no, const char *name, size_t size, int prot)
+{
+  char instance[64];
+  int fd;
+  switch_instance_name(switch_no, name, instance, sizeof(instance));
+  void *ptr = shm_map(instance, size, prot, &fd);
+  if(ptr != MAP_FAILED)
+  {
+    /* the mapping stays valid without the fd */
+    close(fd);
+  }
+  return ptr;
+}
+
+/*
+ * Function    : release
+ * Description : Closes and unmaps whatever the station has opened, without telling the switch
+ * */
+static void release(vnstation_t *st)
+{
+  for(int link = 0; link < st->port_count; link++)
+  {
+    if(st->send_fd[link] != (mqd_t) -1)
+      mq_close(st->send_fd[link]);
+    if(st->recv_fd[link] != (mqd_t) -1)
+      mq_close(st->recv_fd[link]);
+  }
+  if(st->epoll_fd != -1)
+    close(st->epoll_fd);
+  if(st->switch_pid && st->switch_pid != MAP_FAILED)
+    shm_unmap(st->switch_pid, SWITCH_PID_SIZE);
+  if(st->en_dis_ports && st->en_dis_ports != MAP_FAILED)
+    shm_unmap(st->en_dis_ports, EN_DIS_PORTS_SIZE);
+  if(st->con_discon_ports && st->con_discon_ports != MAP_FAILED)
+    shm_unmap(st->con_discon_ports, CON_DISCON_PORTS_SIZE);
+  free(st);
+}
+
+/*
+ * Function    : open_port
+ * @params     : st        -> station being attached
+ *               switch_no -> number of the switch
+ *               link      -> index of the port in st->port_nos
+ * Output      : 0 -> mqueues opened and receive mqueue added to the epoll set, -1 -> error
+ * */
+static int open_port(vnstation_t *st, int switch_no, int link)
+{
+  char name[64], instance[64];
+  snprintf(name, sizeof(name), RECV_MQ, st->port_nos[link]);
+  switch_instance_name(switch_no, name, instance, sizeof(instance));
+  st->send_fd[link] = mq_open(instance, O_WRONLY | O_NONBLOCK);
+  if(st->send_fd[link] == (mqd_t) -1)
+  {
+    perror("Error in mq_open()");
+    return -1;
+  }
+  snprintf(name, sizeof(name), SEND_MQ, st->port_nos[link]);
+  switch_instance_name(switch_no, name, instance, sizeof(instance));
+  st->recv_fd[link] = mq_open(instance, O_RDONLY | O_NONBLOCK);
+  if(st->recv_fd[link] == (mqd_t) -1)
+  {
+    perror("Error in mq_open()");
+    return -1;
+  }
+
+  /* posix mqueue descriptors are file descriptors on linux */
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.u32 = link;
+  if(epoll_ctl(st->epoll_fd, EPOLL_CTL_ADD, st->recv_fd[link], &event) == -1)
+  {
+    perror("Error in epoll_ctl()");
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Function    : vnstation_attach
+ * @params     : switch_no   -> number of the switch to attach to (0 by default, see instance.h)
+ *               mac_address -> address of the station, "AA:BB:CC:DD:EE:FF"
+ *               port_nos    -> ports to connect to, several ones are aggregated and must be in one LAG
+ *               port_count  -> 1 .. VNSTATION_MAX_PORTS
+ *               options     -> VNSTATION_* flags
+ * Output      : the station, NULL if it can not be attached (the reason is printed)
+ * Description : Connects a station to the ports, which must be enabled and have no station. Any number of stations
+ *               can be attached by one process.
+ * */
+vnstation_t *vnstation_attach(int switch_no, const char *mac_address, const int *port_nos, int port_count,
+                              int options)
+{
+  if(strlen(mac_address) != 17)
+  {
+    printf("Error: Invalid MAC address\n");
+    return NULL;
+  }
+  if(port_count < 1 || port_count > VNSTATION_MAX_PORTS)
+  {
+    printf("Error: A station connects to 1 to %d ports\n", VNSTATION_MAX_PORTS);
+    return NULL;
+  }
+  if(!crc32c_ready)
+  {
+    crc32c_init();
+    crc32c_ready = 1;
+  }
+
+  vnstation_t *st = calloc(1, sizeof(vnstation_t));
+  if(!st)
+  {
+    perror("Error in calloc()");
+    return NULL;
+  }
+  strcpy(st->mac_address, mac_address);
+  st->port_count = port_count;
+  st->options = options;
+  for(int link = 0; link < VNSTATION_MAX_PORTS; link++)
+  {
+    st->send_fd[link] = (mqd_t) -1;
+    st->recv_fd[link] = (mqd_t) -1;
+  }
+  st->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if(st->epoll_fd == -1)
+  {
+    perror("Error in epoll_create1()");
+    release(st);
+    return NULL;
+  }
+
+  /* mapped read only first, so a station can not create the shared memories of a switch that is not there */
+  st->switch_pid = map_switch_memory(switch_no, SWITCH_PID, SWITCH_PID_SIZE, PROT_READ);
+  if(st->switch_pid == MAP_FAILED)
+  {
+    printf("Error: Switch %d is not running\n", switch_no);
+    release(st);
+    return NULL;
+  }
+  st->en_dis_ports = map_switch_memory(switch_no, EN_DIS_PORTS, EN_DIS_PORTS_SIZE, PROT_READ);
+  st->con_discon_ports = map_switch_memory(switch_no, CON_DISCON_PORTS, CON_DISCON_PORTS_SIZE, PROT_READ | PROT_WRITE);
+  if(st->en_dis_ports == MAP_FAILED || st->con_discon_ports == MAP_FAILED)
+  {
+    release(st);
+    return NULL;
+  }
+  if(*st->switch_pid <= 0 || kill(*st->switch_pid, 0) == -1)
+  {
+    printf("Error: Switch %d is not running\n", switch_no);
+    release(st);
+    return NULL;
+  }
+
+  for(int link = 0; link < port_count; link++)
+  {
+    int port = port_nos[link];
+    st->port_nos[link] = port;
+    if(port <= 0 || port > VNSTATION_MAX_PORTS)
+    {
+      printf("Error: Invalid port number\n");
+      release(st);
+      return NULL;
+    }
+    for(int other = 0; other < link; other++)
+    {
+      if(port_nos[other] == port)
+      {
+        printf("Error: Port - %d is given twice\n", port);
+        release(st);
+        return NULL;
+      }
+    }
+    if(!st->en_dis_ports[port - 1])
+    {
+      printf("Error: Port is disabled, cannot connect to port - %d\n", port);
+      release(st);
+      return NULL;
+    }
+    if(st->con_discon_ports[port - 1].pid != -1)
+    {
+      printf("Error: Port - %d is alread connected to a station\n", port);
+      release(st);
+      return NULL;
+    }
+    if(open_port(st, switch_no, link) == -1)
+    {
+      release(st);
+      return NULL;
+    }
+  }
+
+  /* the switch forwards to the ports from now on */
+  for(int link = 0; link < port_count; link++)
+  {
+    con_discon_t *entry = &st->con_discon_ports[st->port_nos[link] - 1];
+    strcpy(entry->mac_address, st->mac_address);
+    entry->pid = getpid();
+  }
+  return st;
+}
+
+/*
+ * Function    : ports_freed
+ * Output      : 1 when the switch has disconnected every port of the station
+ * */
+static int ports_freed(const vnstation_t *st)
+{
+  for(int link = 0; link < st->port_count; link++)
+  {
+    if(st->con_discon_ports[st->port_nos[link] - 1].pid == getpid())
+      return 0;
+  }
+  return 1;
+}
+
+/*
+ * Function    : vnstation_detach
+ * @params     : st -> station, freed
+ * Description : Disconnects the station from its ports and waits (up to a second) until the switch has removed the
+ *               addresses learned on them and freed them. SIGUSR1 does not queue, so the signal of a station leaving
+ *               right after another one of the process may be lost and is sent again. Ports of a switch that is not
+ *               running any more are freed here.
+ * */
+void vnstation_detach(vnstation_t *st)
+{
+  if(!st)
+    return;
+  int port_mask = 0;
+  for(int link = 0; link < st->port_count; link++)
+  {
+    port_mask |= 1 << (st->port_nos[link] - 1);
+  }
+  union sigval value;
+  value.sival_int = port_mask;
+  struct timespec retry = {0, DETACH_RETRY_NS};
+  for(int attempt = 0; attempt < DETACH_ATTEMPTS && !ports_freed(st); attempt++)
+  {
+    if(sigqueue(*st->switch_pid, SIGUSR1, value) == -1)
+      break;
+    nanosleep(&retry, NULL);
+  }
+  for(int link = 0; link < st->port_count; link++)
+  {
+    con_discon_t *entry = &st->con_discon_ports[st->port_nos[link] - 1];
+    if(entry->pid == getpid())
+    {
+      entry->pid = -1;
+      entry->mac_address[0] = '\0';
+    }
+  }
+  release(st);
+}
+
+/*
+ * Function    : vnstation_fd
+ * Output      : file descriptor readable when recv_batch has frames to return or a port send_batch found full has
+ *               room again. It stays readable until they are received, or sent, so an edge triggered epoll set must
+ *               call both until they stop making progress.
+ * */
+int vnstation_fd(const vnstation_t *st)
+{
+  return st->epoll_fd;
+}
+
+/*
+ * Function    : vnstation_set_header
+ * @params     : priority -> 0 (lowest) .. 7, also the mqueue priority the frame is sent with
+ *               vlan_id  -> 802.1Q vlan of the frames, 0 for untagged frames
+ * Description : Header fields vnstation_frame_init() gives the frames
+ * */
+void vnstation_set_header(vnstation_t *st, int priority, int vlan_id)
+{
+  st->priority = priority;
+  st->vlan_id = vlan_id;
+}
+
+/*
+ * Function    : vnstation_frame_init
+ * @params     : frame            -> frame to fill, sent as it is by send_batch
+ *               dest_mac_address -> destination of the frame
+ *               data             -> text carried by the frame, cut to fit
+ * Description : Builds a frame from the station, in the format of station.c. A traffic tool builds its frames once
+ *               and only changes seq, timestamp or data between two batches.
+ * */
+void vnstation_frame_init(const vnstation_t *st, frame_t *frame, const char *dest_mac_address, const char *data)
+{
+  char *buffer = (char *) frame;
+  memset(frame, 0, sizeof(frame_t));
+  memcpy(buffer, st->mac_address, 17);
+  buffer[17] = ' ';
+  memcpy(buffer + 18, dest_mac_address, 17);
+  buffer[35] = ' ';
+  strncat(buffer, data, sizeof(frame->data) - 1);
+  frame->priority = st->priority;
+  frame->vlan_id = st->vlan_id;
+}
+
+/*
+ * Function    : link_of
+ * Output      : index of port_no in st->port_nos, the first port for 0, -1 if the station is not connected to it
+ * */
+static int link_of(const vnstation_t *st, int port_no)
+{
+  if(port_no == 0)
+    return 0;
+  for(int link = 0; link < st->port_count; link++)
+  {
+    if(st->port_nos[link] == port_no)
+      return link;
+  }
+  return -1;
+}
+
+/*
+ * Function    : watch_room
+ * @params     : link  -> port of the station
+ *               watch -> 1 to make the station's fd readable when the port's send mqueue has room, 0 to stop
+ * */
+static void watch_room(vnstation_t *st, int link, int watch)
+{
+  unsigned int bit = 1u << link;
+  if(!!(st->waiting_room & bit) == watch)
+    return;
+  struct epoll_event event;
+  event.events = EPOLLOUT;
+  event.data.u32 = VNSTATION_MAX_PORTS + link;
+  if(epoll_ctl(st->epoll_fd, watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, st->send_fd[link], &event) == 0)
+    st->waiting_room ^= bit;
+}
+
+/*
+ * Function    : vnstation_send_batch
+ * @params     : port_no -> port to send on, 0 for the first port of the station
+ *               frames  -> frames to send, in order
+ *               count   -> number of frames
+ * Output      : frames sent, fewer than count when the port mqueue is full, -1 on error
+ * Description : Sends the frames without waiting. With VNSTATION_FCS their fcs is set first. When the port mqueue
+ *               fills up the rest is left to the caller, and the station's fd becomes readable once there is room.
+ * */
+int vnstation_send_batch(vnstation_t *st, int port_no, frame_t *frames, int count)
+{
+  int link = link_of(st, port_no);
+  if(link == -1)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+  int sent = 0;
+  while(sent < count)
+  {
+    frame_t *f = &frames[sent];
+    if(st->options & VNSTATION_FCS)
+    {
+      frame_set_fcs((char *) f);
+    }
+    /* mqueue priority lets the switch read high priority frames of this port first */
+    if(mq_send(st->send_fd[link], (char *) f, FRAME_SIZE, f->priority) == -1)
+    {
+      if(errno == EINTR)
+        continue;
+      if(errno != EAGAIN)
+      {
+        perror("Error in mq_send()");
+        if(sent == 0)
+          return -1;
+        break;
+      }
+      st->stats.tx_full++;
+      watch_room(st, link, 1);
+      break;
+    }
+    sent++;
+  }
+  if(sent == count)
+  {
+    watch_room(st, link, 0);
+  }
+  st->stats.tx_frames += sent;
+  return sent;
+}
+
+/*
+ * Function    : vnstation_recv_batch
+ * @params     : frames   -> buffer of max frames to receive into
+ *               port_nos -> port every frame was received on, may be NULL
+ *               max      -> frames wanted at most
+ * Output      : frames received, 0 when none has arrived, -1 on error
+ * Description : Receives what has arrived on the station's ports, without waiting. Ports are drained in turn, the
+ *               first one changing with every call so a busy port can not starve the others. Frames with a bad fcs
+ *               and frames the filter rejects are dropped and counted.
+ * */
+int vnstation_recv_batch(vnstation_t *st, frame_t *frames, int *port_nos, int max)
+{
+  int received = 0;
+  for(int i = 0; i < st->port_count && received < max; i++)
+  {
+    int link = (st->next_link + i) % st->port_count;
+    while(received < max)
+    {
+      char *buffer = (char *) &frames[received];
+      if(mq_receive(st->recv_fd[link], buffer, FRAME_SIZE, NULL) == -1)
+      {
+        if(errno == EINTR)
+          continue;
+        if(errno == EAGAIN)
+          break;
+        perror("Error in mq_receive()");
+        return received ? received : -1;
+      }
+      /* a corrupted frame is dropped before its header is looked at */
+      if(!frame_fcs_ok(buffer))
+      {
+        st->stats.rx_bad_fcs++;
+        continue;
+      }
+      if(st->filter && !st->filter(&frames[received], st->port_nos[link], st->filter_arg))
+      {
+        st->stats.rx_filtered++;
+        continue;
+      }
+      if(port_nos)
+        port_nos[received] = st->port_nos[link];
+      received++;
+    }
+  }
+  st->next_link = (st->next_link + 1) % st->port_count;
+  st->stats.rx_frames += received;
+  return received;
+}
+
+/*
+ * Function    : vnstation_set_filter
+ * @params     : filter -> called for every received frame, NULL to receive every frame
+ *               arg    -> passed to the filter
+ * */
+void vnstation_set_filter(vnstation_t *st, vnstation_filter_t filter, void *arg)
+{
+  st->filter = filter;
+  st->filter_arg = arg;
+}
+
+/*
+ * Function    : vnstation_filter_own
+ * @params     : arg -> the station
+ * Output      : 1 for frames to the station's address and to group addresses (broadcast, multicast), 0 for others
+ * Description : The filter of station.c, without its list of joined groups: vnstation_set_filter(st,
+ *               vnstation_filter_own, st)
+ * */
+int vnstation_filter_own(const frame_t *frame, int port_no, void *arg)
+{
+  const vnstation_t *st = arg;
+  return memcmp(frame->dest_mac_address, st->mac_address, 17) == 0 ||
+         is_multicast_mac_address(frame->dest_mac_address);
+}
+
+/*
+ * Function    : vnstation_get_stats
+ * @params     : stats -> to store the counters of the station
+ * */
+void vnstation_get_stats(const vnstation_t *st, vnstation_stats_t *stats)
+{
+  *stats = st->stats;
+}
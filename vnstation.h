@@ -0,0 +1,57 @@
+#ifndef VNSTATION_H
+#define VNSTATION_H
+
+/*
+ * File        : vnstation.h
+ * Description : libvnstation, a station as a library, to embed stations in test applications and traffic tools. A
+ *               process attaches any number of stations, each one to one or more ports of a running switch, and sends
+ *               and receives frames in batches through buffers it owns. Nothing blocks: send_batch sends what the port
+ *               mqueue takes and recv_batch returns what has arrived, and vnstation_fd() is a file descriptor to poll
+ *               (or add to an epoll set) that is readable when frames have arrived or a port the last send_batch
+ *               found full has room again. Received frames are checked (fcs) and offered to a filter callback, the
+ *               library never formats, logs or copies a frame more than the mqueue does.
+ *               The switch signals SIGUSR1 to every attached process when it closes; an application that must
+ *               outlive the switch handles or ignores SIGUSR1.
+ *               A station is used by one thread at a time, stations of different threads are independent.
+ *               Build: gcc -O2 -c vnstation.c fcs.c instance.c mac_util.c shm_pages.c
+ *                      ar rcs libvnstation.a vnstation.o fcs.o instance.o mac_util.o shm_pages.o
+ *                      and link the application with -L. -lvnstation -lrt
+ * */
+
+#include "frame.h"
+
+#define VNSTATION_MAX_PORTS 4
+
+/* options of vnstation_attach() */
+#define VNSTATION_FCS 0x01        /* send_batch sets the fcs of every frame */
+
+typedef struct vnstation vnstation_t;
+
+/*
+ * Receive filter, called for every received frame with a good fcs. Returns 1 to hand the frame to the caller of
+ * recv_batch, 0 to drop it. The frame's addresses are in their text form, separated by spaces.
+ * */
+typedef int (*vnstation_filter_t)(const frame_t *frame, int port_no, void *arg);
+
+typedef struct vnstation_stats
+{
+  unsigned long long tx_frames;     /* frames handed to the switch */
+  unsigned long long tx_full;       /* send_batch calls stopped by a full port mqueue */
+  unsigned long long rx_frames;     /* frames returned by recv_batch */
+  unsigned long long rx_filtered;   /* frames dropped by the filter */
+  unsigned long long rx_bad_fcs;    /* frames dropped because of a bad fcs */
+} vnstation_stats_t;
+
+vnstation_t *vnstation_attach(int switch_no, const char *mac_address, const int *port_nos, int port_count,
+                              int options);
+void vnstation_detach(vnstation_t *st);
+int vnstation_fd(const vnstation_t *st);
+void vnstation_frame_init(const vnstation_t *st, frame_t *frame, const char *dest_mac_address, const char *data);
+void vnstation_set_header(vnstation_t *st, int priority, int vlan_id);
+int vnstation_send_batch(vnstation_t *st, int port_no, frame_t *frames, int count);
+int vnstation_recv_batch(vnstation_t *st, frame_t *frames, int *port_nos, int max);
+void vnstation_set_filter(vnstation_t *st, vnstation_filter_t filter, void *arg);
+int vnstation_filter_own(const frame_t *frame, int port_no, void *arg);
+void vnstation_get_stats(const vnstation_t *st, vnstation_stats_t *stats);
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * File        : vnstation_blast.c
+ * Description : Traffic tool built on libvnstation. Two stations in one process, one sending on a port and one
+ *               receiving on another, push frames through a running switch as fast as it forwards them. One poll() on
+ *               the two stations' fds drives both: the sender refills its batch whenever the port mqueue has room and
+ *               the receiver drains whatever arrived, checking that frames come in order and counting the lost ones.
+ *               Build: gcc -O2 -o vnstation_blast vnstation_blast.c -L. -lvnstation -lrt
+ *               Usage: ./vnstation_blast [-n <SWITCH_NO>] [-p <TX_PORT>:<RX_PORT>] [-b <BATCH>] [-s <SECONDS>] [-f]
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+
+#include "vnstation.h"
+
+#define TX_MAC_ADDRESS "02:00:00:00:0B:01"
+#define RX_MAC_ADDRESS "02:00:00:00:0B:02"
+#define MAX_BATCH 1024
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int sig)
+{
+  running = 0;
+}
+
+static unsigned long long now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int usage()
+{
+  printf("Usage: ./vnstation_blast [-n <SWITCH_NO>] [-p <TX_PORT>:<RX_PORT>] [-b <BATCH>] [-s <SECONDS>] [-f]\n");
+  printf("  -n : number of the switch (default 0)\n");
+  printf("  -p : port the frames are sent on and port they are received on (default 1:2)\n");
+  printf("  -b : frames per send_batch / recv_batch (default 64, at most %d)\n", MAX_BATCH);
+  printf("  -s : seconds to send for (default 3)\n");
+  printf("  -f : send frames with an fcs\n");
+  return EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[])
+{
+  int switch_no = 0, tx_port = 1, rx_port = 2, batch = 64, seconds = 3, options = 0;
+  for(int i = 1; i < argc; i++)
+  {
+    if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+      switch_no = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+    {
+      if(sscanf(argv[++i], "%d:%d", &tx_port, &rx_port) != 2 || tx_port == rx_port)
+        return usage();
+    }
+    else if(strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+      batch = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+      seconds = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-f") == 0)
+      options |= VNSTATION_FCS;
+    else
+      return usage();
+  }
+  if(batch < 1 || batch > MAX_BATCH || seconds < 1)
+    return usage();
+
+  /* the switch signals SIGUSR1 when it closes, ctrl+c stops early */
+  signal(SIGUSR1, stop);
+  signal(SIGINT, stop);
+
+  vnstation_t *tx = vnstation_attach(switch_no, TX_MAC_ADDRESS, &tx_port, 1, options);
+  if(!tx)
+    return EXIT_FAILURE;
+  vnstation_t *rx = vnstation_attach(switch_no, RX_MAC_ADDRESS, &rx_port, 1, options);
+  if(!rx)
+  {
+    vnstation_detach(tx);
+    return EXIT_FAILURE;
+  }
+  vnstation_set_filter(rx, vnstation_filter_own, rx);
+
+  static frame_t frames[MAX_BATCH], received[MAX_BATCH];
+  /* the receiver is heard once, so the switch forwards to its port instead of flooding */
+  vnstation_frame_init(rx, &frames[0], TX_MAC_ADDRESS, "*** HELLO ***");
+  vnstation_send_batch(rx, 0, frames, 1);
+  for(int i = 0; i < batch; i++)
+  {
+    vnstation_frame_init(tx, &frames[i], RX_MAC_ADDRESS, "*** BLAST ***");
+  }
+
+  unsigned int next_seq = 1, expected_seq = 1;
+  unsigned long long rx_frames = 0, lost = 0, out_of_order = 0, polls = 0;
+  int pending = 0, offset = 0;
+  struct pollfd fds[2] = {{vnstation_fd(tx), POLLIN, 0}, {vnstation_fd(rx), POLLIN, 0}};
+  unsigned long long start = now_ns(), end = start + seconds * 1000000000ULL, drain_end = 0;
+  while(running)
+  {
+    unsigned long long t = now_ns();
+    int sending = t < end;
+    if(!sending && !drain_end)
+      drain_end = t + 200000000ULL;
+    if(drain_end && t > drain_end)
+      break;
+
+    int progress = 0;
+    if(sending)
+    {
+      if(pending == 0)
+      {
+        for(int i = 0; i < batch; i++)
+          frames[i].seq = next_seq++;
+        pending = batch;
+        offset = 0;
+      }
+      int sent = vnstation_send_batch(tx, 0, frames + offset, pending);
+      if(sent == -1)
+        break;
+      pending -= sent;
+      offset += sent;
+      progress |= sent > 0;
+    }
+
+    int count = vnstation_recv_batch(rx, received, NULL, batch);
+    if(count == -1)
+      break;
+    for(int i = 0; i < count; i++)
+    {
+      unsigned int seq = received[i].seq;
+      if(seq < expected_seq)
+      {
+        out_of_order++;
+        continue;
+      }
+      lost += seq - expected_seq;
+      expected_seq = seq + 1;
+    }
+    rx_frames += count;
+    progress |= count > 0;
+
+    if(!progress)
+    {
+      /* the send mqueue is full and nothing arrived: wait for either station */
+      polls++;
+      poll(fds, 2, 10);
+    }
+  }
+  unsigned long long elapsed = now_ns() - start;
+
+  vnstation_stats_t tx_stats, rx_stats;
+  vnstation_get_stats(tx, &tx_stats);
+  vnstation_get_stats(rx, &rx_stats);
+  printf("port %d -> port %d, batches of %d frames%s\n", tx_port, rx_port, batch,
+         options & VNSTATION_FCS ? ", with fcs" : "");
+  printf("sent     %12llu frames  %10.0f frames/s  (port mqueue full %llu times, %llu polls)\n", tx_stats.tx_frames,
+         tx_stats.tx_frames * 1e9 / elapsed, tx_stats.tx_full, polls);
+  printf("received %12llu frames  %10.0f frames/s\n", rx_frames, rx_frames * 1e9 / elapsed);
+  /* frames sent after the last one received never arrived either */
+  lost += next_seq - pending - expected_seq;
+  printf("lost     %12llu frames, %llu out of order, %llu filtered, %llu bad fcs\n", lost, out_of_order,
+         rx_stats.rx_filtered, rx_stats.rx_bad_fcs);
+
+  vnstation_detach(rx);
+  vnstation_detach(tx);
+  return EXIT_SUCCESS;
+}